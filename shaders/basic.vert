@@ -8,6 +8,13 @@ layout(location = 2) in vec2 in_uv;
 layout(location = 3) in vec4 in_tangent_bitangent_sign;
 layout(location = 4) in vec3 in_color;
 
+// Packed vertices (see PackedVertex), only one of the two sets of attributes is enabled for a draw
+layout(location = 6) in vec4 in_packed_pos; // Bitangent sign in w
+layout(location = 7) in vec2 in_packed_normal;
+layout(location = 8) in vec2 in_packed_tangent;
+layout(location = 9) in vec2 in_packed_uv;
+layout(location = 10) in vec4 in_packed_color;
+
 layout(location = 0) out vec3 out_normal;
 layout(location = 1) out vec2 out_uv;
 layout(location = 2) out vec3 out_color;
@@ -19,17 +26,40 @@ layout(binding = 0) uniform Data {
     FrameData frame;
 };
 
-uniform mat4 model;
+// Index of the object in the object buffer. GL 4.5 has no gl_BaseInstance or gl_DrawID,
+// so the index comes from an instanced attribute and each draw selects its objects using base_instance.
+layout(location = 5) in uint in_object_index;
+
+layout(std430, binding = 2) readonly buffer Objects {
+    ObjectData objects[];
+};
+
+// The G-buffer pass tests for equality against the depth of depth.vert
+invariant gl_Position;
 
 void main() {
-    const vec4 position = model * vec4(in_pos, 1.0);
+    const ObjectData object = objects[in_object_index];
+
+    vec3 normal = in_normal;
+    vec4 tangent_bitangent_sign = in_tangent_bitangent_sign;
+    vec2 uv = in_uv;
+    vec3 color = in_color;
+    if(object.vertex_format != 0) {
+        normal = octahedral_decode(in_packed_normal);
+        tangent_bitangent_sign = vec4(octahedral_decode(in_packed_tangent), in_packed_pos.w > 0.5 ? 1.0 : -1.0);
+        uv = in_packed_uv;
+        color = in_packed_color.rgb;
+    }
+
+    const mat4 model = object.model;
+    const vec4 position = model * vec4(decode_position(object, in_pos, in_packed_pos), 1.0);
 
-    out_normal = normalize(mat3(model) * in_normal);
-    out_tangent = normalize(mat3(model) * in_tangent_bitangent_sign.xyz);
-    out_bitangent = cross(out_tangent, out_normal) * (in_tangent_bitangent_sign.w > 0.0 ? 1.0 : -1.0);
+    out_normal = normalize(mat3(object.normal_matrix) * normal);
+    out_tangent = normalize(mat3(model) * tangent_bitangent_sign.xyz);
+    out_bitangent = cross(out_tangent, out_normal) * (tangent_bitangent_sign.w > 0.0 ? 1.0 : -1.0);
 
-    out_uv = in_uv;
-    out_color = in_color;
+    out_uv = uv;
+    out_color = color;
     out_position = position.xyz;
 
     gl_Position = frame.camera.view_proj * position;
@@ -0,0 +1,86 @@
+#include "utils.glsl"
+
+// Frustum and hierarchical-Z occlusion tests of bounding spheres, shared by the culling shaders
+
+layout(binding = 0) uniform sampler2D in_hiz;
+
+#define DRAW_HIDDEN 0u
+#define DRAW_EARLY 1u
+#define DRAW_LATE 2u
+#define DRAW_MESHLETS 4u
+
+uniform mat4 view_proj;
+uniform mat4 hiz_view_proj;
+uniform uint hiz_valid;
+
+bool in_frustum(vec3 center, float radius) {
+    const mat4 m = transpose(view_proj);
+
+    // There is no far plane with an infinite reverse-Z projection
+    vec4 planes[5] = vec4[](
+        m[3] + m[0],
+        m[3] - m[0],
+        m[3] + m[1],
+        m[3] - m[1],
+        m[3] - m[2]
+    );
+
+    for(int i = 0; i != 5; ++i) {
+        if(dot(planes[i], vec4(center, 1.0)) < -radius * length(planes[i].xyz)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool is_occluded(vec3 center, float radius) {
+    if(hiz_valid == 0) {
+        return false;
+    }
+
+    // Screen rect and closest depth of the box around the sphere
+    vec2 min_uv = vec2(1.0);
+    vec2 max_uv = vec2(0.0);
+    float max_z = 0.0;
+    for(int i = 0; i != 8; ++i) {
+        const vec3 offset = vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);
+        const vec4 clip = hiz_view_proj * vec4(center + offset * radius, 1.0);
+        if(clip.w < 1.0e-4) {
+            // Crosses the near plane
+            return false;
+        }
+
+        const vec3 ndc = clip.xyz / clip.w;
+        const vec2 uv = ndc.xy * 0.5 + 0.5;
+        min_uv = min(min_uv, uv);
+        max_uv = max(max_uv, uv);
+        max_z = max(max_z, ndc.z);
+    }
+
+    if(any(lessThan(max_uv, vec2(0.0))) || any(greaterThan(min_uv, vec2(1.0)))) {
+        return false;
+    }
+
+    const ivec2 size = textureSize(in_hiz, 0);
+    const ivec2 min_texel = clamp(ivec2(floor(saturate(min_uv) * vec2(size))), ivec2(0), size - 1);
+    const ivec2 max_texel = clamp(ivec2(floor(saturate(max_uv) * vec2(size))), ivec2(0), size - 1);
+
+    // Pick the level where the rect covers at most 2x2 texels
+    const int level_count = textureQueryLevels(in_hiz);
+    int level = 0;
+    while(level + 1 < level_count && any(greaterThan((max_texel >> level) - (min_texel >> level), ivec2(1)))) {
+        ++level;
+    }
+
+    const ivec2 level_max = textureSize(in_hiz, level) - 1;
+    const ivec2 t0 = min(min_texel >> level, level_max);
+    const ivec2 t1 = min(max_texel >> level, level_max);
+
+    const float farthest = min(
+        min(texelFetch(in_hiz, t0, level).x, texelFetch(in_hiz, ivec2(t1.x, t0.y), level).x),
+        min(texelFetch(in_hiz, ivec2(t0.x, t1.y), level).x, texelFetch(in_hiz, t1, level).x)
+    );
+
+    // Reverse-Z: the sphere is hidden if its closest point is behind everything in the rect
+    return max_z < farthest;
+}
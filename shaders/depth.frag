@@ -0,0 +1,6 @@
+#version 450
+
+// Depth only, nothing to shade
+
+void main() {
+}
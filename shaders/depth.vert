@@ -0,0 +1,28 @@
+#version 450
+
+#include "utils.glsl"
+
+// Position only vertex shader of the depth prepass, reading the position streams of the geometry buffer
+
+layout(location = 0) in vec3 in_pos;
+layout(location = 6) in vec4 in_packed_pos;
+
+layout(location = 5) in uint in_object_index;
+
+layout(binding = 0) uniform Data {
+    FrameData frame;
+};
+
+layout(std430, binding = 2) readonly buffer Objects {
+    ObjectData objects[];
+};
+
+// Must match basic.vert exactly
+invariant gl_Position;
+
+void main() {
+    const ObjectData object = objects[in_object_index];
+    const vec4 position = object.model * vec4(decode_position(object, in_pos, in_packed_pos), 1.0);
+
+    gl_Position = frame.camera.view_proj * position;
+}
@@ -2,35 +2,25 @@
 
 #include "utils.glsl"
 
+// vertex shader of the light volumes, one instance per visible light
+
 layout(location = 0) in vec3 in_pos;
-layout(location = 1) in vec3 in_normal;
-layout(location = 2) in vec2 in_uv;
-layout(location = 3) in vec4 in_tangent_bitangent_sign;
-layout(location = 4) in vec3 in_color;
-
-layout(location = 0) out vec3 out_normal;
-layout(location = 1) out vec2 out_uv;
-layout(location = 2) out vec3 out_color;
-layout(location = 3) out vec3 out_position;
-layout(location = 4) out vec3 out_tangent;
-layout(location = 5) out vec3 out_bitangent;
+
+layout(location = 0) flat out uint out_light;
 
 layout(binding = 3) uniform Data {
     FrameData frame;
 };
 
-uniform mat4 model;
+layout(std430, binding = 4) readonly buffer PointLights {
+    PointLight point_lights[];
+};
 
 void main() {
-    const vec4 position = model * vec4(in_pos, 1.0);
-
-    out_normal = normalize(mat3(model) * in_normal);
-    out_tangent = normalize(mat3(model) * in_tangent_bitangent_sign.xyz);
-    out_bitangent = cross(out_tangent, out_normal) * (in_tangent_bitangent_sign.w > 0.0 ? 1.0 : -1.0);
+    const PointLight light = point_lights[gl_InstanceID];
+    const vec3 position = light.position + in_pos * light.radius;
 
-    out_uv = in_uv;
-    out_color = in_color;
-    out_position = position.xyz;
+    out_light = uint(gl_InstanceID);
 
-    gl_Position = frame.camera.view_proj * position;
+    gl_Position = frame.camera.view_proj * vec4(position, 1.0);
 }
@@ -26,8 +26,31 @@
         PointLight point_lights[];
     };
 
+    layout(binding = 6) uniform Clusters {
+        ClusterInfo clusters;
+    };
+
+    // Lights of cluster c are cluster_lights[cluster_offsets[c]] to cluster_lights[cluster_offsets[c + 1]]
+    layout(std430, binding = 5) readonly buffer ClusterOffsets {
+        uint cluster_offsets[];
+    };
+
+    layout(std430, binding = 6) readonly buffer ClusterLights {
+        uint cluster_lights[];
+    };
+
     const vec3 ambient = vec3(0.0);
 
+    // Must match LightClusters::cluster_index
+    uint cluster_index() {
+        // Infinite reverse-Z projection
+        const float depth = clusters.z_near / gl_FragCoord.z;
+        const float slice = floor(log(depth) * clusters.slice_scale + clusters.slice_bias);
+        const uvec2 tile = min(uvec2(gl_FragCoord.xy * clusters.tile_scale), clusters.grid_size.xy - 1);
+        const uint z = uint(clamp(slice, 0.0, float(clusters.grid_size.z - 1)));
+        return (z * clusters.grid_size.y + tile.y) * clusters.grid_size.x + tile.x;
+    }
+
     void main() {
     #ifdef NORMAL_MAPPED
         const vec3 normal_map = unpack_normal_map(texture(in_normal_texture, in_uv).xy);
@@ -40,8 +63,10 @@
 
         vec3 acc = frame.sun_color * max(0.0, dot(frame.sun_dir, normal)) + ambient;
 
-        for(uint i = 0; i != frame.point_light_count; ++i) {
-            PointLight light = point_lights[i];
+        const uint cluster = cluster_index();
+        const uint light_end = cluster_offsets[cluster + 1];
+        for(uint i = cluster_offsets[cluster]; i != light_end; ++i) {
+            PointLight light = point_lights[cluster_lights[i]];
             const vec3 to_light = (light.position - in_position);
             const float dist = length(to_light);
             const vec3 light_vec = to_light / dist;
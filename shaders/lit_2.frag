@@ -9,6 +9,8 @@
 layout(location = 0) out vec4 out_color;
 layout(location = 1) out vec4 out_normal;
 
+layout(location = 0) flat in uint in_light;
+
 
 
 layout(binding = 0) uniform sampler2D in_color;
@@ -19,8 +21,8 @@ layout(binding = 3) uniform Data {
     FrameData frame;
 };
 
-layout(binding = 4) buffer PointLights {
-        PointLight point_lights[];
+layout(std430, binding = 4) readonly buffer PointLights {
+    PointLight point_lights[];
 };
 layout(binding = 5) uniform WindowData {
     WindowSize window_size;
@@ -44,9 +46,15 @@ void main() {
     const float pixel_depth = texelFetch(in_depth, coord, 0).x;
     const vec3 pos = unproject(uv, pixel_depth, inv);
 
-    PointLight light = point_lights[0];
+    const PointLight light = point_lights[in_light];
     const vec3 to_light = (light.position - pos);
     const float dist = length(to_light);
+
+    // The volume covers the pixel on screen but the surface is outside of the light sphere (or is the sky)
+    if(pixel_depth == 0.0 || dist > light.radius) {
+        discard;
+    }
+
     const vec3 light_vec = to_light / dist;
 
     const float NoL = dot(light_vec, normal);
@@ -23,3 +23,91 @@ struct WindowSize {
     uvec2 inner;
 };
 
+
+struct DrawElementsCommand {
+    uint count;
+    uint instance_count;
+    uint first_index;
+    int base_vertex;
+    uint base_instance;
+};
+
+struct CullingStats {
+    uint tested;
+    uint frustum_culled;
+    uint occlusion_culled;
+    uint late_visible;
+    uint small_culled;
+
+    uint meshlets_tested;
+    uint meshlets_frustum_culled;
+    uint meshlets_cone_culled;
+    uint meshlets_occlusion_culled;
+
+    uint triangles_submitted;
+    uint triangles_culled;
+};
+
+struct ObjectData {
+    mat4 model;
+    mat4 normal_matrix; // Inverse transpose of the model, only the upper 3x3 is used
+
+    // Packed vertex positions are decoded as position_offset + position * position_scale
+    vec3 position_offset;
+    uint vertex_format; // VertexFormat of the mesh: 0 for full vertices, 1 for packed ones
+    vec3 position_scale;
+    float padding_1;
+};
+
+struct CullData {
+    vec4 sphere; // Center and radius
+    uint first_lod; // Levels of detail of the mesh in the LOD buffer
+    uint lod_count;
+    int base_vertex;
+    float scale; // From mesh space to world space, for LOD errors
+
+    uint meshlet_count; // 0 if the mesh isn't drawn through meshlets
+    uint padding_1;
+    uint padding_2;
+    uint padding_3;
+};
+
+struct MeshletData {
+    vec4 sphere; // Center and radius, in mesh space
+    vec3 cone_apex;
+    float cone_cutoff; // 1 for meshlets that can't be cone culled
+    vec3 cone_axis;
+    uint first_index;
+    uint index_count;
+    uint padding_1;
+    uint padding_2;
+    uint padding_3;
+};
+
+// One per meshlet of every draw split in meshlets
+struct MeshletDraw {
+    uint draw;
+    uint meshlet;
+    uint object;
+    int base_vertex;
+    uint cone_culling; // 0 for meshes whose back faces are drawn
+    uint padding_1;
+    uint padding_2;
+    uint padding_3;
+};
+
+struct LodRange {
+    uint first_index;
+    uint index_count;
+    float error; // In mesh space
+    uint padding_1;
+};
+
+struct ClusterInfo {
+    uvec3 grid_size; // Tiles in x and y, depth slices
+    float z_near;
+
+    vec2 tile_scale; // Tiles per pixel
+    float slice_scale; // slice = log(depth) * slice_scale + slice_bias
+    float slice_bias;
+};
@@ -60,3 +60,16 @@ vec3 unpack_normal_map(vec2 normal) {
     return vec3(normal, 1.0 - sqrt(dot(normal, normal)));
 }
 
+// Inverse of the octahedral encoding of OM3D::octahedral_encode
+vec3 octahedral_decode(vec2 e) {
+    vec3 v = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    const float t = max(-v.z, 0.0);
+    v.xy += mix(vec2(t), vec2(-t), greaterThanEqual(v.xy, vec2(0.0)));
+    return normalize(v);
+}
+
+// Object space position of a vertex of either format, see PackedVertex.
+// Shared by basic.vert and depth.vert so that both compute the exact same depth.
+vec3 decode_position(ObjectData object, vec3 position, vec4 packed_position) {
+    return object.vertex_format != 0 ? object.position_offset + packed_position.xyz * object.position_scale : position;
+}
@@ -0,0 +1,257 @@
+#include "BVH.h"
+
+#include <array>
+#include <algorithm>
+
+namespace OM3D {
+
+static constexpr u32 sah_bin_count = 16;
+
+void BVH::build(Span<const AABB> bounds) {
+    _nodes.clear();
+    _indices.clear();
+    _bounds.assign(bounds.begin(), bounds.end());
+
+    std::vector<glm::vec3> centers(bounds.size());
+    for(size_t i = 0; i != bounds.size(); ++i) {
+        // Objects without bounds (no mesh) can never be visible
+        if(!bounds[i].is_empty()) {
+            centers[i] = bounds[i].center();
+            _indices.push_back(u32(i));
+        }
+    }
+
+    if(_indices.empty()) {
+        return;
+    }
+
+    _nodes.reserve(2 * (_indices.size() / max_leaf_size + 1));
+    build_node(0, u32(_indices.size()), centers);
+}
+
+u32 BVH::build_node(u32 first, u32 count, Span<const glm::vec3> centers) {
+    const u32 node_index = u32(_nodes.size());
+
+    AABB bounds;
+    AABB center_bounds;
+    for(u32 i = first; i != first + count; ++i) {
+        bounds.add(_bounds[_indices[i]]);
+        center_bounds.add(centers[_indices[i]]);
+    }
+
+    {
+        Node& node = _nodes.emplace_back();
+        node.bounds = bounds;
+        node.first = first;
+        node.count = count;
+    }
+
+    if(count <= max_leaf_size) {
+        return node_index;
+    }
+
+    const auto begin = _indices.begin() + first;
+    const auto end = begin + count;
+
+    const glm::vec3 extent = center_bounds.max - center_bounds.min;
+    const int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+    u32 left_count = count / 2;
+    if(extent[axis] > 0.0f) {
+        // Binned SAH split along the largest axis of the centroid bounds
+        struct Bin {
+            AABB bounds;
+            u32 count = 0;
+        };
+
+        const float scale = float(sah_bin_count) / extent[axis];
+        auto bin_index = [&](u32 prim) {
+            return std::min(sah_bin_count - 1, u32((centers[prim][axis] - center_bounds.min[axis]) * scale));
+        };
+
+        std::array<Bin, sah_bin_count> bins;
+        for(auto it = begin; it != end; ++it) {
+            Bin& bin = bins[bin_index(*it)];
+            bin.bounds.add(_bounds[*it]);
+            ++bin.count;
+        }
+
+        std::array<float, sah_bin_count> right_cost = {};
+        {
+            AABB acc;
+            u32 acc_count = 0;
+            for(u32 i = sah_bin_count - 1; i != 0; --i) {
+                acc.add(bins[i].bounds);
+                acc_count += bins[i].count;
+                right_cost[i] = acc_count ? acc.surface_area() * float(acc_count) : 0.0f;
+            }
+        }
+
+        u32 best_split = 0;
+        float best_cost = std::numeric_limits<float>::max();
+        {
+            AABB acc;
+            u32 acc_count = 0;
+            for(u32 i = 1; i != sah_bin_count; ++i) {
+                acc.add(bins[i - 1].bounds);
+                acc_count += bins[i - 1].count;
+                if(!acc_count || acc_count == count) {
+                    continue;
+                }
+
+                const float cost = acc.surface_area() * float(acc_count) + right_cost[i];
+                if(cost < best_cost) {
+                    best_cost = cost;
+                    best_split = i;
+                }
+            }
+        }
+
+        if(best_split) {
+            const auto mid = std::partition(begin, end, [&](u32 prim) { return bin_index(prim) < best_split; });
+            left_count = u32(mid - begin);
+        }
+    }
+
+    build_node(first, left_count, centers);
+    const u32 right = build_node(first + left_count, count - left_count, centers);
+    _nodes[node_index].right = right;
+
+    return node_index;
+}
+
+void BVH::refit(Span<const AABB> bounds) {
+    ALWAYS_ASSERT(bounds.size() == _bounds.size(), "BVH primitive count changed, it needs to be rebuilt");
+    std::copy(bounds.begin(), bounds.end(), _bounds.begin());
+
+    // Children always come after their parent
+    for(size_t i = _nodes.size(); i != 0; --i) {
+        Node& node = _nodes[i - 1];
+
+        AABB node_bounds;
+        if(node.is_leaf()) {
+            for(u32 k = node.first; k != node.first + node.count; ++k) {
+                node_bounds.add(_bounds[_indices[k]]);
+            }
+        } else {
+            node_bounds = _nodes[i].bounds;
+            node_bounds.add(_nodes[node.right].bounds);
+        }
+        node.bounds = node_bounds;
+    }
+}
+
+void BVH::cull(const Frustum& frustum, std::vector<u32>& visible) const {
+    std::vector<IndexRange> partial;
+    cull(frustum, visible, partial);
+
+    for(const IndexRange& range : partial) {
+        for(u32 k = range.first; k != range.first + range.count; ++k) {
+            const u32 prim = _indices[k];
+            if(frustum.test(_bounds[prim]) != FrustumTest::Outside) {
+                visible.push_back(prim);
+            }
+        }
+    }
+}
+
+void BVH::cull(const Frustum& frustum, std::vector<u32>& visible, std::vector<IndexRange>& partial) const {
+    CullResult result;
+    result.visible.swap(visible);
+    result.partial.swap(partial);
+    cull(Span<const Frustum>(frustum), Span<CullResult>(result));
+    result.visible.swap(visible);
+    result.partial.swap(partial);
+}
+
+void BVH::cull(Span<const Frustum> frustums, Span<CullResult> results) const {
+    ALWAYS_ASSERT(frustums.size() == results.size(), "Expected one result per frustum");
+    ALWAYS_ASSERT(frustums.size() <= max_frustums, "Too many frustums");
+
+    if(_nodes.empty() || frustums.is_empty()) {
+        return;
+    }
+
+    struct StackEntry {
+        u32 node;
+        u32 mask; // Frustums this node may intersect
+    };
+
+    std::vector<StackEntry> stack;
+    stack.reserve(64);
+    stack.push_back(StackEntry{0, u32((u64(1) << frustums.size()) - 1)});
+
+    while(!stack.empty()) {
+        const auto [node_index, parent_mask] = stack.back();
+        stack.pop_back();
+
+        const Node& node = _nodes[node_index];
+
+        u32 mask = parent_mask;
+        for(u32 bits = parent_mask, f = 0; bits; bits >>= 1, ++f) {
+            if(!(bits & 1)) {
+                continue;
+            }
+
+            switch(frustums[f].test(node.bounds)) {
+                case FrustumTest::Outside:
+                    mask &= ~(1u << f);
+                break;
+
+                case FrustumTest::Inside: {
+                    // The whole subtree is visible, no need to test anything else
+                    const auto begin = _indices.begin() + node.first;
+                    results[f].visible.insert(results[f].visible.end(), begin, begin + node.count);
+                    mask &= ~(1u << f);
+                } break;
+
+                case FrustumTest::Intersecting:
+                break;
+            }
+        }
+
+        if(!mask) {
+            continue;
+        }
+
+        if(!node.is_leaf()) {
+            stack.push_back(StackEntry{node.right, mask});
+            stack.push_back(StackEntry{node_index + 1, mask});
+            continue;
+        }
+
+        for(u32 bits = mask, f = 0; bits; bits >>= 1, ++f) {
+            if(!(bits & 1)) {
+                continue;
+            }
+
+            CullResult& result = results[f];
+            if(node.count == 1) {
+                result.visible.push_back(_indices[node.first]);
+            } else if(!result.partial.empty() && result.partial.back().first + result.partial.back().count == node.first) {
+                // Leaves are contiguous in depth first order, merge ranges when possible
+                result.partial.back().count += node.count;
+            } else {
+                result.partial.push_back(IndexRange{node.first, node.count});
+            }
+        }
+    }
+}
+
+Span<const u32> BVH::primitive_order() const {
+    return _indices;
+}
+
+bool BVH::is_empty() const {
+    return _nodes.empty();
+}
+
+size_t BVH::primitive_count() const {
+    return _bounds.size();
+}
+
+Span<const BVH::Node> BVH::nodes() const {
+    return _nodes;
+}
+
+}
@@ -0,0 +1,71 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <Bounds.h>
+#include <Camera.h>
+
+#include <vector>
+
+namespace OM3D {
+
+// Bounding volume hierarchy over world space AABBs.
+// Nodes are stored depth first: the left child of an internal node immediately follows it,
+// and the primitives of any subtree are contiguous in _indices.
+class BVH {
+    public:
+        struct Node {
+            AABB bounds;
+            u32 first = 0;
+            u32 count = 0;
+            u32 right = 0; // 0 for leaves
+
+            bool is_leaf() const {
+                return !right;
+            }
+        };
+
+        static constexpr u32 max_leaf_size = 4;
+
+        BVH() = default;
+
+        void build(Span<const AABB> bounds);
+
+        // Update node bounds without changing the topology
+        void refit(Span<const AABB> bounds);
+
+        // Append the index of every primitive that is not outside the frustum
+        void cull(const Frustum& frustum, std::vector<u32>& visible) const;
+
+        struct CullResult {
+            std::vector<u32> visible;
+            std::vector<IndexRange> partial;
+        };
+
+        static constexpr size_t max_frustums = 32;
+
+        // Append the index of every primitive in subtrees fully inside the frustum,
+        // leaves that intersect it are returned as ranges of primitive_order() to be tested by the caller
+        void cull(const Frustum& frustum, std::vector<u32>& visible, std::vector<IndexRange>& partial) const;
+
+        // Same as above for several frustums in a single traversal, nodes are only tested against the frustums
+        // they are known to intersect
+        void cull(Span<const Frustum> frustums, Span<CullResult> results) const;
+
+        // Primitive indices in leaf order
+        Span<const u32> primitive_order() const;
+
+        bool is_empty() const;
+        size_t primitive_count() const;
+        Span<const Node> nodes() const;
+
+    private:
+        u32 build_node(u32 first, u32 count, Span<const glm::vec3> centers);
+
+        std::vector<Node> _nodes;
+        std::vector<u32> _indices;
+        std::vector<AABB> _bounds;
+};
+
+}
+
+#endif // BVH_H
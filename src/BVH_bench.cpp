@@ -0,0 +1,50 @@
+#include "BVH.h"
+
+#include <benchmarks.h>
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+namespace OM3D {
+
+void bench_bvh_culling() {
+    std::cout << "BVH frustum culling" << std::endl;
+
+    const Frustum frustum = benchmark_camera().build_frustum();
+
+    for(const size_t count : {1000, 10000, 100000}) {
+        const std::vector<AABB> boxes = random_boxes(count);
+        const u32 iterations = u32(std::max(size_t(10), 1000000 / count));
+
+        std::vector<u32> linear_visible;
+        const double linear = time_ms([&] {
+            linear_visible.clear();
+            for(size_t i = 0; i != boxes.size(); ++i) {
+                if(frustum.test(boxes[i]) != FrustumTest::Outside) {
+                    linear_visible.push_back(u32(i));
+                }
+            }
+        }, iterations);
+
+        BVH bvh;
+        const double build = time_ms([&] { bvh.build(boxes); });
+        const double refit = time_ms([&] { bvh.refit(boxes); }, iterations);
+
+        std::vector<u32> bvh_visible;
+        const double traversal = time_ms([&] {
+            bvh_visible.clear();
+            bvh.cull(frustum, bvh_visible);
+        }, iterations);
+
+        std::sort(bvh_visible.begin(), bvh_visible.end());
+        const bool match = (bvh_visible == linear_visible);
+
+        std::cout << "  " << std::setw(6) << count << " objects, " << std::setw(6) << linear_visible.size() << " visible: "
+                  << "linear " << linear << "ms, "
+                  << "bvh " << traversal << "ms (build " << build << "ms, refit " << refit << "ms, " << bvh.nodes().size() << " nodes)"
+                  << check_result(match, " MISMATCH") << std::endl;
+    }
+}
+
+}
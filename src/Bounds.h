@@ -0,0 +1,73 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <utils.h>
+
+#include <glm/vec3.hpp>
+#include <glm/matrix.hpp>
+
+#include <limits>
+#include <algorithm>
+
+namespace OM3D {
+
+struct AABB {
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::infinity());
+    glm::vec3 max = glm::vec3(-std::numeric_limits<float>::infinity());
+
+    bool is_empty() const {
+        return min.x > max.x || min.y > max.y || min.z > max.z;
+    }
+
+    glm::vec3 center() const {
+        return (min + max) * 0.5f;
+    }
+
+    glm::vec3 half_extent() const {
+        return (max - min) * 0.5f;
+    }
+
+    float surface_area() const {
+        const glm::vec3 e = max - min;
+        return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+    }
+
+    void add(const glm::vec3& point) {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    void add(const AABB& other) {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    // Bounds of the transformed box (Arvo's method, no need to transform all 8 corners)
+    AABB transformed(const glm::mat4& tr) const {
+        if(is_empty()) {
+            return *this;
+        }
+
+        const glm::vec3 c = glm::vec3(tr * glm::vec4(center(), 1.0f));
+        const glm::vec3 e = half_extent();
+        glm::vec3 r = {};
+        for(int i = 0; i != 3; ++i) {
+            r += glm::abs(glm::vec3(tr[i])) * e[i];
+        }
+        return AABB{c - r, c + r};
+    }
+};
+
+struct BoundingSphere {
+    glm::vec3 center = {};
+    float radius = 0.0f;
+};
+
+struct IndexRange {
+    u32 first = 0;
+    u32 count = 0;
+};
+
+}
+
+#endif // BOUNDS_H
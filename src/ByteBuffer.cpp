@@ -1,5 +1,7 @@
 #include "ByteBuffer.h"
 
+#include <GLState.h>
+
 #include <glad/gl.h>
 
 #include <iostream>
@@ -19,17 +21,18 @@ ByteBuffer::ByteBuffer(const void* data, size_t size) : _handle(create_buffer_ha
 
 ByteBuffer::~ByteBuffer() {
     if(auto handle = _handle.get()) {
+        forget_buffer(handle);
         glDeleteBuffers(1, &handle);
     }
 }
 
 void ByteBuffer::bind(BufferUsage usage) const {
-    glBindBuffer(buffer_usage_to_gl(usage), _handle.get());
+    bind_buffer(usage, _handle.get());
 }
 
 void ByteBuffer::bind(BufferUsage usage, u32 index) const {
     ALWAYS_ASSERT(usage == BufferUsage::Uniform || usage == BufferUsage::Storage, "Index bind is only available for uniform and storage buffers");
-    glBindBufferBase(buffer_usage_to_gl(usage), index, _handle.get());
+    bind_buffer_base(usage, index, _handle.get());
 }
 
 size_t ByteBuffer::byte_size() const {
@@ -40,6 +43,17 @@ BufferMapping<byte> ByteBuffer::map_bytes(AccessType access) {
     return BufferMapping<byte>(map_internal(access), byte_size(), handle());
 }
 
+void ByteBuffer::upload(const void* data, size_t size, size_t offset) {
+    DEBUG_ASSERT(offset + size <= _size);
+    glNamedBufferSubData(_handle.get(), offset, size, data);
+}
+
+void ByteBuffer::copy_to(ByteBuffer& dst, size_t size, size_t src_offset, size_t dst_offset) const {
+    DEBUG_ASSERT(src_offset + size <= _size);
+    DEBUG_ASSERT(dst_offset + size <= dst._size);
+    glCopyNamedBufferSubData(_handle.get(), dst._handle.get(), src_offset, dst_offset, size);
+}
+
 void* ByteBuffer::map_internal(AccessType access) {
     DEBUG_ASSERT(_handle.is_valid() && _size);
     return glMapNamedBuffer(_handle.get(), access_type_to_gl(access));
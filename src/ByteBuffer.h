@@ -23,9 +23,13 @@ class ByteBuffer : NonCopyable {
 
         BufferMapping<byte> map_bytes(AccessType access = AccessType::ReadWrite);
 
+        void upload(const void* data, size_t size, size_t offset = 0);
+        void copy_to(ByteBuffer& dst, size_t size, size_t src_offset = 0, size_t dst_offset = 0) const;
+
+        const GLHandle& handle() const;
+
     protected:
         void* map_internal(AccessType access);
-        const GLHandle& handle() const;
 
     private:
         GLHandle _handle;
@@ -128,6 +128,7 @@ Frustum Camera::build_frustum() const {
     const glm::vec3 camera_right = right();
 
     Frustum frustum;
+    frustum._origin = position();
     frustum._near_normal = camera_forward;
 
     const float half_fov = fov() * 0.5f;
@@ -148,4 +149,37 @@ Frustum Camera::build_frustum() const {
     return frustum;
 }
 
+FrustumTest Frustum::test(const AABB& box) const {
+    // Their center and extent are NaN, which would pass every plane
+    if(box.is_empty()) {
+        return FrustumTest::Outside;
+    }
+
+    const glm::vec3 center = box.center() - _origin;
+    const glm::vec3 extent = box.half_extent();
+
+    FrustumTest result = FrustumTest::Inside;
+    for(const glm::vec3& normal : {_near_normal, _top_normal, _bottom_normal, _right_normal, _left_normal}) {
+        const float dist = glm::dot(normal, center);
+        const float radius = glm::dot(glm::abs(normal), extent);
+        if(dist < -radius) {
+            return FrustumTest::Outside;
+        }
+        if(dist < radius) {
+            result = FrustumTest::Intersecting;
+        }
+    }
+    return result;
+}
+
+bool Frustum::intersects(const BoundingSphere& sphere) const {
+    const glm::vec3 center = sphere.center - _origin;
+    for(const glm::vec3& normal : {_near_normal, _top_normal, _bottom_normal, _right_normal, _left_normal}) {
+        if(glm::dot(normal, center) < -sphere.radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
 }
@@ -4,9 +4,16 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <utils.h>
+#include <Bounds.h>
 
 namespace OM3D {
 
+enum class FrustumTest {
+    Outside,
+    Intersecting,
+    Inside
+};
+
 struct Frustum {
     glm::vec3 _near_normal;
     // No far plane (zFar is +inf)
@@ -14,6 +21,13 @@ struct Frustum {
     glm::vec3 _bottom_normal;
     glm::vec3 _right_normal;
     glm::vec3 _left_normal;
+
+    // All planes go through the camera position
+    glm::vec3 _origin;
+
+    // Empty boxes (objects without a mesh) are outside
+    FrustumTest test(const AABB& box) const;
+    bool intersects(const BoundingSphere& sphere) const;
 };
 
 
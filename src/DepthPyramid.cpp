@@ -0,0 +1,57 @@
+#include "DepthPyramid.h"
+
+#include <glad/gl.h>
+
+namespace OM3D {
+
+static constexpr u32 group_size = 8;
+
+static void dispatch(const glm::uvec2& size) {
+    glDispatchCompute((size.x + group_size - 1) / group_size, (size.y + group_size - 1) / group_size, 1);
+}
+
+DepthPyramid::DepthPyramid(const glm::uvec2& size) :
+    _texture(size, ImageFormat::R32_FLOAT, Texture::mip_levels(size)),
+    _from_depth_program(Program::from_file("hiz.comp", {"FROM_DEPTH"})),
+    _downsample_program(Program::from_file("hiz.comp")) {
+}
+
+void DepthPyramid::build(const Texture& depth, const glm::mat4& view_proj) {
+    DEBUG_ASSERT(depth.size() == _texture.size());
+
+    // Make the depth written by previous draws visible
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    _from_depth_program->bind();
+    depth.bind(0);
+    _texture.bind_as_image(1, AccessType::WriteOnly, 0);
+    dispatch(_texture.size());
+
+    _downsample_program->bind();
+    for(u32 level = 1; level != _texture.mip_count(); ++level) {
+        glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+        _texture.bind_as_image(0, AccessType::ReadOnly, level - 1);
+        _texture.bind_as_image(1, AccessType::WriteOnly, level);
+        dispatch(glm::max(glm::uvec2(1), _texture.size() >> level));
+    }
+
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    _view_proj = view_proj;
+    _valid = true;
+}
+
+void DepthPyramid::bind(u32 index) const {
+    _texture.bind(index);
+}
+
+bool DepthPyramid::is_valid() const {
+    return _valid;
+}
+
+const glm::mat4& DepthPyramid::view_proj() const {
+    return _view_proj;
+}
+
+}
@@ -0,0 +1,42 @@
+#ifndef DEPTHPYRAMID_H
+#define DEPTHPYRAMID_H
+
+#include <Texture.h>
+#include <Program.h>
+
+#include <glm/mat4x4.hpp>
+
+#include <memory>
+
+namespace OM3D {
+
+// Hierarchical depth buffer: a R32F mip chain where every texel holds the farthest depth it covers.
+// It remembers the view_proj used to render the depth so that it can be reprojected by the next frame.
+class DepthPyramid : NonCopyable {
+    public:
+        DepthPyramid() = default;
+        DepthPyramid(DepthPyramid&&) = default;
+        DepthPyramid& operator=(DepthPyramid&&) = default;
+
+        DepthPyramid(const glm::uvec2& size);
+
+        void build(const Texture& depth, const glm::mat4& view_proj);
+
+        void bind(u32 index) const;
+
+        // False until build has been called at least once
+        bool is_valid() const;
+        const glm::mat4& view_proj() const;
+
+    private:
+        Texture _texture;
+        std::shared_ptr<Program> _from_depth_program;
+        std::shared_ptr<Program> _downsample_program;
+
+        glm::mat4 _view_proj = glm::mat4(1.0f);
+        bool _valid = false;
+};
+
+}
+
+#endif // DEPTHPYRAMID_H
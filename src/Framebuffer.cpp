@@ -1,30 +1,29 @@
 #include "Framebuffer.h"
 
+#include <GLState.h>
+
 #include <glm/vec4.hpp>
 
 #include <glad/gl.h>
 
 namespace OM3D {
 
+// Reads the shadow state instead of querying GL, which would stall the driver
 struct WriteMask {
-    GLboolean color[4] = {};
-    GLboolean depth = {};
+    bool color = true;
+    bool depth = true;
 
     static WriteMask get() {
-        WriteMask mask = {};
-        glGetBooleanv(GL_DEPTH_WRITEMASK, &mask.depth);
-        glGetBooleanv(GL_COLOR_WRITEMASK, mask.color);
-        return mask;
+        return WriteMask{color_write(), depth_write()};
     }
 
     static void set(WriteMask mask) {
-        glColorMask(mask.color[0], mask.color[1], mask.color[2], mask.color[3]);
-        glDepthMask(mask.depth);
+        set_color_write(mask.color);
+        set_depth_write(mask.depth);
     }
 
     static void set_all() {
-        glColorMask(true, true, true, true);
-        glDepthMask(true);
+        set({true, true});
     }
 };
 
@@ -34,8 +33,6 @@ static GLuint create_framebuffer_handle() {
     return handle;
 }
 
-
-
 Framebuffer::Framebuffer() {
 }
 
@@ -73,14 +70,15 @@ Framebuffer::Framebuffer(Texture* depth, Texture** colors, size_t count) : _hand
 
 Framebuffer::~Framebuffer() {
     if(u32 handle = _handle.get()) {
+        forget_framebuffer(handle);
         glDeleteFramebuffers(1, &handle);
     }
 }
 
 
 void Framebuffer::bind(bool clear_depth, bool clear_color) const {
-    glBindFramebuffer(GL_FRAMEBUFFER, _handle.get());
-    glViewport(0, 0, _size.x, _size.y);
+    bind_framebuffer(_handle.get());
+    set_viewport(_size);
 
     GLenum clear_mask = 0;
     if(clear_color) {
@@ -104,17 +102,15 @@ void Framebuffer::blit(bool depth) const {
     DEFER(WriteMask::set(mask));
     WriteMask::set_all();
 
-    i32 binding = 0;
-    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &binding);
-    ALWAYS_ASSERT(u32(binding) != _handle.get(), "Framebuffer is bound");
+    const u32 binding = bound_framebuffer();
+    ALWAYS_ASSERT(binding != _handle.get(), "Framebuffer is bound");
 
-    int viewport[4] = {};
-    glGetIntegerv(GL_VIEWPORT, viewport);
+    const glm::uvec2& viewport = viewport_size();
 
     glBlitNamedFramebuffer(
         _handle.get(), binding,
         0, 0, _size.x, _size.y,
-        0, 0, viewport[2], viewport[3],
+        0, 0, viewport.x, viewport.y,
         GL_COLOR_BUFFER_BIT | (depth ? GL_DEPTH_BUFFER_BIT : 0), GL_NEAREST);
 }
 
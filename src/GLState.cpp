@@ -0,0 +1,356 @@
+#include "GLState.h"
+
+#include <glad/gl.h>
+
+#include <array>
+#include <unordered_map>
+
+namespace OM3D {
+
+static constexpr u32 max_texture_units = 32;
+static constexpr u32 max_buffer_bindings = 16;
+static constexpr u32 buffer_usage_count = u32(BufferUsage::Indirect) + 1;
+static constexpr u32 max_vertex_buffer_bindings = 16;
+
+struct IndexedBinding {
+    u32 handle = 0;
+    // Both 0 for whole buffer binds
+    size_t offset = 0;
+    size_t size = 0;
+
+    bool operator==(const IndexedBinding& other) const {
+        return handle == other.handle && offset == other.offset && size == other.size;
+    }
+};
+
+struct VertexBufferBinding {
+    u32 handle = 0;
+    size_t offset = 0;
+    u32 stride = 0;
+
+    bool operator==(const VertexBufferBinding& other) const {
+        return handle == other.handle && offset == other.offset && stride == other.stride;
+    }
+};
+
+struct VertexArrayBindings {
+    u32 element_buffer = 0;
+    std::array<VertexBufferBinding, max_vertex_buffer_bindings> vertex_buffers = {};
+};
+
+// Starts with the GL defaults of a fresh context
+struct ShadowState {
+    u32 program = 0;
+    std::array<u32, max_texture_units> textures = {};
+    std::array<u32, buffer_usage_count> buffers = {};
+    std::array<std::array<IndexedBinding, max_buffer_bindings>, 2> indexed_buffers = {};
+    u32 framebuffer = 0;
+    glm::uvec2 viewport = {};
+
+    u32 vertex_array = 0;
+    std::unordered_map<u32, VertexArrayBindings> vertex_arrays;
+
+    bool blend = false;
+    std::array<GLenum, 2> blend_func = {GL_ONE, GL_ZERO};
+
+    bool depth_test = false;
+    GLenum depth_func = GL_LESS;
+
+    bool cull = false;
+    GLenum cull_face = GL_BACK;
+
+    bool depth_write = true;
+    bool color_write = true;
+};
+
+static ShadowState state;
+static GLCallStats call_stats;
+
+// Returns true if the call has to be issued
+template<typename T>
+static bool update(T& cached, const T& value) {
+    if(cached == value) {
+        ++call_stats.filtered;
+        return false;
+    }
+    cached = value;
+    ++call_stats.issued;
+    return true;
+}
+
+static IndexedBinding* indexed_buffer_slot(BufferUsage usage, u32 index) {
+    if(index >= max_buffer_bindings) {
+        return nullptr;
+    }
+    switch(usage) {
+        case BufferUsage::Uniform:
+            return &state.indexed_buffers[0][index];
+
+        case BufferUsage::Storage:
+            return &state.indexed_buffers[1][index];
+
+        default:
+            return nullptr;
+    }
+}
+
+static void set_enabled(bool& cached, GLenum cap, bool enabled) {
+    if(update(cached, enabled)) {
+        enabled ? glEnable(cap) : glDisable(cap);
+    }
+}
+
+void bind_program(u32 handle) {
+    if(update(state.program, handle)) {
+        ++call_stats.program_binds;
+        glUseProgram(handle);
+    }
+}
+
+void bind_texture_unit(u32 unit, u32 handle) {
+    if(unit >= max_texture_units) {
+        ++call_stats.issued;
+        ++call_stats.texture_binds;
+        glBindTextureUnit(unit, handle);
+        return;
+    }
+    if(update(state.textures[unit], handle)) {
+        ++call_stats.texture_binds;
+        glBindTextureUnit(unit, handle);
+    }
+}
+
+void bind_buffer(BufferUsage usage, u32 handle) {
+    if(update(state.buffers[u32(usage)], handle)) {
+        glBindBuffer(buffer_usage_to_gl(usage), handle);
+        if(usage == BufferUsage::Index) {
+            // The index buffer binding is part of the bound vertex array
+            state.vertex_arrays[state.vertex_array].element_buffer = handle;
+        }
+    }
+}
+
+void bind_buffer_base(BufferUsage usage, u32 index, u32 handle) {
+    IndexedBinding* slot = indexed_buffer_slot(usage, index);
+    if(!slot) {
+        ++call_stats.issued;
+    } else if(!update(*slot, IndexedBinding{handle, 0, 0})) {
+        return;
+    }
+
+    glBindBufferBase(buffer_usage_to_gl(usage), index, handle);
+    // Indexed binds also change the generic binding point
+    state.buffers[u32(usage)] = handle;
+}
+
+void bind_buffer_range(BufferUsage usage, u32 index, u32 handle, size_t offset, size_t size) {
+    IndexedBinding* slot = indexed_buffer_slot(usage, index);
+    if(!slot) {
+        ++call_stats.issued;
+    } else if(!update(*slot, IndexedBinding{handle, offset, size})) {
+        return;
+    }
+
+    glBindBufferRange(buffer_usage_to_gl(usage), index, handle, offset, size);
+    state.buffers[u32(usage)] = handle;
+}
+
+void bind_framebuffer(u32 handle) {
+    if(update(state.framebuffer, handle)) {
+        glBindFramebuffer(GL_FRAMEBUFFER, handle);
+    }
+}
+
+void bind_vertex_array(u32 handle) {
+    if(update(state.vertex_array, handle)) {
+        glBindVertexArray(handle);
+        state.buffers[u32(BufferUsage::Index)] = state.vertex_arrays[handle].element_buffer;
+    }
+}
+
+void bind_vertex_buffer(u32 vertex_array, u32 binding, u32 handle, size_t offset, u32 stride) {
+    VertexArrayBindings& bindings = state.vertex_arrays[vertex_array];
+    if(binding >= max_vertex_buffer_bindings) {
+        ++call_stats.issued;
+    } else if(!update(bindings.vertex_buffers[binding], VertexBufferBinding{handle, offset, stride})) {
+        return;
+    }
+    glVertexArrayVertexBuffer(vertex_array, binding, handle, offset, stride);
+}
+
+void bind_element_buffer(u32 vertex_array, u32 handle) {
+    VertexArrayBindings& bindings = state.vertex_arrays[vertex_array];
+    if(update(bindings.element_buffer, handle)) {
+        glVertexArrayElementBuffer(vertex_array, handle);
+        if(vertex_array == state.vertex_array) {
+            state.buffers[u32(BufferUsage::Index)] = handle;
+        }
+    }
+}
+
+void set_viewport(const glm::uvec2& size) {
+    if(update(state.viewport, size)) {
+        glViewport(0, 0, size.x, size.y);
+    }
+}
+
+void set_blend_mode(BlendMode blend) {
+    set_enabled(state.blend, GL_BLEND, blend != BlendMode::None);
+
+    std::array<GLenum, 2> func = state.blend_func;
+    switch(blend) {
+        case BlendMode::None:
+            return;
+
+        case BlendMode::Alpha:
+            func = {GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA};
+        break;
+
+        case BlendMode::Add:
+            func = {GL_SRC_ALPHA, GL_SRC_ALPHA};
+        break;
+    }
+
+    if(update(state.blend_func, func)) {
+        glBlendFunc(func[0], func[1]);
+    }
+}
+
+void set_depth_test_mode(DepthTestMode depth) {
+    set_enabled(state.depth_test, GL_DEPTH_TEST, depth != DepthTestMode::None);
+
+    GLenum func = state.depth_func;
+    switch(depth) {
+        case DepthTestMode::None:
+            return;
+
+        case DepthTestMode::Equal:
+            func = GL_EQUAL;
+        break;
+
+        case DepthTestMode::Standard:
+            // We are using reverse-Z
+            func = GL_GEQUAL;
+        break;
+
+        case DepthTestMode::Reversed:
+            // We are using reverse-Z
+            func = GL_LEQUAL;
+        break;
+    }
+
+    if(update(state.depth_func, func)) {
+        glDepthFunc(func);
+    }
+}
+
+void set_depth_write(bool write) {
+    if(update(state.depth_write, write)) {
+        glDepthMask(write);
+    }
+}
+
+void set_color_write(bool write) {
+    if(update(state.color_write, write)) {
+        glColorMask(write, write, write, write);
+    }
+}
+
+void set_cull_mode(CullMode cull) {
+    set_enabled(state.cull, GL_CULL_FACE, cull != CullMode::None);
+    if(cull == CullMode::None) {
+        return;
+    }
+
+    const GLenum face = (cull == CullMode::Front ? GL_FRONT : GL_BACK);
+    if(update(state.cull_face, face)) {
+        glCullFace(face);
+    }
+}
+
+u32 bound_framebuffer() {
+    return state.framebuffer;
+}
+
+const glm::uvec2& viewport_size() {
+    return state.viewport;
+}
+
+bool depth_write() {
+    return state.depth_write;
+}
+
+bool color_write() {
+    return state.color_write;
+}
+
+void forget_program(u32 handle) {
+    if(state.program == handle) {
+        // Deleting the bound program doesn't unbind it, but the name can be reused
+        state.program = u32(-1);
+    }
+}
+
+void forget_texture(u32 handle) {
+    // Deleted textures are unbound from every unit
+    for(u32& texture : state.textures) {
+        if(texture == handle) {
+            texture = 0;
+        }
+    }
+}
+
+void forget_buffer(u32 handle) {
+    // Deleted buffers are unbound from the generic binding points only
+    for(u32& buffer : state.buffers) {
+        if(buffer == handle) {
+            buffer = 0;
+        }
+    }
+    for(auto& bindings : state.indexed_buffers) {
+        for(IndexedBinding& binding : bindings) {
+            if(binding.handle == handle) {
+                binding.handle = u32(-1);
+            }
+        }
+    }
+    // Vertex arrays that aren't bound keep referencing the deleted buffer, under a name that can be reused
+    for(auto& [vertex_array, bindings] : state.vertex_arrays) {
+        if(bindings.element_buffer == handle) {
+            bindings.element_buffer = u32(-1);
+        }
+        for(VertexBufferBinding& binding : bindings.vertex_buffers) {
+            if(binding.handle == handle) {
+                binding.handle = u32(-1);
+            }
+        }
+    }
+}
+
+void forget_framebuffer(u32 handle) {
+    // Deleting the bound framebuffer reverts to the default one
+    if(state.framebuffer == handle) {
+        state.framebuffer = 0;
+    }
+}
+
+void forget_vertex_array(u32 handle) {
+    // Deleting the bound vertex array reverts to the default one
+    if(state.vertex_array == handle) {
+        state.vertex_array = 0;
+        state.buffers[u32(BufferUsage::Index)] = state.vertex_arrays[0].element_buffer;
+    }
+    state.vertex_arrays.erase(handle);
+}
+
+GLCallStats reset_gl_call_stats() {
+    const GLCallStats stats = call_stats;
+    call_stats = {};
+    return stats;
+}
+
+const GLCallStats& gl_call_stats() {
+    return call_stats;
+}
+
+}
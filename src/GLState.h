@@ -0,0 +1,78 @@
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+#include <graphics.h>
+
+#include <glm/vec2.hpp>
+
+namespace OM3D {
+
+enum class BlendMode {
+    None,
+    Alpha,
+    Add,
+};
+
+enum class DepthTestMode {
+    Standard,
+    Reversed,
+    Equal,
+    None
+};
+
+enum class CullMode {
+    None,
+    Back,
+    Front,
+};
+
+// Number of GL state calls that reached the driver versus the ones dropped because the state was already set
+struct GLCallStats {
+    u32 issued = 0;
+    u32 filtered = 0;
+    // Issued program and texture binds, also counted in issued
+    u32 program_binds = 0;
+    u32 texture_binds = 0;
+};
+
+// Shadow copy of the GL state: every function below only calls into GL if the value differs from the cached one.
+// Everything that changes these states must go through here, or the cache will be out of sync.
+void bind_program(u32 handle);
+void bind_texture_unit(u32 unit, u32 handle);
+void bind_buffer(BufferUsage usage, u32 handle);
+void bind_buffer_base(BufferUsage usage, u32 index, u32 handle);
+void bind_buffer_range(BufferUsage usage, u32 index, u32 handle, size_t offset, size_t size);
+void bind_framebuffer(u32 handle);
+
+// Vertex array bindings are cached per vertex array, and set with DSA so that the vertex array doesn't have to be bound
+void bind_vertex_array(u32 handle);
+void bind_vertex_buffer(u32 vertex_array, u32 binding, u32 handle, size_t offset, u32 stride);
+void bind_element_buffer(u32 vertex_array, u32 handle);
+
+void set_viewport(const glm::uvec2& size);
+void set_blend_mode(BlendMode blend);
+void set_depth_test_mode(DepthTestMode depth);
+void set_depth_write(bool write);
+void set_color_write(bool write);
+void set_cull_mode(CullMode cull);
+
+u32 bound_framebuffer();
+const glm::uvec2& viewport_size();
+bool depth_write();
+bool color_write();
+
+// Called when GL objects are deleted, as their names can be reused by new objects
+void forget_program(u32 handle);
+void forget_texture(u32 handle);
+void forget_buffer(u32 handle);
+void forget_framebuffer(u32 handle);
+void forget_vertex_array(u32 handle);
+
+// Returns the counters accumulated since the last call and resets them
+GLCallStats reset_gl_call_stats();
+// Counters accumulated since the last reset
+const GLCallStats& gl_call_stats();
+
+}
+
+#endif // GLSTATE_H
@@ -0,0 +1,217 @@
+#include "GeometryBuffer.h"
+
+#include <VertexArray.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace OM3D {
+
+static constexpr u32 min_capacity = 64 * 1024;
+
+GeometryBuffer& GeometryBuffer::global() {
+    static GeometryBuffer buffer;
+    return buffer;
+}
+
+template<typename... Ts>
+u32 GeometryBuffer::allocate(RangeAllocator& allocator, u32 count, std::unique_ptr<TypedBuffer<Ts>>&... buffers) {
+    u32 offset = allocator.allocate(count);
+    if(offset == RangeAllocator::invalid_offset) {
+        // Grow geometrically so that loading n meshes is linear
+        const u32 capacity = allocator.capacity();
+        const u32 new_capacity = std::max({min_capacity, capacity * 2, capacity + count});
+        (resize(buffers, capacity, new_capacity), ...);
+        allocator.grow(new_capacity);
+        ++_buffer_growths;
+
+        offset = allocator.allocate(count);
+        DEBUG_ASSERT(offset != RangeAllocator::invalid_offset);
+    }
+    return offset;
+}
+
+template<typename T>
+void GeometryBuffer::resize(std::unique_ptr<TypedBuffer<T>>& buffer, u32 capacity, u32 new_capacity) {
+    auto new_buffer = std::make_unique<TypedBuffer<T>>(nullptr, new_capacity);
+    if(buffer && capacity) {
+        // Free ranges are copied too, it is cheaper than one copy per live range
+        buffer->copy_to(*new_buffer, capacity * sizeof(T));
+        _bytes_copied += capacity * sizeof(T);
+    }
+    buffer = std::move(new_buffer);
+}
+
+template<typename T>
+void GeometryBuffer::upload(TypedBuffer<T>& buffer, u32 offset, Span<const T> data) {
+    buffer.upload(data.data(), data.size() * sizeof(T), offset * sizeof(T));
+    _bytes_uploaded += data.size() * sizeof(T);
+}
+
+// Empty ranges are never allocated, so that every allocation owns at least one element
+MeshRange GeometryBuffer::add(Span<const Vertex> vertices, Span<const u32> indices) {
+    MeshRange range;
+    range.format = VertexFormat::Full;
+    range.vertex_count = u32(vertices.size());
+    range.index_count = u32(indices.size());
+
+    if(range.vertex_count) {
+        std::vector<glm::vec3> positions(vertices.size());
+        std::transform(vertices.begin(), vertices.end(), positions.begin(), [](const Vertex& vertex) { return vertex.position; });
+
+        range.first_vertex = allocate(_vertex_allocator, range.vertex_count, _vertices, _positions);
+        upload(*_vertices, range.first_vertex, vertices);
+        upload(*_positions, range.first_vertex, Span<const glm::vec3>(positions));
+    }
+    if(range.index_count) {
+        range.first_index = allocate(_index_allocator, range.index_count, _indices);
+        upload(*_indices, range.first_index, indices);
+    }
+
+    return range;
+}
+
+MeshRange GeometryBuffer::add(Span<const PackedVertex> vertices, Span<const u32> indices) {
+    MeshRange range;
+    range.format = VertexFormat::Packed;
+    range.vertex_count = u32(vertices.size());
+    range.index_count = u32(indices.size());
+
+    if(range.vertex_count) {
+        std::vector<glm::u16vec4> positions(vertices.size());
+        std::transform(vertices.begin(), vertices.end(), positions.begin(), [](const PackedVertex& vertex) {
+            return glm::u16vec4(vertex.position[0], vertex.position[1], vertex.position[2], vertex.position[3]);
+        });
+
+        range.first_vertex = allocate(_packed_vertex_allocator, range.vertex_count, _packed_vertices, _packed_positions);
+        upload(*_packed_vertices, range.first_vertex, vertices);
+        upload(*_packed_positions, range.first_vertex, Span<const glm::u16vec4>(positions));
+    }
+    if(range.index_count) {
+        range.first_index = allocate(_index_allocator, range.index_count, _indices);
+        upload(*_indices, range.first_index, indices);
+    }
+
+    return range;
+}
+
+void GeometryBuffer::remove(const MeshRange& range) {
+    if(range.vertex_count) {
+        (range.format == VertexFormat::Packed ? _packed_vertex_allocator : _vertex_allocator).free(range.first_vertex);
+    }
+    if(range.index_count) {
+        _index_allocator.free(range.first_index);
+    }
+}
+
+// Vertex layouts, every layout reads the object index from the last binding
+using FullStream = VertexStream<sizeof(Vertex), 0,
+    Attribute<0, AttributeType::Float, 3, offsetof(Vertex, position)>,
+    Attribute<1, AttributeType::Float, 3, offsetof(Vertex, normal)>,
+    Attribute<2, AttributeType::Float, 2, offsetof(Vertex, uv)>,
+    Attribute<3, AttributeType::Float, 4, offsetof(Vertex, tangent_bitangent_sign)>,
+    Attribute<4, AttributeType::Float, 3, offsetof(Vertex, color)>>;
+
+using PackedStream = VertexStream<sizeof(PackedVertex), 0,
+    // Position and bitangent sign
+    Attribute<GeometryBuffer::first_packed_attribute, AttributeType::U16, 4, offsetof(PackedVertex, position), AttributeKind::Normalized>,
+    // Octahedral normal and tangent
+    Attribute<GeometryBuffer::first_packed_attribute + 1, AttributeType::I16, 2, offsetof(PackedVertex, normal), AttributeKind::Normalized>,
+    Attribute<GeometryBuffer::first_packed_attribute + 2, AttributeType::I16, 2, offsetof(PackedVertex, tangent), AttributeKind::Normalized>,
+    Attribute<GeometryBuffer::first_packed_attribute + 3, AttributeType::HalfFloat, 2, offsetof(PackedVertex, uv)>,
+    Attribute<GeometryBuffer::first_packed_attribute + 4, AttributeType::U8, 4, offsetof(PackedVertex, color), AttributeKind::Normalized>>;
+
+using PositionStream = VertexStream<sizeof(glm::vec3), 0, Attribute<0, AttributeType::Float, 3, 0>>;
+using PackedPositionStream = VertexStream<sizeof(glm::u16vec4), 0, Attribute<GeometryBuffer::first_packed_attribute, AttributeType::U16, 4, 0, AttributeKind::Normalized>>;
+
+using ObjectIndexStream = VertexStream<sizeof(u32), 1, Attribute<GeometryBuffer::object_index_attribute, AttributeType::U32, 1, 0, AttributeKind::Integer>>;
+
+// 0 when the object index attribute is disabled
+static u32 object_index_buffer = 0;
+static size_t object_index_offset = 0;
+
+template<typename Stream>
+static void bind_vertex_array(const ByteBuffer& vertices, const ByteBuffer& indices) {
+    const VertexArray& vertex_array = object_index_buffer
+        ? VertexArray::get<Stream, ObjectIndexStream>()
+        : VertexArray::get<Stream>();
+
+    vertex_array.bind();
+    vertex_array.bind_index_buffer(indices.handle().get());
+    vertex_array.bind_vertex_buffer(0, vertices.handle().get());
+    if(object_index_buffer) {
+        vertex_array.bind_vertex_buffer(1, object_index_buffer, object_index_offset);
+    }
+}
+
+void GeometryBuffer::bind(VertexFormat format) const {
+    DEBUG_ASSERT(_indices);
+
+    if(format == VertexFormat::Packed) {
+        DEBUG_ASSERT(_packed_vertices);
+        bind_vertex_array<PackedStream>(*_packed_vertices, *_indices);
+    } else {
+        DEBUG_ASSERT(_vertices);
+        bind_vertex_array<FullStream>(*_vertices, *_indices);
+    }
+}
+
+void GeometryBuffer::bind_positions(VertexFormat format) const {
+    DEBUG_ASSERT(_indices);
+
+    if(format == VertexFormat::Packed) {
+        DEBUG_ASSERT(_packed_positions);
+        bind_vertex_array<PackedPositionStream>(*_packed_positions, *_indices);
+    } else {
+        DEBUG_ASSERT(_positions);
+        bind_vertex_array<PositionStream>(*_positions, *_indices);
+    }
+}
+
+void GeometryBuffer::set_object_index_buffer(u32 buffer, size_t offset) {
+    object_index_buffer = buffer;
+    object_index_offset = offset;
+}
+
+void GeometryBuffer::disable_object_index_attribute() {
+    object_index_buffer = 0;
+    object_index_offset = 0;
+}
+
+u32 GeometryBuffer::vertex_count() const {
+    return _vertex_allocator.used();
+}
+
+u32 GeometryBuffer::packed_vertex_count() const {
+    return _packed_vertex_allocator.used();
+}
+
+u32 GeometryBuffer::index_count() const {
+    return _index_allocator.used();
+}
+
+u64 GeometryBuffer::Stats::capacity_bytes() const {
+    return u64(vertices.capacity) * (sizeof(Vertex) + sizeof(glm::vec3)) +
+           u64(packed_vertices.capacity) * (sizeof(PackedVertex) + sizeof(glm::u16vec4)) +
+           u64(indices.capacity) * sizeof(u32);
+}
+
+u64 GeometryBuffer::Stats::used_bytes() const {
+    return u64(vertices.used) * (sizeof(Vertex) + sizeof(glm::vec3)) +
+           u64(packed_vertices.used) * (sizeof(PackedVertex) + sizeof(glm::u16vec4)) +
+           u64(indices.used) * sizeof(u32);
+}
+
+GeometryBuffer::Stats GeometryBuffer::stats() const {
+    Stats stats;
+    stats.vertices = _vertex_allocator.stats();
+    stats.packed_vertices = _packed_vertex_allocator.stats();
+    stats.indices = _index_allocator.stats();
+    stats.bytes_uploaded = _bytes_uploaded;
+    stats.bytes_copied = _bytes_copied;
+    stats.buffer_growths = _buffer_growths;
+    return stats;
+}
+
+}
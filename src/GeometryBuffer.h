@@ -0,0 +1,106 @@
+#ifndef GEOMETRYBUFFER_H
+#define GEOMETRYBUFFER_H
+
+#include <TypedBuffer.h>
+#include <Vertex.h>
+#include <RangeAllocator.h>
+
+#include <glm/ext/vector_uint4_sized.hpp>
+
+#include <memory>
+
+namespace OM3D {
+
+// Where a mesh lives in the geometry buffer, first_vertex is in the vertex buffer of its format
+struct MeshRange {
+    VertexFormat format = VertexFormat::Full;
+    u32 first_vertex = 0;
+    u32 vertex_count = 0;
+    u32 first_index = 0;
+    u32 index_count = 0;
+};
+
+// Vertices and indices of every mesh in a single pair of buffers,
+// so that meshes can be drawn together using base vertices and multi-draw-indirect.
+// Packed vertices live in their own vertex buffer, meshes of different formats can't be drawn together.
+// Both vertex buffers have a tightly packed copy of their positions, for depth only passes.
+// Meshes are sub-allocated with a best fit free list, so that they can be streamed in and out without leaking space.
+// Buffers grow geometrically when full, ranges never move.
+class GeometryBuffer : NonMovable {
+    public:
+        struct Stats {
+            RangeAllocator::Stats vertices;
+            RangeAllocator::Stats packed_vertices;
+            RangeAllocator::Stats indices;
+
+            u64 bytes_uploaded = 0;
+            // Copied on the GPU when growing the buffers
+            u64 bytes_copied = 0;
+            u32 buffer_growths = 0;
+
+            // Allocated bytes of all the buffers
+            u64 capacity_bytes() const;
+            u64 used_bytes() const;
+        };
+
+        static GeometryBuffer& global();
+
+        MeshRange add(Span<const Vertex> vertices, Span<const u32> indices);
+        MeshRange add(Span<const PackedVertex> vertices, Span<const u32> indices);
+        // The range can be reused by meshes added later, it must not be drawn anymore
+        void remove(const MeshRange& range);
+
+        // Bind the vertex array of the format and its buffers, the attributes of the other format are disabled
+        void bind(VertexFormat format = VertexFormat::Full) const;
+        // Same, with only the position attribute, read from the position stream
+        void bind_positions(VertexFormat format) const;
+
+        // Packed vertices use their own attributes, so that basic.vert can read both formats
+        static constexpr u32 first_packed_attribute = 6;
+
+        // Instanced attribute carrying the object index of every instance, read by basic.vert and depth.vert.
+        // Reads u32s from buffer, starting at offset, in the draws following the next bind.
+        static constexpr u32 object_index_attribute = 5;
+        static void set_object_index_buffer(u32 buffer, size_t offset = 0);
+        // For instanced draws that don't read it, so that it never fetches past the end of its buffer
+        static void disable_object_index_attribute();
+
+        // Live vertices and indices
+        u32 vertex_count() const;
+        u32 packed_vertex_count() const;
+        u32 index_count() const;
+
+        Stats stats() const;
+
+    private:
+        GeometryBuffer() = default;
+
+        // Allocates count elements, growing the buffers sharing the allocator if needed
+        template<typename... Ts>
+        u32 allocate(RangeAllocator& allocator, u32 count, std::unique_ptr<TypedBuffer<Ts>>&... buffers);
+
+        template<typename T>
+        void resize(std::unique_ptr<TypedBuffer<T>>& buffer, u32 capacity, u32 new_capacity);
+
+        template<typename T>
+        void upload(TypedBuffer<T>& buffer, u32 offset, Span<const T> data);
+
+        std::unique_ptr<TypedBuffer<Vertex>> _vertices;
+        std::unique_ptr<TypedBuffer<PackedVertex>> _packed_vertices;
+        std::unique_ptr<TypedBuffer<glm::vec3>> _positions;
+        std::unique_ptr<TypedBuffer<glm::u16vec4>> _packed_positions;
+        std::unique_ptr<TypedBuffer<u32>> _indices;
+
+        // Vertex buffers share the allocator of their position stream
+        RangeAllocator _vertex_allocator;
+        RangeAllocator _packed_vertex_allocator;
+        RangeAllocator _index_allocator;
+
+        u64 _bytes_uploaded = 0;
+        u64 _bytes_copied = 0;
+        u32 _buffer_growths = 0;
+};
+
+}
+
+#endif // GEOMETRYBUFFER_H
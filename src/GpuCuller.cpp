@@ -0,0 +1,201 @@
+#include "GpuCuller.h"
+
+#include <GeometryBuffer.h>
+#include <GLState.h>
+
+#include <glad/gl.h>
+
+
+namespace OM3D {
+
+extern bool audit_bindings_before_draw;
+
+static constexpr u32 group_size = 64;
+
+GpuCuller::GpuCuller() :
+    _early_program(Program::from_file("hiz_cull.comp")),
+    _late_program(Program::from_file("hiz_cull.comp", {"LATE"})),
+    _early_meshlet_program(Program::from_file("meshlet_cull.comp")),
+    _late_meshlet_program(Program::from_file("meshlet_cull.comp", {"LATE"})) {
+
+    const Stats zero = {};
+    for(auto& buffer : _stats_buffers) {
+        buffer = std::make_unique<TypedBuffer<Stats>>(&zero, 1);
+    }
+}
+
+void GpuCuller::set_draws(Span<const shader::CullData> draws, Span<const u32> object_indices, Span<const shader::LodRange> lods,
+                          Span<const shader::MeshletData> meshlets, Span<const shader::MeshletDraw> meshlet_draws) {
+    ALWAYS_ASSERT(draws.size() == object_indices.size(), "Expected one object per draw");
+
+    _meshlet_draw_count = u32(meshlet_draws.size());
+    if(_meshlet_draw_count) {
+        _meshlets = std::make_unique<TypedBuffer<shader::MeshletData>>(meshlets);
+        _meshlet_draws = std::make_unique<TypedBuffer<shader::MeshletDraw>>(meshlet_draws);
+        _meshlet_commands = std::make_unique<TypedBuffer<shader::DrawElementsCommand>>(nullptr, _meshlet_draw_count);
+        _late_meshlet_commands = std::make_unique<TypedBuffer<shader::DrawElementsCommand>>(nullptr, _meshlet_draw_count);
+    } else {
+        _meshlets = nullptr;
+        _meshlet_draws = nullptr;
+        _meshlet_commands = nullptr;
+        _late_meshlet_commands = nullptr;
+    }
+
+    _draw_count = u32(draws.size());
+    if(!_draw_count) {
+        _draws = nullptr;
+        _commands = nullptr;
+        _late_commands = nullptr;
+        _object_indices = nullptr;
+        _lods = nullptr;
+        _draw_states = nullptr;
+        return;
+    }
+
+    // Commands are entirely written by the culling shader
+    _draws = std::make_unique<TypedBuffer<shader::CullData>>(draws);
+    _commands = std::make_unique<TypedBuffer<shader::DrawElementsCommand>>(nullptr, _draw_count);
+    _late_commands = std::make_unique<TypedBuffer<shader::DrawElementsCommand>>(nullptr, _draw_count);
+    // Commands use the draw index as base instance, which maps to the object index
+    _object_indices = std::make_unique<TypedBuffer<u32>>(object_indices);
+    _lods = std::make_unique<TypedBuffer<shader::LodRange>>(lods);
+    _draw_states = std::make_unique<TypedBuffer<u32>>(nullptr, _draw_count);
+}
+
+void GpuCuller::update_draws(Span<const shader::CullData> draws) {
+    ALWAYS_ASSERT(draws.size() == _draw_count, "Draw count changed, set_draws needs to be called");
+    if(!_draw_count) {
+        return;
+    }
+
+    _draws->upload(draws.data(), draws.size() * sizeof(shader::CullData));
+}
+
+u32 GpuCuller::draw_count() const {
+    return _draw_count;
+}
+
+u32 GpuCuller::meshlet_draw_count() const {
+    return _meshlet_culling ? _meshlet_draw_count : 0;
+}
+
+void GpuCuller::set_meshlet_culling(bool enabled) {
+    _meshlet_culling = enabled;
+}
+
+void GpuCuller::set_lod_selection(bool enabled, float pixel_error) {
+    _lod_selection = enabled;
+    _lod_pixel_error = pixel_error;
+}
+
+void GpuCuller::cull(const Camera& camera, const DepthPyramid& pyramid, GpuCullPhase phase, const TypedBuffer<shader::ObjectData>& objects) {
+    if(!_draw_count) {
+        return;
+    }
+
+    if(phase == GpuCullPhase::Early) {
+        ++_frame_index;
+    }
+
+    TypedBuffer<Stats>& stats_buffer = *_stats_buffers[_frame_index % stats_latency];
+    if(phase == GpuCullPhase::Early) {
+        // This buffer was last written stats_latency frames ago
+        auto mapping = stats_buffer.map(AccessType::ReadWrite);
+        _stats = mapping[0];
+        mapping[0] = {};
+    }
+
+    Program& program = phase == GpuCullPhase::Early ? *_early_program : *_late_program;
+    program.set_uniform(HASH("object_count"), _draw_count);
+    program.set_uniform(HASH("view_proj"), camera.view_proj_matrix());
+    program.set_uniform(HASH("hiz_view_proj"), phase == GpuCullPhase::Early ? pyramid.view_proj() : camera.view_proj_matrix());
+    program.set_uniform(HASH("hiz_valid"), u32(pyramid.is_valid()));
+    program.set_uniform(HASH("camera_position"), camera.position());
+    program.set_uniform(HASH("orthographic"), u32(camera.is_orthographic()));
+    program.set_uniform(HASH("lod_pixel_scale"), _lod_selection ? float(viewport_size().y) * camera.projection_matrix()[1][1] * 0.5f : 0.0f);
+    program.set_uniform(HASH("lod_pixel_error"), _lod_pixel_error);
+    program.set_uniform(HASH("use_meshlets"), u32(meshlet_draw_count() != 0));
+    program.bind();
+
+    if(pyramid.is_valid()) {
+        pyramid.bind(0);
+    }
+    _draws->bind(BufferUsage::Storage, 0);
+    _commands->bind(BufferUsage::Storage, 1);
+    _late_commands->bind(BufferUsage::Storage, 2);
+    stats_buffer.bind(BufferUsage::Storage, 3);
+    _lods->bind(BufferUsage::Storage, 4);
+    _draw_states->bind(BufferUsage::Storage, 5);
+
+    glDispatchCompute((_draw_count + group_size - 1) / group_size, 1, 1);
+
+    if(meshlet_draw_count()) {
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        Program& meshlet_program = phase == GpuCullPhase::Early ? *_early_meshlet_program : *_late_meshlet_program;
+        meshlet_program.set_uniform(HASH("meshlet_draw_count"), _meshlet_draw_count);
+        meshlet_program.set_uniform(HASH("camera_position"), camera.position());
+        meshlet_program.set_uniform(HASH("view_proj"), camera.view_proj_matrix());
+        meshlet_program.set_uniform(HASH("hiz_view_proj"), phase == GpuCullPhase::Early ? pyramid.view_proj() : camera.view_proj_matrix());
+        meshlet_program.set_uniform(HASH("hiz_valid"), u32(pyramid.is_valid()));
+        meshlet_program.bind();
+
+        _meshlet_draws->bind(BufferUsage::Storage, 0);
+        _meshlet_commands->bind(BufferUsage::Storage, 1);
+        _meshlets->bind(BufferUsage::Storage, 4);
+        _late_meshlet_commands->bind(BufferUsage::Storage, 6);
+        objects.bind(BufferUsage::Storage, 7);
+
+        glDispatchCompute((_meshlet_draw_count + group_size - 1) / group_size, 1, 1);
+    }
+
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+const TypedBuffer<shader::DrawElementsCommand>& GpuCuller::commands() const {
+    DEBUG_ASSERT(_commands);
+    return *_commands;
+}
+
+const TypedBuffer<shader::DrawElementsCommand>& GpuCuller::late_commands() const {
+    DEBUG_ASSERT(_late_commands);
+    return *_late_commands;
+}
+
+const TypedBuffer<shader::DrawElementsCommand>& GpuCuller::meshlet_commands() const {
+    DEBUG_ASSERT(_meshlet_commands);
+    return *_meshlet_commands;
+}
+
+const TypedBuffer<shader::DrawElementsCommand>& GpuCuller::late_meshlet_commands() const {
+    DEBUG_ASSERT(_late_meshlet_commands);
+    return *_late_meshlet_commands;
+}
+
+void GpuCuller::bind_draw_data(VertexFormat format, bool positions_only) const {
+    DEBUG_ASSERT(_draw_count);
+
+    GeometryBuffer::set_object_index_buffer(_object_indices->handle().get());
+    if(positions_only) {
+        GeometryBuffer::global().bind_positions(format);
+    } else {
+        GeometryBuffer::global().bind(format);
+    }
+}
+
+void GpuCuller::multi_draw(const TypedBuffer<shader::DrawElementsCommand>& commands, u32 first, u32 count) const {
+    DEBUG_ASSERT(first + count <= commands.element_count());
+
+    if(audit_bindings_before_draw) {
+        audit_bindings();
+    }
+
+    commands.bind(BufferUsage::Indirect);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, reinterpret_cast<void*>(size_t(first) * sizeof(shader::DrawElementsCommand)), int(count), 0);
+}
+
+const GpuCuller::Stats& GpuCuller::stats() const {
+    return _stats;
+}
+
+}
@@ -0,0 +1,102 @@
+#ifndef GPUCULLER_H
+#define GPUCULLER_H
+
+#include <DepthPyramid.h>
+#include <TypedBuffer.h>
+#include <Camera.h>
+#include <Vertex.h>
+#include <shader_structs.h>
+
+#include <array>
+#include <memory>
+
+namespace OM3D {
+
+enum class GpuCullPhase {
+    // Objects visible in the previous frame pyramid, drawn first to build the new one
+    Early,
+    // Objects rejected by the early phase but visible in the new pyramid
+    Late,
+};
+
+// GPU driven rendering: per draw bounds and draw arguments live in storage buffers,
+// a compute shader does frustum and hierarchical-Z occlusion culling and writes one indirect draw command per draw.
+// Draws are then submitted with glMultiDrawElementsIndirect over contiguous ranges of commands.
+// Visible draws split in meshlets are then culled meshlet by meshlet by a second compute shader,
+// which writes one command per meshlet into separate command buffers.
+class GpuCuller : NonCopyable {
+    public:
+        using Stats = shader::CullingStats;
+
+        GpuCuller();
+
+        // object_indices gives the index in the object buffer of every draw, draws index their levels of detail in lods.
+        // meshlet_draws has an entry for every meshlet of the draws with a non zero meshlet count, indexing meshlets.
+        void set_draws(Span<const shader::CullData> draws, Span<const u32> object_indices, Span<const shader::LodRange> lods,
+                       Span<const shader::MeshletData> meshlets, Span<const shader::MeshletDraw> meshlet_draws);
+        // Draws moved but are still the same
+        void update_draws(Span<const shader::CullData> draws);
+
+        u32 draw_count() const;
+        u32 meshlet_draw_count() const;
+
+        // Pick levels of detail by projected error and cull objects under a pixel, otherwise always draw the full meshes
+        void set_lod_selection(bool enabled, float pixel_error);
+
+        // Draw meshes through their meshlets when they have some, otherwise as a whole
+        void set_meshlet_culling(bool enabled);
+
+        // Meshlet culling reads the transforms of the objects
+        void cull(const Camera& camera, const DepthPyramid& pyramid, GpuCullPhase phase, const TypedBuffer<shader::ObjectData>& objects);
+
+        // Commands of every visible draw after the late phase, or only those visible in the early phase before it
+        const TypedBuffer<shader::DrawElementsCommand>& commands() const;
+        // Commands of the draws only visible in the late phase
+        const TypedBuffer<shader::DrawElementsCommand>& late_commands() const;
+
+        // Same, for the meshlet draws
+        const TypedBuffer<shader::DrawElementsCommand>& meshlet_commands() const;
+        const TypedBuffer<shader::DrawElementsCommand>& late_meshlet_commands() const;
+
+        // Bind the geometry and the object index attribute, the object buffer must be bound by the caller
+        void bind_draw_data(VertexFormat format, bool positions_only = false) const;
+        // Draw count commands starting at first
+        void multi_draw(const TypedBuffer<shader::DrawElementsCommand>& commands, u32 first, u32 count) const;
+
+        // Stats are read back a few frames late to avoid stalling
+        const Stats& stats() const;
+
+    private:
+        static constexpr u32 stats_latency = 3;
+
+        std::shared_ptr<Program> _early_program;
+        std::shared_ptr<Program> _late_program;
+        std::shared_ptr<Program> _early_meshlet_program;
+        std::shared_ptr<Program> _late_meshlet_program;
+
+        std::unique_ptr<TypedBuffer<shader::CullData>> _draws;
+        std::unique_ptr<TypedBuffer<shader::DrawElementsCommand>> _commands;
+        std::unique_ptr<TypedBuffer<shader::DrawElementsCommand>> _late_commands;
+        std::unique_ptr<TypedBuffer<u32>> _object_indices;
+        std::unique_ptr<TypedBuffer<shader::LodRange>> _lods;
+        std::unique_ptr<TypedBuffer<u32>> _draw_states;
+        u32 _draw_count = 0;
+
+        std::unique_ptr<TypedBuffer<shader::MeshletData>> _meshlets;
+        std::unique_ptr<TypedBuffer<shader::MeshletDraw>> _meshlet_draws;
+        std::unique_ptr<TypedBuffer<shader::DrawElementsCommand>> _meshlet_commands;
+        std::unique_ptr<TypedBuffer<shader::DrawElementsCommand>> _late_meshlet_commands;
+        u32 _meshlet_draw_count = 0;
+        bool _meshlet_culling = true;
+
+        bool _lod_selection = true;
+        float _lod_pixel_error = 1.0f;
+
+        std::array<std::unique_ptr<TypedBuffer<Stats>>, stats_latency> _stats_buffers;
+        u32 _frame_index = 0;
+        Stats _stats = {};
+};
+
+}
+
+#endif // GPUCULLER_H
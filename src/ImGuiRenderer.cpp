@@ -1,6 +1,7 @@
 #include "ImGuiRenderer.h"
 
-#include <TypedBuffer.h>
+#include <StreamBuffer.h>
+#include <VertexArray.h>
 
 #include <glm/vec2.hpp>
 
@@ -11,6 +12,7 @@
 #include <GLFW/glfw3.h>
 
 #include <algorithm>
+#include <cstddef>
 
 #include <imgui/fa-solid-900.h>
 
@@ -202,6 +204,7 @@ ImGuiRenderer::ImGuiRenderer(GLFWwindow* window) : _window(window) {
     _material.set_program(Program::from_files("imgui.frag", "imgui.vert"));
     _material.set_depth_test_mode(DepthTestMode::None);
     _material.set_blend_mode(BlendMode::Alpha);
+    _material.set_cull_mode(CullMode::None);
 
     _font = create_font();
 
@@ -257,13 +260,10 @@ void ImGuiRenderer::render(const ImDrawData* draw_data) {
     glEnable(GL_SCISSOR_TEST);
     DEFER(glDisable(GL_SCISSOR_TEST));
 
-    TypedBuffer<ImDrawIdx> index_buffer(nullptr, draw_data->TotalIdxCount);
-    TypedBuffer<ImDrawVert> vertex_buffer(nullptr, draw_data->TotalVtxCount);
+    const auto indices = StreamBuffer::global().allocate<ImDrawIdx>(draw_data->TotalIdxCount);
+    const auto vertices = StreamBuffer::global().allocate<ImDrawVert>(draw_data->TotalVtxCount);
 
     {
-        auto indices = index_buffer.map(AccessType::WriteOnly);
-        auto vertices = vertex_buffer.map(AccessType::WriteOnly);
-
         size_t index_offset = 0;
         size_t vertex_offset = 0;
         for(int c = 0; c != draw_data->CmdListsCount; ++c) {
@@ -275,13 +275,20 @@ void ImGuiRenderer::render(const ImDrawData* draw_data) {
         }
     }
 
-    index_buffer.bind(BufferUsage::Index);
-    vertex_buffer.bind(BufferUsage::Attribute);
+    using ImGuiStream = VertexStream<sizeof(ImDrawVert), 0,
+        Attribute<0, AttributeType::Float, 2, offsetof(ImDrawVert, pos)>,
+        Attribute<1, AttributeType::Float, 2, offsetof(ImDrawVert, uv)>,
+        Attribute<2, AttributeType::U8, 4, offsetof(ImDrawVert, col)>>;
+
+    const VertexArray& vertex_array = VertexArray::get<ImGuiStream>();
+    vertex_array.bind();
+    vertex_array.bind_index_buffer(indices.buffer);
 
-    byte* vertex_offset = nullptr;
-    byte* index_offset = nullptr;
+    size_t vertex_offset = vertices.offset;
+    byte* index_offset = reinterpret_cast<byte*>(indices.offset);
     for(int c = 0; c != draw_data->CmdListsCount; ++c) {
         const ImDrawList* cmd_list = draw_data->CmdLists[c];
+        vertex_array.bind_vertex_buffer(0, vertices.buffer, vertex_offset);
 
         byte* drawn_index_offset = index_offset;
         for(int i = 0; i != cmd_list->CmdBuffer.Size; ++i) {
@@ -301,13 +308,6 @@ void ImGuiRenderer::render(const ImDrawData* draw_data) {
                 tex->bind(0);
             }
 
-            glVertexAttribPointer(0, 2, GL_FLOAT, false, sizeof(ImDrawVert), vertex_offset);
-            glVertexAttribPointer(1, 2, GL_FLOAT, false, sizeof(ImDrawVert), vertex_offset + (2 * sizeof(float)));
-            glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, false, sizeof(ImDrawVert), vertex_offset + (4 * sizeof(float)));
-            glEnableVertexAttribArray(0);
-            glEnableVertexAttribArray(1);
-            glEnableVertexAttribArray(2);
-
             glDrawElements(GL_TRIANGLES, cmd.ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, reinterpret_cast<void*>(drawn_index_offset));
             drawn_index_offset += cmd.ElemCount * sizeof(ImDrawIdx);
         }
@@ -11,6 +11,7 @@ ImageFormatGL image_format_to_gl(ImageFormat format) {
         case ImageFormat::RGB8_UNORM:       return ImageFormatGL{ GL_RGB, GL_RGB8, GL_UNSIGNED_BYTE };
         case ImageFormat::RGB8_sRGB:        return ImageFormatGL{ GL_RGB, GL_SRGB8, GL_UNSIGNED_BYTE };
         case ImageFormat::RGBA16_FLOAT:     return ImageFormatGL{ GL_RGBA, GL_RGBA16F, GL_FLOAT };
+        case ImageFormat::R32_FLOAT:        return ImageFormatGL{ GL_RED, GL_R32F, GL_FLOAT };
         case ImageFormat::Depth32_FLOAT:    return ImageFormatGL{ GL_DEPTH_COMPONENT, GL_DEPTH_COMPONENT32F, GL_FLOAT };
     }
 
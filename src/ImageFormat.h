@@ -12,6 +12,7 @@ enum class ImageFormat {
     RGB8_sRGB,
 
     RGBA16_FLOAT,
+    R32_FLOAT,
     Depth32_FLOAT
 };
 
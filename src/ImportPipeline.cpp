@@ -0,0 +1,250 @@
+#include "ImportPipeline.h"
+
+#include <glm/geometric.hpp>
+
+#include <cstring>
+
+namespace OM3D {
+
+// FNV-1a, to find meshes and images coming from different indices that may be identical
+static u64 hash_bytes(const void* data, size_t size, u64 h = 0xcbf29ce484222325) {
+    const u8* bytes = static_cast<const u8*>(data);
+    for(size_t i = 0; i != size; ++i) {
+        h = (h ^ bytes[i]) * 0x100000001b3;
+    }
+    return h;
+}
+
+static u64 hash_mesh_data(const MeshData& mesh) {
+    u64 h = hash_bytes(mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+    h = hash_bytes(mesh.indices.data(), mesh.indices.size() * sizeof(u32), h);
+    hash_combine(h, u64(mesh.vertices.size()));
+    hash_combine(h, u64(mesh.indices.size()));
+    return h;
+}
+
+static bool same_mesh_data(const MeshData& a, const MeshData& b) {
+    return a.vertices.size() == b.vertices.size() && a.indices == b.indices &&
+           (a.vertices.empty() || std::memcmp(a.vertices.data(), b.vertices.data(), a.vertices.size() * sizeof(Vertex)) == 0);
+}
+
+static void compute_tangents(MeshData& mesh) {
+    for(Vertex& vert : mesh.vertices) {
+        vert.tangent_bitangent_sign = glm::vec4(0.0f, 0.0f, 0.0f, 0.0f);
+    }
+
+    for(size_t i = 0; i < mesh.indices.size(); i += 3) {
+        const u32 tri[] = {
+            mesh.indices[i + 0],
+            mesh.indices[i + 1],
+            mesh.indices[i + 2]
+        };
+
+        const glm::vec3 edges[] = {
+            mesh.vertices[tri[1]].position - mesh.vertices[tri[0]].position,
+            mesh.vertices[tri[2]].position - mesh.vertices[tri[0]].position
+        };
+
+        const glm::vec2 uvs[] = {
+            mesh.vertices[tri[0]].uv,
+            mesh.vertices[tri[1]].uv,
+            mesh.vertices[tri[2]].uv
+        };
+
+        const float dt[] = {
+            uvs[1].y - uvs[0].y,
+            uvs[2].y - uvs[0].y
+        };
+
+        const glm::vec3 tangent = -glm::normalize((edges[0] * dt[1]) - (edges[1] * dt[0]));
+        mesh.vertices[tri[0]].tangent_bitangent_sign += glm::vec4(tangent, 0.0f);
+        mesh.vertices[tri[1]].tangent_bitangent_sign += glm::vec4(tangent, 0.0f);
+        mesh.vertices[tri[2]].tangent_bitangent_sign += glm::vec4(tangent, 0.0f);
+    }
+
+    for(Vertex& vert : mesh.vertices) {
+        const glm::vec3 tangent = vert.tangent_bitangent_sign;
+        vert.tangent_bitangent_sign = glm::vec4(glm::normalize(tangent), 1.0f);
+    }
+}
+
+u32 ImportPipeline::add_mesh(std::function<Result<MeshData>()> decode) {
+    MeshTask& mesh = _meshes.emplace_back();
+    mesh.decode = std::move(decode);
+    return u32(_meshes.size() - 1);
+}
+
+u32 ImportPipeline::add_image(Span<const u8> encoded, bool as_sRGB) {
+    ImageTask& image = _images.emplace_back();
+    image.encoded = encoded;
+    image.as_sRGB = as_sRGB;
+    return u32(_images.size() - 1);
+}
+
+void ImportPipeline::deduplicate_meshes() {
+    // Run before any mesh is processed, so that meshes are compared as they were decoded
+    std::unordered_multimap<u64, u32> owners;
+    for(u32 i = 0; i != _meshes.size(); ++i) {
+        MeshTask& mesh = _meshes[i];
+        mesh.unique = i;
+        if(!mesh.ok) {
+            continue;
+        }
+
+        const auto [begin, end] = owners.equal_range(mesh.hash);
+        for(auto it = begin; it != end; ++it) {
+            if(same_mesh_data(_meshes[it->second].data, mesh.data)) {
+                mesh.unique = it->second;
+                break;
+            }
+        }
+
+        if(mesh.unique == i) {
+            owners.emplace(mesh.hash, i);
+        } else {
+            mesh.data = {};
+        }
+    }
+}
+
+u32 ImportPipeline::claim_image(u64 hash, u32 index) {
+    // Encoded bytes never change, they can be compared while other images are being decoded
+    const ImageTask& image = _images[index];
+    const std::unique_lock lock(_image_lock);
+    const auto [begin, end] = _image_owners.equal_range(hash);
+    for(auto it = begin; it != end; ++it) {
+        const ImageTask& owner = _images[it->second];
+        if(owner.as_sRGB == image.as_sRGB && owner.encoded.size() == image.encoded.size() &&
+           (image.encoded.is_empty() || std::memcmp(owner.encoded.data(), image.encoded.data(), image.encoded.size()) == 0)) {
+            return it->second;
+        }
+    }
+    _image_owners.emplace(hash, index);
+    return index;
+}
+
+bool ImportPipeline::run(ThreadPool& pool) {
+    std::vector<TaskGraph::Task> decodes;
+    for(MeshTask& mesh : _meshes) {
+        decodes.push_back(_graph.add("Mesh decode", [&mesh] {
+            auto result = mesh.decode();
+            mesh.ok = result.is_ok;
+            if(mesh.ok) {
+                mesh.data = std::move(result.value);
+                mesh.hash = hash_mesh_data(mesh.data);
+            }
+        }));
+    }
+
+    const TaskGraph::Task deduplicate = _graph.add("Mesh deduplication", [this] { deduplicate_meshes(); }, decodes);
+
+    // Later stages do nothing for duplicates, which share the data of their unique mesh or image
+    for(u32 i = 0; i != _meshes.size(); ++i) {
+        MeshTask& mesh = _meshes[i];
+        // Primitives without triangles have nothing to process either
+        auto is_unique = [&mesh, i] { return mesh.ok && mesh.unique == i && !mesh.data.is_empty(); };
+
+        const TaskGraph::Task optimize = _graph.add("Vertex cache optimization", [&mesh, is_unique] {
+            if(is_unique()) {
+                // Authoring order is rarely good for the post transform cache or early depth testing
+                mesh.before = analyze_vertex_cache(mesh.data.indices, mesh.data.vertices.size());
+                mesh.data.optimize();
+                mesh.after = analyze_vertex_cache(mesh.data.indices, mesh.data.vertices.size());
+            }
+        }, {deduplicate});
+
+        const TaskGraph::Task tangents = _graph.add("Tangent generation", [&mesh, is_unique] {
+            if(is_unique() && mesh.data.vertices[0].tangent_bitangent_sign == glm::vec4(0.0f)) {
+                compute_tangents(mesh.data);
+            }
+        }, {optimize});
+
+        const TaskGraph::Task meshlets = _graph.add("Meshlet building", [&mesh, is_unique] {
+            if(is_unique()) {
+                mesh.data.build_meshlets();
+            }
+        }, {tangents});
+
+        _graph.add("LOD generation", [&mesh, is_unique] {
+            if(is_unique()) {
+                mesh.data.generate_lods();
+            }
+        }, {meshlets});
+    }
+
+    for(u32 i = 0; i != _images.size(); ++i) {
+        ImageTask& image = _images[i];
+
+        const TaskGraph::Task decode = _graph.add("Image decode", [this, &image, i] {
+            u64 hash = hash_bytes(image.encoded.data(), image.encoded.size());
+            hash_combine(hash, u64(image.as_sRGB));
+            image.unique = claim_image(hash, i);
+            if(image.unique == i) {
+                auto result = TextureData::from_memory(image.encoded, image.as_sRGB);
+                image.ok = result.is_ok;
+                image.data = std::move(result.value);
+            }
+        });
+
+        _graph.add("Mip generation", [&image, i] {
+            if(image.ok && image.unique == i) {
+                image.data.generate_mips();
+            }
+        }, {decode});
+    }
+
+    _graph.run(pool);
+
+    // Results of duplicates are those of their unique task
+    bool ok = true;
+    for(const MeshTask& mesh : _meshes) {
+        ok &= mesh.ok;
+    }
+    for(ImageTask& image : _images) {
+        image.ok = _images[image.unique].ok;
+    }
+    return ok;
+}
+
+u32 ImportPipeline::mesh_count() const {
+    return u32(_meshes.size());
+}
+
+u32 ImportPipeline::unique_mesh(u32 mesh) const {
+    return _meshes[mesh].unique;
+}
+
+const MeshData& ImportPipeline::mesh_data(u32 mesh) const {
+    return _meshes[unique_mesh(mesh)].data;
+}
+
+const VertexCacheStats& ImportPipeline::cache_stats_before(u32 mesh) const {
+    return _meshes[unique_mesh(mesh)].before;
+}
+
+const VertexCacheStats& ImportPipeline::cache_stats_after(u32 mesh) const {
+    return _meshes[unique_mesh(mesh)].after;
+}
+
+u32 ImportPipeline::image_count() const {
+    return u32(_images.size());
+}
+
+u32 ImportPipeline::unique_image(u32 image) const {
+    return _images[image].unique;
+}
+
+bool ImportPipeline::image_ok(u32 image) const {
+    return _images[image].ok;
+}
+
+const TextureData& ImportPipeline::texture_data(u32 image) const {
+    DEBUG_ASSERT(image_ok(image));
+    return _images[unique_image(image)].data;
+}
+
+Span<const TaskGraph::StageTiming> ImportPipeline::stage_timings() const {
+    return _graph.stage_timings();
+}
+
+}
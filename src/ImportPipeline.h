@@ -0,0 +1,81 @@
+#ifndef IMPORTPIPELINE_H
+#define IMPORTPIPELINE_H
+
+#include <StaticMesh.h>
+#include <Texture.h>
+#include <MeshOptimizer.h>
+#include <TaskGraph.h>
+
+#include <mutex>
+#include <unordered_map>
+
+namespace OM3D {
+
+// CPU side of scene imports, run as a task graph on a thread pool:
+//   meshes: decode -> deduplication (once all are decoded) -> vertex cache optimization -> tangents -> meshlets -> levels of detail
+//   images: decode -> mips
+// Meshes and images with the same content as an earlier one are only decoded, or only hashed for images, and share its data.
+// Content is found by hash, then compared byte for byte.
+// GL objects are created by the caller afterwards, on the GL thread.
+class ImportPipeline : NonCopyable {
+    public:
+        // decode is called from a worker thread
+        u32 add_mesh(std::function<Result<MeshData>()> decode);
+        // The encoded bytes must stay alive until run returns
+        u32 add_image(Span<const u8> encoded, bool as_sRGB);
+
+        // Returns false if a mesh failed to decode, images that fail are only reported by image_ok
+        bool run(ThreadPool& pool = ThreadPool::global());
+
+        u32 mesh_count() const;
+        // First mesh with the same content, the mesh itself if it is unique
+        u32 unique_mesh(u32 mesh) const;
+        // Shared with every mesh of the same content
+        const MeshData& mesh_data(u32 mesh) const;
+        // Before and after optimization, of unique meshes only
+        const VertexCacheStats& cache_stats_before(u32 mesh) const;
+        const VertexCacheStats& cache_stats_after(u32 mesh) const;
+
+        u32 image_count() const;
+        u32 unique_image(u32 image) const;
+        bool image_ok(u32 image) const;
+        // With its full mip chain
+        const TextureData& texture_data(u32 image) const;
+
+        Span<const TaskGraph::StageTiming> stage_timings() const;
+
+    private:
+        struct MeshTask {
+            std::function<Result<MeshData>()> decode;
+            MeshData data;
+            u64 hash = 0;
+            VertexCacheStats before;
+            VertexCacheStats after;
+            u32 unique = 0;
+            bool ok = false;
+        };
+
+        struct ImageTask {
+            Span<const u8> encoded;
+            bool as_sRGB = false;
+            TextureData data;
+            u32 unique = 0;
+            bool ok = false;
+        };
+
+        // Sets the unique mesh of every mesh, in order, so that the first one of the same content is kept
+        void deduplicate_meshes();
+        // Returns the first image with the same content, the image itself if it is the first
+        u32 claim_image(u64 hash, u32 index);
+
+        std::vector<MeshTask> _meshes;
+        std::vector<ImageTask> _images;
+        TaskGraph _graph;
+
+        std::mutex _image_lock;
+        std::unordered_multimap<u64, u32> _image_owners;
+};
+
+}
+
+#endif // IMPORTPIPELINE_H
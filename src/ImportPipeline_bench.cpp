@@ -0,0 +1,153 @@
+#include "ImportPipeline.h"
+#include "ThreadPool.h"
+
+#include <benchmarks.h>
+
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmissing-field-initializers"
+#endif
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb/stb_image_write.h>
+
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif
+
+#include <iostream>
+#include <iomanip>
+#include <random>
+
+namespace OM3D {
+
+// PNG of a noisy gradient, so that decoding has to inflate real data
+static std::vector<u8> encoded_image(u32 size, u32 seed) {
+    std::mt19937 rng(seed);
+    std::vector<u8> texels(size_t(size) * size * 4);
+    for(u32 y = 0; y != size; ++y) {
+        for(u32 x = 0; x != size; ++x) {
+            u8* texel = texels.data() + (size_t(y) * size + x) * 4;
+            texel[0] = u8(x * 255 / size);
+            texel[1] = u8(y * 255 / size);
+            texel[2] = u8(rng() % 64 + seed);
+            texel[3] = 255;
+        }
+    }
+
+    std::vector<u8> encoded;
+    stbi_write_png_to_func([](void* context, void* data, int bytes) {
+        const u8* begin = static_cast<const u8*>(data);
+        static_cast<std::vector<u8>*>(context)->insert(static_cast<std::vector<u8>*>(context)->end(), begin, begin + bytes);
+    }, &encoded, int(size), int(size), 4, texels.data(), int(size * 4));
+    return encoded;
+}
+
+void bench_import_pipeline() {
+    std::cout << "Import pipeline" << std::endl;
+
+    // No GL context here: this only runs the CPU side of Scene::from_gltf, on a synthetic scene
+    const u32 mesh_count = 24;
+    const u32 duplicate_meshes = 8;
+    const u32 image_count = 16;
+    const u32 duplicate_images = 4;
+
+    std::vector<std::vector<u8>> images;
+    for(u32 i = 0; i != image_count; ++i) {
+        images.push_back(encoded_image(512, i));
+    }
+
+    auto make_mesh = [](u32 index) {
+        MeshData mesh = MeshData::icosphere(4);
+        const float frequency = 4.0f + float(index);
+        for(Vertex& vertex : mesh.vertices) {
+            const glm::vec3 n = glm::normalize(vertex.position);
+            vertex.position = n * (1.0f + 0.05f * std::sin(frequency * n.x) * std::sin(frequency * n.y) * std::sin(frequency * n.z));
+        }
+        return mesh;
+    };
+
+    std::vector<MeshData> reference_meshes;
+    std::vector<size_t> reference_images;
+    double single_thread_time = 0.0;
+
+    std::vector<u32> thread_counts;
+    const u32 max_threads = ThreadPool::default_worker_count() + 1;
+    for(u32 threads = 1; threads < max_threads; threads *= 2) {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(max_threads);
+
+    for(const u32 threads : thread_counts) {
+        ThreadPool pool(threads - 1);
+        ImportPipeline pipeline;
+        for(u32 i = 0; i != mesh_count + duplicate_meshes; ++i) {
+            pipeline.add_mesh([&make_mesh, i] { return Result<MeshData>{true, make_mesh(i % mesh_count)}; });
+        }
+        for(u32 i = 0; i != image_count + duplicate_images; ++i) {
+            const std::vector<u8>& image = images[i % image_count];
+            pipeline.add_image(Span<const u8>(image.data(), image.size()), i % 2 == 0);
+        }
+
+        bool valid = true;
+        const double time = time_ms([&] { valid &= pipeline.run(pool); });
+
+        // Every thread count must produce the same data, duplicates must be found
+        for(u32 i = 0; i != pipeline.mesh_count(); ++i) {
+            const MeshData& mesh = pipeline.mesh_data(i);
+            valid &= pipeline.unique_mesh(i) == i % mesh_count;
+            valid &= !mesh.lods.empty() && !mesh.meshlets.empty();
+            valid &= mesh.vertices[0].tangent_bitangent_sign.w == 1.0f;
+            if(threads == 1) {
+                reference_meshes.push_back(mesh);
+            } else {
+                valid &= mesh.indices == reference_meshes[i].indices && mesh.lods.size() == reference_meshes[i].lods.size();
+            }
+        }
+        for(u32 i = 0; i != pipeline.image_count(); ++i) {
+            valid &= pipeline.image_ok(i) && pipeline.unique_image(i) == i % image_count;
+
+            const TextureData& data = pipeline.texture_data(i);
+            valid &= data.mip_count == 10;
+            const size_t bytes = data.mip_offset(data.mip_count);
+            size_t checksum = 0;
+            for(size_t k = 0; k != bytes; ++k) {
+                checksum = checksum * 31 + data.data[k];
+            }
+            if(threads == 1) {
+                reference_images.push_back(checksum);
+            } else {
+                valid &= checksum == reference_images[i];
+            }
+        }
+
+        if(threads == 1) {
+            single_thread_time = time;
+        }
+
+        std::cout << "  " << std::setw(2) << threads << " threads: " << time << "ms (x" << std::setprecision(2) << single_thread_time / time << std::setprecision(3) << ")";
+        for(const TaskGraph::StageTiming& stage : pipeline.stage_timings()) {
+            std::cout << ", " << stage.name << " " << stage.busy_time * 1000.0 << "ms";
+        }
+        std::cout << check_result(valid) << std::endl;
+    }
+
+    // Primitives without vertices or triangles go through every stage untouched,
+    // and are empty for the loader, so that it never creates geometry for them
+    {
+        ThreadPool pool(0);
+        ImportPipeline pipeline;
+        pipeline.add_mesh([] { return Result<MeshData>{true, MeshData{}}; });
+        pipeline.add_mesh([] {
+            MeshData mesh = MeshData::icosphere(1);
+            mesh.indices.clear();
+            return Result<MeshData>{true, std::move(mesh)};
+        });
+
+        bool valid = pipeline.run(pool);
+        valid &= pipeline.unique_mesh(1) == 1 && pipeline.mesh_data(0).is_empty() && pipeline.mesh_data(1).is_empty();
+        std::cout << "  empty meshes" << check_result(valid) << std::endl;
+    }
+}
+
+}
@@ -0,0 +1,286 @@
+#include "LightClusters.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OM3D_CLUSTERS_SSE
+#endif
+
+namespace OM3D {
+
+// Clusters are tested 4 at a time along a row of tiles
+static constexpr u32 group_size = 4;
+static_assert(LightClusters::tiles_x % group_size == 0);
+
+// Far bound of the last slice, big enough to be infinite but small enough to keep the bounds finite
+static constexpr float infinite_depth = 1.0e30f;
+
+struct ViewSphere {
+    float x = 0.0f;
+    float y = 0.0f;
+    float z = 0.0f;
+    float radius_sq = 0.0f;
+};
+
+static u32 tile_index(float ndc, u32 tile_count) {
+    const float tile = std::floor((ndc * 0.5f + 0.5f) * float(tile_count));
+    return u32(std::clamp(tile, 0.0f, float(tile_count - 1)));
+}
+
+LightClusters::LightClusters() {
+    _offsets.assign(cluster_count + 1, 0);
+}
+
+void LightClusters::set_depth_range(float first_split, float far) {
+    ALWAYS_ASSERT(first_split > 0.0f && far > first_split, "Invalid cluster depth range");
+    _first_split = first_split;
+    _far = far;
+
+    // Bounds have to be recomputed
+    _min_x.clear();
+}
+
+float LightClusters::slice_depth(u32 slice) const {
+    if(slice == 0) {
+        return _near;
+    }
+    if(slice >= slices) {
+        return infinite_depth;
+    }
+    return _first_split * std::exp(float(slice - 1) / _slice_scale);
+}
+
+u32 LightClusters::slice_index(float depth) const {
+    if(depth <= 0.0f) {
+        return 0;
+    }
+    const float slice = std::floor(std::log(depth) * _slice_scale + _slice_bias);
+    return u32(std::clamp(slice, 0.0f, float(slices - 1)));
+}
+
+u32 LightClusters::cluster_index(const glm::vec2& ndc, float depth) const {
+    const u32 x = tile_index(ndc.x, tiles_x);
+    const u32 y = tile_index(ndc.y, tiles_y);
+    return (slice_index(depth) * tiles_y + y) * tiles_x + x;
+}
+
+void LightClusters::compute_bounds(const glm::mat4& projection) {
+    ALWAYS_ASSERT(projection[3][3] == 0.0f, "Light clusters require a perspective projection");
+
+    _projection = projection;
+    _near = projection[3][2];
+    _slice_scale = float(slices - 2) / std::log(_far / _first_split);
+    _slice_bias = 1.0f - std::log(_first_split) * _slice_scale;
+
+    _min_x.resize(cluster_count);
+    _min_y.resize(cluster_count);
+    _min_z.resize(cluster_count);
+    _max_x.resize(cluster_count);
+    _max_y.resize(cluster_count);
+    _max_z.resize(cluster_count);
+
+    // Clusters are frustum pieces, we store the view space box around them
+    const float inv_x = 1.0f / projection[0][0];
+    const float inv_y = 1.0f / projection[1][1];
+    for(u32 s = 0; s != slices; ++s) {
+        const float slice_near = slice_depth(s);
+        const float slice_far = slice_depth(s + 1);
+        for(u32 y = 0; y != tiles_y; ++y) {
+            const float ndc_y0 = float(y) / float(tiles_y) * 2.0f - 1.0f;
+            const float ndc_y1 = float(y + 1) / float(tiles_y) * 2.0f - 1.0f;
+            for(u32 x = 0; x != tiles_x; ++x) {
+                const float ndc_x0 = float(x) / float(tiles_x) * 2.0f - 1.0f;
+                const float ndc_x1 = float(x + 1) / float(tiles_x) * 2.0f - 1.0f;
+
+                const u32 index = (s * tiles_y + y) * tiles_x + x;
+                _min_x[index] = std::min(ndc_x0 * slice_near, ndc_x0 * slice_far) * inv_x;
+                _max_x[index] = std::max(ndc_x1 * slice_near, ndc_x1 * slice_far) * inv_x;
+                _min_y[index] = std::min(ndc_y0 * slice_near, ndc_y0 * slice_far) * inv_y;
+                _max_y[index] = std::max(ndc_y1 * slice_near, ndc_y1 * slice_far) * inv_y;
+                _min_z[index] = -slice_far;
+                _max_z[index] = -slice_near;
+            }
+        }
+    }
+}
+
+void LightClusters::bin_lights(const glm::mat4& view, Span<const BoundingSphere> lights, u32 first, u32 count, std::vector<ClusterLight>& pairs) const {
+    const float scale_x = _projection[0][0];
+    const float scale_y = _projection[1][1];
+
+#if defined(OM3D_CLUSTERS_SSE)
+    auto test_group = [&](u32 index, const ViewSphere& sphere) {
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 cx = _mm_set1_ps(sphere.x);
+        const __m128 cy = _mm_set1_ps(sphere.y);
+        const __m128 cz = _mm_set1_ps(sphere.z);
+
+        // Distance from the center to the boxes, 0 along axes where the center is inside
+        const __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(_min_x.data() + index), cx), _mm_sub_ps(cx, _mm_loadu_ps(_max_x.data() + index))), zero);
+        const __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(_min_y.data() + index), cy), _mm_sub_ps(cy, _mm_loadu_ps(_max_y.data() + index))), zero);
+        const __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(_min_z.data() + index), cz), _mm_sub_ps(cz, _mm_loadu_ps(_max_z.data() + index))), zero);
+
+        const __m128 dist_sq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+        return u32(_mm_movemask_ps(_mm_cmple_ps(dist_sq, _mm_set1_ps(sphere.radius_sq))));
+    };
+#else
+    auto test_group = [&](u32 index, const ViewSphere& sphere) {
+        u32 mask = 0;
+        for(u32 k = 0; k != group_size; ++k) {
+            const u32 i = index + k;
+            const float dx = std::max({_min_x[i] - sphere.x, sphere.x - _max_x[i], 0.0f});
+            const float dy = std::max({_min_y[i] - sphere.y, sphere.y - _max_y[i], 0.0f});
+            const float dz = std::max({_min_z[i] - sphere.z, sphere.z - _max_z[i], 0.0f});
+            if(dx * dx + dy * dy + dz * dz <= sphere.radius_sq) {
+                mask |= 1u << k;
+            }
+        }
+        return mask;
+    };
+#endif
+
+    for(u32 light = first; light != first + count; ++light) {
+        const BoundingSphere& bounds = lights[light];
+        const glm::vec3 center = glm::vec3(view * glm::vec4(bounds.center, 1.0f));
+        const float radius = bounds.radius;
+
+        const float min_depth = -center.z - radius;
+        const float max_depth = -center.z + radius;
+        if(max_depth < _near || radius <= 0.0f) {
+            continue;
+        }
+
+        // Screen rectangle of the view space box around the sphere, the whole screen if it crosses the near plane
+        u32 x0 = 0;
+        u32 x1 = tiles_x - 1;
+        u32 y0 = 0;
+        u32 y1 = tiles_y - 1;
+        if(min_depth > _near) {
+            const float min_x = scale_x * std::min((center.x - radius) / min_depth, (center.x - radius) / max_depth);
+            const float max_x = scale_x * std::max((center.x + radius) / min_depth, (center.x + radius) / max_depth);
+            const float min_y = scale_y * std::min((center.y - radius) / min_depth, (center.y - radius) / max_depth);
+            const float max_y = scale_y * std::max((center.y + radius) / min_depth, (center.y + radius) / max_depth);
+            if(max_x < -1.0f || min_x > 1.0f || max_y < -1.0f || min_y > 1.0f) {
+                continue;
+            }
+            x0 = tile_index(min_x, tiles_x);
+            x1 = tile_index(max_x, tiles_x);
+            y0 = tile_index(min_y, tiles_y);
+            y1 = tile_index(max_y, tiles_y);
+        }
+
+        const u32 s0 = slice_index(std::max(min_depth, _near));
+        const u32 s1 = slice_index(max_depth);
+
+        const ViewSphere sphere = {center.x, center.y, center.z, radius * radius};
+        for(u32 s = s0; s <= s1; ++s) {
+            for(u32 y = y0; y <= y1; ++y) {
+                const u32 row = (s * tiles_y + y) * tiles_x;
+                for(u32 g = x0 / group_size * group_size; g <= x1; g += group_size) {
+                    // Only keep the lanes inside the rectangle
+                    const u32 first_lane = std::max(x0, g) - g;
+                    const u32 last_lane = std::min(x1, g + group_size - 1) - g;
+                    const u32 lanes = ((1u << (last_lane + 1)) - 1) & ~((1u << first_lane) - 1);
+
+                    u32 mask = test_group(row + g, sphere) & lanes;
+                    for(u32 k = 0; mask; ++k, mask >>= 1) {
+                        if(mask & 1) {
+                            pairs.push_back(ClusterLight{row + g + k, light});
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+void LightClusters::build(const Camera& camera, Span<const BoundingSphere> lights, ThreadPool& pool) {
+    if(_min_x.empty() || camera.projection_matrix() != _projection) {
+        compute_bounds(camera.projection_matrix());
+    }
+
+    // Lights are split in fixed chunks whatever the number of threads, each one producing its pairs in light order
+    const u32 light_count = u32(lights.size());
+    const u32 chunk_count = (light_count + chunk_size - 1) / chunk_size;
+    if(_chunk_pairs.size() < chunk_count) {
+        _chunk_pairs.resize(chunk_count);
+    }
+
+    const glm::mat4& view = camera.view_matrix();
+    auto bin_chunk = [&](u32 chunk) {
+        const u32 first = chunk * chunk_size;
+        std::vector<ClusterLight>& pairs = _chunk_pairs[chunk];
+        pairs.clear();
+        bin_lights(view, lights, first, std::min(chunk_size, light_count - first), pairs);
+    };
+
+    if(chunk_count > 1 && pool.thread_count() > 1) {
+        pool.parallel_for(chunk_count, bin_chunk);
+    } else {
+        for(u32 chunk = 0; chunk != chunk_count; ++chunk) {
+            bin_chunk(chunk);
+        }
+    }
+
+    // Counting sort by cluster, chunks are merged in order so lights stay sorted within each cluster
+    _stats = {};
+    std::fill(_offsets.begin(), _offsets.end(), 0);
+
+    u32 last_light = u32(-1);
+    for(u32 chunk = 0; chunk != chunk_count; ++chunk) {
+        for(const ClusterLight& pair : _chunk_pairs[chunk]) {
+            ++_offsets[pair.cluster + 1];
+            if(pair.light != last_light) {
+                last_light = pair.light;
+                ++_stats.lights;
+            }
+        }
+    }
+
+    for(u32 c = 0; c != cluster_count; ++c) {
+        const u32 lights_in_cluster = _offsets[c + 1];
+        _stats.non_empty_clusters += (lights_in_cluster != 0);
+        _stats.max_lights_per_cluster = std::max(_stats.max_lights_per_cluster, lights_in_cluster);
+        _offsets[c + 1] += _offsets[c];
+    }
+    _stats.light_references = _offsets[cluster_count];
+
+    _light_indices.resize(_offsets[cluster_count]);
+    std::vector<u32> cursors(_offsets.begin(), _offsets.end() - 1);
+    for(u32 chunk = 0; chunk != chunk_count; ++chunk) {
+        for(const ClusterLight& pair : _chunk_pairs[chunk]) {
+            _light_indices[cursors[pair.cluster]++] = pair.light;
+        }
+    }
+}
+
+Span<const u32> LightClusters::offsets() const {
+    return _offsets;
+}
+
+Span<const u32> LightClusters::light_indices() const {
+    return _light_indices;
+}
+
+Span<const u32> LightClusters::cluster_lights(u32 cluster) const {
+    DEBUG_ASSERT(cluster < cluster_count);
+    return Span<const u32>(_light_indices.data() + _offsets[cluster], _offsets[cluster + 1] - _offsets[cluster]);
+}
+
+shader::ClusterInfo LightClusters::shader_info(const glm::uvec2& viewport_size) const {
+    shader::ClusterInfo info = {};
+    info.grid_size = glm::uvec3(tiles_x, tiles_y, slices);
+    info.z_near = _near;
+    info.tile_scale = glm::vec2(tiles_x, tiles_y) / glm::vec2(glm::max(viewport_size, glm::uvec2(1)));
+    info.slice_scale = _slice_scale;
+    info.slice_bias = _slice_bias;
+    return info;
+}
+
+const LightClusters::Stats& LightClusters::stats() const {
+    return _stats;
+}
+
+}
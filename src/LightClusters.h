@@ -0,0 +1,91 @@
+#ifndef LIGHTCLUSTERS_H
+#define LIGHTCLUSTERS_H
+
+#include <Bounds.h>
+#include <Camera.h>
+#include <ThreadPool.h>
+#include <shader_structs.h>
+
+#include <vector>
+
+namespace OM3D {
+
+// Point lights binned into a froxel grid covering the camera frustum, for the forward lighting path.
+// Tiles split the screen evenly and depth slices are exponential: slice 0 goes from the near plane to first_split,
+// the following ones cover [first_split; far] and the last one extends to infinity (we use an infinite reverse-Z projection).
+// Lights of each cluster are sorted by index, so the result doesn't depend on the number of threads.
+class LightClusters {
+    public:
+        static constexpr u32 tiles_x = 16;
+        static constexpr u32 tiles_y = 9;
+        static constexpr u32 slices = 24;
+        static constexpr u32 cluster_count = tiles_x * tiles_y * slices;
+
+        // Lights are binned in chunks of this size, one chunk per task
+        static constexpr u32 chunk_size = 1024;
+
+        struct Stats {
+            u32 lights = 0;              // Lights touching at least one cluster
+            u32 light_references = 0;    // Size of the light index list
+            u32 non_empty_clusters = 0;
+            u32 max_lights_per_cluster = 0;
+        };
+
+        LightClusters();
+
+        void set_depth_range(float first_split, float far);
+
+        // Bin the lights, the index of a light in the output is its index in lights
+        void build(const Camera& camera, Span<const BoundingSphere> lights, ThreadPool& pool = ThreadPool::global());
+
+        // Lights of the cluster are light_indices()[offsets()[c]] to light_indices()[offsets()[c + 1]]
+        Span<const u32> offsets() const;
+        Span<const u32> light_indices() const;
+        Span<const u32> cluster_lights(u32 cluster) const;
+
+        // Same computation as lit.frag, from normalized device coordinates and positive view space depth
+        u32 cluster_index(const glm::vec2& ndc, float depth) const;
+
+        shader::ClusterInfo shader_info(const glm::uvec2& viewport_size) const;
+
+        const Stats& stats() const;
+
+    private:
+        struct ClusterLight {
+            u32 cluster = 0;
+            u32 light = 0;
+        };
+
+        void compute_bounds(const glm::mat4& projection);
+        void bin_lights(const glm::mat4& view, Span<const BoundingSphere> lights, u32 first, u32 count, std::vector<ClusterLight>& pairs) const;
+
+        float slice_depth(u32 slice) const;
+        u32 slice_index(float depth) const;
+
+        float _first_split = 1.0f;
+        float _far = 500.0f;
+
+        float _near = 0.0f;
+        float _slice_scale = 0.0f;
+        float _slice_bias = 0.0f;
+        glm::mat4 _projection = {};
+
+        // View space bounds of every cluster, as structure of arrays
+        std::vector<float> _min_x;
+        std::vector<float> _min_y;
+        std::vector<float> _min_z;
+        std::vector<float> _max_x;
+        std::vector<float> _max_y;
+        std::vector<float> _max_z;
+
+        std::vector<std::vector<ClusterLight>> _chunk_pairs;
+
+        std::vector<u32> _offsets;
+        std::vector<u32> _light_indices;
+
+        Stats _stats;
+};
+
+}
+
+#endif // LIGHTCLUSTERS_H
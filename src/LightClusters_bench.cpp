@@ -0,0 +1,68 @@
+#include "LightClusters.h"
+#include "ThreadPool.h"
+
+#include <benchmarks.h>
+
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <algorithm>
+
+namespace OM3D {
+
+void bench_light_clusters() {
+    std::cout << "Clustered light binning (" << ThreadPool::global().thread_count() << " threads)" << std::endl;
+
+    const Camera camera = benchmark_camera();
+    const glm::mat4 inv_view = glm::inverse(camera.view_matrix());
+    const glm::mat4& projection = camera.projection_matrix();
+
+    // Same pool size whatever the machine, to check that the result doesn't depend on the number of threads
+    ThreadPool reference_pool(3);
+
+    for(const size_t count : {1000, 10000, 50000}) {
+        std::mt19937 rng(0x5EED);
+        const float half_side = 10.0f * std::cbrt(float(count));
+        std::uniform_real_distribution<float> pos(-half_side, half_side);
+        std::uniform_real_distribution<float> radius(2.0f, 10.0f);
+
+        std::vector<BoundingSphere> lights(count);
+        for(BoundingSphere& light : lights) {
+            light = BoundingSphere{glm::vec3(pos(rng), pos(rng), pos(rng)), radius(rng)};
+        }
+
+        const u32 iterations = u32(std::max(size_t(5), 100000 / count));
+
+        LightClusters clusters;
+        const double time = time_ms([&] { clusters.build(camera, lights); }, iterations);
+
+        LightClusters reference;
+        reference.build(camera, lights, reference_pool);
+        bool valid = clusters.offsets() == reference.offsets() && clusters.light_indices() == reference.light_indices();
+
+        // Every light touching a point inside the frustum must be in the cluster of that point
+        std::uniform_real_distribution<float> ndc(-1.0f, 1.0f);
+        std::uniform_real_distribution<float> log_depth(std::log(0.01f), std::log(half_side * 2.0f));
+        for(u32 i = 0; i != 256 && valid; ++i) {
+            const glm::vec2 point_ndc(ndc(rng), ndc(rng));
+            const float depth = std::exp(log_depth(rng));
+            const glm::vec3 view_pos(point_ndc.x * depth / projection[0][0], point_ndc.y * depth / projection[1][1], -depth);
+            const glm::vec3 world_pos = glm::vec3(inv_view * glm::vec4(view_pos, 1.0f));
+
+            const Span<const u32> cluster = clusters.cluster_lights(clusters.cluster_index(point_ndc, depth));
+            for(u32 l = 0; l != count; ++l) {
+                if(glm::length(world_pos - lights[l].center) < lights[l].radius) {
+                    valid &= std::binary_search(cluster.begin(), cluster.end(), l);
+                }
+            }
+        }
+
+        const LightClusters::Stats& stats = clusters.stats();
+        std::cout << "  " << std::setw(6) << count << " lights, " << std::setw(6) << stats.lights << " binned: "
+                  << time << "ms, " << stats.light_references << " references in " << stats.non_empty_clusters << "/" << LightClusters::cluster_count
+                  << " clusters (max " << stats.max_lights_per_cluster << ")"
+                  << check_result(valid) << std::endl;
+    }
+}
+
+}
@@ -0,0 +1,203 @@
+#include "LooseOctree.h"
+
+#include <algorithm>
+
+namespace OM3D {
+
+static constexpr u32 level_offset(u32 level) {
+    return ((1u << (3 * level)) - 1) / 7;
+}
+
+static constexpr u32 node_count = level_offset(LooseOctree::levels);
+
+static u32 node_index(u32 level, const glm::uvec3& cell) {
+    return level_offset(level) + (((cell.z << level) + cell.y) << level) + cell.x;
+}
+
+LooseOctree::LooseOctree() {
+    reset(AABB{glm::vec3(-1.0f), glm::vec3(1.0f)});
+}
+
+void LooseOctree::reset(const AABB& bounds) {
+    // Cells are cubes
+    const glm::vec3 extent = bounds.is_empty() ? glm::vec3(1.0f) : bounds.max - bounds.min;
+    _size = std::max({extent.x, extent.y, extent.z, 1.0e-3f});
+    _bounds.min = bounds.is_empty() ? glm::vec3(-0.5f) : bounds.min;
+    _bounds.max = _bounds.min + _size;
+
+    _heads.assign(node_count, invalid_handle);
+    _subtree_counts.assign(node_count, 0);
+
+    _items.clear();
+    _free_items.clear();
+    _item_count = 0;
+}
+
+const AABB& LooseOctree::bounds() const {
+    return _bounds;
+}
+
+size_t LooseOctree::size() const {
+    return _item_count;
+}
+
+LooseOctree::Location LooseOctree::find_location(const AABB& bounds) const {
+    if(bounds.is_empty()) {
+        return Location{};
+    }
+
+    const glm::vec3 center = bounds.center();
+    if(glm::any(glm::lessThan(center, _bounds.min)) || glm::any(glm::greaterThan(center, _bounds.max))) {
+        return Location{};
+    }
+
+    // Deepest level where the item is smaller than a cell, it then fits in the loose bounds of the cell containing its center
+    const glm::vec3 extent = bounds.max - bounds.min;
+    const float item_size = std::max({extent.x, extent.y, extent.z});
+    u32 level = 0;
+    float cell_size = _size;
+    while(level + 1 != levels && cell_size * 0.5f >= item_size) {
+        cell_size *= 0.5f;
+        ++level;
+    }
+
+    const glm::vec3 cell = glm::floor((center - _bounds.min) / cell_size);
+    const float max_cell = float((1u << level) - 1);
+    return Location{level, glm::uvec3(glm::clamp(cell, glm::vec3(0.0f), glm::vec3(max_cell)))};
+}
+
+void LooseOctree::add_to_subtree_counts(const Location& location, u32 value) {
+    glm::uvec3 cell = location.cell;
+    for(u32 level = location.level + 1; level-- != 0; cell >>= 1u) {
+        _subtree_counts[node_index(level, cell)] += value;
+    }
+}
+
+void LooseOctree::link(u32 handle, const Location& location) {
+    const u32 node = node_index(location.level, location.cell);
+
+    Item& item = _items[handle];
+    item.location = location;
+    item.node = node;
+    item.prev = invalid_handle;
+    item.next = _heads[node];
+    if(item.next != invalid_handle) {
+        _items[item.next].prev = handle;
+    }
+    _heads[node] = handle;
+
+    add_to_subtree_counts(location, 1);
+}
+
+void LooseOctree::unlink(u32 handle) {
+    const Item& item = _items[handle];
+    if(item.prev != invalid_handle) {
+        _items[item.prev].next = item.next;
+    } else {
+        _heads[item.node] = item.next;
+    }
+    if(item.next != invalid_handle) {
+        _items[item.next].prev = item.prev;
+    }
+
+    add_to_subtree_counts(item.location, u32(-1));
+}
+
+u32 LooseOctree::insert(u32 id, const AABB& bounds) {
+    u32 handle = 0;
+    if(_free_items.empty()) {
+        handle = u32(_items.size());
+        _items.emplace_back();
+    } else {
+        handle = _free_items.back();
+        _free_items.pop_back();
+    }
+
+    _items[handle].bounds = bounds;
+    _items[handle].id = id;
+    link(handle, find_location(bounds));
+    ++_item_count;
+    return handle;
+}
+
+void LooseOctree::update(u32 handle, const AABB& bounds) {
+    DEBUG_ASSERT(handle < _items.size());
+    _items[handle].bounds = bounds;
+
+    const Location location = find_location(bounds);
+    if(node_index(location.level, location.cell) != _items[handle].node) {
+        unlink(handle);
+        link(handle, location);
+    }
+}
+
+void LooseOctree::remove(u32 handle) {
+    DEBUG_ASSERT(handle < _items.size());
+    unlink(handle);
+    _free_items.push_back(handle);
+    --_item_count;
+}
+
+template<typename T>
+void LooseOctree::query(const T& test, std::vector<u32>& ids, u32 level, const glm::uvec3& cell, bool inside) const {
+    const u32 node = node_index(level, cell);
+    if(!_subtree_counts[node]) {
+        return;
+    }
+
+    // The root also holds the items outside of the octree, so its bounds are not tested
+    if(!inside && level) {
+        const float cell_size = _size / float(1u << level);
+        const glm::vec3 min = _bounds.min + glm::vec3(cell) * cell_size - cell_size * 0.5f;
+        const FrustumTest result = test(AABB{min, min + cell_size * 2.0f});
+        if(result == FrustumTest::Outside) {
+            return;
+        }
+        inside = (result == FrustumTest::Inside);
+    }
+
+    for(u32 handle = _heads[node]; handle != invalid_handle; handle = _items[handle].next) {
+        const Item& item = _items[handle];
+        if(inside || test(item.bounds) != FrustumTest::Outside) {
+            ids.push_back(item.id);
+        }
+    }
+
+    if(level + 1 != levels) {
+        for(u32 i = 0; i != 8; ++i) {
+            const glm::uvec3 child = cell * 2u + glm::uvec3(i & 1, (i >> 1) & 1, i >> 2);
+            query(test, ids, level + 1, child, inside);
+        }
+    }
+}
+
+void LooseOctree::query(const Frustum& frustum, std::vector<u32>& ids) const {
+    query([&](const AABB& box) { return frustum.test(box); }, ids, 0, glm::uvec3(0), false);
+}
+
+void LooseOctree::query(const AABB& box, std::vector<u32>& ids) const {
+    query([&](const AABB& other) {
+        if(glm::any(glm::lessThan(other.max, box.min)) || glm::any(glm::greaterThan(other.min, box.max))) {
+            return FrustumTest::Outside;
+        }
+        if(glm::all(glm::lessThanEqual(box.min, other.min)) && glm::all(glm::greaterThanEqual(box.max, other.max))) {
+            return FrustumTest::Inside;
+        }
+        return FrustumTest::Intersecting;
+    }, ids, 0, glm::uvec3(0), false);
+}
+
+void LooseOctree::query(const BoundingSphere& sphere, std::vector<u32>& ids) const {
+    const float radius_sq = sphere.radius * sphere.radius;
+    query([&](const AABB& box) {
+        const glm::vec3 closest = glm::clamp(sphere.center, box.min, box.max);
+        const glm::vec3 to_closest = closest - sphere.center;
+        if(glm::dot(to_closest, to_closest) > radius_sq) {
+            return FrustumTest::Outside;
+        }
+        const glm::vec3 farthest = glm::max(glm::abs(box.min - sphere.center), glm::abs(box.max - sphere.center));
+        return glm::dot(farthest, farthest) <= radius_sq ? FrustumTest::Inside : FrustumTest::Intersecting;
+    }, ids, 0, glm::uvec3(0), false);
+}
+
+}
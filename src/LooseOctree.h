@@ -0,0 +1,76 @@
+#ifndef LOOSEOCTREE_H
+#define LOOSEOCTREE_H
+
+#include <Bounds.h>
+#include <Camera.h>
+
+#include <vector>
+
+namespace OM3D {
+
+// Loose octree over world space AABBs, for things that move every frame.
+// Nodes are implicit: every level is a dense grid, and the bounds of a node are its cell grown by half a cell on every side.
+// An item lives in the deepest node whose cells are at least as big as it, in the cell containing its center,
+// so (re)inserting only touches one node list and the item counts of its ancestors.
+// Items that don't fit in the octree bounds are kept in the root, which is tested against everything.
+class LooseOctree {
+    public:
+        static constexpr u32 levels = 6;
+        static constexpr u32 invalid_handle = u32(-1);
+
+        LooseOctree();
+
+        // Removes every item
+        void reset(const AABB& bounds);
+        const AABB& bounds() const;
+
+        // The id is what queries return
+        u32 insert(u32 id, const AABB& bounds);
+        void update(u32 handle, const AABB& bounds);
+        void remove(u32 handle);
+
+        size_t size() const;
+
+        // Append the id of every item not outside the frustum / intersecting the box or sphere
+        void query(const Frustum& frustum, std::vector<u32>& ids) const;
+        void query(const AABB& box, std::vector<u32>& ids) const;
+        void query(const BoundingSphere& sphere, std::vector<u32>& ids) const;
+
+    private:
+        struct Location {
+            u32 level = 0;
+            glm::uvec3 cell = {};
+        };
+
+        struct Item {
+            AABB bounds;
+            Location location;
+            u32 id = 0;
+            u32 node = 0;
+            u32 prev = invalid_handle;
+            u32 next = invalid_handle;
+        };
+
+        Location find_location(const AABB& bounds) const;
+        void link(u32 handle, const Location& location);
+        void unlink(u32 handle);
+        void add_to_subtree_counts(const Location& location, u32 value);
+
+        template<typename T>
+        void query(const T& test, std::vector<u32>& ids, u32 level, const glm::uvec3& cell, bool inside) const;
+
+        AABB _bounds;
+        float _size = 0.0f;
+
+        // Indexed by node
+        std::vector<u32> _heads;
+        std::vector<u32> _subtree_counts;
+
+        std::vector<Item> _items;
+        std::vector<u32> _free_items;
+        size_t _item_count = 0;
+};
+
+}
+
+#endif // LOOSEOCTREE_H
@@ -0,0 +1,138 @@
+#include "LooseOctree.h"
+#include "BVH.h"
+
+#include <benchmarks.h>
+
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <algorithm>
+
+namespace OM3D {
+
+void bench_loose_octree() {
+    std::cout << "Loose octree, everything moving every frame" << std::endl;
+
+    const Frustum frustum = benchmark_camera().build_frustum();
+
+    for(const size_t count : {1000, 10000}) {
+        std::vector<AABB> boxes = random_boxes(count);
+        std::vector<glm::vec3> velocities(count);
+
+        std::mt19937 rng(0x5EED);
+        std::uniform_real_distribution<float> speed(-2.0f, 2.0f);
+        for(glm::vec3& velocity : velocities) {
+            velocity = glm::vec3(speed(rng), speed(rng), speed(rng));
+        }
+
+        AABB scene_bounds;
+        for(const AABB& box : boxes) {
+            scene_bounds.add(box);
+        }
+
+        LooseOctree octree;
+        octree.reset(scene_bounds);
+        std::vector<u32> handles(count);
+        for(size_t i = 0; i != count; ++i) {
+            handles[i] = octree.insert(u32(i), boxes[i]);
+        }
+
+        BVH bvh;
+        bvh.build(boxes);
+
+        auto move = [&] {
+            for(size_t i = 0; i != count; ++i) {
+                boxes[i].min += velocities[i];
+                boxes[i].max += velocities[i];
+            }
+        };
+
+        const u32 frames = 50;
+        bool valid = true;
+        double octree_update = 0.0;
+        double octree_query = 0.0;
+        double bvh_refit = 0.0;
+        double bvh_query = 0.0;
+        size_t visible_count = 0;
+
+        std::vector<u32> octree_visible;
+        std::vector<u32> bvh_visible;
+        std::vector<u32> linear_visible;
+        for(u32 frame = 0; frame != frames; ++frame) {
+            move();
+
+            octree_update += time_ms([&] {
+                for(size_t i = 0; i != count; ++i) {
+                    octree.update(handles[i], boxes[i]);
+                }
+            });
+            octree_query += time_ms([&] {
+                octree_visible.clear();
+                octree.query(frustum, octree_visible);
+            });
+
+            bvh_refit += time_ms([&] { bvh.refit(boxes); });
+            bvh_query += time_ms([&] {
+                bvh_visible.clear();
+                bvh.cull(frustum, bvh_visible);
+            });
+
+            linear_visible.clear();
+            for(size_t i = 0; i != count; ++i) {
+                if(frustum.test(boxes[i]) != FrustumTest::Outside) {
+                    linear_visible.push_back(u32(i));
+                }
+            }
+
+            std::sort(octree_visible.begin(), octree_visible.end());
+            valid &= octree_visible == linear_visible;
+            visible_count += octree_visible.size();
+        }
+
+        // Sphere and box queries against brute force
+        std::uniform_int_distribution<size_t> index(0, count - 1);
+        for(u32 i = 0; i != 64 && valid; ++i) {
+            const BoundingSphere sphere = {boxes[index(rng)].center(), 20.0f};
+            const AABB box = {sphere.center - sphere.radius, sphere.center + sphere.radius};
+
+            std::vector<u32> sphere_result;
+            std::vector<u32> box_result;
+            octree.query(sphere, sphere_result);
+            octree.query(box, box_result);
+            std::sort(sphere_result.begin(), sphere_result.end());
+            std::sort(box_result.begin(), box_result.end());
+
+            std::vector<u32> sphere_expected;
+            std::vector<u32> box_expected;
+            for(size_t k = 0; k != count; ++k) {
+                const glm::vec3 closest = glm::clamp(sphere.center, boxes[k].min, boxes[k].max);
+                if(glm::length(closest - sphere.center) <= sphere.radius) {
+                    sphere_expected.push_back(u32(k));
+                }
+                if(glm::all(glm::lessThanEqual(boxes[k].min, box.max)) && glm::all(glm::greaterThanEqual(boxes[k].max, box.min))) {
+                    box_expected.push_back(u32(k));
+                }
+            }
+            valid &= sphere_result == sphere_expected && box_result == box_expected;
+        }
+
+        std::cout << "  " << std::setw(6) << count << " objects, " << std::setw(5) << visible_count / frames << " visible: "
+                  << "octree update " << octree_update / frames << "ms + query " << octree_query / frames << "ms, "
+                  << "bvh refit " << bvh_refit / frames << "ms + cull " << bvh_query / frames << "ms"
+                  << check_result(valid) << std::endl;
+    }
+
+    // Items without bounds are never visible
+    {
+        LooseOctree octree;
+        octree.reset(AABB{glm::vec3(-1.0f), glm::vec3(1.0f)});
+        octree.insert(0, AABB{});
+        octree.insert(1, AABB{glm::vec3(9.0f, -0.5f, 4.0f), glm::vec3(10.0f, 0.5f, 5.0f)});
+
+        std::vector<u32> visible;
+        octree.query(benchmark_camera().build_frustum(), visible);
+        std::cout << "  empty bounds" << check_result(visible == std::vector<u32>{1}) << std::endl;
+    }
+}
+
+}
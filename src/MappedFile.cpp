@@ -0,0 +1,99 @@
+#include "MappedFile.h"
+
+#ifdef OS_WIN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace OM3D {
+
+#ifdef OS_WIN
+Result<std::unique_ptr<MappedFile>> MappedFile::open(const std::string& file_name) {
+    auto file = std::unique_ptr<MappedFile>(new MappedFile());
+
+    file->_file = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(file->_file == INVALID_HANDLE_VALUE) {
+        file->_file = nullptr;
+        return {false, {}};
+    }
+
+    LARGE_INTEGER size = {};
+    if(!GetFileSizeEx(file->_file, &size)) {
+        return {false, {}};
+    }
+    file->_size = size_t(size.QuadPart);
+    if(!file->_size) {
+        // Empty files can't be mapped
+        return {true, std::move(file)};
+    }
+
+    file->_mapping = CreateFileMappingA(file->_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(!file->_mapping) {
+        return {false, {}};
+    }
+
+    file->_data = static_cast<const u8*>(MapViewOfFile(file->_mapping, FILE_MAP_READ, 0, 0, 0));
+    if(!file->_data) {
+        return {false, {}};
+    }
+
+    return {true, std::move(file)};
+}
+
+MappedFile::~MappedFile() {
+    if(_data) {
+        UnmapViewOfFile(_data);
+    }
+    if(_mapping) {
+        CloseHandle(_mapping);
+    }
+    if(_file) {
+        CloseHandle(_file);
+    }
+}
+#else
+Result<std::unique_ptr<MappedFile>> MappedFile::open(const std::string& file_name) {
+    const int fd = ::open(file_name.c_str(), O_RDONLY);
+    if(fd < 0) {
+        return {false, {}};
+    }
+    // The mapping stays valid after the file is closed
+    DEFER(::close(fd));
+
+    struct stat info = {};
+    if(fstat(fd, &info) != 0) {
+        return {false, {}};
+    }
+
+    auto file = std::unique_ptr<MappedFile>(new MappedFile());
+    file->_size = size_t(info.st_size);
+    if(!file->_size) {
+        // Empty files can't be mapped
+        return {true, std::move(file)};
+    }
+
+    void* data = mmap(nullptr, file->_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(data == MAP_FAILED) {
+        return {false, {}};
+    }
+    file->_data = static_cast<const u8*>(data);
+
+    return {true, std::move(file)};
+}
+
+MappedFile::~MappedFile() {
+    if(_data) {
+        munmap(const_cast<u8*>(_data), _size);
+    }
+}
+#endif
+
+Span<const u8> MappedFile::data() const {
+    return Span<const u8>(_data, _size);
+}
+
+}
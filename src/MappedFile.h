@@ -0,0 +1,34 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <utils.h>
+
+#include <memory>
+#include <string>
+
+namespace OM3D {
+
+// Read only view of a whole file, pages are loaded on first access
+class MappedFile : NonMovable {
+    public:
+        static Result<std::unique_ptr<MappedFile>> open(const std::string& file_name);
+
+        ~MappedFile();
+
+        Span<const u8> data() const;
+
+    private:
+        MappedFile() = default;
+
+        const u8* _data = nullptr;
+        size_t _size = 0;
+
+#ifdef OS_WIN
+        void* _file = nullptr;
+        void* _mapping = nullptr;
+#endif
+};
+
+}
+
+#endif // MAPPEDFILE_H
@@ -1,7 +1,5 @@
 #include "Material.h"
 
-#include <glad/gl.h>
-
 #include <algorithm>
 
 namespace OM3D {
@@ -11,14 +9,22 @@ Material::Material() {
 
 void Material::set_program(std::shared_ptr<Program> prog) {
     _program = std::move(prog);
+    _pipeline_states = {};
 }
 
 void Material::set_blend_mode(BlendMode blend) {
     _blend_mode = blend;
+    _pipeline_states = {};
 }
 
 void Material::set_depth_test_mode(DepthTestMode depth) {
     _depth_test_mode = depth;
+    _pipeline_states = {};
+}
+
+void Material::set_cull_mode(CullMode cull) {
+    _cull_mode = cull;
+    _pipeline_states = {};
 }
 
 void Material::set_texture(u32 slot, std::shared_ptr<Texture> tex) {
@@ -29,50 +35,63 @@ void Material::set_texture(u32 slot, std::shared_ptr<Texture> tex) {
     }
 }
 
-void Material::bind() const {
-    switch(_blend_mode) {
-        case BlendMode::None:
-            glDisable(GL_BLEND);
-        break;
+const std::shared_ptr<Program>& Material::program() const {
+    return _program;
+}
+
+BlendMode Material::blend_mode() const {
+    return _blend_mode;
+}
 
-        case BlendMode::Alpha:
-            glEnable(GL_BLEND);
-            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        break;
+CullMode Material::cull_mode() const {
+    return _cull_mode;
+}
 
-        case BlendMode::Add:
-            glEnable(GL_BLEND);
-            glBlendFunc(GL_SRC_ALPHA, GL_SRC_ALPHA);
-        break;
+void Material::bind(MaterialPass pass) const {
+    pipeline_state(pass)->bind();
+    if(pass != MaterialPass::Depth) {
+        bind_textures();
     }
+}
 
-    switch(_depth_test_mode) {
-        case DepthTestMode::None:
-            glDisable(GL_DEPTH_TEST);
-        break;
-
-        case DepthTestMode::Equal:
-            glEnable(GL_DEPTH_TEST);
-            glDepthFunc(GL_EQUAL);
-        break;
-
-        case DepthTestMode::Standard:
-            glEnable(GL_DEPTH_TEST);
-            // We are using reverse-Z
-            glDepthFunc(GL_GEQUAL);
-        break;
-
-        case DepthTestMode::Reversed:
-            glEnable(GL_DEPTH_TEST);
-            // We are using reverse-Z
-            glDepthFunc(GL_LEQUAL);
-        break;
+const PipelineState* Material::pipeline_state(MaterialPass pass) const {
+    const PipelineState*& state = _pipeline_states[size_t(pass)];
+    if(!state) {
+        PipelineStateDesc desc;
+        desc.program = _program.get();
+        desc.blend_mode = _blend_mode;
+        desc.depth_test_mode = _depth_test_mode;
+        desc.cull_mode = _cull_mode;
+
+        switch(pass) {
+            case MaterialPass::Depth:
+                if(!_depth_program) {
+                    _depth_program = Program::from_files("depth.frag", "depth.vert");
+                }
+                desc.program = _depth_program.get();
+                desc.blend_mode = BlendMode::None;
+            break;
+
+            case MaterialPass::AfterDepthPrepass:
+                if(_depth_test_mode == DepthTestMode::Standard) {
+                    desc.depth_test_mode = DepthTestMode::Equal;
+                }
+                desc.depth_write = false;
+            break;
+
+            default:
+            break;
+        }
+
+        state = PipelineState::get(desc);
     }
+    return state;
+}
 
+void Material::bind_textures() const {
     for(const auto& texture : _textures) {
         texture.second->bind(texture.first);
     }
-    _program->bind();
 }
 
 std::shared_ptr<Material> Material::empty_material() {
@@ -98,11 +117,26 @@ Material Material::textured_normal_mapped_material() {
     return material;
 }
 
+std::shared_ptr<Material> Material::from_textures(std::shared_ptr<Texture> albedo, std::shared_ptr<Texture> normal) {
+    if(!albedo) {
+        return empty_material();
+    }
+
+    auto material = std::make_shared<Material>(normal ? textured_normal_mapped_material() : textured_material());
+    material->set_texture(0u, std::move(albedo));
+    if(normal) {
+        material->set_texture(1u, std::move(normal));
+    }
+    return material;
+}
+
 Material Material::light_sphere_material()
 {
     Material material;
     material._program = Program::from_files("lit_2.frag", "lights.vert", std::array<std::string, 0>{});
     material._blend_mode = BlendMode::Add;
+    // Light volumes are drawn from the inside
+    material._cull_mode = CullMode::Front;
     return material;
 }
 
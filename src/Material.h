@@ -1,25 +1,24 @@
 #ifndef MATERIAL_H
 #define MATERIAL_H
 
-#include <Program.h>
+#include <PipelineState.h>
 #include <Texture.h>
 
+#include <array>
 #include <memory>
 #include <vector>
 
 namespace OM3D {
 
-enum class BlendMode {
-    None,
-    Alpha,
-    Add,
-};
+enum class MaterialPass : u32 {
+    // Full shading, writing depth
+    Default,
+    // Position only program writing depth (depth.vert), without textures. Reads the position streams of the geometry buffer.
+    Depth,
+    // Full shading over the depth of a depth pass: no depth writes and Equal instead of the standard test, so that each pixel is shaded once
+    AfterDepthPrepass,
 
-enum class DepthTestMode {
-    Standard,
-    Reversed,
-    Equal,
-    None
+    Count,
 };
 
 class Material {
@@ -30,6 +29,7 @@ class Material {
         void set_program(std::shared_ptr<Program> prog);
         void set_blend_mode(BlendMode blend);
         void set_depth_test_mode(DepthTestMode depth);
+        void set_cull_mode(CullMode cull);
         void set_texture(u32 slot, std::shared_ptr<Texture> tex);
 
         template<typename... Args>
@@ -38,20 +38,35 @@ class Material {
         }
 
 
-        void bind() const;
+        void bind(MaterialPass pass = MaterialPass::Default) const;
+
+        const std::shared_ptr<Program>& program() const;
+        BlendMode blend_mode() const;
+        CullMode cull_mode() const;
 
         static std::shared_ptr<Material> empty_material();
         static Material textured_material();
         static Material textured_normal_mapped_material();
         static Material light_sphere_material();
 
+        // Material of imported scenes, normal maps are ignored without albedo
+        static std::shared_ptr<Material> from_textures(std::shared_ptr<Texture> albedo, std::shared_ptr<Texture> normal);
+
 
     private:
+        void bind_textures() const;
+        const PipelineState* pipeline_state(MaterialPass pass) const;
+
         std::shared_ptr<Program> _program;
         std::vector<std::pair<u32, std::shared_ptr<Texture>>> _textures;
 
         BlendMode _blend_mode = BlendMode::None;
         DepthTestMode _depth_test_mode = DepthTestMode::Standard;
+        CullMode _cull_mode = CullMode::Back;
+
+        // Resolved on first bind, reset when the material changes
+        mutable std::array<const PipelineState*, size_t(MaterialPass::Count)> _pipeline_states = {};
+        mutable std::shared_ptr<Program> _depth_program;
 
 };
 
@@ -0,0 +1,313 @@
+#include "MeshOptimizer.h"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace OM3D {
+
+VertexCacheStats analyze_vertex_cache(Span<const u32> indices, size_t vertex_count, u32 cache_size) {
+    // A vertex is in the cache until cache_size other vertices have been inserted after it
+    std::vector<u32> timestamps(vertex_count, 0);
+    u32 time = cache_size + 1;
+
+    size_t misses = 0;
+    size_t referenced = 0;
+    for(const u32 index : indices) {
+        if(timestamps[index] == 0) {
+            ++referenced;
+        }
+        if(time - timestamps[index] > cache_size) {
+            timestamps[index] = time++;
+            ++misses;
+        }
+    }
+
+    VertexCacheStats stats;
+    if(!indices.is_empty()) {
+        stats.acmr = float(misses) / float(indices.size() / 3);
+        stats.atvr = float(misses) / float(referenced);
+    }
+    return stats;
+}
+
+// Vertices of every triangle, as offsets into a flat list of triangles
+struct VertexTriangles {
+    std::vector<u32> offsets;
+    std::vector<u32> triangles;
+
+    VertexTriangles(Span<const u32> indices, size_t vertex_count) : offsets(vertex_count + 1, 0), triangles(indices.size()) {
+        for(const u32 index : indices) {
+            ++offsets[index + 1];
+        }
+        for(size_t i = 0; i != vertex_count; ++i) {
+            offsets[i + 1] += offsets[i];
+        }
+        std::vector<u32> cursors(offsets.begin(), offsets.end() - 1);
+        for(size_t i = 0; i != indices.size(); ++i) {
+            triangles[cursors[indices[i]]++] = u32(i / 3);
+        }
+    }
+};
+
+// Scoring constants from Forsyth's paper
+static constexpr u32 max_cache_size = 32;
+static constexpr u32 max_valence = 32;
+static constexpr float last_triangle_score = 0.75f;
+static constexpr float cache_decay_power = 1.5f;
+static constexpr float valence_boost_scale = 2.0f;
+static constexpr float valence_boost_power = 0.5f;
+
+struct VertexScoreTable {
+    float cache[max_cache_size] = {};
+    float valence[max_valence + 1] = {};
+
+    VertexScoreTable() {
+        for(u32 i = 0; i != max_cache_size; ++i) {
+            // The vertices of the last triangle get a fixed score, so that the next triangle doesn't just reuse the same edge
+            cache[i] = i < 3 ? last_triangle_score : std::pow(1.0f - float(i - 3) / float(max_cache_size - 3), cache_decay_power);
+        }
+        for(u32 i = 1; i <= max_valence; ++i) {
+            valence[i] = valence_boost_scale * std::pow(float(i), -valence_boost_power);
+        }
+    }
+
+    float score(int cache_position, u32 remaining_triangles) const {
+        if(!remaining_triangles) {
+            return -1.0f;
+        }
+        const float cache_score = cache_position < 0 ? 0.0f : cache[cache_position];
+        return cache_score + valence[std::min(remaining_triangles, max_valence)];
+    }
+};
+
+void optimize_vertex_cache(Span<u32> indices, size_t vertex_count) {
+    static const VertexScoreTable table;
+
+    const size_t triangle_count = indices.size() / 3;
+    if(triangle_count < 2) {
+        return;
+    }
+
+    // Triangles not emitted yet come first in the triangle list of every vertex
+    VertexTriangles adjacency(indices, vertex_count);
+    std::vector<u32> remaining(vertex_count);
+    for(size_t i = 0; i != vertex_count; ++i) {
+        remaining[i] = adjacency.offsets[i + 1] - adjacency.offsets[i];
+    }
+
+    std::vector<int> cache_positions(vertex_count, -1);
+    std::vector<float> scores(vertex_count);
+    for(size_t i = 0; i != vertex_count; ++i) {
+        scores[i] = table.score(-1, remaining[i]);
+    }
+
+    std::vector<u8> emitted(triangle_count, 0);
+    std::vector<u32> output;
+    output.reserve(indices.size());
+
+    std::vector<u32> cache;
+    std::vector<u32> new_cache;
+    cache.reserve(max_cache_size + 3);
+    new_cache.reserve(max_cache_size + 3);
+
+    u32 best = u32(-1);
+    size_t dead_end_cursor = 0;
+    while(output.size() != triangle_count * 3) {
+        // Nothing left around the cache: restart from the first triangle left in input order
+        if(best == u32(-1)) {
+            while(emitted[dead_end_cursor]) {
+                ++dead_end_cursor;
+            }
+            best = u32(dead_end_cursor);
+        }
+
+        emitted[best] = 1;
+        new_cache.clear();
+        for(u32 k = 0; k != 3; ++k) {
+            const u32 vertex = indices[best * 3 + k];
+            output.push_back(vertex);
+
+            u32* triangles = adjacency.triangles.data() + adjacency.offsets[vertex];
+            u32* last = triangles + remaining[vertex] - 1;
+            *std::find(triangles, last + 1, best) = *last;
+            *last = best;
+            --remaining[vertex];
+
+            if(std::find(new_cache.begin(), new_cache.end(), vertex) == new_cache.end()) {
+                new_cache.push_back(vertex);
+            }
+        }
+
+        // LRU cache: the vertices of the triangle move to the front
+        const size_t triangle_vertices = new_cache.size();
+        for(const u32 vertex : cache) {
+            if(std::find(new_cache.begin(), new_cache.begin() + triangle_vertices, vertex) == new_cache.begin() + triangle_vertices) {
+                new_cache.push_back(vertex);
+            }
+        }
+        for(size_t i = max_cache_size; i < new_cache.size(); ++i) {
+            cache_positions[new_cache[i]] = -1;
+        }
+        for(size_t i = 0; i != new_cache.size(); ++i) {
+            const u32 vertex = new_cache[i];
+            if(i < max_cache_size) {
+                cache_positions[vertex] = int(i);
+            }
+            scores[vertex] = table.score(cache_positions[vertex], remaining[vertex]);
+        }
+        new_cache.resize(std::min(new_cache.size(), size_t(max_cache_size)));
+        std::swap(cache, new_cache);
+
+        // Best triangle using a cached vertex, the lowest index wins ties so that the result is deterministic
+        best = u32(-1);
+        float best_score = -std::numeric_limits<float>::max();
+        for(const u32 vertex : cache) {
+            const u32* triangles = adjacency.triangles.data() + adjacency.offsets[vertex];
+            for(u32 i = 0; i != remaining[vertex]; ++i) {
+                const u32 triangle = triangles[i];
+                const float score = scores[indices[triangle * 3]] + scores[indices[triangle * 3 + 1]] + scores[indices[triangle * 3 + 2]];
+                if(score > best_score || (score == best_score && triangle < best)) {
+                    best = triangle;
+                    best_score = score;
+                }
+            }
+        }
+    }
+
+    std::copy(output.begin(), output.end(), indices.data());
+}
+
+void optimize_overdraw(Span<u32> indices, Span<const Vertex> vertices, float threshold) {
+    static constexpr u32 cache_size = 16;
+
+    const size_t triangle_count = indices.size() / 3;
+    if(triangle_count < 2) {
+        return;
+    }
+
+    // Same FIFO cache as analyze_vertex_cache, flush() empties it
+    std::vector<u32> timestamps(vertices.size(), 0);
+    u32 time = cache_size + 1;
+    auto misses = [&](size_t triangle) {
+        u32 count = 0;
+        for(u32 k = 0; k != 3; ++k) {
+            const u32 index = indices[triangle * 3 + k];
+            if(time - timestamps[index] > cache_size) {
+                timestamps[index] = time++;
+                ++count;
+            }
+        }
+        return count;
+    };
+    auto flush = [&] { time += cache_size + 1; };
+
+    // Hard boundaries, where the optimized order already starts over with a cold cache.
+    // The first triangle always starts one, even when it is degenerate and can't miss three times.
+    std::vector<u32> hard_boundaries;
+    for(size_t i = 0; i != triangle_count; ++i) {
+        if(misses(i) == 3 || i == 0) {
+            hard_boundaries.push_back(u32(i));
+        }
+    }
+    hard_boundaries.push_back(u32(triangle_count));
+
+    // Soft boundaries, where a cluster is cheap enough that starting the next one with a cold cache doesn't cost much
+    std::vector<u32> clusters;
+    for(size_t h = 0; h + 1 < hard_boundaries.size(); ++h) {
+        const u32 begin = hard_boundaries[h];
+        const u32 end = hard_boundaries[h + 1];
+
+        flush();
+        u32 run_misses = 0;
+        for(u32 i = begin; i != end; ++i) {
+            run_misses += misses(i);
+        }
+        const float max_acmr = threshold * float(run_misses) / float(end - begin);
+
+        flush();
+        clusters.push_back(begin);
+        u32 cluster_misses = 0;
+        for(u32 i = begin; i != end; ++i) {
+            cluster_misses += misses(i);
+            if(i + 1 != end && float(cluster_misses) <= max_acmr * float(i + 1 - clusters.back())) {
+                clusters.push_back(i + 1);
+                cluster_misses = 0;
+                flush();
+            }
+        }
+    }
+    clusters.push_back(u32(triangle_count));
+
+    const size_t cluster_count = clusters.size() - 1;
+    if(cluster_count < 2) {
+        return;
+    }
+
+    // Area weighted centroid and normal of every cluster
+    std::vector<glm::vec3> centroids(cluster_count, glm::vec3(0.0f));
+    std::vector<glm::vec3> normals(cluster_count, glm::vec3(0.0f));
+    glm::vec3 mesh_centroid(0.0f);
+    float mesh_area = 0.0f;
+    for(size_t c = 0; c != cluster_count; ++c) {
+        float area = 0.0f;
+        for(u32 i = clusters[c]; i != clusters[c + 1]; ++i) {
+            const glm::vec3& p0 = vertices[indices[i * 3]].position;
+            const glm::vec3& p1 = vertices[indices[i * 3 + 1]].position;
+            const glm::vec3& p2 = vertices[indices[i * 3 + 2]].position;
+            const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            const float triangle_area = glm::length(normal);
+            centroids[c] += (p0 + p1 + p2) * (triangle_area / 3.0f);
+            normals[c] += normal;
+            area += triangle_area;
+        }
+        mesh_centroid += centroids[c];
+        mesh_area += area;
+        centroids[c] = area > 0.0f ? centroids[c] / area : vertices[indices[clusters[c] * 3]].position;
+    }
+    if(mesh_area > 0.0f) {
+        mesh_centroid /= mesh_area;
+    }
+
+    // Clusters facing out of the mesh are the most likely to occlude the others
+    std::vector<float> keys(cluster_count);
+    for(size_t c = 0; c != cluster_count; ++c) {
+        const float length = glm::length(normals[c]);
+        keys[c] = length > 0.0f ? glm::dot(centroids[c] - mesh_centroid, normals[c] / length) : 0.0f;
+    }
+
+    std::vector<u32> order(cluster_count);
+    for(size_t c = 0; c != cluster_count; ++c) {
+        order[c] = u32(c);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](u32 a, u32 b) { return keys[a] > keys[b]; });
+
+    std::vector<u32> output;
+    output.reserve(indices.size());
+    for(const u32 c : order) {
+        output.insert(output.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+    }
+    ALWAYS_ASSERT(output.size() == indices.size(), "Clusters don't cover every triangle");
+    std::copy(output.begin(), output.end(), indices.data());
+}
+
+void optimize_vertex_fetch(std::vector<Vertex>& vertices, Span<u32> indices) {
+    std::vector<u32> remap(vertices.size(), u32(-1));
+    std::vector<Vertex> reordered;
+    reordered.reserve(vertices.size());
+
+    for(size_t i = 0; i != indices.size(); ++i) {
+        u32& index = indices[i];
+        if(remap[index] == u32(-1)) {
+            remap[index] = u32(reordered.size());
+            reordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    vertices = std::move(reordered);
+}
+
+}
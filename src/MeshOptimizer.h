@@ -0,0 +1,35 @@
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include <Vertex.h>
+#include <utils.h>
+
+#include <vector>
+
+namespace OM3D {
+
+// Post transform vertex cache efficiency of an index buffer, simulated with a FIFO cache
+struct VertexCacheStats {
+    // Average cache miss ratio: vertices transformed per triangle, from 3 down to about 0.5 on large regular meshes
+    float acmr = 0.0f;
+    // Average transform to vertex ratio: vertices transformed per referenced vertex, 1 at best
+    float atvr = 0.0f;
+};
+
+VertexCacheStats analyze_vertex_cache(Span<const u32> indices, size_t vertex_count, u32 cache_size = 16);
+
+// Reorder triangles for the post transform vertex cache, with Forsyth's "Linear-Speed Vertex Cache Optimisation".
+// Triangles sharing vertices with the ones just emitted come first, vertices with few triangles left are finished first.
+void optimize_vertex_cache(Span<u32> indices, size_t vertex_count);
+
+// Reorder clusters of triangles so that the ones facing out of the mesh are drawn first, to reduce overdraw (Sander et al., Tipsify).
+// Expects indices optimized for the vertex cache: they are only split where the cache would be flushed anyway,
+// or where the cluster miss ratio stays under threshold times the one of the whole run.
+void optimize_overdraw(Span<u32> indices, Span<const Vertex> vertices, float threshold = 1.05f);
+
+// Reorder vertices by first use in the index buffer and drop unreferenced ones, remapping the indices
+void optimize_vertex_fetch(std::vector<Vertex>& vertices, Span<u32> indices);
+
+}
+
+#endif // MESHOPTIMIZER_H
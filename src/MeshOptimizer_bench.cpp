@@ -0,0 +1,115 @@
+#include "MeshOptimizer.h"
+
+#include <benchmarks.h>
+
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <algorithm>
+#include <array>
+
+namespace OM3D {
+
+// Triangles as position triples, rotated to start with their smallest position so that the winding is kept
+static std::vector<std::array<glm::vec3, 3>> triangle_positions(const MeshData& mesh) {
+    auto less = [](const glm::vec3& a, const glm::vec3& b) {
+        return std::lexicographical_compare(&a.x, &a.x + 3, &b.x, &b.x + 3);
+    };
+
+    std::vector<std::array<glm::vec3, 3>> triangles;
+    for(size_t i = 0; i != mesh.indices.size(); i += 3) {
+        std::array<glm::vec3, 3> tri = {mesh.vertices[mesh.indices[i]].position, mesh.vertices[mesh.indices[i + 1]].position, mesh.vertices[mesh.indices[i + 2]].position};
+        std::rotate(tri.begin(), std::min_element(tri.begin(), tri.end(), less), tri.end());
+        triangles.push_back(tri);
+    }
+    std::sort(triangles.begin(), triangles.end(), [&](const std::array<glm::vec3, 3>& a, const std::array<glm::vec3, 3>& b) {
+        return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(), less);
+    });
+    return triangles;
+}
+
+void bench_mesh_optimization() {
+    std::cout << "Index buffer optimization (ACMR / ATVR with a 16 entry FIFO cache)" << std::endl;
+
+    auto shuffled = [](MeshData mesh) {
+        std::vector<u32> triangles(mesh.indices.size() / 3);
+        for(u32 i = 0; i != triangles.size(); ++i) {
+            triangles[i] = i;
+        }
+        std::shuffle(triangles.begin(), triangles.end(), std::mt19937(0x5EED));
+        std::vector<u32> indices;
+        for(const u32 triangle : triangles) {
+            indices.insert(indices.end(), mesh.indices.begin() + triangle * 3, mesh.indices.begin() + triangle * 3 + 3);
+        }
+        mesh.indices = std::move(indices);
+        return mesh;
+    };
+
+    const std::pair<const char*, MeshData> meshes[] = {
+        {"grid (row order)      ", flat_grid(128)},
+        {"sphere (subdivision)  ", bumpy_sphere(6)},
+        {"sphere (shuffled)     ", shuffled(bumpy_sphere(6))},
+    };
+
+    for(const auto& [name, source] : meshes) {
+        MeshData mesh = source;
+        const VertexCacheStats before = analyze_vertex_cache(mesh.indices, mesh.vertices.size());
+
+        const double cache_time = time_ms([&] { optimize_vertex_cache(mesh.indices, mesh.vertices.size()); });
+        const VertexCacheStats cache = analyze_vertex_cache(mesh.indices, mesh.vertices.size());
+        const double overdraw_time = time_ms([&] { optimize_overdraw(mesh.indices, mesh.vertices); });
+        const VertexCacheStats overdraw = analyze_vertex_cache(mesh.indices, mesh.vertices.size());
+        const double fetch_time = time_ms([&] { optimize_vertex_fetch(mesh.vertices, mesh.indices); });
+
+        // Same triangles with the same winding, vertices in first use order
+        bool valid = triangle_positions(mesh) == triangle_positions(source);
+        u32 next_vertex = 0;
+        for(const u32 index : mesh.indices) {
+            valid &= index <= next_vertex;
+            next_vertex = std::max(next_vertex, index + 1);
+        }
+        valid &= next_vertex == mesh.vertices.size();
+        valid &= cache.acmr <= before.acmr && overdraw.acmr <= cache.acmr * 1.1f;
+
+        // Must be deterministic
+        MeshData again = source;
+        again.optimize();
+        valid &= again.indices == mesh.indices;
+
+        // Meshlets regroup a copy of the triangles, but keep them local
+        again.build_meshlets();
+        valid &= again.indices == mesh.indices;
+        const VertexCacheStats meshlets = analyze_vertex_cache(again.meshlet_indices, again.vertices.size());
+
+        std::cout << "  " << name << std::setw(6) << mesh.indices.size() / 3 << " triangles: " << std::setprecision(2)
+                  << before.acmr << " / " << before.atvr << " -> "
+                  << "cache " << cache.acmr << " / " << cache.atvr << " -> "
+                  << "overdraw " << overdraw.acmr << " / " << overdraw.atvr << " -> "
+                  << "meshlet copy " << meshlets.acmr << " / " << meshlets.atvr << std::setprecision(3)
+                  << " (" << cache_time << "ms + " << overdraw_time << "ms + " << fetch_time << "ms)"
+                  << check_result(valid) << std::endl;
+    }
+
+    // A degenerate first triangle can't start a cold cache run, it must still start the first cluster
+    {
+        std::vector<Vertex> vertices(12);
+        for(u32 i = 0; i != vertices.size(); ++i) {
+            vertices[i].position = glm::vec3(float(i % 3), float(i / 3), float(i % 2));
+        }
+        const std::vector<u32> source = {0, 0, 1,  0, 1, 2,  3, 4, 5,  6, 7, 8,  9, 10, 11};
+        std::vector<u32> indices = source;
+        optimize_overdraw(indices, vertices);
+
+        auto sorted_triangles = [](const std::vector<u32>& list) {
+            std::vector<std::array<u32, 3>> triangles;
+            for(size_t i = 0; i != list.size(); i += 3) {
+                triangles.push_back({list[i], list[i + 1], list[i + 2]});
+            }
+            std::sort(triangles.begin(), triangles.end());
+            return triangles;
+        };
+        std::cout << "  degenerate first triangle: every triangle kept" << check_result(sorted_triangles(indices) == sorted_triangles(source)) << std::endl;
+    }
+}
+
+}
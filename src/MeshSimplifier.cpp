@@ -0,0 +1,501 @@
+#include "MeshSimplifier.h"
+
+#include <glm/geometric.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+namespace OM3D {
+
+// Border planes are weighted like triangles this many times bigger than the edge length squared
+static constexpr double border_weight = 10.0;
+
+// Cosine under which a collapse is considered to flip a triangle
+static constexpr float min_normal_cosine = 0.2f;
+
+Quadric Quadric::from_plane(const glm::dvec3& normal, double d, double weight) {
+    Quadric q;
+    q.a00 = weight * normal.x * normal.x;
+    q.a01 = weight * normal.x * normal.y;
+    q.a02 = weight * normal.x * normal.z;
+    q.a03 = weight * normal.x * d;
+    q.a11 = weight * normal.y * normal.y;
+    q.a12 = weight * normal.y * normal.z;
+    q.a13 = weight * normal.y * d;
+    q.a22 = weight * normal.z * normal.z;
+    q.a23 = weight * normal.z * d;
+    q.a33 = weight * d * d;
+    q.weight = weight;
+    return q;
+}
+
+void Quadric::add(const Quadric& other) {
+    a00 += other.a00; a01 += other.a01; a02 += other.a02; a03 += other.a03;
+    a11 += other.a11; a12 += other.a12; a13 += other.a13;
+    a22 += other.a22; a23 += other.a23;
+    a33 += other.a33;
+    weight += other.weight;
+}
+
+double Quadric::evaluate(const glm::dvec3& p) const {
+    const double x = p.x;
+    const double y = p.y;
+    const double z = p.z;
+    const double error =
+        a00 * x * x + 2.0 * a01 * x * y + 2.0 * a02 * x * z + 2.0 * a03 * x +
+        a11 * y * y + 2.0 * a12 * y * z + 2.0 * a13 * y +
+        a22 * z * z + 2.0 * a23 * z +
+        a33;
+    // Rounding can make it slightly negative
+    return std::max(error, 0.0);
+}
+
+double Quadric::mean_error(const glm::dvec3& p) const {
+    return weight > 0.0 ? evaluate(p) / weight : 0.0;
+}
+
+static u64 edge_key(u32 a, u32 b) {
+    return (u64(std::min(a, b)) << 32) | std::max(a, b);
+}
+
+static float point_triangle_distance(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+    // Closest point from Real-Time Collision Detection, 5.1.5
+    const glm::vec3 ab = b - a;
+    const glm::vec3 ac = c - a;
+    const glm::vec3 ap = p - a;
+    const float d1 = glm::dot(ab, ap);
+    const float d2 = glm::dot(ac, ap);
+    if(d1 <= 0.0f && d2 <= 0.0f) {
+        return glm::length(ap);
+    }
+
+    const glm::vec3 bp = p - b;
+    const float d3 = glm::dot(ab, bp);
+    const float d4 = glm::dot(ac, bp);
+    if(d3 >= 0.0f && d4 <= d3) {
+        return glm::length(bp);
+    }
+
+    const float vc = d1 * d4 - d3 * d2;
+    if(vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+        return glm::length(p - (a + ab * (d1 / (d1 - d3))));
+    }
+
+    const glm::vec3 cp = p - c;
+    const float d5 = glm::dot(ab, cp);
+    const float d6 = glm::dot(ac, cp);
+    if(d6 >= 0.0f && d5 <= d6) {
+        return glm::length(cp);
+    }
+
+    const float vb = d5 * d2 - d1 * d6;
+    if(vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+        return glm::length(p - (a + ac * (d2 / (d2 - d6))));
+    }
+
+    const float va = d3 * d6 - d5 * d4;
+    if(va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+        return glm::length(p - (b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)))));
+    }
+
+    const float denom = va + vb + vc;
+    if(denom <= 0.0f) {
+        // Degenerate triangle
+        return std::min({glm::length(ap), glm::length(bp), glm::length(cp)});
+    }
+    return glm::length(p - (a + ab * (vb / denom) + ac * (vc / denom)));
+}
+
+MeshSimplifier::MeshSimplifier(Span<const Vertex> vertices, Span<const u32> indices) {
+    const u32 wedge_count = u32(vertices.size());
+
+    // Weld wedges by position
+    _positions.resize(wedge_count);
+    _welded.resize(wedge_count);
+    std::vector<u32> wedges_per_vertex(wedge_count, 0);
+    {
+        auto hash = [](const glm::vec3& p) {
+            u32 bits[3] = {};
+            std::memcpy(bits, &p, sizeof(bits));
+            return (u64(bits[0]) * 0x9E3779B97F4A7C15ull) ^ (u64(bits[1]) * 0xC2B2AE3D27D4EB4Full) ^ (u64(bits[2]) * 0x165667B19E3779F9ull);
+        };
+        std::unordered_multimap<u64, u32> buckets;
+        for(u32 i = 0; i != wedge_count; ++i) {
+            const glm::vec3& p = vertices[i].position;
+            _positions[i] = p;
+            _welded[i] = i;
+
+            const u64 h = hash(p);
+            const auto [begin, end] = buckets.equal_range(h);
+            for(auto it = begin; it != end; ++it) {
+                if(_positions[it->second] == p) {
+                    _welded[i] = it->second;
+                    break;
+                }
+            }
+            if(_welded[i] == i) {
+                buckets.emplace(h, i);
+            }
+            ++wedges_per_vertex[_welded[i]];
+        }
+    }
+
+    _quadrics.resize(wedge_count);
+    _kinds.assign(wedge_count, VertexKind::Manifold);
+    _collapsed_into.resize(wedge_count);
+    _versions.assign(wedge_count, 0);
+    _vertex_triangles.resize(wedge_count);
+    for(u32 i = 0; i != wedge_count; ++i) {
+        _collapsed_into[i] = i;
+    }
+
+    // Degenerate triangles are dropped
+    _triangles.reserve(indices.size() / 3);
+    for(size_t i = 0; i + 2 < indices.size(); i += 3) {
+        const glm::uvec3 tri(indices[i], indices[i + 1], indices[i + 2]);
+        const u32 a = _welded[tri.x];
+        const u32 b = _welded[tri.y];
+        const u32 c = _welded[tri.z];
+        if(a == b || b == c || c == a) {
+            continue;
+        }
+
+        const u32 index = u32(_triangles.size());
+        _triangles.push_back(tri);
+        _vertex_triangles[a].push_back(index);
+        _vertex_triangles[b].push_back(index);
+        _vertex_triangles[c].push_back(index);
+    }
+    _removed.assign(_triangles.size(), 0);
+    _triangle_count = _triangles.size();
+
+    // Triangles sharing every welded edge
+    std::unordered_map<u64, u32> edge_triangles;
+    for(const glm::uvec3& tri : _triangles) {
+        for(u32 k = 0; k != 3; ++k) {
+            ++edge_triangles[edge_key(_welded[tri[k]], _welded[tri[(k + 1) % 3]])];
+        }
+    }
+
+    std::vector<u32> border_edges(wedge_count, 0);
+    for(const glm::uvec3& tri : _triangles) {
+        const glm::dvec3 p0 = _positions[tri.x];
+        const glm::dvec3 p1 = _positions[tri.y];
+        const glm::dvec3 p2 = _positions[tri.z];
+        const glm::dvec3 cross = glm::cross(p1 - p0, p2 - p0);
+        const double area2 = glm::length(cross);
+
+        // Zero area triangles still count for the topology
+        const glm::dvec3 normal = area2 > 0.0 ? cross / area2 : glm::dvec3(0.0);
+        if(area2 > 0.0) {
+            const Quadric plane = Quadric::from_plane(normal, -glm::dot(normal, p0), area2 * 0.5);
+            for(u32 k = 0; k != 3; ++k) {
+                _quadrics[_welded[tri[k]]].add(plane);
+            }
+        }
+
+        // Open edges get a plane orthogonal to the triangle, so that the border keeps its shape
+        for(u32 k = 0; k != 3; ++k) {
+            const u32 a = _welded[tri[k]];
+            const u32 b = _welded[tri[(k + 1) % 3]];
+            const u32 count = edge_triangles[edge_key(a, b)];
+            if(count == 1) {
+                const glm::dvec3 pa = _positions[a];
+                const glm::dvec3 edge = glm::dvec3(_positions[b]) - pa;
+                const double length2 = glm::dot(edge, edge);
+                if(length2 > 0.0 && area2 > 0.0) {
+                    const glm::dvec3 border_normal = glm::normalize(glm::cross(edge, normal));
+                    const Quadric border = Quadric::from_plane(border_normal, -glm::dot(border_normal, pa), length2 * border_weight);
+                    _quadrics[a].add(border);
+                    _quadrics[b].add(border);
+                }
+                ++border_edges[a];
+                ++border_edges[b];
+            } else if(count > 2) {
+                _kinds[a] = VertexKind::Locked;
+                _kinds[b] = VertexKind::Locked;
+            }
+        }
+    }
+
+    for(u32 i = 0; i != wedge_count; ++i) {
+        if(_welded[i] != i) {
+            continue;
+        }
+        if(wedges_per_vertex[i] > 1 || border_edges[i] > 2) {
+            _kinds[i] = VertexKind::Locked;
+        } else if(border_edges[i] && _kinds[i] != VertexKind::Locked) {
+            _kinds[i] = VertexKind::Border;
+        }
+    }
+
+    for(u32 i = 0; i != wedge_count; ++i) {
+        if(_welded[i] == i) {
+            push_collapses(i);
+        }
+    }
+}
+
+float MeshSimplifier::collapse_cost(u32 from, u32 to) const {
+    Quadric q = _quadrics[from];
+    q.add(_quadrics[to]);
+    return float(q.mean_error(_positions[to]));
+}
+
+void MeshSimplifier::push_collapse(u32 from, u32 to) {
+    if(_kinds[from] == VertexKind::Locked) {
+        return;
+    }
+
+    _heap.push_back(Collapse{collapse_cost(from, to), from, to, _versions[from], _versions[to]});
+    std::push_heap(_heap.begin(), _heap.end());
+}
+
+void MeshSimplifier::gather_neighbours(u32 vertex, std::vector<u32>& neighbours) const {
+    neighbours.clear();
+    for(const u32 t : _vertex_triangles[vertex]) {
+        if(_removed[t]) {
+            continue;
+        }
+        for(u32 k = 0; k != 3; ++k) {
+            const u32 other = _welded[_triangles[t][k]];
+            if(other != vertex) {
+                neighbours.push_back(other);
+            }
+        }
+    }
+    std::sort(neighbours.begin(), neighbours.end());
+    neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+}
+
+void MeshSimplifier::push_collapses(u32 vertex) {
+    gather_neighbours(vertex, _scratch_neighbours);
+    for(const u32 other : _scratch_neighbours) {
+        push_collapse(vertex, other);
+        push_collapse(other, vertex);
+    }
+}
+
+bool MeshSimplifier::is_valid(const Collapse& collapse, u32& to_wedge) {
+    const u32 from = collapse.from;
+    const u32 to = collapse.to;
+    if(_versions[from] != collapse.from_version || _versions[to] != collapse.to_version) {
+        return false;
+    }
+    if(_collapsed_into[from] != from || _collapsed_into[to] != to) {
+        return false;
+    }
+
+    // Triangles sharing the edge, and the wedge of the target they use
+    u32 shared = 0;
+    to_wedge = u32(-1);
+    for(const u32 t : _vertex_triangles[from]) {
+        if(_removed[t]) {
+            continue;
+        }
+
+        for(u32 k = 0; k != 3; ++k) {
+            const u32 wedge = _triangles[t][k];
+            if(_welded[wedge] == to) {
+                if(to_wedge != u32(-1) && to_wedge != wedge) {
+                    // The edge crosses an attribute seam of the target
+                    return false;
+                }
+                to_wedge = wedge;
+                ++shared;
+            }
+        }
+    }
+
+    if(!shared || shared > 2) {
+        return false;
+    }
+    const bool border_edge = (shared == 1);
+    if(_kinds[from] == VertexKind::Border ? !border_edge : border_edge) {
+        return false;
+    }
+
+    // Link condition: the only common neighbours are the opposite vertices of the shared triangles
+    gather_neighbours(from, _scratch_neighbours);
+    gather_neighbours(to, _scratch_other_neighbours);
+    u32 common = 0;
+    for(auto a = _scratch_neighbours.begin(), b = _scratch_other_neighbours.begin(); a != _scratch_neighbours.end() && b != _scratch_other_neighbours.end();) {
+        if(*a < *b) {
+            ++a;
+        } else if(*b < *a) {
+            ++b;
+        } else {
+            ++common;
+            ++a;
+            ++b;
+        }
+    }
+    if(common != shared) {
+        return false;
+    }
+
+    // Moving the vertex must not flip or collapse the remaining triangles
+    const glm::vec3& new_position = _positions[to];
+    for(const u32 t : _vertex_triangles[from]) {
+        if(_removed[t]) {
+            continue;
+        }
+
+        glm::vec3 p[3];
+        bool has_to = false;
+        u32 moved = 0;
+        for(u32 k = 0; k != 3; ++k) {
+            const u32 vertex = _welded[_triangles[t][k]];
+            has_to |= (vertex == to);
+            if(vertex == from) {
+                moved = k;
+            }
+            p[k] = _positions[vertex];
+        }
+        if(has_to) {
+            continue;
+        }
+
+        const glm::vec3 old_normal = glm::cross(p[1] - p[0], p[2] - p[0]);
+        p[moved] = new_position;
+        const glm::vec3 new_normal = glm::cross(p[1] - p[0], p[2] - p[0]);
+        const float new_length = glm::length(new_normal);
+        if(new_length <= 0.0f || glm::dot(old_normal, new_normal) <= min_normal_cosine * glm::length(old_normal) * new_length) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void MeshSimplifier::collapse(u32 from, u32 to, u32 to_wedge) {
+    _quadrics[to].add(_quadrics[from]);
+    _collapsed_into[from] = to;
+    ++_versions[from];
+    ++_versions[to];
+
+    std::vector<u32>& to_triangles = _vertex_triangles[to];
+    for(const u32 t : _vertex_triangles[from]) {
+        if(_removed[t]) {
+            continue;
+        }
+
+        glm::uvec3& tri = _triangles[t];
+        bool has_to = false;
+        for(u32 k = 0; k != 3; ++k) {
+            has_to |= (_welded[tri[k]] == to);
+        }
+
+        if(has_to) {
+            _removed[t] = 1;
+            --_triangle_count;
+            continue;
+        }
+
+        // The collapsed vertex isn't on a seam, so it only has one wedge
+        for(u32 k = 0; k != 3; ++k) {
+            if(_welded[tri[k]] == from) {
+                tri[k] = to_wedge;
+            }
+        }
+        to_triangles.push_back(t);
+    }
+    _vertex_triangles[from].clear();
+    _vertex_triangles[from].shrink_to_fit();
+
+    to_triangles.erase(std::remove_if(to_triangles.begin(), to_triangles.end(), [&](u32 t) { return _removed[t]; }), to_triangles.end());
+
+    push_collapses(to);
+}
+
+void MeshSimplifier::simplify(size_t target_index_count, float max_error) {
+    const double max_cost = double(max_error) * double(max_error);
+
+    while(_triangle_count * 3 > target_index_count && !_heap.empty()) {
+        std::pop_heap(_heap.begin(), _heap.end());
+        const Collapse candidate = _heap.back();
+        _heap.pop_back();
+
+        if(double(candidate.cost) > max_cost) {
+            // Invalid candidates are never cheaper than valid ones once recomputed, keep it for the next call
+            if(_versions[candidate.from] == candidate.from_version && _versions[candidate.to] == candidate.to_version) {
+                _heap.push_back(candidate);
+                std::push_heap(_heap.begin(), _heap.end());
+                break;
+            }
+            continue;
+        }
+
+        u32 to_wedge = 0;
+        if(is_valid(candidate, to_wedge)) {
+            collapse(candidate.from, candidate.to, to_wedge);
+        }
+    }
+
+    compute_error();
+}
+
+u32 MeshSimplifier::find_target(u32 vertex) const {
+    while(_collapsed_into[vertex] != vertex) {
+        vertex = _collapsed_into[vertex];
+    }
+    return vertex;
+}
+
+void MeshSimplifier::compute_error() {
+    // Every vertex collapsed (possibly through others) into a surviving vertex, its distance to the triangles around it bounds its distance to the surface
+    float error = 0.0f;
+    for(u32 i = 0; i != u32(_collapsed_into.size()); ++i) {
+        if(_welded[i] != i || _collapsed_into[i] == i) {
+            continue;
+        }
+
+        const u32 target = find_target(i);
+        float distance = glm::length(_positions[i] - _positions[target]);
+
+        auto ring_distance = [&](u32 vertex) {
+            for(const u32 t : _vertex_triangles[vertex]) {
+                if(!_removed[t]) {
+                    const glm::uvec3& tri = _triangles[t];
+                    distance = std::min(distance, point_triangle_distance(_positions[i], _positions[tri.x], _positions[tri.y], _positions[tri.z]));
+                }
+            }
+        };
+
+        // Only the max matters, stop looking as soon as the vertex is closer than that
+        if(distance > error) {
+            ring_distance(target);
+        }
+        if(distance > error) {
+            // The vertex may have slid past the first ring
+            gather_neighbours(target, _scratch_neighbours);
+            for(const u32 vertex : _scratch_neighbours) {
+                ring_distance(vertex);
+            }
+        }
+        error = std::max(error, distance);
+    }
+    _error = error;
+}
+
+size_t MeshSimplifier::index_count() const {
+    return _triangle_count * 3;
+}
+
+std::vector<u32> MeshSimplifier::indices() const {
+    std::vector<u32> indices;
+    indices.reserve(_triangle_count * 3);
+    for(size_t t = 0; t != _triangles.size(); ++t) {
+        if(!_removed[t]) {
+            indices.insert(indices.end(), {_triangles[t].x, _triangles[t].y, _triangles[t].z});
+        }
+    }
+    return indices;
+}
+
+float MeshSimplifier::error() const {
+    return _error;
+}
+
+}
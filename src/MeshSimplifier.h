@@ -0,0 +1,105 @@
+#ifndef MESHSIMPLIFIER_H
+#define MESHSIMPLIFIER_H
+
+#include <Vertex.h>
+#include <utils.h>
+
+#include <limits>
+#include <vector>
+
+namespace OM3D {
+
+// Sum of weighted squared distances to a set of planes, stored as a symmetric 4x4 matrix
+struct Quadric {
+    // Upper triangle of the matrix, row by row
+    double a00 = 0.0, a01 = 0.0, a02 = 0.0, a03 = 0.0;
+    double a11 = 0.0, a12 = 0.0, a13 = 0.0;
+    double a22 = 0.0, a23 = 0.0;
+    double a33 = 0.0;
+    double weight = 0.0;
+
+    // Plane of points p such that dot(normal, p) + d = 0, normal must be normalized
+    static Quadric from_plane(const glm::dvec3& normal, double d, double weight);
+
+    void add(const Quadric& other);
+
+    // Weighted sum of the squared distances of the point to the planes
+    double evaluate(const glm::dvec3& p) const;
+    // Weighted mean of the squared distances
+    double mean_error(const glm::dvec3& p) const;
+};
+
+// Quadric error metric edge collapse (Garland & Heckbert).
+// Vertices are only ever collapsed onto other existing vertices, so that simplified index buffers still index the original vertices.
+// Vertices sharing a position are welded while simplifying. Attribute seams and non-manifold vertices are locked,
+// vertices on open borders only collapse along the border, which is also kept in place by extra quadrics.
+class MeshSimplifier : NonCopyable {
+    public:
+        MeshSimplifier(Span<const Vertex> vertices, Span<const u32> indices);
+
+        // Collapse edges until at most target_index_count indices are left, or until the cheapest collapse
+        // would be further than max_error from the merged planes. Can be called again with a lower target to keep simplifying.
+        void simplify(size_t target_index_count, float max_error = std::numeric_limits<float>::max());
+
+        size_t index_count() const;
+        std::vector<u32> indices() const;
+
+        // Upper bound on the distance from every original vertex to the simplified surface
+        float error() const;
+
+    private:
+        enum class VertexKind : u8 {
+            Manifold,
+            Border,
+            Locked,
+        };
+
+        struct Collapse {
+            float cost = 0.0f;
+            u32 from = 0;
+            u32 to = 0;
+            u32 from_version = 0;
+            u32 to_version = 0;
+
+            bool operator<(const Collapse& other) const {
+                // Cheapest first in std::priority_queue
+                return cost > other.cost;
+            }
+        };
+
+        // Sorted welded vertices sharing a triangle with the vertex
+        void gather_neighbours(u32 vertex, std::vector<u32>& neighbours) const;
+
+        float collapse_cost(u32 from, u32 to) const;
+        void push_collapse(u32 from, u32 to);
+        void push_collapses(u32 vertex);
+        bool is_valid(const Collapse& collapse, u32& to_wedge);
+        void collapse(u32 from, u32 to, u32 to_wedge);
+
+        u32 find_target(u32 vertex) const;
+        void compute_error();
+
+        std::vector<glm::vec3> _positions;   // Indexed by wedge
+        std::vector<u32> _welded;            // Welded vertex of every wedge
+
+        // Indexed by welded vertex (the first wedge having its position)
+        std::vector<Quadric> _quadrics;
+        std::vector<VertexKind> _kinds;
+        std::vector<u32> _collapsed_into;
+        std::vector<u32> _versions;
+        std::vector<std::vector<u32>> _vertex_triangles;
+
+        // Wedge indices of every triangle
+        std::vector<glm::uvec3> _triangles;
+        std::vector<u8> _removed;
+        size_t _triangle_count = 0;
+
+        std::vector<Collapse> _heap;
+        std::vector<u32> _scratch_neighbours;
+        std::vector<u32> _scratch_other_neighbours;
+        float _error = 0.0f;
+};
+
+}
+
+#endif // MESHSIMPLIFIER_H
@@ -0,0 +1,121 @@
+#include "MeshSimplifier.h"
+
+#include <benchmarks.h>
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <limits>
+
+namespace OM3D {
+
+static float segment_distance(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b) {
+    const glm::vec3 ab = b - a;
+    const float t = glm::clamp(glm::dot(p - a, ab) / std::max(glm::dot(ab, ab), 1.0e-20f), 0.0f, 1.0f);
+    return glm::length(p - (a + ab * t));
+}
+
+// Brute force distance from every vertex to the triangles
+static float max_vertex_distance(Span<const Vertex> vertices, Span<const u32> indices) {
+    float max_distance = 0.0f;
+    for(const Vertex& vertex : vertices) {
+        const glm::vec3& p = vertex.position;
+        float distance = std::numeric_limits<float>::max();
+        for(size_t i = 0; i != indices.size(); i += 3) {
+            const glm::vec3& a = vertices[indices[i]].position;
+            const glm::vec3& b = vertices[indices[i + 1]].position;
+            const glm::vec3& c = vertices[indices[i + 2]].position;
+
+            const glm::vec3 n = glm::cross(b - a, c - a);
+            const float length = glm::length(n);
+            if(length > 0.0f) {
+                // Inside the triangle: distance to the plane
+                const glm::vec3 normal = n / length;
+                const glm::vec3 q = p - normal * glm::dot(p - a, normal);
+                if(glm::dot(glm::cross(b - a, q - a), n) >= 0.0f && glm::dot(glm::cross(c - b, q - b), n) >= 0.0f && glm::dot(glm::cross(a - c, q - c), n) >= 0.0f) {
+                    distance = std::min(distance, std::abs(glm::dot(p - a, normal)));
+                    continue;
+                }
+            }
+            distance = std::min({distance, segment_distance(p, a, b), segment_distance(p, b, c), segment_distance(p, c, a)});
+        }
+        max_distance = std::max(max_distance, distance);
+    }
+    return max_distance;
+}
+
+void bench_mesh_simplification() {
+    std::cout << "Mesh LOD generation (quadric edge collapse)" << std::endl;
+
+    // Quadrics must give back squared distances to their planes
+    {
+        const glm::dvec3 normal = glm::normalize(glm::dvec3(1.0, 2.0, -0.5));
+        Quadric q = Quadric::from_plane(normal, -0.25, 2.0);
+        q.add(Quadric::from_plane(glm::dvec3(0.0, 1.0, 0.0), 1.0, 1.0));
+        const glm::dvec3 p(0.3, -0.7, 2.0);
+        const double d0 = glm::dot(normal, p) - 0.25;
+        const double d1 = p.y + 1.0;
+        const double expected = 2.0 * d0 * d0 + d1 * d1;
+        const bool valid = std::abs(q.evaluate(p) - expected) <= 1.0e-9 && std::abs(q.mean_error(p) - expected / 3.0) <= 1.0e-9;
+        std::cout << "  quadric evaluation" << check_result(valid) << std::endl;
+    }
+
+    // Error bounds against the brute force distance from the original vertices to every level
+    for(const bool flat : {false, true}) {
+        MeshData mesh = flat ? flat_grid(48) : bumpy_sphere(4);
+        mesh.generate_lods();
+
+        bool valid = !mesh.lods.empty();
+        size_t previous_count = mesh.indices.size();
+        std::cout << "  " << (flat ? "flat grid  " : "bumpy sphere") << " " << std::setw(6) << mesh.indices.size() / 3 << " triangles:";
+        for(const MeshLodData& lod : mesh.lods) {
+            const float measured = max_vertex_distance(mesh.vertices, lod.indices);
+            valid &= measured <= lod.error * 1.0001f + 1.0e-6f;
+            valid &= lod.indices.size() < previous_count;
+            valid &= std::all_of(lod.indices.begin(), lod.indices.end(), [&](u32 i) { return i < mesh.vertices.size(); });
+            // Flat meshes simplify without moving the surface until only the corners are left, the bound should stay tight
+            if(flat && lod.indices.size() >= 3 * 16) {
+                valid &= lod.error <= 1.0e-3f;
+            }
+            std::cout << " " << lod.indices.size() / 3 << " (" << std::setprecision(5) << lod.error << " >= " << measured << ")" << std::setprecision(3);
+            previous_count = lod.indices.size();
+        }
+        std::cout << check_result(valid) << std::endl;
+    }
+
+    for(const u32 subdivisions : {5, 6}) {
+        MeshData mesh = bumpy_sphere(subdivisions);
+        const double time = time_ms([&] { mesh.generate_lods(); });
+
+        size_t lod_indices = 0;
+        for(const MeshLodData& lod : mesh.lods) {
+            lod_indices += lod.indices.size();
+        }
+        std::cout << "  " << std::setw(6) << mesh.indices.size() / 3 << " triangles: " << mesh.lods.size() << " levels in " << time << "ms, "
+                  << "+" << std::setprecision(1) << 100.0 * double(lod_indices) / double(mesh.indices.size()) << "% indices" << std::setprecision(3) << std::endl;
+
+        if(subdivisions != 6) {
+            continue;
+        }
+
+        // Level picked for a 1 pixel error at 1080p with a 60 degree field of view, like Scene::select_lod
+        const float pixel_scale = 1080.0f * 0.5f / std::tan(glm::radians(30.0f));
+        std::cout << "    distance:";
+        for(const float distance : {2.0f, 5.0f, 10.0f, 25.0f, 50.0f, 100.0f, 250.0f, 1000.0f, 5000.0f}) {
+            const float pixels_per_unit = pixel_scale / (distance - 1.0f);
+            if(pixels_per_unit < 0.5f) {
+                std::cout << " " << std::setprecision(0) << distance << "=culled" << std::setprecision(3);
+                continue;
+            }
+            u32 lod = 0;
+            while(lod != mesh.lods.size() && mesh.lods[lod].error <= 1.0f / pixels_per_unit) {
+                ++lod;
+            }
+            const size_t triangles = (lod ? mesh.lods[lod - 1].indices.size() : mesh.indices.size()) / 3;
+            std::cout << " " << std::setprecision(0) << distance << "=" << triangles << std::setprecision(3);
+        }
+        std::cout << std::endl;
+    }
+}
+
+}
@@ -0,0 +1,180 @@
+#include "Meshlets.h"
+
+#include <glm/geometric.hpp>
+
+#include <cmath>
+
+namespace OM3D {
+
+// Above this, the triangles face too many directions for the cone to cull anything useful
+static constexpr float min_cone_spread = 0.1f;
+
+bool Meshlet::is_back_facing(const glm::vec3& camera_position) const {
+    const glm::vec3 to_apex = cone_apex - camera_position;
+    const float distance = glm::length(to_apex);
+    return distance > 0.0f && glm::dot(to_apex, cone_axis) >= cone_cutoff * distance;
+}
+
+static void compute_bounds(Meshlet& meshlet, Span<const Vertex> vertices, Span<const u32> indices) {
+    AABB box;
+    for(u32 i = 0; i != meshlet.index_count; ++i) {
+        box.add(vertices[indices[meshlet.first_index + i]].position);
+    }
+
+    const glm::vec3 center = box.center();
+    float radius = 0.0f;
+    for(u32 i = 0; i != meshlet.index_count; ++i) {
+        radius = std::max(radius, glm::length(vertices[indices[meshlet.first_index + i]].position - center));
+    }
+    meshlet.bounds = BoundingSphere{center, radius};
+
+    // Normal cone, as in meshoptimizer's meshopt_computeClusterBounds
+    meshlet.cone_apex = center;
+    meshlet.cone_axis = glm::vec3(0.0f);
+    meshlet.cone_cutoff = 1.0f;
+
+    std::vector<glm::vec3> normals;
+    normals.reserve(meshlet.index_count / 3);
+    glm::vec3 axis(0.0f);
+    for(u32 i = 0; i != meshlet.index_count; i += 3) {
+        const glm::vec3& p0 = vertices[indices[meshlet.first_index + i]].position;
+        const glm::vec3& p1 = vertices[indices[meshlet.first_index + i + 1]].position;
+        const glm::vec3& p2 = vertices[indices[meshlet.first_index + i + 2]].position;
+        const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        const float length = glm::length(normal);
+        // Degenerate triangles are never visible
+        normals.push_back(length > 0.0f ? normal / length : glm::vec3(0.0f));
+        axis += normals.back();
+    }
+
+    const float axis_length = glm::length(axis);
+    if(axis_length <= 0.0f) {
+        return;
+    }
+    axis /= axis_length;
+
+    float min_dot = 1.0f;
+    for(const glm::vec3& normal : normals) {
+        if(normal != glm::vec3(0.0f)) {
+            min_dot = std::min(min_dot, glm::dot(axis, normal));
+        }
+    }
+    if(min_dot <= min_cone_spread) {
+        return;
+    }
+
+    // Move the apex back along the axis until every triangle plane is in front of it
+    float max_t = 0.0f;
+    for(u32 i = 0; i != meshlet.index_count; i += 3) {
+        const glm::vec3& normal = normals[i / 3];
+        if(normal != glm::vec3(0.0f)) {
+            const glm::vec3& p0 = vertices[indices[meshlet.first_index + i]].position;
+            max_t = std::max(max_t, glm::dot(center - p0, normal) / glm::dot(axis, normal));
+        }
+    }
+
+    meshlet.cone_apex = center - axis * max_t;
+    meshlet.cone_axis = axis;
+    meshlet.cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+}
+
+std::vector<Meshlet> build_meshlets(Span<const Vertex> vertices, Span<const u32> indices, std::vector<u32>& meshlet_indices) {
+    const u32 vertex_count = u32(vertices.size());
+    const u32 triangle_count = u32(indices.size() / 3);
+
+    // Triangles of every vertex
+    std::vector<u32> offsets(vertex_count + 1, 0);
+    for(const u32 index : indices) {
+        ++offsets[index + 1];
+    }
+    for(u32 i = 0; i != vertex_count; ++i) {
+        offsets[i + 1] += offsets[i];
+    }
+    std::vector<u32> vertex_triangles(offsets[vertex_count]);
+    {
+        std::vector<u32> cursors(offsets.begin(), offsets.end() - 1);
+        for(u32 i = 0; i != u32(indices.size()); ++i) {
+            vertex_triangles[cursors[indices[i]]++] = i / 3;
+        }
+    }
+
+    std::vector<u8> emitted(triangle_count, 0);
+    std::vector<u32> vertex_meshlet(vertex_count, u32(-1)); // Last meshlet using the vertex
+
+    std::vector<Meshlet> meshlets;
+    std::vector<u32> reordered;
+    reordered.reserve(indices.size());
+
+    std::vector<u32> candidates;
+    for(u32 seed = 0; seed != triangle_count; ++seed) {
+        if(emitted[seed]) {
+            continue;
+        }
+
+        const u32 meshlet_index = u32(meshlets.size());
+        Meshlet meshlet;
+        meshlet.first_index = u32(reordered.size());
+        u32 meshlet_vertices = 0;
+        candidates.clear();
+
+        auto new_vertices = [&](u32 triangle) {
+            u32 count = 0;
+            for(u32 k = 0; k != 3; ++k) {
+                count += (vertex_meshlet[indices[triangle * 3 + k]] != meshlet_index);
+            }
+            return count;
+        };
+
+        auto add_triangle = [&](u32 triangle) {
+            emitted[triangle] = 1;
+            for(u32 k = 0; k != 3; ++k) {
+                const u32 vertex = indices[triangle * 3 + k];
+                reordered.push_back(vertex);
+                if(vertex_meshlet[vertex] != meshlet_index) {
+                    vertex_meshlet[vertex] = meshlet_index;
+                    ++meshlet_vertices;
+                    candidates.insert(candidates.end(), vertex_triangles.begin() + offsets[vertex], vertex_triangles.begin() + offsets[vertex + 1]);
+                }
+            }
+            meshlet.index_count += 3;
+        };
+
+        add_triangle(seed);
+
+        // Grow with the neighbouring triangle adding the fewest vertices
+        while(meshlet.index_count / 3 != Meshlet::max_triangles) {
+            u32 best = u32(-1);
+            u32 best_new = 3;
+            for(size_t i = 0; i != candidates.size();) {
+                const u32 triangle = candidates[i];
+                if(emitted[triangle]) {
+                    candidates[i] = candidates.back();
+                    candidates.pop_back();
+                    continue;
+                }
+
+                const u32 count = new_vertices(triangle);
+                if(count < best_new || (count == best_new && triangle < best)) {
+                    best = triangle;
+                    best_new = count;
+                }
+                ++i;
+            }
+
+            if(best == u32(-1) || meshlet_vertices + best_new > Meshlet::max_vertices) {
+                break;
+            }
+            add_triangle(best);
+        }
+
+        meshlets.push_back(meshlet);
+    }
+
+    meshlet_indices = std::move(reordered);
+    for(Meshlet& meshlet : meshlets) {
+        compute_bounds(meshlet, vertices, meshlet_indices);
+    }
+    return meshlets;
+}
+
+}
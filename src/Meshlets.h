@@ -0,0 +1,39 @@
+#ifndef MESHLETS_H
+#define MESHLETS_H
+
+#include <Vertex.h>
+#include <Bounds.h>
+
+#include <vector>
+
+namespace OM3D {
+
+// Small cluster of neighbouring triangles of a mesh, culled on its own.
+// Meshlets are contiguous ranges of the mesh indices, stored after its levels of detail, so they are drawn without any extra index buffer.
+struct Meshlet {
+    static constexpr u32 max_vertices = 64;
+    static constexpr u32 max_triangles = 124;
+
+    BoundingSphere bounds;
+
+    // Every triangle is back facing from cameras where dot(normalize(cone_apex - camera), cone_axis) >= cone_cutoff.
+    // Meshlets facing too many directions have a cutoff of 1 and are never cone culled.
+    glm::vec3 cone_apex = {};
+    glm::vec3 cone_axis = {};
+    float cone_cutoff = 1.0f;
+
+    // Relative to the first index of the mesh
+    u32 first_index = 0;
+    u32 index_count = 0;
+
+    // Expects counter clockwise front faces
+    bool is_back_facing(const glm::vec3& camera_position) const;
+};
+
+// Greedily grow meshlets from neighbouring triangles, and copy the triangles to meshlet_indices so that each meshlet is a contiguous range.
+// Regrouping undoes the vertex cache order, so indices are left untouched for the draws that don't use meshlets.
+std::vector<Meshlet> build_meshlets(Span<const Vertex> vertices, Span<const u32> indices, std::vector<u32>& meshlet_indices);
+
+}
+
+#endif // MESHLETS_H
@@ -0,0 +1,113 @@
+#include "Meshlets.h"
+
+#include <benchmarks.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <algorithm>
+
+namespace OM3D {
+
+void bench_meshlets() {
+    std::cout << "Meshlets" << std::endl;
+
+    for(const u32 subdivisions : {4, 6}) {
+        MeshData mesh = bumpy_sphere(subdivisions);
+        std::vector<u32> original = mesh.indices;
+        const double time = time_ms([&] { mesh.build_meshlets(); });
+
+        // Meshlets must cover every triangle exactly once and respect the limits, the mesh keeps its triangle order
+        bool valid = !mesh.meshlets.empty() && mesh.indices == original;
+        std::vector<u32> sorted = mesh.meshlet_indices;
+        std::sort(original.begin(), original.end());
+        std::sort(sorted.begin(), sorted.end());
+        valid &= (sorted == original);
+
+        u32 next_index = 0;
+        size_t vertex_count = 0;
+        std::vector<u32> meshlet_vertices;
+        for(const Meshlet& meshlet : mesh.meshlets) {
+            valid &= meshlet.first_index == next_index && meshlet.index_count % 3 == 0;
+            valid &= meshlet.index_count / 3 <= Meshlet::max_triangles;
+            next_index += meshlet.index_count;
+
+            meshlet_vertices.assign(mesh.meshlet_indices.begin() + meshlet.first_index, mesh.meshlet_indices.begin() + meshlet.first_index + meshlet.index_count);
+            std::sort(meshlet_vertices.begin(), meshlet_vertices.end());
+            meshlet_vertices.erase(std::unique(meshlet_vertices.begin(), meshlet_vertices.end()), meshlet_vertices.end());
+            valid &= meshlet_vertices.size() <= Meshlet::max_vertices;
+            vertex_count += meshlet_vertices.size();
+
+            for(const u32 vertex : meshlet_vertices) {
+                valid &= glm::length(mesh.vertices[vertex].position - meshlet.bounds.center) <= meshlet.bounds.radius * 1.0001f;
+            }
+        }
+        valid &= next_index == mesh.meshlet_indices.size();
+
+        // Cones must never reject a meshlet with a triangle facing the camera
+        std::mt19937 rng(0x5EED);
+        std::uniform_real_distribution<float> coord(-4.0f, 4.0f);
+        for(u32 i = 0; i != 64; ++i) {
+            const glm::vec3 camera_position(coord(rng), coord(rng), coord(rng));
+            for(const Meshlet& meshlet : mesh.meshlets) {
+                if(!meshlet.is_back_facing(camera_position)) {
+                    continue;
+                }
+                for(u32 k = meshlet.first_index; k != meshlet.first_index + meshlet.index_count; k += 3) {
+                    const glm::vec3& p0 = mesh.vertices[mesh.meshlet_indices[k]].position;
+                    const glm::vec3& p1 = mesh.vertices[mesh.meshlet_indices[k + 1]].position;
+                    const glm::vec3& p2 = mesh.vertices[mesh.meshlet_indices[k + 2]].position;
+                    const glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+                    valid &= glm::dot(normal, camera_position - p0) <= 1.0e-6f * glm::length(normal);
+                }
+            }
+        }
+
+        const size_t triangle_count = mesh.indices.size() / 3;
+        std::cout << "  " << std::setw(6) << triangle_count << " triangles: " << mesh.meshlets.size() << " meshlets in " << time << "ms, "
+                  << std::setprecision(1) << double(triangle_count) / double(mesh.meshlets.size()) << " triangles and "
+                  << double(vertex_count) / double(mesh.meshlets.size()) << " vertices per meshlet" << std::setprecision(3)
+                  << check_result(valid) << std::endl;
+
+        if(subdivisions != 6) {
+            continue;
+        }
+
+        // Same tests as meshlet_cull.comp, for a camera close to the mesh and looking past its side
+        for(const float distance : {1.5f, 3.0f, 10.0f}) {
+            Camera camera;
+            camera.set_view(glm::lookAt(glm::vec3(0.0f, 0.0f, distance), glm::vec3(0.6f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+            const Frustum frustum = camera.build_frustum();
+
+            size_t frustum_culled = 0;
+            size_t cone_culled = 0;
+            size_t back_facing = 0;
+            for(const Meshlet& meshlet : mesh.meshlets) {
+                const size_t triangles = meshlet.index_count / 3;
+                if(!frustum.intersects(meshlet.bounds)) {
+                    frustum_culled += triangles;
+                    continue;
+                }
+                if(meshlet.is_back_facing(camera.position())) {
+                    cone_culled += triangles;
+                    continue;
+                }
+                for(u32 k = meshlet.first_index; k != meshlet.first_index + meshlet.index_count; k += 3) {
+                    const glm::vec3& p0 = mesh.vertices[mesh.meshlet_indices[k]].position;
+                    const glm::vec3 normal = glm::cross(mesh.vertices[mesh.meshlet_indices[k + 1]].position - p0, mesh.vertices[mesh.meshlet_indices[k + 2]].position - p0);
+                    back_facing += glm::dot(normal, camera.position() - p0) <= 0.0f;
+                }
+            }
+
+            const size_t submitted = triangle_count - frustum_culled - cone_culled;
+            auto percent = [&](size_t count) { return 100.0 * double(count) / double(triangle_count); };
+            std::cout << "    camera at " << std::setprecision(1) << distance << ": " << submitted << " triangles submitted, "
+                      << percent(frustum_culled) << "% frustum culled, " << percent(cone_culled) << "% cone culled, "
+                      << percent(back_facing) << "% left to the rasterizer's back face culling" << std::setprecision(3) << std::endl;
+        }
+    }
+}
+
+}
@@ -0,0 +1,281 @@
+#include "OcclusionCuller.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OM3D_OCCLUSION_SSE
+#endif
+
+namespace OM3D {
+
+static_assert(OcclusionCuller::width % 4 == 0, "Rows are rasterized 4 pixels at a time");
+
+// Triangles with a vertex closer than this (in clip space w) are skipped instead of being clipped.
+// Dropping occluder triangles can only make the culling less aggressive, never wrong.
+static constexpr float min_clip_w = 1.0e-4f;
+
+static u32 level_width(u32 level) {
+    return std::max(1u, OcclusionCuller::width >> level);
+}
+
+static u32 level_height(u32 level) {
+    return std::max(1u, OcclusionCuller::height >> level);
+}
+
+OcclusionCuller::OcclusionCuller() {
+    size_t size = 0;
+    for(u32 level = 0;; ++level) {
+        _level_offsets.push_back(size);
+        size += level_width(level) * level_height(level);
+        if(level_width(level) == 1 && level_height(level) == 1) {
+            break;
+        }
+    }
+    _depth.resize(size, 0.0f);
+}
+
+void OcclusionCuller::add_occluder(u32 id, std::shared_ptr<const OccluderMesh> mesh) {
+    DEBUG_ASSERT(mesh);
+    _occluders.push_back(Occluder{id, std::move(mesh)});
+}
+
+Span<const OcclusionCuller::Occluder> OcclusionCuller::occluders() const {
+    return _occluders;
+}
+
+void OcclusionCuller::begin(const glm::mat4& view_proj) {
+    _view_proj = view_proj;
+    _stats = {};
+
+    // Reverse-Z: far is 0
+    std::fill(_depth.begin(), _depth.end(), 0.0f);
+}
+
+void OcclusionCuller::rasterize(const Occluder& occluder, const glm::mat4& model) {
+    const glm::mat4 transform = _view_proj * model;
+    const OccluderMesh& mesh = *occluder.mesh;
+
+    std::vector<glm::vec4> clip(mesh.positions.size());
+    std::transform(mesh.positions.begin(), mesh.positions.end(), clip.begin(), [&](const glm::vec3& p) { return transform * glm::vec4(p, 1.0f); });
+
+    auto to_screen = [](const glm::vec4& p) {
+        const glm::vec3 ndc = glm::vec3(p) / p.w;
+        return glm::vec3((ndc.x * 0.5f + 0.5f) * float(width), (ndc.y * 0.5f + 0.5f) * float(height), ndc.z);
+    };
+
+    for(size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        const glm::vec4& c0 = clip[mesh.indices[i + 0]];
+        const glm::vec4& c1 = clip[mesh.indices[i + 1]];
+        const glm::vec4& c2 = clip[mesh.indices[i + 2]];
+
+        if(c0.w < min_clip_w || c1.w < min_clip_w || c2.w < min_clip_w) {
+            continue;
+        }
+
+        rasterize_triangle(to_screen(c0), to_screen(c1), to_screen(c2));
+    }
+
+    ++_stats.occluders;
+    _stats.triangles += u32(mesh.indices.size() / 3);
+}
+
+void OcclusionCuller::rasterize_triangle(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2) {
+    const float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+
+    // Same culling as the GPU: counter clockwise triangles are front facing
+    if(!(area > 0.0f)) {
+        return;
+    }
+
+    const int min_x = std::max(0, int(std::floor(std::min({v0.x, v1.x, v2.x}))));
+    const int min_y = std::max(0, int(std::floor(std::min({v0.y, v1.y, v2.y}))));
+    const int max_x = std::min(int(width) - 1, int(std::ceil(std::max({v0.x, v1.x, v2.x}))));
+    const int max_y = std::min(int(height) - 1, int(std::ceil(std::max({v0.y, v1.y, v2.y}))));
+
+    if(min_x > max_x || min_y > max_y) {
+        return;
+    }
+
+    // Edge functions as e(x, y) = a * x + b * y + c, positive inside
+    struct Edge {
+        float a;
+        float b;
+        float c;
+    };
+
+    auto make_edge = [](const glm::vec3& from, const glm::vec3& to) {
+        const float a = from.y - to.y;
+        const float b = to.x - from.x;
+        return Edge{a, b, -(a * from.x + b * from.y)};
+    };
+
+    const Edge edges[] = {
+        make_edge(v1, v2),
+        make_edge(v2, v0),
+        make_edge(v0, v1),
+    };
+
+    // Depth is linear in screen space
+    const float inv_area = 1.0f / area;
+    const float dz_dx = (edges[0].a * v0.z + edges[1].a * v1.z + edges[2].a * v2.z) * inv_area;
+    const float dz_dy = (edges[0].b * v0.z + edges[1].b * v1.z + edges[2].b * v2.z) * inv_area;
+    const float z_c = (edges[0].c * v0.z + edges[1].c * v1.z + edges[2].c * v2.z) * inv_area;
+
+    const int start_x = min_x & ~3;
+
+#ifdef OM3D_OCCLUSION_SSE
+    const __m128 lane_offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 a0 = _mm_set1_ps(edges[0].a);
+    const __m128 a1 = _mm_set1_ps(edges[1].a);
+    const __m128 a2 = _mm_set1_ps(edges[2].a);
+    const __m128 dz = _mm_set1_ps(dz_dx);
+
+    for(int y = min_y; y <= max_y; ++y) {
+        const float py = float(y) + 0.5f;
+        const __m128 row0 = _mm_set1_ps(edges[0].b * py + edges[0].c);
+        const __m128 row1 = _mm_set1_ps(edges[1].b * py + edges[1].c);
+        const __m128 row2 = _mm_set1_ps(edges[2].b * py + edges[2].c);
+        const __m128 row_z = _mm_set1_ps(dz_dy * py + z_c);
+
+        float* row = _depth.data() + y * width;
+        for(int x = start_x; x <= max_x; x += 4) {
+            const __m128 px = _mm_add_ps(_mm_set1_ps(float(x)), lane_offsets);
+
+            const __m128 inside = _mm_and_ps(
+                _mm_and_ps(
+                    _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a0, px), row0), zero),
+                    _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a1, px), row1), zero)),
+                _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a2, px), row2), zero));
+
+            const __m128 z = _mm_add_ps(_mm_mul_ps(dz, px), row_z);
+            const __m128 previous = _mm_load_ps(row + x);
+            const __m128 closest = _mm_max_ps(previous, z);
+            _mm_store_ps(row + x, _mm_or_ps(_mm_and_ps(inside, closest), _mm_andnot_ps(inside, previous)));
+        }
+    }
+#else
+    for(int y = min_y; y <= max_y; ++y) {
+        const float py = float(y) + 0.5f;
+        float* row = _depth.data() + y * width;
+        for(int x = start_x; x <= max_x; ++x) {
+            const float px = float(x) + 0.5f;
+
+            bool inside = true;
+            for(const Edge& edge : edges) {
+                inside &= (edge.a * px + edge.b * py + edge.c) >= 0.0f;
+            }
+
+            if(inside) {
+                row[x] = std::max(row[x], dz_dx * px + dz_dy * py + z_c);
+            }
+        }
+    }
+#endif
+}
+
+void OcclusionCuller::finish() {
+    // Each texel stores the farthest depth of the 4 below
+    for(u32 level = 1; level != level_count(); ++level) {
+        const u32 w = level_width(level);
+        const u32 h = level_height(level);
+        const u32 prev_w = level_width(level - 1);
+        const u32 prev_h = level_height(level - 1);
+
+        const float* src = _depth.data() + _level_offsets[level - 1];
+        float* dst = _depth.data() + _level_offsets[level];
+
+        for(u32 y = 0; y != h; ++y) {
+            const u32 y0 = std::min(2 * y, prev_h - 1);
+            const u32 y1 = std::min(2 * y + 1, prev_h - 1);
+            for(u32 x = 0; x != w; ++x) {
+                const u32 x0 = std::min(2 * x, prev_w - 1);
+                const u32 x1 = std::min(2 * x + 1, prev_w - 1);
+                dst[y * w + x] = std::min({
+                    src[y0 * prev_w + x0], src[y0 * prev_w + x1],
+                    src[y1 * prev_w + x0], src[y1 * prev_w + x1]
+                });
+            }
+        }
+    }
+}
+
+bool OcclusionCuller::is_visible(const AABB& box) {
+    ++_stats.tested;
+
+    glm::vec2 min_ndc = glm::vec2(std::numeric_limits<float>::max());
+    glm::vec2 max_ndc = glm::vec2(-std::numeric_limits<float>::max());
+    float max_z = 0.0f;
+
+    for(u32 i = 0; i != 8; ++i) {
+        const glm::vec3 corner(
+            (i & 1) ? box.max.x : box.min.x,
+            (i & 2) ? box.max.y : box.min.y,
+            (i & 4) ? box.max.z : box.min.z
+        );
+
+        const glm::vec4 clip = _view_proj * glm::vec4(corner, 1.0f);
+        if(clip.w < min_clip_w) {
+            // Crosses the near plane
+            return true;
+        }
+
+        const glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        min_ndc = glm::min(min_ndc, glm::vec2(ndc));
+        max_ndc = glm::max(max_ndc, glm::vec2(ndc));
+        max_z = std::max(max_z, ndc.z);
+    }
+
+    if(max_ndc.x < -1.0f || max_ndc.y < -1.0f || min_ndc.x > 1.0f || min_ndc.y > 1.0f) {
+        // Off screen, this is for frustum culling to decide
+        return true;
+    }
+
+    auto to_pixel = [](float ndc, u32 size) {
+        return u32(std::clamp(int(std::floor((ndc * 0.5f + 0.5f) * float(size))), 0, int(size) - 1));
+    };
+
+    const u32 x0 = to_pixel(min_ndc.x, width);
+    const u32 x1 = to_pixel(max_ndc.x, width);
+    const u32 y0 = to_pixel(min_ndc.y, height);
+    const u32 y1 = to_pixel(max_ndc.y, height);
+
+    // Pick the level where the rect covers at most 3x3 texels
+    u32 level = 0;
+    while(level + 1 < level_count() && ((x1 >> level) - (x0 >> level) > 2 || (y1 >> level) - (y0 >> level) > 2)) {
+        ++level;
+    }
+
+    float farthest = std::numeric_limits<float>::max();
+    for(u32 y = (y0 >> level); y <= std::min(y1 >> level, level_height(level) - 1); ++y) {
+        for(u32 x = (x0 >> level); x <= std::min(x1 >> level, level_width(level) - 1); ++x) {
+            farthest = std::min(farthest, depth(x, y, level));
+        }
+    }
+
+    // Reverse-Z: the box is hidden if its closest point is behind everything in the rect
+    if(max_z < farthest) {
+        ++_stats.occluded;
+        return false;
+    }
+    return true;
+}
+
+const OcclusionCuller::Stats& OcclusionCuller::stats() const {
+    return _stats;
+}
+
+u32 OcclusionCuller::level_count() const {
+    return u32(_level_offsets.size());
+}
+
+float OcclusionCuller::depth(u32 x, u32 y, u32 level) const {
+    DEBUG_ASSERT(level < level_count());
+    DEBUG_ASSERT(x < level_width(level) && y < level_height(level));
+    return _depth[_level_offsets[level] + y * level_width(level) + x];
+}
+
+}
@@ -0,0 +1,76 @@
+#ifndef OCCLUSIONCULLER_H
+#define OCCLUSIONCULLER_H
+
+#include <Bounds.h>
+
+#include <glm/mat4x4.hpp>
+
+#include <memory>
+#include <vector>
+
+namespace OM3D {
+
+// Software rasterizer for a few large occluders into a low resolution reverse-Z depth buffer
+// with a min depth hierarchy on top, used to reject objects hidden behind them. Runs entirely on the CPU.
+class OcclusionCuller {
+    public:
+        static constexpr u32 width = 256;
+        static constexpr u32 height = 128;
+
+        static constexpr u32 max_occluders = 32;
+        static constexpr u32 max_occluder_triangles = 32 * 1024;
+
+        // Object space geometry, shared by the occluders of every object using the same mesh
+        struct OccluderMesh {
+            std::vector<glm::vec3> positions;
+            std::vector<u32> indices;
+        };
+
+        struct Occluder {
+            u32 id = 0;
+            std::shared_ptr<const OccluderMesh> mesh;
+        };
+
+        struct Stats {
+            u32 occluders = 0;
+            u32 triangles = 0;
+            u32 tested = 0;
+            u32 occluded = 0;
+        };
+
+        OcclusionCuller();
+
+        void add_occluder(u32 id, std::shared_ptr<const OccluderMesh> mesh);
+        Span<const Occluder> occluders() const;
+
+        // Clear the depth buffer and stats
+        void begin(const glm::mat4& view_proj);
+        void rasterize(const Occluder& occluder, const glm::mat4& model);
+        // Build the depth hierarchy, must be called after all occluders have been rasterized
+        void finish();
+
+        // Test a world space box against the occluders
+        bool is_visible(const AABB& box);
+
+        const Stats& stats() const;
+
+        u32 level_count() const;
+        float depth(u32 x, u32 y, u32 level = 0) const;
+
+    private:
+        void rasterize_triangle(const glm::vec3& v0, const glm::vec3& v1, const glm::vec3& v2);
+
+        std::vector<Occluder> _occluders;
+
+        glm::mat4 _view_proj = glm::mat4(1.0f);
+
+        // All levels of the hierarchy, level 0 first
+        std::vector<float> _depth;
+        std::vector<size_t> _level_offsets;
+
+        Stats _stats;
+};
+
+}
+
+#endif // OCCLUSIONCULLER_H
@@ -0,0 +1,105 @@
+#include "OcclusionCuller.h"
+#include "BVH.h"
+
+#include <benchmarks.h>
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <limits>
+
+namespace OM3D {
+
+static OcclusionCuller::Occluder box_occluder(const AABB& box) {
+    auto mesh = std::make_shared<OcclusionCuller::OccluderMesh>();
+    for(u32 i = 0; i != 8; ++i) {
+        mesh->positions.emplace_back(
+            (i & 1) ? box.max.x : box.min.x,
+            (i & 2) ? box.max.y : box.min.y,
+            (i & 4) ? box.max.z : box.min.z
+        );
+    }
+
+    // Counter clockwise when seen from outside
+    mesh->indices = {
+        0, 2, 1,  1, 2, 3,
+        4, 5, 6,  5, 7, 6,
+        0, 4, 2,  2, 4, 6,
+        1, 3, 5,  3, 7, 5,
+        0, 1, 4,  1, 5, 4,
+        2, 6, 3,  3, 6, 7,
+    };
+    return OcclusionCuller::Occluder{0, std::move(mesh)};
+}
+
+void bench_occlusion_culling() {
+    std::cout << "Software occlusion culling (" << OcclusionCuller::width << "x" << OcclusionCuller::height << ")" << std::endl;
+
+    const Camera camera = benchmark_camera();
+    const Frustum frustum = camera.build_frustum();
+    const glm::vec3 forward = glm::normalize(glm::vec3(1.0f, 0.2f, 0.5f));
+    const glm::vec3 side = glm::normalize(glm::cross(forward, glm::vec3(0.0f, 1.0f, 0.0f)));
+
+    // A row of large buildings in front of the camera
+    std::vector<OcclusionCuller::Occluder> occluders;
+    float occluder_distance = std::numeric_limits<float>::max();
+    for(int i = -3; i <= 3; ++i) {
+        const glm::vec3 center = forward * 60.0f + side * (float(i) * 45.0f);
+        const glm::vec3 half_extent = glm::vec3(15.0f, 40.0f, 15.0f);
+        occluders.push_back(box_occluder(AABB{center - half_extent, center + half_extent}));
+        for(const glm::vec3& p : occluders.back().mesh->positions) {
+            occluder_distance = std::min(occluder_distance, glm::dot(p, forward));
+        }
+    }
+
+    for(const size_t count : {1000, 10000, 100000}) {
+        const std::vector<AABB> boxes = random_boxes(count);
+        const u32 iterations = u32(std::max(size_t(10), 1000000 / count));
+
+        BVH bvh;
+        bvh.build(boxes);
+        std::vector<u32> frustum_visible;
+        bvh.cull(frustum, frustum_visible);
+        std::sort(frustum_visible.begin(), frustum_visible.end());
+
+        OcclusionCuller culler;
+        const double raster = time_ms([&] {
+            culler.begin(camera.view_proj_matrix());
+            for(const auto& occluder : occluders) {
+                culler.rasterize(occluder, glm::mat4(1.0f));
+            }
+            culler.finish();
+        }, iterations);
+
+        std::vector<u32> visible;
+        const double test = time_ms([&] {
+            visible.clear();
+            for(const u32 index : frustum_visible) {
+                if(culler.is_visible(boxes[index])) {
+                    visible.push_back(index);
+                }
+            }
+        }, iterations);
+
+        // Anything entirely in front of the occluders can not be hidden
+        size_t errors = 0;
+        for(const u32 index : frustum_visible) {
+            float farthest = 0.0f;
+            for(u32 i = 0; i != 8; ++i) {
+                const glm::vec3 corner((i & 1) ? boxes[index].max.x : boxes[index].min.x, (i & 2) ? boxes[index].max.y : boxes[index].min.y, (i & 4) ? boxes[index].max.z : boxes[index].min.z);
+                farthest = std::max(farthest, glm::dot(corner, forward));
+            }
+            if(farthest < occluder_distance && !std::binary_search(visible.begin(), visible.end(), index)) {
+                ++errors;
+            }
+        }
+
+        std::cout << "  " << std::setw(6) << count << " objects, " << std::setw(6) << frustum_visible.size() << " in frustum, "
+                  << std::setw(6) << (frustum_visible.size() - visible.size()) << " occluded: "
+                  << "raster " << raster << "ms (" << culler.stats().triangles << " triangles), "
+                  << "test " << test << "ms"
+                  << check_result(errors == 0) << std::endl;
+    }
+}
+
+}
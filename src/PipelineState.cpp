@@ -0,0 +1,63 @@
+#include "PipelineState.h"
+
+#include <memory>
+#include <unordered_map>
+
+namespace OM3D {
+
+bool PipelineStateDesc::operator==(const PipelineStateDesc& other) const {
+    return program == other.program &&
+           blend_mode == other.blend_mode &&
+           depth_test_mode == other.depth_test_mode &&
+           cull_mode == other.cull_mode &&
+           depth_write == other.depth_write;
+}
+
+u64 PipelineStateDesc::hash() const {
+    u64 h = std::hash<const Program*>{}(program);
+    hash_combine(h, u64(blend_mode));
+    hash_combine(h, u64(depth_test_mode));
+    hash_combine(h, u64(cull_mode));
+    hash_combine(h, u64(depth_write));
+    return h;
+}
+
+PipelineState::PipelineState(const PipelineStateDesc& desc) : _desc(desc), _hash(desc.hash()) {
+}
+
+const PipelineState* PipelineState::get(const PipelineStateDesc& desc) {
+    struct Hasher {
+        size_t operator()(const PipelineStateDesc& desc) const {
+            return size_t(desc.hash());
+        }
+    };
+
+    // Never freed: there is one entry per material configuration, and they are tiny
+    static std::unordered_map<PipelineStateDesc, std::unique_ptr<PipelineState>, Hasher> states;
+
+    auto& state = states[desc];
+    if(!state) {
+        state.reset(new PipelineState(desc));
+    }
+    return state.get();
+}
+
+void PipelineState::bind() const {
+    set_blend_mode(_desc.blend_mode);
+    set_depth_test_mode(_desc.depth_test_mode);
+    set_depth_write(_desc.depth_write);
+    set_cull_mode(_desc.cull_mode);
+    if(_desc.program) {
+        _desc.program->bind();
+    }
+}
+
+const PipelineStateDesc& PipelineState::desc() const {
+    return _desc;
+}
+
+u64 PipelineState::hash() const {
+    return _hash;
+}
+
+}
@@ -0,0 +1,40 @@
+#ifndef PIPELINESTATE_H
+#define PIPELINESTATE_H
+
+#include <GLState.h>
+#include <Program.h>
+
+namespace OM3D {
+
+struct PipelineStateDesc {
+    const Program* program = nullptr;
+    BlendMode blend_mode = BlendMode::None;
+    DepthTestMode depth_test_mode = DepthTestMode::Standard;
+    CullMode cull_mode = CullMode::Back;
+    bool depth_write = true;
+
+    bool operator==(const PipelineStateDesc& other) const;
+    u64 hash() const;
+};
+
+// Immutable and interned: two equal descriptions always give the same object, so states can be compared by pointer.
+class PipelineState : NonMovable {
+    public:
+        static const PipelineState* get(const PipelineStateDesc& desc);
+
+        // Only the states that differ from the currently bound ones reach GL
+        void bind() const;
+
+        const PipelineStateDesc& desc() const;
+        u64 hash() const;
+
+    private:
+        PipelineState(const PipelineStateDesc& desc);
+
+        PipelineStateDesc _desc;
+        u64 _hash = 0;
+};
+
+}
+
+#endif // PIPELINESTATE_H
@@ -1,5 +1,7 @@
 #include "Program.h"
 
+#include <GLState.h>
+
 #include <glad/gl.h>
 
 #include <algorithm>
@@ -170,12 +172,13 @@ void Program::fetch_uniform_locations() {
 
 Program::~Program() {
     if(_handle.is_valid()) {
+        forget_program(_handle.get());
         glDeleteProgram(_handle.get());
     }
 }
 
 void Program::bind() const {
-    glUseProgram(_handle.get());
+    bind_program(_handle.get());
 }
 
 bool Program::is_compute() const {
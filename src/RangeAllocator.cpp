@@ -0,0 +1,114 @@
+#include "RangeAllocator.h"
+
+#include <iterator>
+
+namespace OM3D {
+
+float RangeAllocator::Stats::fragmentation() const {
+    const u32 free = capacity - used;
+    return free ? 1.0f - float(largest_free_block) / float(free) : 0.0f;
+}
+
+RangeAllocator::RangeAllocator(u32 capacity) {
+    grow(capacity);
+}
+
+u32 RangeAllocator::allocate(u32 size) {
+    DEBUG_ASSERT(size);
+
+    const auto best = _free_by_size.lower_bound({size, 0});
+    if(best == _free_by_size.end()) {
+        return invalid_offset;
+    }
+
+    const u32 offset = best->second;
+    const u32 block_size = best->first;
+    remove_free_block(_free_by_offset.find(offset));
+    if(block_size != size) {
+        add_free_block(offset + size, block_size - size);
+    }
+
+    _allocated.emplace(offset, size);
+    _used += size;
+    return offset;
+}
+
+void RangeAllocator::free(u32 offset) {
+    const auto it = _allocated.find(offset);
+    ALWAYS_ASSERT(it != _allocated.end(), "Freeing a range that wasn't allocated");
+
+    u32 size = it->second;
+    _used -= size;
+    _allocated.erase(it);
+
+    // Merge with the free neighbours
+    const auto next = _free_by_offset.find(offset + size);
+    if(next != _free_by_offset.end()) {
+        size += next->second;
+        remove_free_block(next);
+    }
+    const auto previous = _free_by_offset.lower_bound(offset);
+    if(previous != _free_by_offset.begin()) {
+        const auto prev = std::prev(previous);
+        if(prev->first + prev->second == offset) {
+            offset = prev->first;
+            size += prev->second;
+            remove_free_block(prev);
+        }
+    }
+
+    add_free_block(offset, size);
+}
+
+void RangeAllocator::grow(u32 new_capacity) {
+    DEBUG_ASSERT(new_capacity >= _capacity);
+    if(new_capacity == _capacity) {
+        return;
+    }
+
+    u32 offset = _capacity;
+    u32 size = new_capacity - _capacity;
+    _capacity = new_capacity;
+
+    // Extend the last free block if it reached the end
+    if(!_free_by_offset.empty()) {
+        const auto last = std::prev(_free_by_offset.end());
+        if(last->first + last->second == offset) {
+            offset = last->first;
+            size += last->second;
+            remove_free_block(last);
+        }
+    }
+
+    add_free_block(offset, size);
+}
+
+u32 RangeAllocator::capacity() const {
+    return _capacity;
+}
+
+u32 RangeAllocator::used() const {
+    return _used;
+}
+
+RangeAllocator::Stats RangeAllocator::stats() const {
+    Stats stats;
+    stats.capacity = _capacity;
+    stats.used = _used;
+    stats.allocations = u32(_allocated.size());
+    stats.free_blocks = u32(_free_by_offset.size());
+    stats.largest_free_block = _free_by_size.empty() ? 0 : _free_by_size.rbegin()->first;
+    return stats;
+}
+
+void RangeAllocator::add_free_block(u32 offset, u32 size) {
+    _free_by_offset.emplace(offset, size);
+    _free_by_size.emplace(size, offset);
+}
+
+void RangeAllocator::remove_free_block(std::map<u32, u32>::iterator it) {
+    _free_by_size.erase({it->second, it->first});
+    _free_by_offset.erase(it);
+}
+
+}
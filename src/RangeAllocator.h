@@ -0,0 +1,56 @@
+#ifndef RANGEALLOCATOR_H
+#define RANGEALLOCATOR_H
+
+#include <utils.h>
+
+#include <map>
+#include <set>
+#include <unordered_map>
+
+namespace OM3D {
+
+// Best fit allocator of ranges of elements in a growable space, coalescing free neighbours.
+// Only does the bookkeeping, the storage lives elsewhere (see GeometryBuffer).
+class RangeAllocator {
+    public:
+        static constexpr u32 invalid_offset = u32(-1);
+
+        struct Stats {
+            u32 capacity = 0;
+            u32 used = 0;
+            u32 allocations = 0;
+            u32 free_blocks = 0;
+            u32 largest_free_block = 0;
+
+            // Fraction of the free space outside of the largest free block, 0 when all the free space is contiguous
+            float fragmentation() const;
+        };
+
+        RangeAllocator(u32 capacity = 0);
+
+        // Smallest free block that fits, lowest offset first. Returns invalid_offset if none does.
+        u32 allocate(u32 size);
+        void free(u32 offset);
+
+        // Adds free space at the end
+        void grow(u32 new_capacity);
+
+        u32 capacity() const;
+        u32 used() const;
+        Stats stats() const;
+
+    private:
+        void add_free_block(u32 offset, u32 size);
+        void remove_free_block(std::map<u32, u32>::iterator it);
+
+        std::map<u32, u32> _free_by_offset;             // Offset to size
+        std::set<std::pair<u32, u32>> _free_by_size;    // Size and offset
+        std::unordered_map<u32, u32> _allocated;        // Offset to size
+
+        u32 _capacity = 0;
+        u32 _used = 0;
+};
+
+}
+
+#endif // RANGEALLOCATOR_H
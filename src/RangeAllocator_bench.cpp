@@ -0,0 +1,86 @@
+#include "RangeAllocator.h"
+
+#include <benchmarks.h>
+
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <algorithm>
+
+namespace OM3D {
+
+void bench_range_allocator() {
+    std::cout << "Geometry range allocator" << std::endl;
+
+    // Meshes streamed in and out around a working set, like GeometryBuffer does with its vertex ranges
+    for(const u32 working_set : {64, 1024}) {
+        RangeAllocator allocator;
+        std::vector<u32> owners; // Allocation owning every element, to check for overlaps
+        std::vector<std::pair<u32, u32>> live;
+        std::mt19937 rng(0x5EED);
+        std::uniform_int_distribution<u32> sizes(16, 16 * 1024);
+
+        u64 streamed = 0;
+        u32 growths = 0;
+        bool valid = true;
+        float max_fragmentation = 0.0f;
+        float min_occupancy = 1.0f;
+
+        const u32 operations = 50000;
+        const double time = time_ms([&] {
+            for(u32 i = 0; i != operations; ++i) {
+                if(live.size() >= working_set || (!live.empty() && rng() % 3 == 0)) {
+                    const size_t index = rng() % live.size();
+                    const auto [offset, size] = live[index];
+                    allocator.free(offset);
+                    std::fill(owners.begin() + offset, owners.begin() + offset + size, u32(-1));
+                    live[index] = live.back();
+                    live.pop_back();
+                    continue;
+                }
+
+                const u32 size = sizes(rng);
+                u32 offset = allocator.allocate(size);
+                if(offset == RangeAllocator::invalid_offset) {
+                    const u32 capacity = allocator.capacity();
+                    allocator.grow(std::max({u32(64 * 1024), capacity * 2, capacity + size}));
+                    owners.resize(allocator.capacity(), u32(-1));
+                    offset = allocator.allocate(size);
+                    ++growths;
+                }
+
+                valid &= offset != RangeAllocator::invalid_offset && offset + size <= allocator.capacity();
+                if(!valid) {
+                    break;
+                }
+                for(u32 k = offset; k != offset + size; ++k) {
+                    valid &= owners[k] == u32(-1);
+                    owners[k] = i;
+                }
+                live.emplace_back(offset, size);
+                streamed += size;
+
+                if(live.size() == working_set) {
+                    const RangeAllocator::Stats stats = allocator.stats();
+                    max_fragmentation = std::max(max_fragmentation, stats.fragmentation());
+                    min_occupancy = std::min(min_occupancy, float(stats.used) / float(stats.capacity));
+                }
+            }
+        });
+
+        // Everything freed must coalesce back into a single block
+        for(const auto& range : live) {
+            allocator.free(range.first);
+        }
+        const RangeAllocator::Stats stats = allocator.stats();
+        valid &= stats.used == 0 && stats.allocations == 0 && stats.free_blocks == 1 && stats.largest_free_block == stats.capacity;
+
+        std::cout << "  " << std::setw(4) << working_set << " live meshes: " << operations << " operations in " << time << "ms, "
+                  << "capacity " << std::setprecision(1) << float(stats.capacity) / float(1024 * 1024) << "M elements for " << float(streamed) / float(1024 * 1024) << "M streamed, "
+                  << growths << " growths, full working set at " << min_occupancy * 100.0f << "% occupancy or more, "
+                  << max_fragmentation * 100.0f << "% fragmentation at most" << std::setprecision(3)
+                  << check_result(valid) << std::endl;
+    }
+}
+
+}
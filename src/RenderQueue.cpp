@@ -0,0 +1,108 @@
+#include "RenderQueue.h"
+
+#include <StaticMesh.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace OM3D {
+
+static_assert(2 + RenderQueue::program_bits + RenderQueue::material_bits + RenderQueue::mesh_bits + RenderQueue::lod_bits + RenderQueue::depth_bits == 64, "Keys should use exactly 64 bits");
+static_assert(MeshData::max_lod_count <= 1 << RenderQueue::lod_bits, "Keys should fit every level of detail");
+
+static constexpr u32 pass_shift = 62;
+static constexpr u64 state_mask = (u64(1) << (RenderQueue::program_bits + RenderQueue::material_bits + RenderQueue::mesh_bits + RenderQueue::lod_bits)) - 1;
+static constexpr u64 depth_mask = (u64(1) << RenderQueue::depth_bits) - 1;
+
+static u64 bits(u32 value, u32 count) {
+    return u64(value) & ((u64(1) << count) - 1);
+}
+
+static u64 quantize_depth(float depth) {
+    // The bits of positive floats sort like the floats, keep the most significant ones
+    const float clamped = std::max(depth, 0.0f);
+    u32 raw = 0;
+    std::memcpy(&raw, &clamped, sizeof(raw));
+    return u64(raw >> (32 - RenderQueue::depth_bits));
+}
+
+u64 RenderQueue::state_key(RenderPass pass, u32 program, u32 material, u32 mesh) {
+    const u64 state =
+        (bits(program, program_bits) << (material_bits + mesh_bits + lod_bits)) |
+        (bits(material, material_bits) << (mesh_bits + lod_bits)) |
+        (bits(mesh, mesh_bits) << lod_bits);
+    return (u64(pass) << pass_shift) | state;
+}
+
+u64 RenderQueue::draw_key(u64 state_key, u32 lod, float depth) {
+    DEBUG_ASSERT(lod < MeshData::max_lod_count);
+    const u64 pass = state_key >> pass_shift;
+    const u64 state = (state_key & state_mask) | lod;
+    const u64 quantized = quantize_depth(depth);
+
+    if(pass == u64(RenderPass::Transparent)) {
+        return (pass << pass_shift) | ((depth_mask - quantized) << (pass_shift - depth_bits)) | state;
+    }
+    return (pass << pass_shift) | (state << depth_bits) | quantized;
+}
+
+void RenderQueue::clear() {
+    _packets.clear();
+    _batches.clear();
+}
+
+void RenderQueue::push(u64 key, u32 object, u32 lod) {
+    _packets.push_back(DrawPacket{key, object, lod});
+}
+
+void RenderQueue::sort() {
+    constexpr u32 radix_bits = 8;
+    constexpr u32 bucket_count = 1 << radix_bits;
+    constexpr u32 pass_count = 64 / radix_bits;
+
+    if(_packets.size() < 2) {
+        return;
+    }
+
+    // All histograms in a single pass over the keys
+    std::array<std::array<u32, bucket_count>, pass_count> histograms = {};
+    for(const DrawPacket& packet : _packets) {
+        for(u32 p = 0; p != pass_count; ++p) {
+            ++histograms[p][(packet.key >> (p * radix_bits)) & (bucket_count - 1)];
+        }
+    }
+
+    _scratch.resize(_packets.size());
+    for(u32 p = 0; p != pass_count; ++p) {
+        auto& histogram = histograms[p];
+        const u32 shift = p * radix_bits;
+
+        // Every key has the same digit, nothing to do
+        if(histogram[(_packets[0].key >> shift) & (bucket_count - 1)] == _packets.size()) {
+            continue;
+        }
+
+        u32 offset = 0;
+        for(u32& count : histogram) {
+            const u32 c = count;
+            count = offset;
+            offset += c;
+        }
+
+        for(const DrawPacket& packet : _packets) {
+            _scratch[histogram[(packet.key >> shift) & (bucket_count - 1)]++] = packet;
+        }
+        _packets.swap(_scratch);
+    }
+}
+
+Span<const DrawPacket> RenderQueue::packets() const {
+    return _packets;
+}
+
+Span<const DrawBatch> RenderQueue::batches() const {
+    return _batches;
+}
+
+}
@@ -0,0 +1,89 @@
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <utils.h>
+
+#include <vector>
+
+namespace OM3D {
+
+enum class RenderPass : u32 {
+    Opaque = 0,
+    Transparent = 1,
+};
+
+// One entry per visible object, sorted by key before submission
+struct DrawPacket {
+    u64 key = 0;
+    u32 object = 0;
+    u32 lod = 0;
+};
+
+// Consecutive packets that can be drawn with a single instanced draw
+struct DrawBatch {
+    u32 first = 0;
+    u32 count = 0;
+};
+
+// Keys are laid out so that sorting them in increasing order groups draws by state:
+//   opaque:      [pass:2][program:10][material:14][mesh:11][lod:3][depth:24]  (front to back inside a state bucket)
+//   transparent: [pass:2][inverted depth:24][program:10][material:14][mesh:11][lod:3]  (back to front)
+class RenderQueue {
+    public:
+        struct Stats {
+            u32 draws = 0;
+            u32 instances = 0;
+            u32 material_binds = 0;
+            // Binds that reached GL, binding what is already bound doesn't count
+            u32 program_switches = 0;
+            u32 texture_rebinds = 0;
+            u32 geometry_binds = 0;
+            u32 triangles = 0;
+            // CPU time spent in the draw loop, binds included
+            float submit_ms = 0.0f;
+        };
+
+        static constexpr u32 program_bits = 10;
+        static constexpr u32 material_bits = 14;
+        static constexpr u32 mesh_bits = 11;
+        static constexpr u32 lod_bits = 3;
+        static constexpr u32 depth_bits = 24;
+
+        // Everything but the level of detail and the depth, computed once per object.
+        // Ids wrap around if they don't fit: batches compare the objects, so this only costs batching, never correctness.
+        static u64 state_key(RenderPass pass, u32 program, u32 material, u32 mesh);
+        // Combine a state key with the level of detail and the view space depth of the object
+        static u64 draw_key(u64 state_key, u32 lod, float depth);
+
+        void clear();
+        void push(u64 key, u32 object, u32 lod = 0);
+
+        // Stable LSD radix sort on the keys
+        void sort();
+
+        Span<const DrawPacket> packets() const;
+
+        // Split the packets in runs where same_state(first packet, packet) holds for every packet of the run.
+        // Runs never reorder packets, so sort first to get the biggest batches.
+        template<typename F>
+        void build_batches(F&& same_state) {
+            _batches.clear();
+            for(u32 i = 0; i != u32(_packets.size()); ++i) {
+                if(_batches.empty() || !same_state(_packets[_batches.back().first], _packets[i])) {
+                    _batches.push_back(DrawBatch{i, 0});
+                }
+                ++_batches.back().count;
+            }
+        }
+
+        Span<const DrawBatch> batches() const;
+
+    private:
+        std::vector<DrawPacket> _packets;
+        std::vector<DrawBatch> _batches;
+        std::vector<DrawPacket> _scratch;
+};
+
+}
+
+#endif // RENDERQUEUE_H
@@ -0,0 +1,134 @@
+#include "RenderQueue.h"
+
+#include <benchmarks.h>
+
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <algorithm>
+
+namespace OM3D {
+
+void bench_render_queue() {
+    std::cout << "Render queue sorting" << std::endl;
+
+    for(const size_t count : {1000, 10000, 100000}) {
+        std::mt19937 rng(0x5EED);
+        std::uniform_int_distribution<u32> program(0, 8);
+        std::uniform_int_distribution<u32> material(0, 200);
+        std::uniform_int_distribution<u32> mesh(0, u32(count));
+        std::uniform_real_distribution<float> depth(0.1f, 1000.0f);
+
+        std::vector<DrawPacket> packets(count);
+        for(size_t i = 0; i != count; ++i) {
+            const u64 state = RenderQueue::state_key(RenderPass::Opaque, program(rng), material(rng), mesh(rng));
+            packets[i] = DrawPacket{RenderQueue::draw_key(state, 0, depth(rng)), u32(i)};
+        }
+
+        const u32 iterations = u32(std::max(size_t(10), 1000000 / count));
+
+        RenderQueue queue;
+        const double radix = time_ms([&] {
+            queue.clear();
+            for(const DrawPacket& packet : packets) {
+                queue.push(packet.key, packet.object);
+            }
+            queue.sort();
+        }, iterations);
+
+        std::vector<DrawPacket> sorted;
+        const double comparison = time_ms([&] {
+            sorted = packets;
+            std::stable_sort(sorted.begin(), sorted.end(), [](const DrawPacket& a, const DrawPacket& b) { return a.key < b.key; });
+        }, iterations);
+
+        const Span<const DrawPacket> result = queue.packets();
+        const bool match = std::equal(result.begin(), result.end(), sorted.begin(), sorted.end(), [](const DrawPacket& a, const DrawPacket& b) {
+            return a.key == b.key && a.object == b.object;
+        });
+
+        std::cout << "  " << std::setw(6) << count << " packets: "
+                  << "radix " << radix << "ms, "
+                  << "std::stable_sort " << comparison << "ms"
+                  << check_result(match, " MISMATCH") << std::endl;
+    }
+
+    // Ids too large for their field wrap without spilling into the next one, transparent draws come last, back to front
+    {
+        const u64 last_mesh = RenderQueue::draw_key(RenderQueue::state_key(RenderPass::Opaque, 0, 0, u32(-1)), MeshData::max_lod_count - 1, 1000.0f);
+        const u64 next_material = RenderQueue::draw_key(RenderQueue::state_key(RenderPass::Opaque, 0, 1, 0), 0, 0.1f);
+        const u64 far_transparent = RenderQueue::draw_key(RenderQueue::state_key(RenderPass::Transparent, 0, 0, 0), 0, 100.0f);
+        const u64 near_transparent = RenderQueue::draw_key(RenderQueue::state_key(RenderPass::Transparent, 0, 0, 0), 0, 1.0f);
+        const bool valid = last_mesh < next_material && next_material < far_transparent && far_transparent < near_transparent;
+        std::cout << "  key layout" << check_result(valid) << std::endl;
+    }
+}
+
+void bench_instancing() {
+    std::cout << "Automatic instancing" << std::endl;
+
+    // Generated scene: 50k copies of 64 props using 8 materials
+    const size_t count = 50000;
+    const u32 mesh_count = 64;
+    const u32 material_count = 8;
+
+    std::mt19937 rng(0x5EED);
+    std::uniform_int_distribution<u32> prop(0, mesh_count - 1);
+    std::uniform_real_distribution<float> pos(-500.0f, 500.0f);
+
+    std::vector<u32> meshes(count);
+    std::vector<glm::mat4> transforms(count);
+    std::vector<u64> state_keys(count);
+    for(size_t i = 0; i != count; ++i) {
+        meshes[i] = prop(rng);
+        transforms[i] = glm::translate(glm::mat4(1.0f), glm::vec3(pos(rng), pos(rng), pos(rng)));
+
+        const u32 material = meshes[i] % material_count;
+        state_keys[i] = RenderQueue::state_key(RenderPass::Opaque, material % 3, material, meshes[i]);
+    }
+
+    auto same_state = [&](const DrawPacket& a, const DrawPacket& b) {
+        return meshes[a.object] == meshes[b.object];
+    };
+
+    for(const bool sorted : {false, true}) {
+        RenderQueue queue;
+        std::vector<u32> object_indices;
+
+        const double time = time_ms([&] {
+            queue.clear();
+            for(u32 i = 0; i != count; ++i) {
+                queue.push(RenderQueue::draw_key(state_keys[i], 0, transforms[i][3].z + 1000.0f), i);
+            }
+            if(sorted) {
+                queue.sort();
+            }
+            queue.build_batches(same_state);
+
+            // Instances read their transform through the object index of their packet
+            const Span<const DrawPacket> packets = queue.packets();
+            object_indices.resize(packets.size());
+            for(size_t i = 0; i != packets.size(); ++i) {
+                object_indices[i] = packets[i].object;
+            }
+        }, 20);
+
+        // Batches must cover the queue in order and only group identical props
+        bool valid = true;
+        u32 next = 0;
+        for(const DrawBatch& batch : queue.batches()) {
+            valid &= batch.first == next && batch.count > 0;
+            for(u32 i = batch.first; i != batch.first + batch.count; ++i) {
+                valid &= meshes[queue.packets()[i].object] == meshes[queue.packets()[batch.first].object];
+            }
+            next = batch.first + batch.count;
+        }
+        valid &= next == count;
+
+        std::cout << "  " << count << " instances, " << (sorted ? "sorted  " : "unsorted") << ": "
+                  << queue.batches().size() << " draws instead of " << count << " in " << time << "ms"
+                  << check_result(valid) << std::endl;
+    }
+}
+
+}
@@ -1,34 +1,58 @@
 #include "Scene.h"
 
 #include <TypedBuffer.h>
+#include <StreamBuffer.h>
+#include <GLState.h>
 
 #include <shader_structs.h>
 
 #include <algorithm>
+#include <unordered_map>
 
 namespace OM3D {
 
     Scene::Scene() {
     }
 
-Scene::Scene(std::shared_ptr<StaticMesh> mesh) {
-    _ball = std::move(mesh);
-}
+void Scene::add_object(SceneObject obj, u32 node) {
+    if(node != SceneGraph::no_node) {
+        obj.set_transform(_graph.world_transform(node));
+        if(obj.getMesh()) {
+            AABB bounds = _graph.local_bounds(node);
+            bounds.add(obj.getMesh()->aabb());
+            _graph.set_local_bounds(node, bounds);
+        }
+        _node_objects_dirty = true;
+    }
 
-void Scene::add_object(SceneObject obj) {
     _objects.emplace_back(std::move(obj));
+    _object_nodes.push_back(node);
+    _bvh_state = BVHState::NeedsRebuild;
+    _object_buffer_dirty = true;
 }
 
 void Scene::add_light(PointLight obj) {
-      
-    auto pos = obj.position();
-    auto radius = obj.radius();
     _point_lights.emplace_back(std::move(obj));
-    auto obj_light = SceneObject(_ball, std::make_shared<Material>(std::move(Material::light_sphere_material())));
-    
-    obj_light.set_transform(glm::translate(glm::mat4(1.0), pos) * glm::scale(glm::mat4(1.0), glm::vec3(radius / 3.2) ));
-        
-    _light_balls.emplace_back(std::move(obj_light));
+}
+
+void Scene::set_light_position(size_t index, const glm::vec3& position) {
+    DEBUG_ASSERT(index < _point_lights.size());
+    _point_lights[index].set_position(position);
+    _dirty_lights.push_back(u32(index));
+}
+
+void Scene::light_objects(size_t light_index, std::vector<u32>& objects) const {
+    DEBUG_ASSERT(light_index < _point_lights.size());
+    update_culling_data();
+
+    // The octree only tests boxes, objects are kept if their bounding sphere touches the light
+    const size_t first = objects.size();
+    const BoundingSphere& light = _light_bounds[light_index];
+    _object_octree.query(light, objects);
+    objects.erase(std::remove_if(objects.begin() + first, objects.end(), [&](u32 index) {
+        const BoundingSphere sphere = _objects[index].world_sphere();
+        return glm::length(sphere.center - light.center) > sphere.radius + light.radius;
+    }), objects.end());
 }
 
 Span<const SceneObject> Scene::objects() const {
@@ -52,134 +76,785 @@ void Scene::set_sun(glm::vec3 direction, glm::vec3 color) {
     _sun_color = color;
 }
 
-float getSignedDistanceToPlane(const glm::vec3& plane, const glm::vec3& point) {
-    return glm::dot(plane, point);
+void Scene::set_object_transform(size_t index, const glm::mat4& transform) {
+    DEBUG_ASSERT(index < _objects.size());
+    _objects[index].set_transform(transform);
+    _dirty_object_data.push_back(u32(index));
+    if(_bvh_state != BVHState::NeedsRebuild) {
+        _bvh_state = BVHState::NeedsRefit;
+        _dirty_objects.push_back(u32(index));
+    }
+}
+
+u32 Scene::add_node(u32 parent, const NodeTransform& local) {
+    _node_objects_dirty = true;
+    return _graph.add_node(parent, local);
+}
+
+void Scene::set_node_transform(u32 node, const NodeTransform& local) {
+    _graph.set_local_transform(node, local);
+}
+
+const SceneGraph& Scene::graph() const {
+    return _graph;
+}
+
+void Scene::update_transforms() {
+    _graph.update();
+
+    const Span<const u32> changed = _graph.changed_nodes();
+    if(changed.is_empty()) {
+        return;
+    }
+
+    if(_node_objects_dirty) {
+        _node_object_offsets.assign(_graph.size() + 1, 0);
+        for(const u32 node : _object_nodes) {
+            if(node != SceneGraph::no_node) {
+                ++_node_object_offsets[node + 1];
+            }
+        }
+        for(size_t i = 0; i != _graph.size(); ++i) {
+            _node_object_offsets[i + 1] += _node_object_offsets[i];
+        }
+
+        _node_object_list.resize(_node_object_offsets.back());
+        std::vector<u32> cursors(_node_object_offsets.begin(), _node_object_offsets.end() - 1);
+        for(u32 i = 0; i != _object_nodes.size(); ++i) {
+            if(_object_nodes[i] != SceneGraph::no_node) {
+                _node_object_list[cursors[_object_nodes[i]]++] = i;
+            }
+        }
+        _node_objects_dirty = false;
+    }
+
+    for(const u32 node : changed) {
+        for(u32 i = _node_object_offsets[node]; i != _node_object_offsets[node + 1]; ++i) {
+            set_object_transform(_node_object_list[i], _graph.world_transform(node));
+        }
+    }
+}
+
+void Scene::add_occluder(size_t object_index, std::shared_ptr<const OcclusionCuller::OccluderMesh> mesh) {
+    DEBUG_ASSERT(object_index < _objects.size());
+    _occlusion_culler.add_occluder(u32(object_index), std::move(mesh));
+}
+
+void Scene::set_octree_culling(bool enabled) {
+    if(_octree_culling && !enabled) {
+        // The BVH isn't refit while culling with the octree
+        _bvh_state = BVHState::NeedsRebuild;
+    }
+    _octree_culling = enabled;
 }
 
-bool isOnForwardPlane(glm::vec3& plane, glm::vec3 globalCenter, const float globalRadius) {
-    return getSignedDistanceToPlane(plane, globalCenter) >= -globalRadius;
+bool Scene::octree_culling() const {
+    return _octree_culling;
 }
 
-bool isOnFrustum(Frustum frustum, SceneObject obj, Camera camera) {
+void Scene::set_occlusion_culling(bool enabled) {
+    _occlusion_culling = enabled;
+}
 
-    glm::mat4 transform = obj.transform();
+bool Scene::occlusion_culling() const {
+    return _occlusion_culling;
+}
 
-    glm::vec3 surfacePoint = obj.getMesh()->getCenter() + glm::vec3(1.0f) * obj.getMesh()->getRadius();
+void Scene::set_gpu_culling(bool enabled) {
+    _gpu_culling = enabled;
+}
 
-    glm::vec4 globalCenter = transform * glm::vec4(obj.getMesh()->getCenter(), 1.0f);
+void Scene::set_sort_render_queue(bool enabled) {
+    _sort_render_queue = enabled;
+}
 
-    glm::vec4 globalSurfacePoint = transform * glm::vec4(surfacePoint, 1.0f);
+bool Scene::sort_render_queue() const {
+    return _sort_render_queue;
+}
 
-    glm::vec4 diag = (globalSurfacePoint - globalCenter);
-    const float globalRadius = std::sqrt((diag.x * diag.x + diag.y * diag.y + diag.z * diag.z)) * 0.5f;
+void Scene::set_instancing(bool enabled) {
+    _instancing = enabled;
+}
 
-    glm::vec3 globalCameraCenter = glm::vec3(globalCenter) - camera.position();
+bool Scene::instancing() const {
+    return _instancing;
+}
 
-    return (isOnForwardPlane(frustum._bottom_normal, globalCameraCenter, globalRadius) &&
-            isOnForwardPlane(frustum._top_normal, globalCameraCenter, globalRadius) &&
-            isOnForwardPlane(frustum._left_normal, globalCameraCenter, globalRadius) &&
-            isOnForwardPlane(frustum._right_normal, globalCameraCenter, globalRadius) &&
-            isOnForwardPlane(frustum._near_normal, globalCameraCenter, globalRadius));
+const RenderQueue::Stats& Scene::render_stats() const {
+    return _render_stats;
 }
 
-void Scene::render() const {
+void Scene::set_lod_selection(bool enabled) {
+    _lod_selection = enabled;
+}
+
+bool Scene::lod_selection() const {
+    return _lod_selection;
+}
+
+void Scene::set_lod_pixel_error(float pixels) {
+    _lod_pixel_error = pixels;
+}
+
+float Scene::lod_pixel_error() const {
+    return _lod_pixel_error;
+}
+
+bool Scene::gpu_culling() const {
+    return _gpu_culling;
+}
+
+GpuCuller::Stats Scene::gpu_culling_stats() const {
+    return _gpu_culler ? _gpu_culler->stats() : GpuCuller::Stats{};
+}
+
+void Scene::set_meshlet_culling(bool enabled) {
+    _meshlet_culling = enabled;
+}
+
+bool Scene::meshlet_culling() const {
+    return _meshlet_culling;
+}
+
+bool Scene::use_gpu_culling() const {
+    return _gpu_culling && _gpu_culler;
+}
+
+void Scene::update_culling_data() const {
+    if(_bvh_state == BVHState::NeedsRebuild) {
+        _gpu_objects_dirty = true;
+        _object_bounds.resize(_objects.size());
+        for(size_t i = 0; i != _objects.size(); ++i) {
+            _object_bounds[i] = _objects[i].world_aabb();
+        }
+        _bvh.build(_object_bounds);
+
+        // Small ids for the sort keys, in order of first appearance
+        std::unordered_map<const void*, u32> program_ids;
+        std::unordered_map<const void*, u32> material_ids;
+        std::unordered_map<const void*, u32> mesh_ids;
+        auto id = [](auto& ids, const void* ptr) { return ids.emplace(ptr, u32(ids.size())).first->second; };
+
+        _object_state_keys.resize(_objects.size());
+        for(size_t i = 0; i != _objects.size(); ++i) {
+            const Material* material = _objects[i].material().get();
+            _object_state_keys[i] = RenderQueue::state_key(
+                material && material->blend_mode() != BlendMode::None ? RenderPass::Transparent : RenderPass::Opaque,
+                id(program_ids, material ? material->program().get() : nullptr),
+                id(material_ids, material),
+                id(mesh_ids, _objects[i].getMesh().get())
+            );
+        }
+
+        AABB scene_bounds;
+        for(const AABB& bounds : _object_bounds) {
+            scene_bounds.add(bounds);
+        }
+        _object_octree.reset(scene_bounds);
+        _object_handles.resize(_objects.size());
+        for(size_t i = 0; i != _objects.size(); ++i) {
+            _object_handles[i] = _object_octree.insert(u32(i), _object_bounds[i]);
+        }
+
+        // Store spheres in BVH leaf order so that partially visible leaves are contiguous
+        const Span<const u32> order = _bvh.primitive_order();
+        _object_slots.assign(_objects.size(), u32(-1));
+        _object_spheres.resize(order.size());
+        for(size_t k = 0; k != order.size(); ++k) {
+            const u32 index = order[k];
+            _object_slots[index] = u32(k);
+            _object_spheres.set(k, index, _objects[index].world_sphere());
+        }
+    } else if(_bvh_state == BVHState::NeedsRefit) {
+        _gpu_transforms_dirty = true;
+        for(const u32 index : _dirty_objects) {
+            _object_bounds[index] = _objects[index].world_aabb();
+            _object_octree.update(_object_handles[index], _object_bounds[index]);
+            if(const u32 slot = _object_slots[index]; slot != u32(-1)) {
+                _object_spheres.set(slot, index, _objects[index].world_sphere());
+            }
+        }
+        // Rebuilt when switching back to BVH culling
+        if(!_octree_culling) {
+            _bvh.refit(_object_bounds);
+        }
+    }
+    _dirty_objects.clear();
+    _bvh_state = BVHState::UpToDate;
+
+    auto light_box = [](const BoundingSphere& sphere) {
+        return AABB{sphere.center - sphere.radius, sphere.center + sphere.radius};
+    };
+
+    if(_light_bounds.size() != _point_lights.size()) {
+        _light_bounds.resize(_point_lights.size());
+        _light_spheres.resize(_point_lights.size());
+
+        AABB light_scene_bounds;
+        for(size_t i = 0; i != _point_lights.size(); ++i) {
+            _light_bounds[i] = BoundingSphere{_point_lights[i].position(), _point_lights[i].radius()};
+            _light_spheres.set(i, u32(i), _light_bounds[i]);
+            light_scene_bounds.add(light_box(_light_bounds[i]));
+        }
+
+        _light_octree.reset(light_scene_bounds);
+        _light_handles.resize(_point_lights.size());
+        for(size_t i = 0; i != _point_lights.size(); ++i) {
+            _light_handles[i] = _light_octree.insert(u32(i), light_box(_light_bounds[i]));
+        }
+    } else {
+        for(const u32 index : _dirty_lights) {
+            _light_bounds[index] = BoundingSphere{_point_lights[index].position(), _point_lights[index].radius()};
+            _light_spheres.set(index, index, _light_bounds[index]);
+            _light_octree.update(_light_handles[index], light_box(_light_bounds[index]));
+        }
+    }
+    _dirty_lights.clear();
+}
+
+void Scene::cull(View& view) const {
+    View* views[] = {&view};
+    cull(views);
+}
+
+void Scene::cull(Span<View*> views) const {
+    update_culling_data();
+
+    // BVH traversal is shared by all views
+    for(size_t first = 0; first < views.size(); first += BVH::max_frustums) {
+        const size_t count = std::min(views.size() - first, BVH::max_frustums);
+
+        std::vector<Frustum> frustums(count);
+        std::vector<BVH::CullResult> results(count);
+        for(size_t i = 0; i != count; ++i) {
+            View& view = *views[first + i];
+            frustums[i] = view.frustum();
+
+            // Reuse the previous frame allocation
+            view._visible_objects.clear();
+            results[i].visible.swap(view._visible_objects);
+        }
+
+        // Objects are culled on the GPU, don't spend CPU time on them
+        if(!_gpu_culling && !_octree_culling) {
+            _bvh.cull(frustums, results);
+        }
+
+        for(size_t i = 0; i != count; ++i) {
+            View& view = *views[first + i];
+            view._visible_objects.swap(results[i].visible);
+            view._occlusion_stats = {};
+
+            if(!_gpu_culling) {
+                if(_octree_culling) {
+                    _object_octree.query(frustums[i], view._visible_objects);
+                } else {
+                    _object_spheres.cull(frustums[i], results[i].partial, view._visible_objects);
+                }
+                if(_occlusion_culling && !_occlusion_culler.occluders().is_empty()) {
+                    occlusion_cull(view);
+                }
+            }
+
+            view._visible_lights.clear();
+            if(_octree_culling) {
+                std::vector<u32>& lights = view._visible_lights;
+                _light_octree.query(frustums[i], lights);
+                lights.erase(std::remove_if(lights.begin(), lights.end(), [&](u32 index) {
+                    return !frustums[i].intersects(_light_bounds[index]);
+                }), lights.end());
+            } else {
+                _light_spheres.cull(frustums[i], view._visible_lights);
+            }
+            if(!view.camera().is_orthographic()) {
+                view._light_clusters.build(view.camera(), _light_bounds);
+            }
+
+            build_render_queue(view);
+        }
+    }
+}
+
+// Pixels covered by one unit at a distance of one unit (or at any distance for orthographic cameras)
+static float lod_pixel_scale(const Camera& camera) {
+    return float(viewport_size().y) * camera.projection_matrix()[1][1] * 0.5f;
+}
+
+u32 Scene::select_lod(u32 object_index, const glm::vec3& camera_position, float pixel_scale, bool orthographic) const {
+    // Radius under which the object is culled
+    static constexpr float min_pixel_radius = 0.5f;
+
+    const SceneObject& object = _objects[object_index];
+    StaticMesh* mesh = object.getMesh().get();
+    if(!mesh) {
+        return 0;
+    }
+
+    const BoundingSphere sphere = object.world_sphere();
+    const float distance = orthographic ? 1.0f : glm::length(sphere.center - camera_position) - sphere.radius;
+    if(distance <= 0.0f) {
+        return 0;
+    }
+
+    const float pixels_per_unit = pixel_scale / distance;
+    if(sphere.radius * pixels_per_unit < min_pixel_radius) {
+        return no_lod;
+    }
+
+    // Errors are in mesh space
+    const float mesh_radius = mesh->getRadius();
+    const float scale = mesh_radius > 0.0f ? sphere.radius / mesh_radius : 1.0f;
+    return mesh->select_lod(_lod_pixel_error / (pixels_per_unit * scale));
+}
+
+void Scene::build_render_queue(View& view) const {
+    const glm::vec3 position = view.camera().position();
+    const glm::vec3 forward = view.camera().forward();
+    const float pixel_scale = lod_pixel_scale(view.camera());
+    const bool orthographic = view.camera().is_orthographic();
+
+    RenderQueue& queue = view._render_queue;
+    queue.clear();
+    view._lod_stats = {};
+
+    std::vector<u32>& visible = view._visible_objects;
+    size_t visible_count = 0;
+    for(const u32 index : visible) {
+        const u32 lod = _lod_selection ? select_lod(index, position, pixel_scale, orthographic) : 0;
+        if(lod == no_lod) {
+            ++view._lod_stats.small_culled;
+            continue;
+        }
+        visible[visible_count++] = index;
+        ++view._lod_stats.objects[lod];
+
+        const float depth = glm::dot(_object_bounds[index].center() - position, forward);
+        queue.push(RenderQueue::draw_key(_object_state_keys[index], lod, depth), index, lod);
+    }
+    visible.resize(visible_count);
+
+    if(_sort_render_queue) {
+        queue.sort();
+    }
+
+    if(_instancing) {
+        queue.build_batches([&](const DrawPacket& a, const DrawPacket& b) {
+            const SceneObject& first = _objects[a.object];
+            const SceneObject& object = _objects[b.object];
+            return a.lod == b.lod && first.material() == object.material() && first.getMesh() == object.getMesh();
+        });
+    } else {
+        queue.build_batches([](const DrawPacket&, const DrawPacket&) { return false; });
+    }
+    view._object_indices_dirty = true;
+}
+
+void Scene::submit(const View& view, RenderQueue::Stats& stats, MaterialPass pass) const {
+    stats = {};
+
+    const RenderQueue& queue = view.render_queue();
+    const Span<const DrawPacket> packets = queue.packets();
+    if(packets.is_empty()) {
+        return;
+    }
+
+    // Shared by every pass drawing the view, only upload once
+    if(view._object_indices_dirty) {
+        const auto indices = StreamBuffer::global().allocate<u32>(packets.size());
+        for(size_t i = 0; i != packets.size(); ++i) {
+            indices[i] = packets[i].object;
+        }
+        view._object_indices = indices;
+        view._object_indices_dirty = false;
+    }
+
+    update_object_buffer();
+    _object_buffer->bind(BufferUsage::Storage, 2);
+
+    // Batches use their first packet as base instance, so instances read the object index of their packet
+    GeometryBuffer::set_object_index_buffer(view._object_indices.buffer, view._object_indices.offset);
+
+    const double submit_start = program_time();
+    DEFER(stats.submit_ms = float((program_time() - submit_start) * 1000.0));
+
+    // Programs and textures are counted when they actually reach GL: the depth pass shares one program,
+    // and materials often share textures with the previous one
+    const GLCallStats calls_before = gl_call_stats();
+
+    const Material* bound_material = nullptr;
+    const StaticMesh* bound_geometry = nullptr; // Any mesh of the bound vertex format
+    for(const DrawBatch& batch : queue.batches()) {
+        const SceneObject& object = _objects[packets[batch.first].object];
+        const Material* material = object.material().get();
+        const StaticMesh* mesh = object.getMesh().get();
+        if(!material || !mesh) {
+            continue;
+        }
+
+        // Only rebind when the state changes between consecutive draws
+        if(material != bound_material) {
+            material->bind(pass);
+            bound_material = material;
+            ++stats.material_binds;
+        }
+
+        // Every mesh of a format shares the same buffers, they are only bound when the format changes
+        if(!bound_geometry || bound_geometry->vertex_format() != mesh->vertex_format()) {
+            if(pass == MaterialPass::Depth) {
+                GeometryBuffer::global().bind_positions(mesh->vertex_format());
+            } else {
+                GeometryBuffer::global().bind(mesh->vertex_format());
+            }
+            bound_geometry = mesh;
+            ++stats.geometry_binds;
+        }
+
+        const u32 lod = packets[batch.first].lod;
+        mesh->draw_bound(batch.first, batch.count, lod);
+
+        ++stats.draws;
+        stats.instances += batch.count;
+        stats.triangles += mesh->lods()[lod].index_count / 3 * batch.count;
+    }
+
+    const GLCallStats& calls = gl_call_stats();
+    stats.program_switches += calls.program_binds - calls_before.program_binds;
+    stats.texture_rebinds += calls.texture_binds - calls_before.texture_binds;
+}
+
+static shader::ObjectData object_data(const SceneObject& object) {
+    shader::ObjectData data;
+    data.model = object.transform();
+    data.normal_matrix = glm::mat4(glm::transpose(glm::inverse(glm::mat3(data.model))));
+    if(const auto& mesh = object.getMesh()) {
+        data.position_offset = mesh->quantization().offset;
+        data.position_scale = mesh->quantization().scale;
+        data.vertex_format = u32(mesh->vertex_format());
+    }
+    return data;
+}
+
+void Scene::update_object_buffer() const {
+    if(_object_buffer_dirty || !_object_buffer) {
+        std::vector<shader::ObjectData> data(std::max(_objects.size(), size_t(1)));
+        for(size_t i = 0; i != _objects.size(); ++i) {
+            data[i] = object_data(_objects[i]);
+        }
+        _object_buffer = std::make_unique<TypedBuffer<shader::ObjectData>>(data);
+        _object_buffer_dirty = false;
+        _dirty_object_data.clear();
+        return;
+    }
+
+    if(_dirty_object_data.empty()) {
+        return;
+    }
+
+    // Upload contiguous runs of moved objects
+    std::sort(_dirty_object_data.begin(), _dirty_object_data.end());
+    _dirty_object_data.erase(std::unique(_dirty_object_data.begin(), _dirty_object_data.end()), _dirty_object_data.end());
+
+    std::vector<shader::ObjectData> run;
+    for(size_t i = 0; i != _dirty_object_data.size();) {
+        const u32 first = _dirty_object_data[i];
+        run.clear();
+        for(; i != _dirty_object_data.size() && _dirty_object_data[i] == first + run.size(); ++i) {
+            run.push_back(object_data(_objects[_dirty_object_data[i]]));
+        }
+        _object_buffer->upload(run.data(), run.size() * sizeof(shader::ObjectData), first * sizeof(shader::ObjectData));
+    }
+    _dirty_object_data.clear();
+}
+
+void Scene::occlusion_cull(View& view) const {
+    _occlusion_culler.begin(view.camera().view_proj_matrix());
+    for(const OcclusionCuller::Occluder& occluder : _occlusion_culler.occluders()) {
+        const SceneObject& object = _objects[occluder.id];
+        if(view.frustum().intersects(object.world_sphere())) {
+            _occlusion_culler.rasterize(occluder, object.transform());
+        }
+    }
+    _occlusion_culler.finish();
+
+    std::vector<u32>& visible = view._visible_objects;
+    visible.erase(std::remove_if(visible.begin(), visible.end(), [&](u32 index) {
+        return !_occlusion_culler.is_visible(_object_bounds[index]);
+    }), visible.end());
+
+    view._occlusion_stats = _occlusion_culler.stats();
+}
+
+void Scene::update_gpu_draws() const {
+    if(_gpu_objects_dirty) {
+        _gpu_draw_objects.clear();
+        for(size_t i = 0; i != _objects.size(); ++i) {
+            if(_objects[i].getMesh() && _objects[i].material()) {
+                _gpu_draw_objects.push_back(u32(i));
+            }
+        }
+
+        // Meshes with different vertex formats read different vertex buffers
+        auto bucket_key = [&](u32 object) {
+            return std::make_pair(_objects[object].material().get(), _objects[object].getMesh()->vertex_format());
+        };
+        std::stable_sort(_gpu_draw_objects.begin(), _gpu_draw_objects.end(), [&](u32 a, u32 b) {
+            return bucket_key(a) < bucket_key(b);
+        });
+
+        _gpu_buckets.clear();
+        for(u32 i = 0; i != _gpu_draw_objects.size(); ++i) {
+            const auto [material, format] = bucket_key(_gpu_draw_objects[i]);
+            if(_gpu_buckets.empty() || _gpu_buckets.back().material != material || _gpu_buckets.back().format != format) {
+                _gpu_buckets.push_back(GpuDrawBucket{material, format, i, 0});
+            }
+            ++_gpu_buckets.back().count;
+        }
+
+        // Levels of detail of every mesh, once per mesh
+        _gpu_lods.clear();
+        _gpu_draw_first_lods.resize(_gpu_draw_objects.size());
+        std::unordered_map<const StaticMesh*, u32> first_lods;
+        for(size_t i = 0; i != _gpu_draw_objects.size(); ++i) {
+            const StaticMesh* mesh = _objects[_gpu_draw_objects[i]].getMesh().get();
+            const auto [it, inserted] = first_lods.emplace(mesh, u32(_gpu_lods.size()));
+            if(inserted) {
+                for(const MeshLod& lod : mesh->lods()) {
+                    _gpu_lods.push_back(shader::LodRange{lod.first_index, lod.index_count, lod.error, 0});
+                }
+            }
+            _gpu_draw_first_lods[i] = it->second;
+        }
+
+        // Meshlets of every mesh, once per mesh, and one meshlet draw per meshlet of every draw.
+        // Meshes with a single meshlet are culled as a whole anyway.
+        _gpu_meshlets.clear();
+        _gpu_meshlet_draws.clear();
+        _gpu_draw_meshlet_counts.assign(_gpu_draw_objects.size(), 0);
+        std::unordered_map<const StaticMesh*, u32> first_meshlets;
+        for(GpuDrawBucket& bucket : _gpu_buckets) {
+            bucket.first_meshlet = u32(_gpu_meshlet_draws.size());
+            const bool cone_culling = bucket.material->cull_mode() == CullMode::Back;
+            for(u32 i = bucket.first; i != bucket.first + bucket.count; ++i) {
+                const StaticMesh* mesh = _objects[_gpu_draw_objects[i]].getMesh().get();
+                const Span<const Meshlet> meshlets = mesh->meshlets();
+                if(meshlets.size() < 2) {
+                    continue;
+                }
+
+                const auto [it, inserted] = first_meshlets.emplace(mesh, u32(_gpu_meshlets.size()));
+                if(inserted) {
+                    for(const Meshlet& meshlet : meshlets) {
+                        shader::MeshletData& data = _gpu_meshlets.emplace_back();
+                        data.sphere = glm::vec4(meshlet.bounds.center, meshlet.bounds.radius);
+                        data.cone_apex = meshlet.cone_apex;
+                        data.cone_cutoff = meshlet.cone_cutoff;
+                        data.cone_axis = meshlet.cone_axis;
+                        data.first_index = mesh->range().first_index + meshlet.first_index;
+                        data.index_count = meshlet.index_count;
+                    }
+                }
+
+                for(u32 m = 0; m != meshlets.size(); ++m) {
+                    shader::MeshletDraw& draw = _gpu_meshlet_draws.emplace_back();
+                    draw.draw = i;
+                    draw.meshlet = it->second + m;
+                    draw.object = _gpu_draw_objects[i];
+                    draw.base_vertex = int(mesh->range().first_vertex);
+                    draw.cone_culling = cone_culling;
+                }
+                _gpu_draw_meshlet_counts[i] = u32(meshlets.size());
+            }
+            bucket.meshlet_count = u32(_gpu_meshlet_draws.size()) - bucket.first_meshlet;
+        }
+    }
+
+    std::vector<shader::CullData> draws(_gpu_draw_objects.size());
+    for(size_t i = 0; i != _gpu_draw_objects.size(); ++i) {
+        const SceneObject& object = _objects[_gpu_draw_objects[i]];
+        const BoundingSphere sphere = object.world_sphere();
+        StaticMesh& mesh = *object.getMesh();
+
+        draws[i].sphere = glm::vec4(sphere.center, sphere.radius);
+        draws[i].first_lod = _gpu_draw_first_lods[i];
+        draws[i].lod_count = u32(mesh.lods().size());
+        draws[i].base_vertex = int(mesh.range().first_vertex);
+        draws[i].scale = mesh.getRadius() > 0.0f ? sphere.radius / mesh.getRadius() : 1.0f;
+        draws[i].meshlet_count = _gpu_draw_meshlet_counts[i];
+    }
+
+    if(_gpu_objects_dirty) {
+        _gpu_culler->set_draws(draws, _gpu_draw_objects, _gpu_lods, _gpu_meshlets, _gpu_meshlet_draws);
+    } else {
+        _gpu_culler->update_draws(draws);
+    }
+
+    _gpu_objects_dirty = false;
+    _gpu_transforms_dirty = false;
+}
+
+void Scene::gpu_cull(const View& view, const DepthPyramid& pyramid, GpuCullPhase phase) const {
+    if(!_gpu_culler) {
+        _gpu_culler = std::make_unique<GpuCuller>();
+    }
+
+    update_culling_data();
+    if(_gpu_objects_dirty || _gpu_transforms_dirty) {
+        update_gpu_draws();
+    }
+
+    // Meshlet culling transforms the meshlet bounds
+    update_object_buffer();
+
+    _gpu_culler->set_lod_selection(_lod_selection, _lod_pixel_error);
+    _gpu_culler->set_meshlet_culling(_meshlet_culling);
+    _gpu_culler->cull(view.camera(), pyramid, phase, *_object_buffer);
+}
+
+void Scene::render_gpu_driven(bool late_only, MaterialPass pass) const {
+    update_object_buffer();
+    _object_buffer->bind(BufferUsage::Storage, 2);
+
+    const auto& commands = late_only ? _gpu_culler->late_commands() : _gpu_culler->commands();
+    const auto& meshlet_commands = late_only ? _gpu_culler->late_meshlet_commands() : _gpu_culler->meshlet_commands();
+    const bool draw_meshlets = _gpu_culler->meshlet_draw_count() != 0;
+
+    for(const GpuDrawBucket& bucket : _gpu_buckets) {
+        _gpu_culler->bind_draw_data(bucket.format, pass == MaterialPass::Depth);
+        bucket.material->bind(pass);
+        _gpu_culler->multi_draw(commands, bucket.first, bucket.count);
+        if(draw_meshlets && bucket.meshlet_count) {
+            _gpu_culler->multi_draw(meshlet_commands, bucket.first_meshlet, bucket.meshlet_count);
+        }
+    }
+}
+
+void Scene::render(const View& view, MaterialPass pass) const {
+    StreamBuffer& stream = StreamBuffer::global();
+
     // Fill and bind frame data buffer
-    // _frameDataBuffer = std::make_unique<TypedBuffer<shader::FrameData>>(nullptr, 1);
     {
-        auto mapping = _frameDataBuffer->map(AccessType::WriteOnly);
-        mapping[0].camera.view_proj = _camera.view_proj_matrix();
-        mapping[0].point_light_count = u32(_point_lights.size());
-        mapping[0].sun_color = _sun_color;
-        mapping[0].sun_dir = glm::normalize(_sun_direction);
+        const auto frame_data = stream.allocate<shader::FrameData>();
+        frame_data[0].camera.view_proj = view.camera().view_proj_matrix();
+        frame_data[0].point_light_count = u32(_point_lights.size());
+        frame_data[0].sun_color = _sun_color;
+        frame_data[0].sun_dir = glm::normalize(_sun_direction);
+        frame_data.bind(BufferUsage::Uniform, 0);
     }
-    _frameDataBuffer->bind(BufferUsage::Uniform, 0);
 
     // Fill and bind lights buffer
-    _lightBuffer = std::make_unique<TypedBuffer<shader::PointLight>>(nullptr, _point_lights.size());
-    {
-        auto mapping = _lightBuffer->map(AccessType::WriteOnly);
+    if(!_point_lights.empty()) {
+        const auto lights = stream.allocate<shader::PointLight>(_point_lights.size());
         for(size_t i = 0; i != _point_lights.size(); ++i) {
             const auto& light = _point_lights[i];
-            mapping[i] = {
+            lights[i] = {
                 light.position(),
                 light.radius(),
                 light.color(),
                 0.0f
             };
         }
+        lights.bind(BufferUsage::Storage, 1);
     }
-    _lightBuffer->bind(BufferUsage::Storage, 1);
 
-    const Frustum& frustum = _camera.build_frustum();
-    glm::vec3 cameraOrigin = _camera.position();
+    // Clustered lights, for the forward lighting path
+    {
+        const LightClusters& clusters = view.light_clusters();
+
+        const auto info = stream.allocate<shader::ClusterInfo>();
+        info[0] = clusters.shader_info(viewport_size());
+        info.bind(BufferUsage::Uniform, 6);
+
+        const Span<const u32> offsets = clusters.offsets();
+        const auto cluster_offsets = stream.allocate<u32>(offsets.size());
+        std::copy(offsets.begin(), offsets.end(), cluster_offsets.data);
+        cluster_offsets.bind(BufferUsage::Storage, 5);
+
+        const Span<const u32> indices = clusters.light_indices();
+        const auto cluster_lights = stream.allocate<u32>(std::max(indices.size(), size_t(1)));
+        std::copy(indices.begin(), indices.end(), cluster_lights.data);
+        cluster_lights.bind(BufferUsage::Storage, 6);
+    }
 
-    // Render every object
-    for(const SceneObject& obj : _objects) {
-        if (isOnFrustum(frustum, obj, _camera))
-            obj.render();
+    // Render every visible object
+    if(use_gpu_culling()) {
+        if(_gpu_culler->draw_count()) {
+            render_gpu_driven(false, pass);
+        }
+    } else {
+        submit(view, _render_stats, pass);
     }
 }
 
-void Scene::render_lights(glm::uvec2 window_size) const
-{
+void Scene::render_lights(const View& view, glm::uvec2 window_size) const {
+    StreamBuffer& stream = StreamBuffer::global();
+
     {
-        auto mapping = _frameDataBuffer->map(AccessType::WriteOnly);
-        mapping[0].camera.view_proj = _camera.view_proj_matrix();
+        const auto frame_data = stream.allocate<shader::FrameData>();
+        frame_data[0].camera.view_proj = view.camera().view_proj_matrix();
+        frame_data[0].point_light_count = u32(_point_lights.size());
+        frame_data[0].sun_color = _sun_color;
+        frame_data[0].sun_dir = glm::normalize(_sun_direction);
+        frame_data.bind(BufferUsage::Uniform, 3);
     }
-    _frameDataBuffer->bind(BufferUsage::Uniform, 3);
 
-    _windowSizeBuffer = std::make_unique<TypedBuffer<shader::WindowSize>>(nullptr, 1);
     {
-        auto mapping = _windowSizeBuffer->map(AccessType::WriteOnly);
-        mapping[0].inner = window_size;
-    }
-    _windowSizeBuffer->bind(BufferUsage::Uniform, 5);
-
-
-    const Frustum& frustum = _camera.build_frustum();
-    glm::vec3 cameraOrigin = _camera.position();
-
-    for (int i = 0; i < _point_lights.size(); i++) {
-        const SceneObject& obj = _light_balls[i];
-        if (isOnFrustum(frustum, obj, _camera)) {
-            const PointLight& l = _point_lights[i];
-            {
-                auto mapping = _lightBuffer->map(AccessType::WriteOnly);
-                mapping[0] = {
-                        l.position(),
-                        l.radius(),
-                        l.color(),
-                        0.0f
-                 };
-            }
-            _lightBuffer->bind(BufferUsage::Storage, 4);
-            obj.render();
-        }
+        const auto window = stream.allocate<shader::WindowSize>();
+        window[0].inner = window_size;
+        window.bind(BufferUsage::Uniform, 5);
     }
 
+    const Span<const u32> visible_lights = view.visible_lights();
+    if(visible_lights.is_empty()) {
+        return;
+    }
+
+    if(!_light_volume) {
+        // 80 faces are plenty for volumes that only select pixels
+        _light_volume = std::make_unique<StaticMesh>(MeshData::icosphere(1));
+        _light_material = std::make_unique<Material>(Material::light_sphere_material());
+    }
+
+    // Instance i draws the volume of the ith visible light
+    const auto lights = stream.allocate<shader::PointLight>(visible_lights.size());
+    for(size_t i = 0; i != visible_lights.size(); ++i) {
+        const PointLight& light = _point_lights[visible_lights[i]];
+        lights[i] = {
+            light.position(),
+            light.radius(),
+            light.color(),
+            0.0f
+        };
+    }
+    lights.bind(BufferUsage::Storage, 4);
+
+    // Lights are read by instance index
+    GeometryBuffer::disable_object_index_attribute();
+
+    _light_material->bind();
+    _light_volume->draw(0, u32(visible_lights.size()));
 }
 
 
 
-void Scene::zprepass() const {
+void Scene::zprepass(const View& view, GpuCullPhase phase) const {
     // Fill and bind frame data buffer
-    _frameDataBuffer = std::make_unique<TypedBuffer<shader::FrameData>>(nullptr, 1);
     {
-        auto mapping = _frameDataBuffer->map(AccessType::WriteOnly);
-        mapping[0].camera.view_proj = _camera.view_proj_matrix();
-        mapping[0].point_light_count = u32(0);
-        mapping[0].sun_color = glm::vec3(0.0,0.0,0.0);
-        mapping[0].sun_dir = glm::normalize(_sun_direction);
+        const auto frame_data = StreamBuffer::global().allocate<shader::FrameData>();
+        frame_data[0].camera.view_proj = view.camera().view_proj_matrix();
+        frame_data[0].point_light_count = u32(0);
+        frame_data[0].sun_color = glm::vec3(0.0,0.0,0.0);
+        frame_data[0].sun_dir = glm::normalize(_sun_direction);
+        frame_data.bind(BufferUsage::Uniform, 0);
     }
-    _frameDataBuffer->bind(BufferUsage::Uniform, 0);
-
-    const Frustum& frustum = _camera.build_frustum();
-    glm::vec3 cameraOrigin = _camera.position();
 
-    // Render every object
-    for(const SceneObject& obj : _objects) {
-        if (isOnFrustum(frustum, obj, _camera))
-            obj.render();
+    // Render every visible object
+    if(use_gpu_culling()) {
+        if(_gpu_culler->draw_count()) {
+            render_gpu_driven(phase == GpuCullPhase::Late, MaterialPass::Depth);
+        }
+    } else {
+        RenderQueue::Stats stats;
+        submit(view, stats, MaterialPass::Depth);
     }
 }
 
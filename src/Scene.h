@@ -4,6 +4,13 @@
 #include <SceneObject.h>
 #include <PointLight.h>
 #include <Camera.h>
+#include <View.h>
+#include <BVH.h>
+#include <SphereCuller.h>
+#include <LooseOctree.h>
+#include <SceneGraph.h>
+#include <OcclusionCuller.h>
+#include <GpuCuller.h>
 #include <shader_structs.h>
 
 #include <vector>
@@ -15,16 +22,81 @@ class Scene : NonMovable {
 
     public:
         Scene();
-        Scene(std::shared_ptr<StaticMesh> mesh);
 
         static Result<std::unique_ptr<Scene>> from_gltf(const std::string& file_name);
 
-        void render() const;
-        void render_lights(glm::uvec2 window_size) const;
-        void zprepass() const;
+        // Compute the visible objects and lights of the views
+        void cull(View& view) const;
+        void cull(Span<View*> views) const;
 
-        void add_object(SceneObject obj);
+        // Frustum and Hi-Z occlusion culling on the GPU. When enabled, cull only computes light visibility
+        // and render and zprepass draw the objects the GPU found visible with one multi-draw per material.
+        void gpu_cull(const View& view, const DepthPyramid& pyramid, GpuCullPhase phase) const;
+
+        // After a zprepass of the same view, use MaterialPass::AfterDepthPrepass to shade each pixel once
+        void render(const View& view, MaterialPass pass = MaterialPass::Default) const;
+        // Draws the volumes of all the visible lights with a single instanced draw
+        void render_lights(const View& view, glm::uvec2 window_size) const;
+        // Depth only, with the position streams and the depth program of the materials.
+        // With GPU culling, only draws the objects that passed the given phase
+        void zprepass(const View& view, GpuCullPhase phase = GpuCullPhase::Early) const;
+
+        // Objects attached to a node follow its world transform
+        void add_object(SceneObject obj, u32 node = SceneGraph::no_node);
         void add_light(PointLight obj);
+        void set_light_position(size_t index, const glm::vec3& position);
+
+        void set_object_transform(size_t index, const glm::mat4& transform);
+
+        u32 add_node(u32 parent, const NodeTransform& local = {});
+        void set_node_transform(u32 node, const NodeTransform& local);
+        const SceneGraph& graph() const;
+
+        // Propagate the node transforms changed since the last call to the descendant nodes and attached objects
+        void update_transforms();
+
+        // Use the mesh of an object as occluder for software occlusion culling, with the transform of the object
+        void add_occluder(size_t object_index, std::shared_ptr<const OcclusionCuller::OccluderMesh> mesh);
+
+        // Objects within the radius of the light
+        void light_objects(size_t light_index, std::vector<u32>& objects) const;
+
+        // Frustum cull objects and lights using the loose octrees instead of the BVH and the light spheres, off by default
+        void set_octree_culling(bool enabled);
+        bool octree_culling() const;
+
+        void set_occlusion_culling(bool enabled);
+        bool occlusion_culling() const;
+
+        // Sort the render queue by state and depth, otherwise objects are submitted in culling order
+        void set_sort_render_queue(bool enabled);
+        bool sort_render_queue() const;
+
+        // Draw consecutive queued objects sharing a mesh and a material with a single instanced draw
+        void set_instancing(bool enabled);
+        bool instancing() const;
+
+        // Draw objects with the coarsest level of detail whose error projects to at most lod_pixel_error pixels,
+        // and cull objects covering less than a pixel
+        void set_lod_selection(bool enabled);
+        bool lod_selection() const;
+        void set_lod_pixel_error(float pixels);
+        float lod_pixel_error() const;
+
+        // State changes of the last render call
+        const RenderQueue::Stats& render_stats() const;
+
+        // Cull and build draws with compute shaders instead of the CPU path (BVH, occlusion and render queue), off by default
+        void set_gpu_culling(bool enabled);
+        bool gpu_culling() const;
+        GpuCuller::Stats gpu_culling_stats() const;
+
+        // Cull the meshlets of visible meshes by frustum, normal cone and Hi-Z (GPU culling only)
+        void set_meshlet_culling(bool enabled);
+        bool meshlet_culling() const;
+
+        // Rebuild or refit the object BVH and bounding spheres if needed
+        void update_culling_data() const;
 
         Span<const SceneObject> objects() const;
         Span<const PointLight> point_lights() const;
@@ -36,17 +108,102 @@ class Scene : NonMovable {
         void set_sun(glm::vec3 direction, glm::vec3 color = glm::vec3(1.0f));
 
     private:
+        void occlusion_cull(View& view) const;
+        void build_render_queue(View& view) const;
+        void submit(const View& view, RenderQueue::Stats& stats, MaterialPass pass) const;
+        void update_object_buffer() const;
+
+        // Returns no_lod for objects under a pixel
+        static constexpr u32 no_lod = u32(-1);
+        u32 select_lod(u32 object_index, const glm::vec3& camera_position, float pixel_scale, bool orthographic) const;
+
+        void update_gpu_draws() const;
+        // Draws visible after the late phase, or those only visible in the late phase
+        void render_gpu_driven(bool late_only, MaterialPass pass) const;
+        bool use_gpu_culling() const;
+
         std::vector<SceneObject> _objects;
         std::vector<PointLight> _point_lights;
-        std::vector<SceneObject> _light_balls;
-        std::shared_ptr<StaticMesh> _ball;
+
+        SceneGraph _graph;
+        std::vector<u32> _object_nodes;
+        // Objects attached to each node: _node_object_list[_node_object_offsets[n]] to _node_object_list[_node_object_offsets[n + 1]]
+        std::vector<u32> _node_object_offsets;
+        std::vector<u32> _node_object_list;
+        bool _node_objects_dirty = false;
 
         glm::vec3 _sun_direction = glm::vec3(0.2f, 1.0f, 0.1f);
         glm::vec3 _sun_color = glm::vec3(1.0f);
 
-        mutable std::unique_ptr<TypedBuffer<shader::FrameData>> _frameDataBuffer;
-        mutable std::unique_ptr<TypedBuffer<shader::WindowSize>> _windowSizeBuffer;
-        mutable std::unique_ptr<TypedBuffer<shader::PointLight>> _lightBuffer;
+        enum class BVHState {
+            UpToDate,
+            NeedsRefit,
+            NeedsRebuild,
+        };
+
+        mutable BVH _bvh;
+        mutable BVHState _bvh_state = BVHState::NeedsRebuild;
+        mutable std::vector<AABB> _object_bounds;
+        mutable std::vector<u32> _dirty_objects;
+
+        // Object spheres are in BVH order, _object_slots maps object index to sphere slot
+        mutable SphereCuller _object_spheres;
+        mutable std::vector<u32> _object_slots;
+        mutable SphereCuller _light_spheres;
+        mutable std::vector<BoundingSphere> _light_bounds; // Area of influence of every light
+        mutable std::vector<u32> _dirty_lights;
+
+        // Handles are indexed by object / light, moving something only relocates it in its octree
+        mutable LooseOctree _object_octree;
+        mutable std::vector<u32> _object_handles;
+        mutable LooseOctree _light_octree;
+        mutable std::vector<u32> _light_handles;
+        bool _octree_culling = false;
+
+        // Transform and normal matrix of every object, indexed by object. Only moved objects are uploaded.
+        mutable std::unique_ptr<TypedBuffer<shader::ObjectData>> _object_buffer;
+        mutable std::vector<u32> _dirty_object_data;
+        mutable bool _object_buffer_dirty = true;
+
+        // Shared by every light, created on first use
+        mutable std::unique_ptr<StaticMesh> _light_volume;
+        mutable std::unique_ptr<Material> _light_material;
+
+        // Pass, program, material and mesh part of the sort key of each object
+        mutable std::vector<u64> _object_state_keys;
+        bool _sort_render_queue = true;
+        bool _instancing = true;
+        mutable RenderQueue::Stats _render_stats;
+
+        bool _lod_selection = true;
+        float _lod_pixel_error = 1.0f;
+
+        mutable OcclusionCuller _occlusion_culler;
+        bool _occlusion_culling = true;
+
+        // Draws sorted by material, so that each material is a contiguous range of commands
+        struct GpuDrawBucket {
+            const Material* material = nullptr;
+            VertexFormat format = VertexFormat::Full;
+            u32 first = 0;
+            u32 count = 0;
+            // Range of the bucket in the meshlet draws
+            u32 first_meshlet = 0;
+            u32 meshlet_count = 0;
+        };
+
+        mutable std::unique_ptr<GpuCuller> _gpu_culler;
+        mutable std::vector<GpuDrawBucket> _gpu_buckets;
+        mutable std::vector<u32> _gpu_draw_objects; // Object index of every draw
+        mutable std::vector<u32> _gpu_draw_first_lods; // First level of every draw in _gpu_lods
+        mutable std::vector<shader::LodRange> _gpu_lods;
+        mutable std::vector<shader::MeshletData> _gpu_meshlets;
+        mutable std::vector<shader::MeshletDraw> _gpu_meshlet_draws;
+        mutable std::vector<u32> _gpu_draw_meshlet_counts;
+        mutable bool _gpu_objects_dirty = true;
+        mutable bool _gpu_transforms_dirty = false;
+        bool _gpu_culling = false;
+        bool _meshlet_culling = true;
 
         Camera _camera;
 };
@@ -0,0 +1,542 @@
+#include "SceneCache.h"
+
+#include <Material.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace OM3D {
+
+// Arrays are aligned so that they can be read in place from the mapping
+static constexpr size_t array_alignment = 16;
+static constexpr char magic[8] = {'O', 'M', '3', 'D', 'S', 'C', 'N', '\0'};
+
+struct FileArray {
+    u64 offset = 0;
+    u64 count = 0;
+};
+
+struct FileHeader {
+    char magic[8] = {};
+    u32 version = 0;
+    u32 padding = 0;
+    u64 layout_hash = 0;
+    u64 options = 0;
+    u64 source_hash = 0;
+
+    FileArray dependency_names;     // chars, every name ends with a '\0'
+    FileArray dependency_hashes;    // u64
+    FileArray nodes;
+    FileArray meshes;
+    FileArray textures;
+    FileArray materials;
+    FileArray objects;
+    FileArray lights;
+    FileArray occluder_meshes;
+    FileArray occluders;
+};
+
+struct FileNode {
+    u32 node = 0;
+    u32 parent = 0;
+    NodeTransform local;
+};
+
+struct FileMesh {
+    VertexFormat format = VertexFormat::Full;
+    VertexQuantization quantization;
+    AABB aabb;
+    FileArray vertices;             // Vertex or PackedVertex
+    FileArray indices;
+    FileArray lods;
+    FileArray meshlets;
+};
+
+struct FileTexture {
+    glm::uvec2 size = {};
+    ImageFormat format = ImageFormat::RGBA8_UNORM;
+    u32 mip_count = 1;
+    FileArray mips;
+};
+
+struct FileMaterial {
+    u32 albedo = SceneCache::no_index;
+    u32 normal = SceneCache::no_index;
+};
+
+struct FileObject {
+    u32 mesh = 0;
+    u32 material = SceneCache::no_index;
+    u32 node = 0;
+};
+
+struct FileOccluderMesh {
+    FileArray positions;
+    FileArray indices;
+};
+
+struct FileOccluder {
+    u32 object = 0;
+    u32 mesh = 0;
+};
+
+// Catches most changes to the stored types that would be forgotten in the version
+static u64 layout_hash() {
+    u64 h = SceneCache::version;
+    for(const size_t size : {sizeof(FileHeader), sizeof(FileNode), sizeof(FileMesh), sizeof(FileTexture), sizeof(FileMaterial), sizeof(FileObject), sizeof(FileOccluderMesh), sizeof(FileOccluder),
+                             sizeof(Vertex), sizeof(PackedVertex), sizeof(MeshLod), sizeof(Meshlet), sizeof(PointLight)}) {
+        hash_combine(h, u64(size));
+    }
+    return h;
+}
+
+// FNV-1a on 8 byte words with an extra shift, bytes are too slow for scenes of hundreds of MB
+static u64 hash_data(Span<const u8> data) {
+    u64 h = 0xcbf29ce484222325;
+    const size_t words = data.size() / sizeof(u64);
+    for(size_t i = 0; i != words; ++i) {
+        u64 word = 0;
+        std::memcpy(&word, data.data() + i * sizeof(u64), sizeof(u64));
+        h = (h ^ word) * 0x100000001b3;
+        h ^= h >> 29;
+    }
+    for(size_t i = words * sizeof(u64); i != data.size(); ++i) {
+        h = (h ^ data[i]) * 0x100000001b3;
+    }
+    hash_combine(h, u64(data.size()));
+    return h;
+}
+
+static Result<u64> hash_file(const std::string& file_name) {
+    auto file = MappedFile::open(file_name);
+    if(!file.is_ok) {
+        return {false, 0};
+    }
+    return {true, hash_data(file.value->data())};
+}
+
+template<typename T>
+static Span<const T> file_array(Span<const u8> file, const FileArray& array, bool& valid) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    if(array.offset % alignof(T) != 0 || array.offset > file.size() || array.count > (file.size() - array.offset) / sizeof(T)) {
+        valid = false;
+        return {};
+    }
+    return Span<const T>(reinterpret_cast<const T*>(file.data() + array.offset), size_t(array.count));
+}
+
+static std::string dependency_path(const std::string& source_file, const std::string& relative_name) {
+    return (std::filesystem::path(source_file).parent_path() / relative_name).string();
+}
+
+std::string SceneCache::cache_file_name(const std::string& source_file) {
+    return source_file + ".cache";
+}
+
+Result<std::unique_ptr<Scene>> SceneCache::load(const std::string& source_file, u64 options) {
+    const auto cache = read(source_file, options);
+    if(!cache.is_ok) {
+        return {false, {}};
+    }
+    return {true, cache.value.build_scene()};
+}
+
+Result<SceneCache> SceneCache::read(const std::string& source_file, u64 options) {
+    auto mapped = MappedFile::open(cache_file_name(source_file));
+    if(!mapped.is_ok) {
+        return {false, {}};
+    }
+
+    const Span<const u8> file = mapped.value->data();
+    FileHeader header;
+    if(file.size() < sizeof(header)) {
+        return {false, {}};
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+
+    if(std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != version || header.layout_hash != layout_hash() || header.options != options) {
+        return {false, {}};
+    }
+
+    // Every array, every index into another record and every vertex index is checked,
+    // so that an out of date or corrupted cache is only rejected
+    bool valid = true;
+
+    {
+        const auto source_hash = hash_file(source_file);
+        if(!source_hash.is_ok || source_hash.value != header.source_hash) {
+            return {false, {}};
+        }
+
+        const auto names = file_array<char>(file, header.dependency_names, valid);
+        const auto hashes = file_array<u64>(file, header.dependency_hashes, valid);
+        if(!valid || (!names.is_empty() && names[names.size() - 1] != '\0')) {
+            return {false, {}};
+        }
+
+        size_t name_offset = 0;
+        for(const u64 hash : hashes) {
+            if(name_offset >= names.size()) {
+                return {false, {}};
+            }
+            const std::string name = names.data() + name_offset;
+            name_offset += name.size() + 1;
+
+            const auto dependency_hash = hash_file(dependency_path(source_file, name));
+            if(!dependency_hash.is_ok || dependency_hash.value != hash) {
+                return {false, {}};
+            }
+        }
+    }
+
+    const auto nodes = file_array<FileNode>(file, header.nodes, valid);
+    const auto meshes = file_array<FileMesh>(file, header.meshes, valid);
+    const auto textures = file_array<FileTexture>(file, header.textures, valid);
+    const auto materials = file_array<FileMaterial>(file, header.materials, valid);
+    const auto objects = file_array<FileObject>(file, header.objects, valid);
+    const auto lights = file_array<PointLight>(file, header.lights, valid);
+    const auto occluder_meshes = file_array<FileOccluderMesh>(file, header.occluder_meshes, valid);
+    const auto occluders = file_array<FileOccluder>(file, header.occluders, valid);
+    if(!valid) {
+        return {false, {}};
+    }
+
+    SceneCache cache;
+
+    // Parents are always recorded before their children
+    std::unordered_set<u32> node_ids;
+    for(const FileNode& node : nodes) {
+        valid &= node.parent == SceneGraph::no_node || node_ids.count(node.parent);
+        node_ids.insert(node.node);
+        cache._nodes.push_back(NodeRecord{node.node, node.parent, node.local});
+    }
+
+    for(const FileMesh& mesh : meshes) {
+        MeshPayload& payload = cache._meshes.emplace_back();
+        payload.format = mesh.format;
+        payload.quantization = mesh.quantization;
+        payload.aabb = mesh.aabb;
+        if(mesh.format == VertexFormat::Packed) {
+            payload.packed_vertices = file_array<PackedVertex>(file, mesh.vertices, valid);
+        } else {
+            payload.vertices = file_array<Vertex>(file, mesh.vertices, valid);
+        }
+        payload.indices = file_array<u32>(file, mesh.indices, valid);
+        payload.lods = file_array<MeshLod>(file, mesh.lods, valid);
+        payload.meshlets = file_array<Meshlet>(file, mesh.meshlets, valid);
+
+        valid &= mesh.format == VertexFormat::Full || mesh.format == VertexFormat::Packed;
+        const size_t vertex_count = mesh.format == VertexFormat::Packed ? payload.packed_vertices.size() : payload.vertices.size();
+        valid &= std::all_of(payload.indices.begin(), payload.indices.end(), [&](u32 index) { return index < vertex_count; });
+        valid &= !payload.lods.is_empty();
+        for(const MeshLod& lod : payload.lods) {
+            valid &= u64(lod.first_index) + lod.index_count <= payload.indices.size();
+        }
+        for(const Meshlet& meshlet : payload.meshlets) {
+            valid &= u64(meshlet.first_index) + meshlet.index_count <= payload.indices.size();
+        }
+    }
+
+    for(const FileTexture& texture : textures) {
+        TextureRecord& record = cache._textures.emplace_back();
+        record.mips = file_array<u8>(file, texture.mips, valid);
+        record.size = texture.size;
+        record.format = texture.format;
+        record.mip_count = texture.mip_count;
+
+        // Only the formats of imported images, so that the size of the mips can be checked
+        TextureData layout;
+        layout.size = texture.size;
+        layout.format = texture.format;
+        valid &= texture.format == ImageFormat::RGBA8_sRGB || texture.format == ImageFormat::RGBA8_UNORM ||
+                 texture.format == ImageFormat::RGB8_sRGB || texture.format == ImageFormat::RGB8_UNORM;
+        valid &= texture.size.x && texture.size.y && texture.mip_count >= 1 && texture.mip_count <= Texture::mip_levels(texture.size);
+        valid &= valid && layout.mip_offset(texture.mip_count) <= record.mips.size();
+    }
+
+    auto valid_index = [](u32 index, size_t count) {
+        return index == no_index || index < count;
+    };
+    for(const FileMaterial& material : materials) {
+        valid &= valid_index(material.albedo, textures.size()) && valid_index(material.normal, textures.size());
+        cache._materials.push_back(MaterialRecord{material.albedo, material.normal});
+    }
+
+    for(const FileObject& object : objects) {
+        valid &= object.mesh < meshes.size() && valid_index(object.material, materials.size()) && node_ids.count(object.node);
+        cache._objects.push_back(ObjectRecord{object.mesh, object.material, object.node});
+    }
+
+    cache._lights.assign(lights.begin(), lights.end());
+
+    for(const FileOccluderMesh& occluder_mesh : occluder_meshes) {
+        const auto positions = file_array<glm::vec3>(file, occluder_mesh.positions, valid);
+        const auto indices = file_array<u32>(file, occluder_mesh.indices, valid);
+        valid &= std::all_of(indices.begin(), indices.end(), [&](u32 index) { return index < positions.size(); });
+
+        auto mesh = std::make_shared<OcclusionCuller::OccluderMesh>();
+        mesh->positions.assign(positions.begin(), positions.end());
+        mesh->indices.assign(indices.begin(), indices.end());
+        cache._occluder_meshes.push_back(std::move(mesh));
+    }
+
+    for(const FileOccluder& occluder : occluders) {
+        valid &= occluder.object < objects.size() && occluder.mesh < occluder_meshes.size();
+        cache._occluders.push_back(OccluderRecord{occluder.object, occluder.mesh});
+    }
+
+    if(!valid) {
+        return {false, {}};
+    }
+
+    cache._file = std::move(mapped.value);
+    return {true, std::move(cache)};
+}
+
+std::unique_ptr<Scene> SceneCache::build_scene() const {
+    auto scene = std::make_unique<Scene>();
+
+    // Node ids of the cache, mapped to the ids of the new scene
+    std::unordered_map<u32, u32> node_ids;
+    for(const NodeRecord& node : _nodes) {
+        const u32 parent = node.parent == SceneGraph::no_node ? SceneGraph::no_node : node_ids[node.parent];
+        node_ids[node.node] = scene->add_node(parent, node.local);
+    }
+    scene->update_transforms();
+
+    std::vector<std::shared_ptr<StaticMesh>> static_meshes;
+    for(const MeshPayload& payload : _meshes) {
+        static_meshes.push_back(std::make_shared<StaticMesh>(payload));
+    }
+
+    std::vector<std::shared_ptr<Texture>> textures;
+    for(const TextureRecord& texture : _textures) {
+        textures.push_back(std::make_shared<Texture>(texture.mips, texture.size, texture.format, texture.mip_count));
+    }
+
+    auto find_texture = [&](u32 index) {
+        return index == no_index ? nullptr : textures[index];
+    };
+    std::vector<std::shared_ptr<Material>> materials;
+    for(const MaterialRecord& material : _materials) {
+        materials.push_back(Material::from_textures(find_texture(material.albedo), find_texture(material.normal)));
+    }
+
+    for(const ObjectRecord& object : _objects) {
+        const u32 node = node_ids[object.node];
+        auto scene_object = SceneObject(static_meshes[object.mesh], object.material == no_index ? nullptr : materials[object.material]);
+        scene_object.set_transform(scene->graph().world_transform(node));
+        scene->add_object(std::move(scene_object), node);
+    }
+
+    for(const PointLight& light : _lights) {
+        scene->add_light(light);
+    }
+
+    for(const OccluderRecord& occluder : _occluders) {
+        scene->add_occluder(occluder.object, _occluder_meshes[occluder.mesh]);
+    }
+
+    scene->update_culling_data();
+
+    return scene;
+}
+
+u32 SceneCache::mesh_count() const {
+    return u32(_meshes.size());
+}
+
+const MeshPayload& SceneCache::mesh(u32 index) const {
+    return _meshes[index];
+}
+
+u32 SceneCache::texture_count() const {
+    return u32(_textures.size());
+}
+
+Span<const u8> SceneCache::texture_mips(u32 index) const {
+    return _textures[index].mips;
+}
+
+u32 SceneCache::object_count() const {
+    return u32(_objects.size());
+}
+
+u32 SceneCache::occluder_mesh_count() const {
+    return u32(_occluder_meshes.size());
+}
+
+u32 SceneCache::occluder_count() const {
+    return u32(_occluders.size());
+}
+
+void SceneCache::add_dependency(const std::string& relative_name) {
+    _dependencies.push_back(relative_name);
+}
+
+void SceneCache::add_node(u32 node, u32 parent, const NodeTransform& local) {
+    _nodes.push_back(NodeRecord{node, parent, local});
+}
+
+u32 SceneCache::add_mesh(MeshPayload payload) {
+    _meshes.push_back(std::move(payload));
+    return u32(_meshes.size() - 1);
+}
+
+u32 SceneCache::add_texture(const TextureData& data) {
+    _textures.push_back(TextureRecord{Span<const u8>(data.data.get(), data.mip_offset(data.mip_count)), data.size, data.format, data.mip_count});
+    return u32(_textures.size() - 1);
+}
+
+u32 SceneCache::add_material(u32 albedo, u32 normal) {
+    _materials.push_back(MaterialRecord{albedo, normal});
+    return u32(_materials.size() - 1);
+}
+
+void SceneCache::add_object(u32 mesh, u32 material, u32 node) {
+    _objects.push_back(ObjectRecord{mesh, material, node});
+}
+
+void SceneCache::add_light(const PointLight& light) {
+    _lights.push_back(light);
+}
+
+u32 SceneCache::add_occluder_mesh(std::shared_ptr<const OcclusionCuller::OccluderMesh> mesh) {
+    _occluder_meshes.push_back(std::move(mesh));
+    return u32(_occluder_meshes.size() - 1);
+}
+
+void SceneCache::add_occluder(u32 object, u32 occluder_mesh) {
+    _occluders.push_back(OccluderRecord{object, occluder_mesh});
+}
+
+bool SceneCache::write(const std::string& source_file, u64 options) const {
+    FileHeader header;
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.layout_hash = layout_hash();
+    header.options = options;
+
+    std::vector<char> dependency_names;
+    std::vector<u64> dependency_hashes;
+    {
+        const auto source_hash = hash_file(source_file);
+        if(!source_hash.is_ok) {
+            return false;
+        }
+        header.source_hash = source_hash.value;
+
+        for(const std::string& name : _dependencies) {
+            const auto hash = hash_file(dependency_path(source_file, name));
+            if(!hash.is_ok) {
+                return false;
+            }
+            dependency_names.insert(dependency_names.end(), name.begin(), name.end());
+            dependency_names.push_back('\0');
+            dependency_hashes.push_back(hash.value);
+        }
+    }
+
+    const std::string file_name = cache_file_name(source_file);
+    const std::string temp_file_name = file_name + ".tmp";
+    {
+        std::ofstream out(temp_file_name, std::ios::binary | std::ios::trunc);
+        if(!out) {
+            return false;
+        }
+
+        // The header is written last, once every array is placed
+        u64 offset = sizeof(FileHeader);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        auto write_array = [&](auto data) {
+            using T = typename decltype(data)::value_type;
+            static_assert(std::is_trivially_copyable_v<T>);
+
+            static constexpr char zeros[array_alignment] = {};
+            const u64 aligned = (offset + array_alignment - 1) / array_alignment * array_alignment;
+            out.write(zeros, std::streamsize(aligned - offset));
+            out.write(reinterpret_cast<const char*>(data.data()), std::streamsize(data.size() * sizeof(T)));
+            offset = aligned + data.size() * sizeof(T);
+            return FileArray{aligned, u64(data.size())};
+        };
+
+        std::vector<FileMesh> meshes;
+        for(const MeshPayload& payload : _meshes) {
+            FileMesh& mesh = meshes.emplace_back();
+            mesh.format = payload.format;
+            mesh.quantization = payload.quantization;
+            mesh.aabb = payload.aabb;
+            mesh.vertices = payload.format == VertexFormat::Packed ? write_array(payload.packed_vertices) : write_array(payload.vertices);
+            mesh.indices = write_array(payload.indices);
+            mesh.lods = write_array(payload.lods);
+            mesh.meshlets = write_array(payload.meshlets);
+        }
+
+        std::vector<FileTexture> textures;
+        for(const TextureRecord& record : _textures) {
+            FileTexture& texture = textures.emplace_back();
+            texture.size = record.size;
+            texture.format = record.format;
+            texture.mip_count = record.mip_count;
+            texture.mips = write_array(record.mips);
+        }
+
+        std::vector<FileOccluderMesh> occluder_meshes;
+        for(const auto& mesh : _occluder_meshes) {
+            FileOccluderMesh& occluder_mesh = occluder_meshes.emplace_back();
+            occluder_mesh.positions = write_array(Span<const glm::vec3>(mesh->positions));
+            occluder_mesh.indices = write_array(Span<const u32>(mesh->indices));
+        }
+
+        std::vector<FileNode> nodes;
+        for(const NodeRecord& record : _nodes) {
+            nodes.push_back(FileNode{record.node, record.parent, record.local});
+        }
+        std::vector<FileMaterial> materials;
+        for(const MaterialRecord& record : _materials) {
+            materials.push_back(FileMaterial{record.albedo, record.normal});
+        }
+        std::vector<FileObject> objects;
+        for(const ObjectRecord& record : _objects) {
+            objects.push_back(FileObject{record.mesh, record.material, record.node});
+        }
+        std::vector<FileOccluder> occluders;
+        for(const OccluderRecord& record : _occluders) {
+            occluders.push_back(FileOccluder{record.object, record.mesh});
+        }
+
+        header.dependency_names = write_array(Span<const char>(dependency_names));
+        header.dependency_hashes = write_array(Span<const u64>(dependency_hashes));
+        header.nodes = write_array(Span<const FileNode>(nodes));
+        header.meshes = write_array(Span<const FileMesh>(meshes));
+        header.textures = write_array(Span<const FileTexture>(textures));
+        header.materials = write_array(Span<const FileMaterial>(materials));
+        header.objects = write_array(Span<const FileObject>(objects));
+        header.lights = write_array(Span<const PointLight>(_lights));
+        header.occluder_meshes = write_array(Span<const FileOccluderMesh>(occluder_meshes));
+        header.occluders = write_array(Span<const FileOccluder>(occluders));
+
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        if(!out) {
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temp_file_name, file_name, error);
+    if(error) {
+        std::filesystem::remove(temp_file_name, error);
+        return false;
+    }
+    return true;
+}
+
+}
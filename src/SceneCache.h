@@ -0,0 +1,111 @@
+#ifndef SCENECACHE_H
+#define SCENECACHE_H
+
+#include <Scene.h>
+#include <StaticMesh.h>
+#include <Texture.h>
+#include <MappedFile.h>
+
+#include <string>
+#include <vector>
+
+namespace OM3D {
+
+// Binary copy of an imported scene, written next to its source file.
+// Meshes are stored as MeshPayload and textures with all their mips, so that loading maps the file
+// and uploads straight from the mapping, without any parsing or conversion.
+// Caches are keyed by the hashes of the source file, of the files it references, and of the import options.
+// They are ignored, then overwritten by the next import, when any of them or the version changes.
+class SceneCache : NonCopyable {
+    public:
+        // Increment when the file layout or what the importer produces changes
+        static constexpr u32 version = 3;
+
+        static constexpr u32 no_index = u32(-1);
+
+        static std::string cache_file_name(const std::string& source_file);
+
+        // Returns false if there is no cache, or if it is out of date
+        static Result<std::unique_ptr<Scene>> load(const std::string& source_file, u64 options);
+
+        // Maps and validates the cache without touching GL, payloads and texture data point into the mapping
+        static Result<SceneCache> read(const std::string& source_file, u64 options);
+        // Creates the GL objects of a cache returned by read
+        std::unique_ptr<Scene> build_scene() const;
+
+        u32 mesh_count() const;
+        const MeshPayload& mesh(u32 index) const;
+        u32 texture_count() const;
+        Span<const u8> texture_mips(u32 index) const;
+        u32 object_count() const;
+        u32 occluder_mesh_count() const;
+        u32 occluder_count() const;
+
+        // Files read by the import besides the source, relative to the directory of the source
+        void add_dependency(const std::string& relative_name);
+
+        // Everything below is recorded in the order the scene is built.
+        // Data passed by span or in payloads must stay alive until write.
+        void add_node(u32 node, u32 parent, const NodeTransform& local);
+        u32 add_mesh(MeshPayload payload);
+        u32 add_texture(const TextureData& data);
+        // Indices of textures, or no_index
+        u32 add_material(u32 albedo, u32 normal);
+        // Indices of a mesh, a material or no_index, and of a recorded node
+        void add_object(u32 mesh, u32 material, u32 node);
+        void add_light(const PointLight& light);
+        // Shared by every occluder using the same mesh
+        u32 add_occluder_mesh(std::shared_ptr<const OcclusionCuller::OccluderMesh> mesh);
+        // Indices of a recorded object and of an occluder mesh
+        void add_occluder(u32 object, u32 occluder_mesh);
+
+        // Written to a temporary file first, so that an interrupted write never leaves a truncated cache
+        bool write(const std::string& source_file, u64 options) const;
+
+    private:
+        struct NodeRecord {
+            u32 node = 0;
+            u32 parent = 0;
+            NodeTransform local;
+        };
+
+        struct TextureRecord {
+            Span<const u8> mips;
+            glm::uvec2 size = {};
+            ImageFormat format = ImageFormat::RGBA8_UNORM;
+            u32 mip_count = 1;
+        };
+
+        struct MaterialRecord {
+            u32 albedo = no_index;
+            u32 normal = no_index;
+        };
+
+        struct ObjectRecord {
+            u32 mesh = 0;
+            u32 material = no_index;
+            u32 node = 0;
+        };
+
+        struct OccluderRecord {
+            u32 object = 0;
+            u32 mesh = 0;
+        };
+
+        // Set by read, everything points into it
+        std::unique_ptr<MappedFile> _file;
+
+        std::vector<std::string> _dependencies;
+        std::vector<NodeRecord> _nodes;
+        std::vector<MeshPayload> _meshes;
+        std::vector<TextureRecord> _textures;
+        std::vector<MaterialRecord> _materials;
+        std::vector<ObjectRecord> _objects;
+        std::vector<PointLight> _lights;
+        std::vector<std::shared_ptr<const OcclusionCuller::OccluderMesh>> _occluder_meshes;
+        std::vector<OccluderRecord> _occluders;
+};
+
+}
+
+#endif // SCENECACHE_H
@@ -0,0 +1,153 @@
+#include "SceneCache.h"
+#include "SceneGraph.h"
+
+#include <benchmarks.h>
+
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace OM3D {
+
+template<typename T>
+static bool same_bytes(Span<const T> a, Span<const T> b) {
+    return a.size() == b.size() && (a.is_empty() || std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+}
+
+static void write_file(const std::string& file_name, Span<const u8> data) {
+    std::ofstream out(file_name, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(data.data()), std::streamsize(data.size()));
+}
+
+void bench_scene_cache() {
+    std::cout << "Scene cache" << std::endl;
+
+    // No GL context here: meshes and textures are only written, mapped and validated, not uploaded
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "om3d_scene_cache_bench";
+    std::filesystem::create_directories(directory);
+    DEFER(std::filesystem::remove_all(directory));
+
+    const std::string source_file = (directory / "scene.glb").string();
+    const std::string dependency = "scene.bin";
+    const std::string dependency_file = (directory / dependency).string();
+
+    std::mt19937 rng(0x5EED);
+    std::vector<u8> source(4 * 1024 * 1024);
+    std::generate(source.begin(), source.end(), [&] { return u8(rng()); });
+    write_file(source_file, source);
+    write_file(dependency_file, Span<const u8>(source.data(), 1024));
+
+    // Same CPU work as an import, cached meshes skip all of it
+    const u32 mesh_count = 8;
+    std::vector<MeshData> meshes;
+    std::vector<TextureData> textures;
+    const double import_time = time_ms([&] {
+        for(u32 i = 0; i != mesh_count; ++i) {
+            MeshData& mesh = meshes.emplace_back(bumpy_sphere(4));
+            mesh.optimize();
+            mesh.build_meshlets();
+            mesh.generate_lods();
+        }
+        for(u32 i = 0; i != 4; ++i) {
+            TextureData& texture = textures.emplace_back();
+            texture.size = glm::uvec2(512);
+            texture.format = i % 2 ? ImageFormat::RGBA8_UNORM : ImageFormat::RGB8_sRGB;
+            texture.data = std::make_unique<u8[]>(texture.mip_offset(1));
+            std::generate_n(texture.data.get(), texture.mip_offset(1), [&] { return u8(rng()); });
+            texture.generate_mips();
+        }
+    });
+
+    const u64 options = 7;
+    SceneCache cache;
+    cache.add_dependency(dependency);
+    cache.add_node(0, SceneGraph::no_node, NodeTransform{});
+    for(u32 i = 0; i != mesh_count; ++i) {
+        cache.add_node(i + 1, 0, NodeTransform{glm::vec3(float(i), 0.0f, 0.0f)});
+        cache.add_mesh(MeshPayload::from_mesh_data(meshes[i], i % 2 ? VertexFormat::Packed : VertexFormat::Full));
+    }
+    for(const TextureData& texture : textures) {
+        cache.add_texture(texture);
+    }
+    cache.add_material(0, 1);
+    cache.add_material(SceneCache::no_index, SceneCache::no_index);
+    for(u32 i = 0; i != mesh_count; ++i) {
+        cache.add_object(i, i % 3 == 2 ? SceneCache::no_index : i % 2, i + 1);
+    }
+    cache.add_light(PointLight());
+    {
+        // Two objects sharing their occluder geometry
+        auto occluder_mesh = std::make_shared<OcclusionCuller::OccluderMesh>();
+        for(const Vertex& vertex : meshes[0].vertices) {
+            occluder_mesh->positions.push_back(vertex.position);
+        }
+        occluder_mesh->indices = meshes[0].indices;
+        const u32 occluder_mesh_index = cache.add_occluder_mesh(std::move(occluder_mesh));
+        cache.add_occluder(0, occluder_mesh_index);
+        cache.add_occluder(1, occluder_mesh_index);
+    }
+
+    bool written = false;
+    const double write_time = time_ms([&] { written = cache.write(source_file, options); });
+    const size_t file_size = size_t(std::filesystem::file_size(SceneCache::cache_file_name(source_file)));
+
+    Result<SceneCache> read = {false, {}};
+    const double read_time = time_ms([&] { read = SceneCache::read(source_file, options); });
+
+    // Everything read must be what was written
+    bool valid = written && read.is_ok && read.value.mesh_count() == mesh_count && read.value.texture_count() == textures.size() && read.value.object_count() == mesh_count;
+    valid &= read.is_ok && read.value.occluder_mesh_count() == 1 && read.value.occluder_count() == 2;
+    for(u32 i = 0; valid && i != mesh_count; ++i) {
+        const MeshPayload& expected = cache.mesh(i);
+        const MeshPayload& mesh = read.value.mesh(i);
+        valid &= mesh.format == expected.format;
+        valid &= same_bytes(mesh.vertices, expected.vertices) && same_bytes(mesh.packed_vertices, expected.packed_vertices);
+        valid &= same_bytes(mesh.indices, expected.indices) && same_bytes(mesh.lods, expected.lods) && same_bytes(mesh.meshlets, expected.meshlets);
+    }
+    for(u32 i = 0; valid && i != textures.size(); ++i) {
+        valid &= same_bytes(read.value.texture_mips(i), cache.texture_mips(i));
+    }
+
+    // Caches must be rejected when anything they were built from changes, or when they are damaged
+    const u32 checks = 5;
+    u32 rejected = 0;
+    rejected += !SceneCache::read(source_file, options + 1).is_ok;
+    {
+        std::vector<u8> changed = source;
+        changed[512] ^= 1;
+        write_file(dependency_file, Span<const u8>(changed.data(), 1024));
+        rejected += !SceneCache::read(source_file, options).is_ok;
+        write_file(dependency_file, Span<const u8>(source.data(), 1024));
+
+        write_file(source_file, changed);
+        rejected += !SceneCache::read(source_file, options).is_ok;
+        write_file(source_file, source);
+    }
+    valid &= SceneCache::read(source_file, options).is_ok;
+    {
+        std::vector<u8> truncated(file_size / 2);
+        std::ifstream(SceneCache::cache_file_name(source_file), std::ios::binary).read(reinterpret_cast<char*>(truncated.data()), std::streamsize(truncated.size()));
+        write_file(SceneCache::cache_file_name(source_file), truncated);
+        rejected += !SceneCache::read(source_file, options).is_ok;
+    }
+    {
+        // Valid layout, but an index past the last vertex
+        MeshData broken = meshes[0];
+        broken.indices[0] = u32(broken.vertices.size());
+        SceneCache broken_cache;
+        broken_cache.add_mesh(MeshPayload::from_mesh_data(broken, VertexFormat::Full));
+        broken_cache.write(source_file, options);
+        rejected += !SceneCache::read(source_file, options).is_ok;
+    }
+    valid &= rejected == checks;
+
+    std::cout << "  " << mesh_count << " meshes and " << textures.size() << " textures: import " << import_time << "ms, "
+              << "cache write " << write_time << "ms, cache read " << read_time << "ms (" << std::setprecision(1) << float(file_size) / float(1024 * 1024) << "MB, "
+              << "x" << import_time / read_time << "), " << rejected << "/" << checks << " stale or damaged caches rejected" << std::setprecision(3) << check_result(valid) << std::endl;
+}
+
+}
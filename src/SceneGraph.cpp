@@ -0,0 +1,268 @@
+#include "SceneGraph.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+
+namespace OM3D {
+
+// Nodes of a level updated by each task
+static constexpr u32 batch_size = 1024;
+
+glm::mat4 NodeTransform::matrix() const {
+    return glm::translate(glm::mat4(1.0f), translation) * glm::mat4_cast(rotation) * glm::scale(glm::mat4(1.0f), scale);
+}
+
+u32 SceneGraph::add_node(u32 parent, const NodeTransform& local) {
+    ALWAYS_ASSERT(parent == no_node || parent < _slots.size(), "Invalid parent node");
+
+    const u32 id = u32(_slots.size());
+    const u32 slot = u32(_ids.size());
+    _slots.push_back(slot);
+    _ids.push_back(id);
+    _parents.push_back(parent == no_node ? no_node : _slots[parent]);
+    _first_child.push_back(0);
+    _child_count.push_back(0);
+    _local.push_back(local);
+    _local_bounds.push_back(AABB{});
+    _world.push_back(glm::mat4(1.0f));
+    _world_bounds.push_back(AABB{});
+    _dirty.push_back(0);
+    _visited.push_back(0);
+
+    // New nodes are appended, the breadth-first order is restored by the next update
+    _layout_dirty = true;
+    mark_dirty(slot);
+    return id;
+}
+
+void SceneGraph::set_local_transform(u32 node, const NodeTransform& local) {
+    DEBUG_ASSERT(node < _slots.size());
+    const u32 slot = _slots[node];
+    _local[slot] = local;
+    mark_dirty(slot);
+}
+
+const NodeTransform& SceneGraph::local_transform(u32 node) const {
+    DEBUG_ASSERT(node < _slots.size());
+    return _local[_slots[node]];
+}
+
+void SceneGraph::set_local_bounds(u32 node, const AABB& bounds) {
+    DEBUG_ASSERT(node < _slots.size());
+    const u32 slot = _slots[node];
+    _local_bounds[slot] = bounds;
+    mark_dirty(slot);
+}
+
+const AABB& SceneGraph::local_bounds(u32 node) const {
+    DEBUG_ASSERT(node < _slots.size());
+    return _local_bounds[_slots[node]];
+}
+
+u32 SceneGraph::parent(u32 node) const {
+    DEBUG_ASSERT(node < _slots.size());
+    const u32 parent_slot = _parents[_slots[node]];
+    return parent_slot == no_node ? no_node : _ids[parent_slot];
+}
+
+size_t SceneGraph::size() const {
+    return _slots.size();
+}
+
+const glm::mat4& SceneGraph::world_transform(u32 node) const {
+    DEBUG_ASSERT(node < _slots.size());
+    return _world[_slots[node]];
+}
+
+const AABB& SceneGraph::world_bounds(u32 node) const {
+    DEBUG_ASSERT(node < _slots.size());
+    return _world_bounds[_slots[node]];
+}
+
+Span<const u32> SceneGraph::changed_nodes() const {
+    return _changed_nodes;
+}
+
+const SceneGraph::Stats& SceneGraph::stats() const {
+    return _stats;
+}
+
+void SceneGraph::mark_dirty(u32 slot) {
+    if(!_dirty[slot]) {
+        _dirty[slot] = 1;
+        _dirty_nodes.push_back(_ids[slot]);
+    }
+}
+
+void SceneGraph::rebuild_layout() {
+    const u32 node_count = u32(_ids.size());
+
+    // Children of every slot, in slot order
+    std::vector<u32> child_offsets(node_count + 1, 0);
+    for(const u32 parent : _parents) {
+        if(parent != no_node) {
+            ++child_offsets[parent + 1];
+        }
+    }
+    for(u32 i = 0; i != node_count; ++i) {
+        child_offsets[i + 1] += child_offsets[i];
+    }
+    std::vector<u32> children(child_offsets[node_count]);
+    {
+        std::vector<u32> cursors(child_offsets.begin(), child_offsets.end() - 1);
+        for(u32 i = 0; i != node_count; ++i) {
+            if(_parents[i] != no_node) {
+                children[cursors[_parents[i]]++] = i;
+            }
+        }
+    }
+
+    // Breadth-first traversal from the roots, one level at a time
+    std::vector<u32> order;
+    order.reserve(node_count);
+    for(u32 i = 0; i != node_count; ++i) {
+        if(_parents[i] == no_node) {
+            order.push_back(i);
+        }
+    }
+
+    _levels.clear();
+    for(size_t level_begin = 0; level_begin != order.size();) {
+        const size_t level_end = order.size();
+        _levels.push_back(IndexRange{u32(level_begin), u32(level_end - level_begin)});
+        for(size_t i = level_begin; i != level_end; ++i) {
+            order.insert(order.end(), children.begin() + child_offsets[order[i]], children.begin() + child_offsets[order[i] + 1]);
+        }
+        level_begin = level_end;
+    }
+    DEBUG_ASSERT(order.size() == node_count);
+
+    std::vector<u32> new_slots(node_count);
+    for(u32 i = 0; i != node_count; ++i) {
+        new_slots[order[i]] = i;
+    }
+
+    auto permute = [&](auto& values) {
+        std::remove_reference_t<decltype(values)> permuted(node_count);
+        for(u32 i = 0; i != node_count; ++i) {
+            permuted[i] = values[order[i]];
+        }
+        values.swap(permuted);
+    };
+
+    permute(_ids);
+    permute(_local);
+    permute(_local_bounds);
+    permute(_world);
+    permute(_world_bounds);
+    permute(_dirty);
+    permute(_visited);
+
+    for(u32 i = 0; i != node_count; ++i) {
+        const u32 old_slot = order[i];
+        const u32 child_count = child_offsets[old_slot + 1] - child_offsets[old_slot];
+        _child_count[i] = child_count;
+        // Siblings were queued together, so they are contiguous
+        _first_child[i] = child_count ? new_slots[children[child_offsets[old_slot]]] : 0;
+    }
+
+    std::vector<u32> parents(node_count);
+    for(u32 i = 0; i != node_count; ++i) {
+        const u32 parent = _parents[order[i]];
+        parents[i] = parent == no_node ? no_node : new_slots[parent];
+    }
+    _parents.swap(parents);
+
+    for(u32 i = 0; i != node_count; ++i) {
+        _slots[_ids[i]] = i;
+    }
+
+    _layout_dirty = false;
+}
+
+void SceneGraph::update_node(u32 slot) {
+    const glm::mat4 local = _local[slot].matrix();
+    const u32 parent = _parents[slot];
+    _world[slot] = parent == no_node ? local : _world[parent] * local;
+    _world_bounds[slot] = _local_bounds[slot].transformed(_world[slot]);
+    _dirty[slot] = 0;
+}
+
+void SceneGraph::update(ThreadPool& pool) {
+    if(_layout_dirty) {
+        rebuild_layout();
+    }
+
+    _changed_nodes.clear();
+    _stats = {};
+    _stats.nodes = u32(_ids.size());
+    _stats.levels = u32(_levels.size());
+
+    if(_dirty_nodes.empty()) {
+        return;
+    }
+
+    if(++_update_stamp == 0) {
+        std::fill(_visited.begin(), _visited.end(), 0);
+        _update_stamp = 1;
+    }
+
+    // Flagged nodes in layout order, so they can be picked up level by level
+    std::vector<u32> dirty_slots(_dirty_nodes.size());
+    for(size_t i = 0; i != _dirty_nodes.size(); ++i) {
+        dirty_slots[i] = _slots[_dirty_nodes[i]];
+    }
+    std::sort(dirty_slots.begin(), dirty_slots.end());
+    _dirty_nodes.clear();
+
+    // The frontier holds the nodes of the current level to update: children of updated nodes and flagged nodes
+    _frontier.clear();
+    size_t next_dirty = 0;
+    for(const IndexRange& level : _levels) {
+        const u32 level_end = level.first + level.count;
+        for(; next_dirty != dirty_slots.size() && dirty_slots[next_dirty] < level_end; ++next_dirty) {
+            const u32 slot = dirty_slots[next_dirty];
+            if(_visited[slot] != _update_stamp) {
+                _visited[slot] = _update_stamp;
+                _frontier.push_back(slot);
+            }
+        }
+
+        if(_frontier.empty()) {
+            if(next_dirty == dirty_slots.size()) {
+                break;
+            }
+            continue;
+        }
+
+        // Parents are all up to date, nodes of a level are independent
+        const u32 frontier_size = u32(_frontier.size());
+        if(frontier_size >= parallel_threshold && pool.thread_count() > 1) {
+            pool.parallel_for((frontier_size + batch_size - 1) / batch_size, [&](u32 batch) {
+                const u32 end = std::min(frontier_size, (batch + 1) * batch_size);
+                for(u32 i = batch * batch_size; i != end; ++i) {
+                    update_node(_frontier[i]);
+                }
+            });
+        } else {
+            for(const u32 slot : _frontier) {
+                update_node(slot);
+            }
+        }
+
+        _next_frontier.clear();
+        for(const u32 slot : _frontier) {
+            _changed_nodes.push_back(_ids[slot]);
+            for(u32 child = _first_child[slot]; child != _first_child[slot] + _child_count[slot]; ++child) {
+                _visited[child] = _update_stamp;
+                _next_frontier.push_back(child);
+            }
+        }
+        _frontier.swap(_next_frontier);
+    }
+
+    _stats.updated = u32(_changed_nodes.size());
+}
+
+}
@@ -0,0 +1,99 @@
+#ifndef SCENEGRAPH_H
+#define SCENEGRAPH_H
+
+#include <Bounds.h>
+#include <ThreadPool.h>
+
+#include <glm/gtc/quaternion.hpp>
+
+#include <vector>
+
+namespace OM3D {
+
+struct NodeTransform {
+    glm::vec3 translation = glm::vec3(0.0f);
+    glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    glm::vec3 scale = glm::vec3(1.0f);
+
+    glm::mat4 matrix() const;
+};
+
+// Transform hierarchy stored breadth-first in flat arrays, so that every level is a contiguous range
+// and the children of a node are contiguous. Nodes are identified by ids that stay valid when the layout changes.
+// Changing a local transform only flags the node, update() then recomputes the flagged subtrees level by level.
+class SceneGraph {
+    public:
+        static constexpr u32 no_node = u32(-1);
+
+        // Below this many nodes to update in a level, splitting the work across threads isn't worth it
+        static constexpr u32 parallel_threshold = 4 * 1024;
+
+        struct Stats {
+            u32 nodes = 0;
+            u32 levels = 0;
+            u32 updated = 0; // Nodes recomputed by the last update
+        };
+
+        SceneGraph() = default;
+
+        // Parent must already exist
+        u32 add_node(u32 parent, const NodeTransform& local = {});
+
+        void set_local_transform(u32 node, const NodeTransform& local);
+        const NodeTransform& local_transform(u32 node) const;
+
+        // Bounds of what the node holds, in node space
+        void set_local_bounds(u32 node, const AABB& bounds);
+        const AABB& local_bounds(u32 node) const;
+
+        u32 parent(u32 node) const;
+        size_t size() const;
+
+        // Recompute the world transforms and bounds of the flagged subtrees
+        void update(ThreadPool& pool = ThreadPool::global());
+
+        // Only up to date after update()
+        const glm::mat4& world_transform(u32 node) const;
+        const AABB& world_bounds(u32 node) const;
+
+        // Nodes whose world transform was recomputed by the last update, level by level
+        Span<const u32> changed_nodes() const;
+
+        const Stats& stats() const;
+
+    private:
+        void mark_dirty(u32 slot);
+        void rebuild_layout();
+        void update_node(u32 slot);
+
+        // Indexed by node id
+        std::vector<u32> _slots;
+
+        // Indexed by slot, in breadth-first order once the layout is up to date
+        std::vector<u32> _ids;
+        std::vector<u32> _parents;       // Slot of the parent
+        std::vector<u32> _first_child;   // Slot of the first child, children are contiguous
+        std::vector<u32> _child_count;
+        std::vector<NodeTransform> _local;
+        std::vector<AABB> _local_bounds;
+        std::vector<glm::mat4> _world;
+        std::vector<AABB> _world_bounds;
+        std::vector<u8> _dirty;
+        std::vector<u32> _visited;       // Update stamp, to not queue a node twice
+
+        std::vector<IndexRange> _levels;
+        bool _layout_dirty = false;
+
+        std::vector<u32> _dirty_nodes;   // Node ids
+        std::vector<u32> _changed_nodes; // Node ids
+        u32 _update_stamp = 0;
+
+        std::vector<u32> _frontier;
+        std::vector<u32> _next_frontier;
+
+        Stats _stats;
+};
+
+}
+
+#endif // SCENEGRAPH_H
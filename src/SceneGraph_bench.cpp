@@ -0,0 +1,85 @@
+#include "SceneGraph.h"
+#include "ThreadPool.h"
+
+#include <benchmarks.h>
+
+#include <iostream>
+#include <iomanip>
+#include <random>
+
+namespace OM3D {
+
+void bench_scene_graph() {
+    std::cout << "Scene graph propagation (" << ThreadPool::global().thread_count() << " threads)" << std::endl;
+
+    const u32 count = 100000;
+    const u32 moving = count / 100;
+
+    std::mt19937 rng(0x5EED);
+    std::uniform_real_distribution<float> offset(-10.0f, 10.0f);
+    std::uniform_real_distribution<float> angle(-3.14f, 3.14f);
+
+    auto random_transform = [&] {
+        NodeTransform transform;
+        transform.translation = glm::vec3(offset(rng), offset(rng), offset(rng));
+        transform.rotation = glm::angleAxis(angle(rng), glm::normalize(glm::vec3(offset(rng), offset(rng), 1.0f)));
+        return transform;
+    };
+
+    // Random tree with about 4 children per node, parents are always created before their children
+    SceneGraph graph;
+    std::vector<u32> parents(count, SceneGraph::no_node);
+    std::vector<NodeTransform> locals(count);
+    for(u32 i = 0; i != count; ++i) {
+        if(i) {
+            parents[i] = std::uniform_int_distribution<u32>(i / 5, (i - 1) / 3)(rng);
+        }
+        locals[i] = random_transform();
+        graph.add_node(parents[i], locals[i]);
+        graph.set_local_bounds(i, AABB{glm::vec3(-1.0f), glm::vec3(1.0f)});
+    }
+    graph.update();
+
+    // Same nodes moving in both runs
+    std::vector<u32> moved(moving);
+    std::uniform_int_distribution<u32> node(0, count - 1);
+
+    const u32 frames = 20;
+    u32 updated = 0;
+    const double incremental = time_ms([&] {
+        for(u32& index : moved) {
+            index = node(rng);
+            locals[index] = random_transform();
+            graph.set_local_transform(index, locals[index]);
+        }
+        graph.update();
+        updated += graph.stats().updated;
+    }, frames);
+
+    // Everything, as if the transforms were flattened again
+    std::vector<glm::mat4> world(count);
+    const double full = time_ms([&] {
+        for(u32 i = 0; i != count; ++i) {
+            const glm::mat4 local = locals[i].matrix();
+            world[i] = parents[i] == SceneGraph::no_node ? local : world[parents[i]] * local;
+        }
+    }, frames);
+
+    bool valid = true;
+    for(u32 i = 0; i != count; ++i) {
+        valid &= graph.world_transform(i) == world[i];
+        valid &= graph.parent(i) == parents[i];
+    }
+
+    // Moving a root updates everything, in parallel for the largest levels
+    graph.set_local_transform(0, random_transform());
+    const double all = time_ms([&] { graph.update(); });
+    valid &= graph.stats().updated == count;
+
+    std::cout << "  " << count << " nodes in " << graph.stats().levels << " levels, " << moving << " moving: "
+              << incremental << "ms (" << updated / frames << " nodes updated), "
+              << "full recompute " << full << "ms, root moving " << all << "ms"
+              << check_result(valid) << std::endl;
+}
+
+}
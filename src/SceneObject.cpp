@@ -2,6 +2,8 @@
 
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <algorithm>
+
 namespace OM3D {
 
 SceneObject::SceneObject(std::shared_ptr<StaticMesh> mesh, std::shared_ptr<Material> material) :
@@ -9,14 +11,13 @@ SceneObject::SceneObject(std::shared_ptr<StaticMesh> mesh, std::shared_ptr<Mater
     _material(std::move(material)) {
 }
 
-void SceneObject::render() const {
+void SceneObject::render(u32 first_instance) const {
     if(!_material || !_mesh) {
         return;
     }
 
-    _material->set_uniform(HASH("model"), transform());
     _material->bind();
-    _mesh->draw();
+    _mesh->draw(first_instance);
 }
 
 void SceneObject::set_transform(const glm::mat4& tr) {
@@ -27,8 +28,28 @@ const glm::mat4& SceneObject::transform() const {
     return _transform;
 }
 
-const std::shared_ptr<StaticMesh> SceneObject::getMesh() const {
+const std::shared_ptr<StaticMesh>& SceneObject::getMesh() const {
     return _mesh;
 }
 
+const std::shared_ptr<Material>& SceneObject::material() const {
+    return _material;
+}
+
+AABB SceneObject::world_aabb() const {
+    if(!_mesh) {
+        return AABB{};
+    }
+    return _mesh->aabb().transformed(_transform);
+}
+
+BoundingSphere SceneObject::world_sphere() const {
+    if(!_mesh) {
+        return BoundingSphere{};
+    }
+
+    const float max_scale = std::max({glm::length(glm::vec3(_transform[0])), glm::length(glm::vec3(_transform[1])), glm::length(glm::vec3(_transform[2]))});
+    return BoundingSphere{glm::vec3(_transform * glm::vec4(_mesh->getCenter(), 1.0f)), _mesh->getRadius() * max_scale};
+}
+
 }
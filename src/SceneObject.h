@@ -15,12 +15,17 @@ class SceneObject {
     public:
         SceneObject(std::shared_ptr<StaticMesh> mesh = nullptr, std::shared_ptr<Material> material = nullptr);
 
-        void render() const;
+        // The transform is read from the object buffer, at the index given by the object index attribute for first_instance
+        void render(u32 first_instance) const;
 
         void set_transform(const glm::mat4& tr);
         const glm::mat4& transform() const;
 
-        const std::shared_ptr<StaticMesh> getMesh() const;
+        const std::shared_ptr<StaticMesh>& getMesh() const;
+        const std::shared_ptr<Material>& material() const;
+
+        AABB world_aabb() const;
+        BoundingSphere world_sphere() const;
 
     private:
         glm::mat4 _transform = glm::mat4(1.0f);
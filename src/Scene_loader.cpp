@@ -1,11 +1,15 @@
 #include "Scene.h"
 #include "StaticMesh.h"
+#include "ImportPipeline.h"
+#include "SceneCache.h"
 
 #include <glm/gtc/quaternion.hpp>
 
 #include <utils.h>
 
+#include <algorithm>
 #include <iostream>
+#include <map>
 
 #ifdef __GNUC__
 #pragma GCC diagnostic push
@@ -24,6 +28,10 @@
 namespace OM3D {
 
 bool display_gltf_loading_warnings = false;
+// Reload scenes from their binary cache, written after every import that didn't find one
+bool scene_cache_enabled = true;
+// Format of the vertices of loaded meshes
+VertexFormat gltf_vertex_format = VertexFormat::Full;
 
 static size_t component_count(int type) {
     switch(type) {
@@ -156,7 +164,12 @@ static bool decode_index_buffer(const tinygltf::Model& gltf, const tinygltf::Acc
     return true;
 }
 
-static Result<MeshData> build_mesh_data(const tinygltf::Model& gltf, const tinygltf::Primitive& prim) {
+static float round_2(float x) {
+    return std::round(x * 100.0f) / 100.0f;
+}
+
+// Vertices and indices as stored in the file
+static Result<MeshData> decode_mesh_data(const tinygltf::Model& gltf, const tinygltf::Primitive& prim) {
     std::vector<Vertex> vertices;
     for(auto&& [name, id] : prim.attributes) {
         tinygltf::Accessor accessor = gltf.accessors[id];
@@ -197,167 +210,81 @@ static Result<MeshData> build_mesh_data(const tinygltf::Model& gltf, const tinyg
         }
     }
 
-    return {true, MeshData{std::move(vertices), std::move(indices)}};
+    return {true, MeshData{std::move(vertices), std::move(indices), {}, {}, {}}};
 }
 
-static Result<TextureData> build_texture_data(const tinygltf::Image& image, bool as_sRGB) {
-    if(image.bits != 8 && image.pixel_type != TINYGLTF_COMPONENT_TYPE_BYTE && image.pixel_type != TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) {
-        std::cerr << "Unsupported image format (pixel type)" << std::endl;
-        return {false, {}};
-    }
+// Size of the mesh in the geometry buffer, every level and the meshlets included
+static size_t geometry_bytes(const StaticMesh& mesh) {
+    const MeshRange& range = mesh.range();
+    const size_t vertex_size = range.format == VertexFormat::Packed ? sizeof(PackedVertex) : sizeof(Vertex);
+    return range.vertex_count * vertex_size + range.index_count * sizeof(u32);
+}
 
-    ImageFormat format = ImageFormat::RGBA8_UNORM;
-    switch(image.component) {
-        case 3:
-            format = as_sRGB ? ImageFormat::RGB8_sRGB : ImageFormat::RGB8_UNORM;
-        break;
+static double to_mb(size_t bytes) {
+    return std::round(double(bytes) / (1024.0 * 1024.0) * 100.0) / 100.0;
+}
 
-        case 4:
-            format = as_sRGB ? ImageFormat::RGBA8_sRGB : ImageFormat::RGBA8_UNORM;
-        break;
+static double to_ms(double seconds) {
+    return std::round(seconds * 1000.0 * 100.0) / 100.0;
+}
 
-        default:
-            std::cerr << "Unsupported image format (components)" << std::endl;
-            return {false, {}};
+// Images are decoded by the import pipeline, and only if a material uses them: keep them encoded
+static bool keep_encoded_image(tinygltf::Image* image, const int, std::string*, std::string*, int, int, const unsigned char* bytes, int size, void*) {
+    image->image.assign(bytes, bytes + size);
+    return true;
+}
+
+// Returns the image of the texture, or -1
+template<typename T>
+static int texture_image(const tinygltf::Model& gltf, const T& texture_info) {
+    if(texture_info.texCoord != 0) {
+        std::cerr << "Unsupported texture coordinate channel (" << texture_info.texCoord << ")" << std::endl;
+        return -1;
     }
 
-    auto data = std::make_unique<u8[]>(image.image.size());
-    std::copy(image.image.begin(), image.image.end(), data.get());
+    if(texture_info.index < 0) {
+        return -1;
+    }
 
-    return {true, TextureData{std::move(data), glm::uvec2(image.width, image.height), format}};
+    return gltf.textures[texture_info.index].source;
 }
 
 
-static glm::mat4 parse_node_matrix(const tinygltf::Node& node) {
-    glm::vec3 translation(0.0f, 0.0f, 0.0f);
+static NodeTransform parse_node_transform(const tinygltf::Node& node) {
+    NodeTransform transform;
     for(u32 k = 0; k != node.translation.size(); ++k) {
-        translation[k] = float(node.translation[k]);
+        transform.translation[k] = float(node.translation[k]);
     }
 
-    glm::vec3 scale(1.0f, 1.0f, 1.0f);
     for(u32 k = 0; k != node.scale.size(); ++k) {
-        scale[k] = float(node.scale[k]);
+        transform.scale[k] = float(node.scale[k]);
     }
 
-    glm::vec4 rotation(0.0f, 0.0f, 0.0f, 1.0f);
-    for(u32 k = 0; k != node.rotation.size(); ++k) {
-        rotation[k] = float(node.rotation[k]);
+    if(node.rotation.size() == 4) {
+        transform.rotation = glm::quat(float(node.rotation[3]), float(node.rotation[0]), float(node.rotation[1]), float(node.rotation[2]));
     }
 
-    const glm::tquat<float> q(rotation.w, rotation.x, rotation.y, rotation.z);
-    return glm::translate(glm::mat4(1.0f), translation) * glm::mat4_cast(q) * glm::scale(glm::mat4(1.0f), scale);
+    return transform;
 }
 
-static glm::mat4 base_transform() {
-    return glm::mat4(1.0f);
+static NodeTransform base_transform() {
+    return NodeTransform{};
 }
 
-static void parse_node_transforms(int node_index, const tinygltf::Model& gltf, std::unordered_map<int, glm::mat4>& node_transforms, const glm::mat4& parent_transform = base_transform()) {
+static void add_graph_nodes(int node_index, const tinygltf::Model& gltf, Scene& scene, SceneCache& cache, std::vector<u32>& graph_nodes, u32 parent) {
     const tinygltf::Node& node = gltf.nodes[node_index];
-    const glm::mat4 transform = parent_transform * parse_node_matrix(node);
-    node_transforms[node_index] = transform;
+    const NodeTransform transform = parse_node_transform(node);
+    const u32 graph_node = scene.add_node(parent, transform);
+    cache.add_node(graph_node, parent, transform);
+    graph_nodes[node_index] = graph_node;
     for(int child : node.children)  {
-        parse_node_transforms(child, gltf, node_transforms, transform);
-    }
-}
-
-static void compute_tangents(MeshData& mesh) {
-    for(Vertex& vert : mesh.vertices) {
-        vert.tangent_bitangent_sign = glm::vec4(0.0f, 0.0f, 0.0f, 0.0f);
-    }
-
-    for(size_t i = 0; i < mesh.indices.size(); i += 3) {
-        const u32 tri[] = {
-            mesh.indices[i + 0],
-            mesh.indices[i + 1],
-            mesh.indices[i + 2]
-        };
-
-        const glm::vec3 edges[] = {
-            mesh.vertices[tri[1]].position - mesh.vertices[tri[0]].position,
-            mesh.vertices[tri[2]].position - mesh.vertices[tri[0]].position
-        };
-
-        const glm::vec2 uvs[] = {
-            mesh.vertices[tri[0]].uv,
-            mesh.vertices[tri[1]].uv,
-            mesh.vertices[tri[2]].uv
-        };
-
-        const float dt[] = {
-            uvs[1].y - uvs[0].y,
-            uvs[2].y - uvs[0].y
-        };
-
-        const glm::vec3 tangent = -glm::normalize((edges[0] * dt[1]) - (edges[1] * dt[0]));
-        mesh.vertices[tri[0]].tangent_bitangent_sign += glm::vec4(tangent, 0.0f);
-        mesh.vertices[tri[1]].tangent_bitangent_sign += glm::vec4(tangent, 0.0f);
-        mesh.vertices[tri[2]].tangent_bitangent_sign += glm::vec4(tangent, 0.0f);
-    }
-
-    for(Vertex& vert : mesh.vertices) {
-        const glm::vec3 tangent = vert.tangent_bitangent_sign;
-        vert.tangent_bitangent_sign = glm::vec4(glm::normalize(tangent), 1.0f);
+        add_graph_nodes(child, gltf, scene, cache, graph_nodes, graph_node);
     }
 }
 
-
-Result<std::shared_ptr<StaticMesh>> make_ball(const std::string& file_name) {
-    const double time = program_time();
-    DEFER(std::cout << file_name << " loaded in " << std::round((program_time() - time) * 100.0) / 100.0 << "s" << std::endl);
-
-    tinygltf::TinyGLTF ctx;
-    tinygltf::Model gltf;
-
-    {
-        std::string err, warn;
-        const bool is_ascii = ends_with(file_name, ".gltf");
-        const bool ok = is_ascii
-            ? ctx.LoadASCIIFromFile(&gltf, &err, &warn, file_name)
-            : ctx.LoadBinaryFromFile(&gltf, &err, &warn, file_name);
-
-        if (!ok) {
-            if (!err.empty()) std::cerr << "Error while loading GLTF: " << err << std::endl;
-            if (!warn.empty()) std::cerr << "Warning while loading GLTF: " << warn << std::endl;
-            return { false, {} };
-        }
-    }
-
-    if (gltf.nodes.empty()) {
-        std::cerr << "No nodes found in GLTF file." << std::endl;
-        return { false, {} };
-    }
-
-    const tinygltf::Node& node = gltf.nodes[0]; // Get the first node.
-    if (node.mesh < 0) {
-        std::cerr << "No mesh associated with the first node." << std::endl;
-        return { false, {} };
-    }
-
-    const tinygltf::Mesh& mesh = gltf.meshes[node.mesh];
-    if (mesh.primitives.empty()) {
-        std::cerr << "No primitives found in the first mesh." << std::endl;
-        return { false, {} };
-    }
-
-    const tinygltf::Primitive& prim = mesh.primitives[0]; // Get the first primitive.
-    if (prim.mode != TINYGLTF_MODE_TRIANGLES) {
-        std::cerr << "Primitive is not in TRIANGLES mode." << std::endl;
-        return { false, {} };
-    }
-
-    auto mesh_data = build_mesh_data(gltf, prim);
-    if (!mesh_data.is_ok) {
-        return { false, {} };
-    }
-
-    // Compute tangents if missing
-    if (mesh_data.value.vertices[0].tangent_bitangent_sign == glm::vec4(0.0f)) {
-        compute_tangents(mesh_data.value);
-    }
-
-
-    return { true, std::make_shared<StaticMesh>(mesh_data.value) };
+// Everything that changes what the import produces, besides the source files
+static u64 cache_options() {
+    return u64(gltf_vertex_format);
 }
 
 
@@ -365,8 +292,16 @@ Result<std::shared_ptr<StaticMesh>> make_ball(const std::string& file_name) {
         const double time = program_time();
         DEFER(std::cout << file_name << " loaded in " << std::round((program_time() - time) * 100.0) / 100.0 << "s" << std::endl);
 
+        if(scene_cache_enabled) {
+            if(auto cached = SceneCache::load(file_name, cache_options()); cached.is_ok) {
+                std::cout << file_name << " loaded from " << SceneCache::cache_file_name(file_name) << std::endl;
+                return cached;
+            }
+        }
+
         tinygltf::TinyGLTF ctx;
         tinygltf::Model gltf;
+        ctx.SetImageLoader(keep_encoded_image, nullptr);
 
         {
             std::string err;
@@ -391,51 +326,206 @@ Result<std::shared_ptr<StaticMesh>> make_ball(const std::string& file_name) {
 
         std::cout << file_name << " parsed in " << std::round((program_time() - time) * 100.0) / 100.0 << "s" << std::endl;
 
-        auto ball = make_ball(std::string(data_path) + "sphere.glb");
+        auto scene = std::make_unique<Scene>();
 
-        if (!ball.is_ok) {
-            return { false, {} };
+        // Records the scene as it is built, payloads point into the import pipeline until the cache is written
+        SceneCache cache;
+        for(const tinygltf::Buffer& buffer : gltf.buffers) {
+            if(!buffer.uri.empty() && !tinygltf::IsDataURI(buffer.uri)) {
+                cache.add_dependency(buffer.uri);
+            }
+        }
+        for(const tinygltf::Image& image : gltf.images) {
+            if(!image.uri.empty() && !tinygltf::IsDataURI(image.uri)) {
+                cache.add_dependency(image.uri);
+            }
         }
-        std::shared_ptr<StaticMesh> mesh = std::move(ball.value);
-
-        auto scene = std::make_unique<Scene>(std::move(mesh));
 
-        std::unordered_map<int, std::shared_ptr<Texture>> textures;
-        std::unordered_map<int, std::shared_ptr<Material>> materials;
-        std::unordered_map<int, glm::mat4> node_transforms;
+        // Graph node of every glTF node, the hierarchy is kept so that moving a node moves its children
+        std::vector<u32> graph_nodes(gltf.nodes.size(), SceneGraph::no_node);
         std::vector<std::pair<int, int>> light_nodes;
 
+        struct OccluderCandidate {
+            size_t object_index = 0;
+            float radius = 0.0f;
+            u32 mesh_task = 0;
+        };
+        std::vector<OccluderCandidate> occluder_candidates;
+
         {
             std::vector<int> node_indices;
             if(gltf.defaultScene >= 0) {
                 node_indices = gltf.scenes[gltf.defaultScene].nodes;
             } else {
+                // Every node that isn't a child is a root
+                std::vector<bool> is_child(gltf.nodes.size(), false);
+                for(const tinygltf::Node& node : gltf.nodes) {
+                    for(const int child : node.children) {
+                        is_child[child] = true;
+                    }
+                }
                 for(u32 i = 0; i != gltf.nodes.size(); ++i) {
-                    node_indices.push_back(i);
-                    node_transforms[i] = base_transform();
+                    if(!is_child[i]) {
+                        node_indices.push_back(i);
+                    }
                 }
             }
 
+            const u32 root = scene->add_node(SceneGraph::no_node, base_transform());
+            cache.add_node(root, SceneGraph::no_node, base_transform());
             for(const int node_index : node_indices) {
-                parse_node_transforms(node_index, gltf, node_transforms);
+                add_graph_nodes(node_index, gltf, *scene, cache, graph_nodes, root);
             }
 
-            for(const int node_index : node_indices) {
+            // World transforms are needed to place objects and lights
+            scene->update_transforms();
+
+            // Lights can be attached to any node in the graph, not only to roots
+            for(u32 node_index = 0; node_index != gltf.nodes.size(); ++node_index) {
                 const auto& node = gltf.nodes[node_index];
+                if(graph_nodes[node_index] == SceneGraph::no_node) {
+                    continue;
+                }
                 if(const auto it = node.extensions.find("KHR_lights_punctual"); it != node.extensions.end()) {
                     const int light_index = it->second.Get("light").Get<int>();
                     if(light_index < 0 || light_index >= static_cast<int>(gltf.lights.size())) {
                         continue;
                     }
-                    light_nodes.emplace_back(std::pair{node_index, light_index});
+                    light_nodes.emplace_back(std::pair{int(node_index), light_index});
+                }
+            }
+        }
+
+        // Everything that doesn't need GL runs on the thread pool.
+        // Primitives and images are shared by index, then by content, so that load time and memory scale with unique data
+        ImportPipeline pipeline;
+        std::unordered_map<u64, u32> mesh_tasks;        // Mesh and primitive index
+        std::unordered_map<u64, u32> image_tasks;       // Image index and color space
+        std::vector<std::string> mesh_names;
+
+        struct MaterialImages {
+            int albedo = -1;
+            int normal = -1;
+        };
+        std::unordered_map<int, MaterialImages> material_images;
+
+        auto add_image = [&](int index, bool as_sRGB) -> int {
+            if(index < 0) {
+                return -1;
+            }
+            const auto it = image_tasks.emplace((u64(index) << 1) | u64(as_sRGB), 0);
+            if(it.second) {
+                it.first->second = pipeline.add_image(Span<const u8>(gltf.images[index].image.data(), gltf.images[index].image.size()), as_sRGB);
+            }
+            return int(it.first->second);
+        };
+
+        for(size_t node_index = 0; node_index != gltf.nodes.size(); ++node_index) {
+            const tinygltf::Node& node = gltf.nodes[node_index];
+            if(node.mesh < 0 || graph_nodes[node_index] == SceneGraph::no_node) {
+                continue;
+            }
+
+            const tinygltf::Mesh& mesh = gltf.meshes[node.mesh];
+            for(size_t j = 0; j != mesh.primitives.size(); ++j) {
+                const tinygltf::Primitive& prim = mesh.primitives[j];
+                if(prim.mode != TINYGLTF_MODE_TRIANGLES) {
+                    continue;
                 }
+
+                const u64 key = (u64(node.mesh) << 32) | u64(j);
+                if(mesh_tasks.find(key) == mesh_tasks.end()) {
+                    mesh_tasks[key] = pipeline.add_mesh([&gltf, &prim] { return decode_mesh_data(gltf, prim); });
+                    mesh_names.push_back(mesh.name + "[" + std::to_string(j) + "]");
+                }
+
+                if(prim.material >= 0 && material_images.find(prim.material) == material_images.end()) {
+                    const tinygltf::Material& material = gltf.materials[prim.material];
+                    MaterialImages& images = material_images[prim.material];
+                    images.albedo = add_image(texture_image(gltf, material.pbrMetallicRoughness.baseColorTexture), true);
+                    images.normal = add_image(texture_image(gltf, material.normalTexture), false);
+                }
+            }
+        }
+
+        if(!pipeline.run()) {
+            return {false, {}};
+        }
+
+        for(u32 i = 0; i != pipeline.mesh_count(); ++i) {
+            if(pipeline.unique_mesh(i) == i) {
+                const VertexCacheStats& before = pipeline.cache_stats_before(i);
+                const VertexCacheStats& after = pipeline.cache_stats_after(i);
+                std::cout << "  " << mesh_names[i] << ": " << pipeline.mesh_data(i).indices.size() / 3 << " triangles, "
+                          << "ACMR " << round_2(before.acmr) << " -> " << round_2(after.acmr) << ", "
+                          << "ATVR " << round_2(before.atvr) << " -> " << round_2(after.atvr) << std::endl;
+            }
+        }
+
+        struct DedupStats {
+            u32 referenced = 0;
+            u32 unique = 0;
+            u32 content_duplicates = 0;
+            size_t referenced_bytes = 0;
+            size_t unique_bytes = 0;
+        };
+        DedupStats mesh_stats;
+        DedupStats texture_stats;
+        DedupStats material_stats;
+
+        // GL objects can only be created from this thread
+        const double gl_time = program_time();
+
+        std::vector<std::shared_ptr<StaticMesh>> static_meshes(pipeline.mesh_count());
+        std::vector<u32> cache_meshes(pipeline.mesh_count());
+        for(u32 i = 0; i != pipeline.mesh_count(); ++i) {
+            const u32 unique = pipeline.unique_mesh(i);
+            if(pipeline.mesh_data(i).is_empty()) {
+                // Empty primitives get no geometry at all, and their objects are skipped
+                cache_meshes[i] = SceneCache::no_index;
+            } else if(unique == i) {
+                MeshPayload payload = MeshPayload::from_mesh_data(pipeline.mesh_data(i), gltf_vertex_format);
+                static_meshes[i] = std::make_shared<StaticMesh>(payload);
+                cache_meshes[i] = cache.add_mesh(std::move(payload));
+                ++mesh_stats.unique;
+                mesh_stats.unique_bytes += geometry_bytes(*static_meshes[i]);
+            } else {
+                static_meshes[i] = static_meshes[unique];
+                cache_meshes[i] = cache_meshes[unique];
+                ++mesh_stats.content_duplicates;
+            }
+        }
+
+        std::vector<std::shared_ptr<Texture>> textures(pipeline.image_count());
+        std::vector<u32> cache_textures(pipeline.image_count(), SceneCache::no_index);
+        for(u32 i = 0; i != pipeline.image_count(); ++i) {
+            const u32 unique = pipeline.unique_image(i);
+            if(!pipeline.image_ok(i)) {
+                std::cerr << "Unsupported image format" << std::endl;
+            } else if(unique == i) {
+                textures[i] = std::make_shared<Texture>(pipeline.texture_data(i));
+                cache_textures[i] = cache.add_texture(pipeline.texture_data(i));
+                ++texture_stats.unique;
+                texture_stats.unique_bytes += pipeline.texture_data(i).mip_offset(1);
+            } else {
+                textures[i] = textures[unique];
+                cache_textures[i] = cache_textures[unique];
+                ++texture_stats.content_duplicates;
             }
         }
 
-        for(auto [node_index, node_transform] : node_transforms) {
+        struct LoadedMaterial {
+            std::shared_ptr<Material> material;
+            u32 cache_index = SceneCache::no_index;
+        };
+        std::unordered_map<int, LoadedMaterial> materials;
+        std::map<std::pair<const Texture*, const Texture*>, LoadedMaterial> unique_materials;
+
+        for(size_t node_index = 0; node_index != gltf.nodes.size(); ++node_index) {
             const tinygltf::Node& node = gltf.nodes[node_index];
+            const u32 graph_node = graph_nodes[node_index];
 
-            if(node.mesh < 0) {
+            if(node.mesh < 0 || graph_node == SceneGraph::no_node) {
                 continue;
             }
 
@@ -448,69 +538,68 @@ Result<std::shared_ptr<StaticMesh>> make_ball(const std::string& file_name) {
                     continue;
                 }
 
-                auto mesh = build_mesh_data(gltf, prim);
-                if(!mesh.is_ok) {
-                    return {false, {}};
+                const u32 mesh_task = mesh_tasks[(u64(node.mesh) << 32) | u64(j)];
+                const std::shared_ptr<StaticMesh>& static_mesh = static_meshes[mesh_task];
+                if(!static_mesh) {
+                    continue;
                 }
 
-                if(mesh.value.vertices[0].tangent_bitangent_sign == glm::vec4(0.0f)) {
-                    compute_tangents(mesh.value);
-                }
+                const MeshData& mesh_data = pipeline.mesh_data(mesh_task);
+                ++mesh_stats.referenced;
+                mesh_stats.referenced_bytes += geometry_bytes(*static_mesh);
 
-                std::shared_ptr<Material> material;
+                LoadedMaterial material;
                 if(prim.material >= 0) {
                     auto& mat = materials[prim.material];
 
-                    if(!mat) {
-                        const auto& albedo_info = gltf.materials[prim.material].pbrMetallicRoughness.baseColorTexture;
-                        const auto& normal_info = gltf.materials[prim.material].normalTexture;
-
-                        auto load_texture = [&](auto texture_info, bool as_sRGB) -> std::shared_ptr<Texture> {
-                            if(texture_info.texCoord != 0) {
-                                std::cerr << "Unsupported texture coordinate channel (" << texture_info.texCoord << ")" << std::endl;
+                    if(!mat.material) {
+                        auto load_texture = [&](int image) -> std::shared_ptr<Texture> {
+                            if(image < 0) {
                                 return nullptr;
                             }
 
-                            if(texture_info.index < 0) {
-                                return nullptr;
+                            ++texture_stats.referenced;
+                            if(textures[image]) {
+                                texture_stats.referenced_bytes += pipeline.texture_data(image).mip_offset(1);
                             }
-
-                            const int index = gltf.textures[texture_info.index].source;
-                            if(index < 0) {
-                                return nullptr;
-                            }
-
-                            auto& texture = textures[index];
-                            if(!texture) {
-                                if(const auto r = build_texture_data(gltf.images[index], as_sRGB); r.is_ok) {
-                                    texture = std::make_shared<Texture>(r.value);
-                                }
-                            }
-                            return texture;
+                            return textures[image];
                         };
 
-                        auto albedo = load_texture(albedo_info, true);
-                        auto normal = load_texture(normal_info, false);
-
-                        if(!albedo) {
-                            mat = Material::empty_material();
-                        } else if(!normal) {
-                            mat = std::make_shared<Material>(Material::textured_material());
-                            mat->set_texture(0u, albedo);
+                        const MaterialImages& images = material_images[prim.material];
+                        auto albedo = load_texture(images.albedo);
+                        auto normal = load_texture(images.normal);
+
+                        // Materials only differ by their textures, normal maps are ignored without albedo
+                        auto& unique = unique_materials[{albedo.get(), albedo ? normal.get() : nullptr}];
+                        if(!unique.material) {
+                            unique.material = Material::from_textures(albedo, normal);
+                            unique.cache_index = cache.add_material(images.albedo < 0 ? SceneCache::no_index : cache_textures[images.albedo],
+                                                                    images.normal < 0 ? SceneCache::no_index : cache_textures[images.normal]);
+                            ++material_stats.unique;
                         } else {
-                            mat = std::make_shared<Material>(Material::textured_normal_mapped_material());
-                            mat->set_texture(0u, albedo);
-                            mat->set_texture(1u, normal);
+                            ++material_stats.content_duplicates;
                         }
-                        //mat = std::make_shared<Material>(Material::g_buffer_material());
+                        mat = unique;
                     }
 
                     material = mat;
+                    ++material_stats.referenced;
+                }
+
+                auto scene_object = SceneObject(static_mesh, std::move(material.material));
+                scene_object.set_transform(scene->graph().world_transform(graph_node));
+
+                // Transparent surfaces can't hide anything
+                const bool opaque = prim.material < 0 || gltf.materials[prim.material].alphaMode == "OPAQUE";
+                if(opaque && mesh_data.indices.size() / 3 <= OcclusionCuller::max_occluder_triangles) {
+                    OccluderCandidate& candidate = occluder_candidates.emplace_back();
+                    candidate.object_index = scene->objects().size();
+                    candidate.radius = scene_object.world_sphere().radius;
+                    candidate.mesh_task = mesh_task;
                 }
 
-                auto scene_object = SceneObject(std::make_shared<StaticMesh>(mesh.value), std::move(material));
-                scene_object.set_transform(node_transform);
-                scene->add_object(std::move(scene_object));
+                cache.add_object(cache_meshes[mesh_task], material.cache_index, graph_node);
+                scene->add_object(std::move(scene_object), graph_node);
             }
         }
 
@@ -520,7 +609,7 @@ Result<std::shared_ptr<StaticMesh>> make_ball(const std::string& file_name) {
             const glm::vec3 color = glm::vec3(float(gltf_light.color[0]), float(gltf_light.color[1]), float(gltf_light.color[2])) * float(gltf_light.intensity);;
 
             PointLight light;
-            light.set_position(node_transforms[node_index][3]);
+            light.set_position(scene->graph().world_transform(graph_nodes[node_index])[3]);
             light.set_color(color);
             if(gltf_light.range > 0.0) {
                 light.set_radius(float(gltf_light.range));
@@ -528,10 +617,78 @@ Result<std::shared_ptr<StaticMesh>> make_ball(const std::string& file_name) {
                 const float intensity = glm::dot(color, glm::vec3(1.0f));
                 light.set_radius(std::sqrt(intensity * 1000.0f)); // Put radius where lum < 0.1%
             }
+            cache.add_light(light);
             scene->add_light(light);
         }
 
+        {
+            // The biggest objects make the best occluders
+            std::sort(occluder_candidates.begin(), occluder_candidates.end(), [](const auto& a, const auto& b) { return a.radius > b.radius; });
+
+            // Geometry is shared by the occluders of every object using the same mesh, each one uses the transform of its object
+            struct LoadedOccluderMesh {
+                std::shared_ptr<const OcclusionCuller::OccluderMesh> mesh;
+                u32 cache_index = SceneCache::no_index;
+            };
+            std::vector<LoadedOccluderMesh> occluder_meshes(pipeline.mesh_count());
+
+            u32 occluder_count = 0;
+            size_t triangle_count = 0;
+            for(const OccluderCandidate& candidate : occluder_candidates) {
+                if(occluder_count == OcclusionCuller::max_occluders) {
+                    break;
+                }
+
+                const MeshData& mesh_data = pipeline.mesh_data(candidate.mesh_task);
+                const size_t triangles = mesh_data.indices.size() / 3;
+                if(triangle_count + triangles > OcclusionCuller::max_occluder_triangles) {
+                    continue;
+                }
+
+                LoadedOccluderMesh& occluder_mesh = occluder_meshes[pipeline.unique_mesh(candidate.mesh_task)];
+                if(!occluder_mesh.mesh) {
+                    auto mesh = std::make_shared<OcclusionCuller::OccluderMesh>();
+                    mesh->positions.reserve(mesh_data.vertices.size());
+                    for(const Vertex& vert : mesh_data.vertices) {
+                        mesh->positions.push_back(vert.position);
+                    }
+                    mesh->indices = mesh_data.indices;
+                    occluder_mesh.cache_index = cache.add_occluder_mesh(mesh);
+                    occluder_mesh.mesh = std::move(mesh);
+                }
+
+                cache.add_occluder(u32(candidate.object_index), occluder_mesh.cache_index);
+                scene->add_occluder(candidate.object_index, occluder_mesh.mesh);
+                triangle_count += triangles;
+                ++occluder_count;
+            }
+        }
+
+        const double gl_end = program_time();
+
+        std::cout << "  Import on " << ThreadPool::global().thread_count() << " threads:" << std::endl;
+        for(const TaskGraph::StageTiming& stage : pipeline.stage_timings()) {
+            std::cout << "    " << stage.name << ": " << stage.tasks << " tasks, "
+                      << to_ms(stage.busy_time) << "ms busy, " << to_ms(stage.wall_time()) << "ms wall" << std::endl;
+        }
+        std::cout << "    GL thread: " << to_ms(gl_end - gl_time) << "ms" << std::endl;
+
+        std::cout << "  " << mesh_stats.referenced << " primitives referenced, " << mesh_stats.unique << " unique (" << mesh_stats.content_duplicates << " duplicates found by content), "
+                  << to_mb(mesh_stats.referenced_bytes - mesh_stats.unique_bytes) << "MB of geometry saved" << std::endl;
+        std::cout << "  " << texture_stats.referenced << " textures referenced, " << texture_stats.unique << " unique (" << texture_stats.content_duplicates << " duplicates found by content), "
+                  << to_mb(texture_stats.referenced_bytes - texture_stats.unique_bytes) << "MB of texels saved" << std::endl;
+        std::cout << "  " << material_stats.referenced << " materials referenced, " << material_stats.unique << " unique (" << material_stats.content_duplicates << " duplicates found by content)" << std::endl;
+
+        if(scene_cache_enabled) {
+            const double cache_time = program_time();
+            if(cache.write(file_name, cache_options())) {
+                std::cout << "  Cache written to " << SceneCache::cache_file_name(file_name) << " in " << to_ms(program_time() - cache_time) << "ms" << std::endl;
+            } else {
+                std::cerr << "Unable to write scene cache (" << SceneCache::cache_file_name(file_name) << ")" << std::endl;
+            }
+        }
 
+        scene->update_culling_data();
 
         return {true, std::move(scene)};
     }
@@ -0,0 +1,233 @@
+#include "SphereCuller.h"
+
+#include <ThreadPool.h>
+
+#include <algorithm>
+#include <limits>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define OM3D_CULLING_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OM3D_CULLING_SSE
+#endif
+
+namespace OM3D {
+
+#if defined(OM3D_CULLING_AVX)
+static constexpr u32 simd_width = 8;
+#elif defined(OM3D_CULLING_SSE)
+static constexpr u32 simd_width = 4;
+#else
+static constexpr u32 simd_width = 1;
+#endif
+
+// Extra slots at the end so full registers can always be loaded
+static constexpr size_t padding = 8;
+
+static constexpr u32 plane_count = 5;
+
+// Planes as n.p + d >= 0, with d taking the frustum origin into account
+struct FrustumPlanes {
+    float x[plane_count];
+    float y[plane_count];
+    float z[plane_count];
+    float d[plane_count];
+};
+
+struct SphereArrays {
+    const float* x;
+    const float* y;
+    const float* z;
+    const float* radius;
+    const u32* ids;
+};
+
+static FrustumPlanes extract_planes(const Frustum& frustum) {
+    const glm::vec3 normals[plane_count] = {
+        frustum._near_normal,
+        frustum._top_normal,
+        frustum._bottom_normal,
+        frustum._right_normal,
+        frustum._left_normal,
+    };
+
+    FrustumPlanes planes = {};
+    for(u32 i = 0; i != plane_count; ++i) {
+        planes.x[i] = normals[i].x;
+        planes.y[i] = normals[i].y;
+        planes.z[i] = normals[i].z;
+        planes.d[i] = -glm::dot(normals[i], frustum._origin);
+    }
+    return planes;
+}
+
+static void cull_range(const SphereArrays& spheres, const FrustumPlanes& planes, u32 first, u32 count, std::vector<u32>& visible) {
+    const u32 end = first + count;
+
+#if defined(OM3D_CULLING_AVX)
+    __m256 px[plane_count], py[plane_count], pz[plane_count], pd[plane_count];
+    for(u32 p = 0; p != plane_count; ++p) {
+        px[p] = _mm256_set1_ps(planes.x[p]);
+        py[p] = _mm256_set1_ps(planes.y[p]);
+        pz[p] = _mm256_set1_ps(planes.z[p]);
+        pd[p] = _mm256_set1_ps(planes.d[p]);
+    }
+
+    auto test_lanes = [&](u32 i) {
+        const __m256 x = _mm256_loadu_ps(spheres.x + i);
+        const __m256 y = _mm256_loadu_ps(spheres.y + i);
+        const __m256 z = _mm256_loadu_ps(spheres.z + i);
+        const __m256 r = _mm256_loadu_ps(spheres.radius + i);
+        const __m256 zero = _mm256_setzero_ps();
+
+        __m256 inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+        for(u32 p = 0; p != plane_count; ++p) {
+            const __m256 dist = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(px[p], x), _mm256_mul_ps(py[p], y)),
+                _mm256_add_ps(_mm256_mul_ps(pz[p], z), _mm256_add_ps(pd[p], r)));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(dist, zero, _CMP_GE_OQ));
+        }
+        return u32(_mm256_movemask_ps(inside));
+    };
+#elif defined(OM3D_CULLING_SSE)
+    __m128 px[plane_count], py[plane_count], pz[plane_count], pd[plane_count];
+    for(u32 p = 0; p != plane_count; ++p) {
+        px[p] = _mm_set1_ps(planes.x[p]);
+        py[p] = _mm_set1_ps(planes.y[p]);
+        pz[p] = _mm_set1_ps(planes.z[p]);
+        pd[p] = _mm_set1_ps(planes.d[p]);
+    }
+
+    auto test_lanes = [&](u32 i) {
+        const __m128 x = _mm_loadu_ps(spheres.x + i);
+        const __m128 y = _mm_loadu_ps(spheres.y + i);
+        const __m128 z = _mm_loadu_ps(spheres.z + i);
+        const __m128 r = _mm_loadu_ps(spheres.radius + i);
+        const __m128 zero = _mm_setzero_ps();
+
+        __m128 inside = _mm_cmpeq_ps(zero, zero);
+        for(u32 p = 0; p != plane_count; ++p) {
+            const __m128 dist = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(px[p], x), _mm_mul_ps(py[p], y)),
+                _mm_add_ps(_mm_mul_ps(pz[p], z), _mm_add_ps(pd[p], r)));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, zero));
+        }
+        return u32(_mm_movemask_ps(inside));
+    };
+#else
+    auto test_lanes = [&](u32 i) {
+        for(u32 p = 0; p != plane_count; ++p) {
+            const float dist = planes.x[p] * spheres.x[i] + planes.y[p] * spheres.y[i] + planes.z[p] * spheres.z[i] + planes.d[p] + spheres.radius[i];
+            if(!(dist >= 0.0f)) {
+                return 0u;
+            }
+        }
+        return 1u;
+    };
+#endif
+
+    for(u32 i = first; i < end; i += simd_width) {
+        // Lanes past the end of the range may belong to another range
+        const u32 lanes = std::min(simd_width, end - i);
+        u32 mask = test_lanes(i) & ((1u << lanes) - 1);
+        for(u32 k = i; mask; ++k, mask >>= 1) {
+            if(mask & 1) {
+                visible.push_back(spheres.ids[k]);
+            }
+        }
+    }
+}
+
+void SphereCuller::resize(size_t count) {
+    _count = count;
+
+    const size_t padded = count + padding;
+    _center_x.resize(padded, 0.0f);
+    _center_y.resize(padded, 0.0f);
+    _center_z.resize(padded, 0.0f);
+    _radius.resize(padded);
+    _ids.resize(padded, u32(-1));
+
+    // Padding slots are never visible
+    std::fill(_radius.begin() + count, _radius.end(), -std::numeric_limits<float>::infinity());
+}
+
+void SphereCuller::set(size_t slot, u32 id, const BoundingSphere& sphere) {
+    DEBUG_ASSERT(slot < _count);
+    _center_x[slot] = sphere.center.x;
+    _center_y[slot] = sphere.center.y;
+    _center_z[slot] = sphere.center.z;
+    _radius[slot] = sphere.radius;
+    _ids[slot] = id;
+}
+
+size_t SphereCuller::size() const {
+    return _count;
+}
+
+BoundingSphere SphereCuller::sphere(size_t slot) const {
+    DEBUG_ASSERT(slot < _count);
+    return BoundingSphere{glm::vec3(_center_x[slot], _center_y[slot], _center_z[slot]), _radius[slot]};
+}
+
+void SphereCuller::cull(const Frustum& frustum, std::vector<u32>& visible) const {
+    const IndexRange all = {0, u32(_count)};
+    cull(frustum, Span<const IndexRange>(&all, 1), visible);
+}
+
+void SphereCuller::cull(const Frustum& frustum, Span<const IndexRange> ranges, std::vector<u32>& visible) const {
+    if(!_count) {
+        return;
+    }
+
+    const FrustumPlanes planes = extract_planes(frustum);
+    const SphereArrays spheres = {_center_x.data(), _center_y.data(), _center_z.data(), _radius.data(), _ids.data()};
+
+    size_t total = 0;
+    for(const IndexRange& range : ranges) {
+        total += range.count;
+    }
+
+    ThreadPool& pool = ThreadPool::global();
+    if(total < parallel_threshold || pool.thread_count() == 1) {
+        for(const IndexRange& range : ranges) {
+            cull_range(spheres, planes, range.first, range.count, visible);
+        }
+        return;
+    }
+
+    // Split the ranges in batches of similar sizes, more batches than threads to balance the load
+    const u32 batch_count = pool.thread_count() * 4;
+    const size_t batch_size = (total / batch_count + simd_width) / simd_width * simd_width;
+
+    std::vector<std::vector<IndexRange>> batches(1);
+    size_t batch_fill = 0;
+    for(IndexRange range : ranges) {
+        while(range.count) {
+            const u32 count = u32(std::min(size_t(range.count), batch_size - batch_fill));
+            batches.back().push_back(IndexRange{range.first, count});
+            range.first += count;
+            range.count -= count;
+
+            if((batch_fill += count) == batch_size) {
+                batches.emplace_back();
+                batch_fill = 0;
+            }
+        }
+    }
+
+    std::vector<std::vector<u32>> results(batches.size());
+    pool.parallel_for(u32(batches.size()), [&](u32 b) {
+        for(const IndexRange& range : batches[b]) {
+            cull_range(spheres, planes, range.first, range.count, results[b]);
+        }
+    });
+
+    for(const std::vector<u32>& result : results) {
+        visible.insert(visible.end(), result.begin(), result.end());
+    }
+}
+
+}
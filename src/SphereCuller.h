@@ -0,0 +1,41 @@
+#ifndef SPHERECULLER_H
+#define SPHERECULLER_H
+
+#include <Bounds.h>
+#include <Camera.h>
+
+#include <vector>
+
+namespace OM3D {
+
+// World space bounding spheres stored as structure of arrays, tested 4 (SSE) or 8 (AVX) at a time.
+// Every slot carries an id which is what ends up in the visible list.
+class SphereCuller {
+    public:
+        // Below this many spheres, splitting the work across threads isn't worth it
+        static constexpr u32 parallel_threshold = 16 * 1024;
+
+        SphereCuller() = default;
+
+        void resize(size_t count);
+        void set(size_t slot, u32 id, const BoundingSphere& sphere);
+
+        size_t size() const;
+        BoundingSphere sphere(size_t slot) const;
+
+        // Append the ids of all visible spheres, in slot order
+        void cull(const Frustum& frustum, std::vector<u32>& visible) const;
+        void cull(const Frustum& frustum, Span<const IndexRange> ranges, std::vector<u32>& visible) const;
+
+    private:
+        std::vector<float> _center_x;
+        std::vector<float> _center_y;
+        std::vector<float> _center_z;
+        std::vector<float> _radius;
+        std::vector<u32> _ids;
+        size_t _count = 0;
+};
+
+}
+
+#endif // SPHERECULLER_H
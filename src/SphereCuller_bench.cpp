@@ -0,0 +1,53 @@
+#include "SphereCuller.h"
+#include "ThreadPool.h"
+
+#include <benchmarks.h>
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+namespace OM3D {
+
+void bench_sphere_culling() {
+    std::cout << "Sphere culling (" << ThreadPool::global().thread_count() << " threads)" << std::endl;
+
+    const Frustum frustum = benchmark_camera().build_frustum();
+
+    for(const size_t count : {10000, 100000, 1000000}) {
+        const std::vector<AABB> boxes = random_boxes(count);
+        const u32 iterations = u32(std::max(size_t(10), 10000000 / count));
+
+        std::vector<BoundingSphere> spheres(count);
+        SphereCuller culler;
+        culler.resize(count);
+        for(size_t i = 0; i != count; ++i) {
+            spheres[i] = BoundingSphere{boxes[i].center(), glm::length(boxes[i].half_extent())};
+            culler.set(i, u32(i), spheres[i]);
+        }
+
+        std::vector<u32> scalar_visible;
+        const double scalar = time_ms([&] {
+            scalar_visible.clear();
+            for(size_t i = 0; i != spheres.size(); ++i) {
+                if(frustum.intersects(spheres[i])) {
+                    scalar_visible.push_back(u32(i));
+                }
+            }
+        }, iterations);
+
+        std::vector<u32> simd_visible;
+        const double simd = time_ms([&] {
+            simd_visible.clear();
+            culler.cull(frustum, simd_visible);
+        }, iterations);
+
+        auto per_us = [&](double ms) { return double(count) / (ms * 1000.0); };
+        std::cout << "  " << std::setw(7) << count << " spheres, " << std::setw(6) << simd_visible.size() << " visible: "
+                  << "scalar " << per_us(scalar) << " objects/us, "
+                  << "SoA " << per_us(simd) << " objects/us"
+                  << check_result(scalar_visible == simd_visible, " MISMATCH") << std::endl;
+    }
+}
+
+}
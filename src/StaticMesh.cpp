@@ -1,32 +1,184 @@
 #include "StaticMesh.h"
 
+#include <MeshSimplifier.h>
+#include <MeshOptimizer.h>
+
 #include <glad/gl.h>
+
 #include <cmath>
+#include <unordered_map>
 
 namespace OM3D {
 
 extern bool audit_bindings_before_draw;
 
-StaticMesh::StaticMesh(const MeshData& data) :
-    _vertex_buffer(data.vertices),
-    _index_buffer(data.indices) {
-    glm::vec3 min = glm::vec3(std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity());
-    glm::vec3 max = glm::vec3(-std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity());;
-    for (auto e : data.vertices) {
-        min.x = (min.x < e.position.x) ? min.x : e.position.x;
-        min.y = (min.y < e.position.y) ? min.y : e.position.y;
-        min.z = (min.z < e.position.z) ? min.z : e.position.z;
-        max.x = (max.x > e.position.x) ? max.x : e.position.x;
-        max.y = (max.y > e.position.y) ? max.y : e.position.y;
-        max.z = (max.z > e.position.z) ? max.z : e.position.z;
+MeshData MeshData::icosphere(u32 subdivisions) {
+    const float t = (1.0f + std::sqrt(5.0f)) * 0.5f;
+    std::vector<glm::vec3> positions = {
+        {-1.0f, t, 0.0f}, {1.0f, t, 0.0f}, {-1.0f, -t, 0.0f}, {1.0f, -t, 0.0f},
+        {0.0f, -1.0f, t}, {0.0f, 1.0f, t}, {0.0f, -1.0f, -t}, {0.0f, 1.0f, -t},
+        {t, 0.0f, -1.0f}, {t, 0.0f, 1.0f}, {-t, 0.0f, -1.0f}, {-t, 0.0f, 1.0f},
+    };
+    std::vector<u32> indices = {
+        0, 11, 5,   0, 5, 1,    0, 1, 7,    0, 7, 10,   0, 10, 11,
+        1, 5, 9,    5, 11, 4,   11, 10, 2,  10, 7, 6,   7, 1, 8,
+        3, 9, 4,    3, 4, 2,    3, 2, 6,    3, 6, 8,    3, 8, 9,
+        4, 9, 5,    2, 4, 11,   6, 2, 10,   8, 6, 7,    9, 8, 1,
+    };
+    for(glm::vec3& p : positions) {
+        p = glm::normalize(p);
+    }
+
+    for(u32 s = 0; s != subdivisions; ++s) {
+        // Edge midpoints are shared by the two triangles of the edge
+        std::unordered_map<u64, u32> midpoints;
+        auto midpoint = [&](u32 a, u32 b) {
+            const u64 key = (u64(std::min(a, b)) << 32) | std::max(a, b);
+            const auto [it, inserted] = midpoints.emplace(key, u32(positions.size()));
+            if(inserted) {
+                positions.push_back(glm::normalize(positions[a] + positions[b]));
+            }
+            return it->second;
+        };
+
+        std::vector<u32> subdivided;
+        subdivided.reserve(indices.size() * 4);
+        for(size_t i = 0; i != indices.size(); i += 3) {
+            const u32 a = indices[i];
+            const u32 b = indices[i + 1];
+            const u32 c = indices[i + 2];
+            const u32 ab = midpoint(a, b);
+            const u32 bc = midpoint(b, c);
+            const u32 ca = midpoint(c, a);
+            subdivided.insert(subdivided.end(), {a, ab, ca,  b, bc, ab,  c, ca, bc,  ab, bc, ca});
+        }
+        indices = std::move(subdivided);
+    }
+
+    // Push the faces out so that the closest one touches the unit sphere
+    float min_distance = 1.0f;
+    for(size_t i = 0; i != indices.size(); i += 3) {
+        const glm::vec3& a = positions[indices[i]];
+        const glm::vec3 normal = glm::normalize(glm::cross(positions[indices[i + 1]] - a, positions[indices[i + 2]] - a));
+        min_distance = std::min(min_distance, std::abs(glm::dot(normal, a)));
+    }
+
+    MeshData data;
+    data.indices = std::move(indices);
+    data.vertices.resize(positions.size());
+    for(size_t i = 0; i != positions.size(); ++i) {
+        Vertex& vertex = data.vertices[i];
+        vertex.position = positions[i] / min_distance;
+        vertex.normal = positions[i];
+        vertex.uv = glm::vec2(0.0f);
+    }
+    return data;
+}
+
+void MeshData::generate_lods() {
+    // Not worth simplifying further
+    static constexpr size_t min_triangles = 16;
+    // Levels that don't remove at least this fraction of the previous one are dropped
+    static constexpr float min_reduction = 0.2f;
+
+    lods.clear();
+    if(indices.size() < min_triangles * 6) {
+        return;
+    }
+
+    MeshSimplifier simplifier(vertices, indices);
+    size_t previous_count = indices.size();
+    while(lods.size() + 1 != max_lod_count && previous_count >= min_triangles * 6) {
+        simplifier.simplify(previous_count / 6 * 3);
+
+        const size_t count = simplifier.index_count();
+        if(float(count) > float(previous_count) * (1.0f - min_reduction)) {
+            break;
+        }
+
+        lods.push_back(MeshLodData{simplifier.indices(), simplifier.error()});
+        previous_count = count;
+    }
+}
+
+void MeshData::optimize() {
+    DEBUG_ASSERT(lods.empty() && meshlets.empty());
+
+    optimize_vertex_cache(indices, vertices.size());
+    optimize_overdraw(indices, vertices);
+    optimize_vertex_fetch(vertices, indices);
+}
+
+void MeshData::build_meshlets() {
+    meshlets = OM3D::build_meshlets(vertices, indices, meshlet_indices);
+}
+
+MeshPayload MeshPayload::from_mesh_data(const MeshData& data, VertexFormat format) {
+    MeshPayload payload;
+    payload.format = format;
+    for(const Vertex& e : data.vertices) {
+        payload.aabb.add(e.position);
+    }
+
+    if(format == VertexFormat::Packed) {
+        payload.quantization = VertexQuantization::from_vertices(data.vertices);
+        payload._packed_storage.resize(data.vertices.size());
+        for(size_t i = 0; i != data.vertices.size(); ++i) {
+            payload._packed_storage[i] = pack_vertex(data.vertices[i], payload.quantization);
+        }
+        payload.packed_vertices = payload._packed_storage;
+    } else {
+        payload.vertices = data.vertices;
+    }
+
+    // All the levels are stored one after the other, followed by the meshlets
+    payload._lod_storage.push_back(MeshLod{0, u32(data.indices.size()), 0.0f});
+    if(data.lods.empty() && data.meshlets.empty()) {
+        payload.indices = data.indices;
+    } else {
+        payload._index_storage = data.indices;
+        for(const MeshLodData& lod : data.lods) {
+            const MeshLod& previous = payload._lod_storage.back();
+            payload._lod_storage.push_back(MeshLod{previous.first_index + previous.index_count, u32(lod.indices.size()), std::max(lod.error, previous.error)});
+            payload._index_storage.insert(payload._index_storage.end(), lod.indices.begin(), lod.indices.end());
+        }
+
+        const u32 first_meshlet_index = u32(payload._index_storage.size());
+        payload._index_storage.insert(payload._index_storage.end(), data.meshlet_indices.begin(), data.meshlet_indices.end());
+        payload._meshlet_storage = data.meshlets;
+        for(Meshlet& meshlet : payload._meshlet_storage) {
+            meshlet.first_index += first_meshlet_index;
+        }
+        payload.indices = payload._index_storage;
+    }
+    payload.lods = payload._lod_storage;
+    payload.meshlets = payload._meshlet_storage;
+
+    return payload;
+}
+
+StaticMesh::StaticMesh(const MeshData& data, VertexFormat format) : StaticMesh(MeshPayload::from_mesh_data(data, format)) {
+}
+
+StaticMesh::StaticMesh(const MeshPayload& payload) :
+    _format(payload.format),
+    _quantization(payload.quantization),
+    _range(payload.format == VertexFormat::Packed
+        ? GeometryBuffer::global().add(payload.packed_vertices, payload.indices)
+        : GeometryBuffer::global().add(payload.vertices, payload.indices)),
+    _meshlets(payload.meshlets.begin(), payload.meshlets.end()),
+    _aabb(payload.aabb) {
+
+    for(const MeshLod& lod : payload.lods) {
+        _lods.push_back(MeshLod{_range.first_index + lod.first_index, lod.index_count, lod.error});
     }
-    _center = (min + max);
-    _center.x = 0.5 * _center.x;
-    _center.y = 0.5 * _center.y;
-    _center.z = 0.5 * _center.z;
-    glm::vec3 diag = (max - min);
-    _radius = std::sqrt((diag.x * diag.x + diag.y * diag.y + diag.z * diag.z)) * 0.5f;
 
+    _center = _aabb.center();
+    _radius = glm::length(_aabb.max - _aabb.min) * 0.5f;
+}
+
+StaticMesh::~StaticMesh() {
+    GeometryBuffer::global().remove(_range);
 }
 
 glm::vec3 StaticMesh::getCenter() {
@@ -37,32 +189,57 @@ float StaticMesh::getRadius() {
     return _radius;
 }
 
-void StaticMesh::draw() const {
-    _vertex_buffer.bind(BufferUsage::Attribute);
-    _index_buffer.bind(BufferUsage::Index);
+const AABB& StaticMesh::aabb() const {
+    return _aabb;
+}
+
+const MeshRange& StaticMesh::range() const {
+    return _range;
+}
+
+VertexFormat StaticMesh::vertex_format() const {
+    return _format;
+}
+
+const VertexQuantization& StaticMesh::quantization() const {
+    return _quantization;
+}
+
+Span<const MeshLod> StaticMesh::lods() const {
+    return _lods;
+}
+
+u32 StaticMesh::select_lod(float max_error) const {
+    u32 lod = 0;
+    while(lod + 1 != _lods.size() && _lods[lod + 1].error <= max_error) {
+        ++lod;
+    }
+    return lod;
+}
+
+Span<const Meshlet> StaticMesh::meshlets() const {
+    return _meshlets;
+}
 
-    // Vertex position
-    glVertexAttribPointer(0, 3, GL_FLOAT, false, sizeof(Vertex), nullptr);
-    // Vertex normal
-    glVertexAttribPointer(1, 3, GL_FLOAT, false, sizeof(Vertex), reinterpret_cast<void*>(3 * sizeof(float)));
-    // Vertex uv
-    glVertexAttribPointer(2, 2, GL_FLOAT, false, sizeof(Vertex), reinterpret_cast<void*>(6 * sizeof(float)));
-    // Tangent / bitangent sign
-    glVertexAttribPointer(3, 4, GL_FLOAT, false, sizeof(Vertex), reinterpret_cast<void*>(8 * sizeof(float)));
-    // Vertex color
-    glVertexAttribPointer(4, 3, GL_FLOAT, false, sizeof(Vertex), reinterpret_cast<void*>(12 * sizeof(float)));
+void StaticMesh::draw(u32 first_instance, u32 instance_count, u32 lod, bool positions_only) const {
+    if(positions_only) {
+        GeometryBuffer::global().bind_positions(_format);
+    } else {
+        GeometryBuffer::global().bind(_format);
+    }
+
+    draw_bound(first_instance, instance_count, lod);
+}
 
-    glEnableVertexAttribArray(0);
-    glEnableVertexAttribArray(1);
-    glEnableVertexAttribArray(2);
-    glEnableVertexAttribArray(3);
-    glEnableVertexAttribArray(4);
+void StaticMesh::draw_bound(u32 first_instance, u32 instance_count, u32 lod) const {
+    DEBUG_ASSERT(lod < _lods.size());
+    const MeshLod& level = _lods[lod];
 
     if(audit_bindings_before_draw) {
         audit_bindings();
     }
 
-    glDrawElements(GL_TRIANGLES, int(_index_buffer.element_count()), GL_UNSIGNED_INT, nullptr);
+    glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, int(level.index_count), GL_UNSIGNED_INT, reinterpret_cast<void*>(size_t(level.first_index) * sizeof(u32)), int(instance_count), int(_range.first_vertex), first_instance);
 }
 
 }
@@ -4,33 +4,129 @@
 #include <graphics.h>
 #include <TypedBuffer.h>
 #include <Vertex.h>
+#include <GeometryBuffer.h>
+#include <Bounds.h>
+#include <Meshlets.h>
 
 #include <vector>
 
 namespace OM3D {
 
+// Simplified index buffer over the same vertices
+struct MeshLodData {
+    std::vector<u32> indices;
+    float error = 0.0f; // Max distance between the original vertices and the simplified surface, in mesh space
+};
+
 struct MeshData {
+    // Including the full resolution level
+    static constexpr u32 max_lod_count = 8;
+
     std::vector<Vertex> vertices;
     std::vector<u32> indices;
+
+    // Coarser and coarser levels, the full resolution one isn't included
+    std::vector<MeshLodData> lods;
+
+    // Clusters of the full resolution level, as ranges of meshlet_indices
+    std::vector<Meshlet> meshlets;
+    // Triangles of the full resolution level grouped by meshlet
+    std::vector<u32> meshlet_indices;
+
+    // Without vertices or triangles there is nothing to process or draw
+    bool is_empty() const {
+        return vertices.empty() || indices.empty();
+    }
+
+    // Build the LOD chain by quadric edge collapse, halving the triangle count every level.
+    // Stops early when the simplification gets stuck (locked borders or seams) or the mesh gets too small.
+    void generate_lods();
+
+    // Split the full resolution level in meshlets, its own triangle order is kept
+    void build_meshlets();
+
+    // Reorder triangles for the post transform vertex cache then for overdraw, and vertices by first use.
+    // Must be called before building meshlets and levels of detail.
+    void optimize();
+
+    // Subdivided icosahedron around the unit sphere: its faces are outside of the sphere, not its vertices
+    static MeshData icosphere(u32 subdivisions);
+};
+
+// Range of indices of a level of detail in the geometry buffer
+struct MeshLod {
+    u32 first_index = 0;
+    u32 index_count = 0;
+    float error = 0.0f;
+};
+
+// Mesh in the layout of the geometry buffer: vertices in their final format and every level in a single index array.
+// Scene caches store it as is, so that meshes are created without any conversion.
+struct MeshPayload : NonCopyable {
+    VertexFormat format = VertexFormat::Full;
+    VertexQuantization quantization;
+    AABB aabb;
+
+    // Only the array of the format is used
+    Span<const Vertex> vertices;
+    Span<const PackedVertex> packed_vertices;
+    // Every level, one after the other, then the triangles of the meshlets
+    Span<const u32> indices;
+    // First indices are relative to the first index of the mesh
+    Span<const MeshLod> lods;
+    Span<const Meshlet> meshlets;
+
+    // Points into data and into the storage of the payload, which moves with it
+    static MeshPayload from_mesh_data(const MeshData& data, VertexFormat format);
+
+    private:
+        std::vector<PackedVertex> _packed_storage;
+        std::vector<u32> _index_storage;
+        std::vector<MeshLod> _lod_storage;
+        std::vector<Meshlet> _meshlet_storage;
 };
 
-class StaticMesh : NonCopyable {
+// Owns its range of the global geometry buffer, which is freed with the mesh
+class StaticMesh : NonMovable {
 
     public:
         StaticMesh() = default;
-        StaticMesh(StaticMesh&&) = default;
-        StaticMesh& operator=(StaticMesh&&) = default;
-
-        StaticMesh(const MeshData& data);
+        StaticMesh(const MeshData& data, VertexFormat format = VertexFormat::Full);
+        StaticMesh(const MeshPayload& payload);
+        ~StaticMesh();
 
         glm::vec3 getCenter();
         float getRadius();
+        const AABB& aabb() const;
+
+        // Covers the indices of every level
+        const MeshRange& range() const;
+
+        VertexFormat vertex_format() const;
+        // Decoding of packed positions, identity for full vertices
+        const VertexQuantization& quantization() const;
+
+        // Level 0 is the full resolution mesh, errors increase with the level
+        Span<const MeshLod> lods() const;
+        // Coarsest level whose error is at most max_error, in mesh space
+        u32 select_lod(float max_error) const;
+
+        // Clusters of the full resolution level, indices are relative to its first index
+        Span<const Meshlet> meshlets() const;
 
-        void draw() const;
+        // Instances read their object index from the object index attribute, starting at first_instance.
+        // positions_only draws from the position stream, for depth only passes.
+        void draw(u32 first_instance, u32 instance_count = 1, u32 lod = 0, bool positions_only = false) const;
+        // Same as draw, for when the geometry buffer of the mesh format is already bound
+        void draw_bound(u32 first_instance, u32 instance_count = 1, u32 lod = 0) const;
 
     private:
-        TypedBuffer<Vertex> _vertex_buffer;
-        TypedBuffer<u32> _index_buffer;
+        VertexFormat _format = VertexFormat::Full;
+        VertexQuantization _quantization;
+        MeshRange _range;
+        std::vector<MeshLod> _lods;
+        std::vector<Meshlet> _meshlets;
+        AABB _aabb;
         glm::vec3 _center;
         float _radius;
 };
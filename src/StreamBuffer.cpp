@@ -0,0 +1,135 @@
+#include "StreamBuffer.h"
+
+#include <GLState.h>
+
+#include <glad/gl.h>
+
+#include <algorithm>
+
+namespace OM3D {
+
+static constexpr size_t min_frame_capacity = 1024 * 1024;
+static constexpr GLbitfield map_flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+void StreamRange::bind(BufferUsage usage) const {
+    bind_buffer(usage, buffer);
+}
+
+void StreamRange::bind(BufferUsage usage, u32 index) const {
+    ALWAYS_ASSERT(usage == BufferUsage::Uniform || usage == BufferUsage::Storage, "Index bind is only available for uniform and storage buffers");
+    bind_buffer_range(usage, index, buffer, offset, size);
+}
+
+StreamBuffer& StreamBuffer::global() {
+    static StreamBuffer buffer;
+    return buffer;
+}
+
+StreamBuffer::StreamBuffer() {
+    int uniform_alignment = 0;
+    int storage_alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniform_alignment);
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storage_alignment);
+    _alignment = size_t(std::max({uniform_alignment, storage_alignment, 16}));
+
+    create_buffer(min_frame_capacity);
+}
+
+StreamBuffer::~StreamBuffer() {
+    for(void* fence : _fences) {
+        if(fence) {
+            glDeleteSync(static_cast<GLsync>(fence));
+        }
+    }
+    for(const Retired& retired : _retired) {
+        forget_buffer(retired.handle);
+        glDeleteBuffers(1, &retired.handle);
+    }
+    if(_handle) {
+        forget_buffer(_handle);
+        glDeleteBuffers(1, &_handle);
+    }
+}
+
+void StreamBuffer::create_buffer(size_t frame_capacity) {
+    if(_handle) {
+        // Draws of this frame may still use the old buffer
+        _retired.push_back(Retired{_handle, _frame});
+    }
+
+    _frame_capacity = align_up_to(u32(frame_capacity), u32(_alignment));
+    const size_t total_size = _frame_capacity * frames_in_flight;
+
+    glCreateBuffers(1, &_handle);
+    glNamedBufferStorage(_handle, total_size, nullptr, map_flags);
+    _mapping = static_cast<byte*>(glMapNamedBufferRange(_handle, 0, total_size, map_flags));
+    ALWAYS_ASSERT(_mapping, "Unable to map stream buffer");
+
+    // Nothing has been written to the new buffer yet
+    _offset = 0;
+    ++_stats.buffer_creations;
+}
+
+void StreamBuffer::begin_frame() {
+    if(void*& fence = _fences[_frame % frames_in_flight]) {
+        const GLsync sync = static_cast<GLsync>(fence);
+        for(;;) {
+            const GLenum result = glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+            if(result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED) {
+                break;
+            }
+            ALWAYS_ASSERT(result != GL_WAIT_FAILED, "Stream buffer fence wait failed");
+        }
+        glDeleteSync(sync);
+        fence = nullptr;
+    }
+
+    // The GPU is done with every frame up to _frame - frames_in_flight
+    _retired.erase(std::remove_if(_retired.begin(), _retired.end(), [&](const Retired& retired) {
+        if(retired.frame + frames_in_flight > _frame) {
+            return false;
+        }
+        forget_buffer(retired.handle);
+        glDeleteBuffers(1, &retired.handle);
+        return true;
+    }), _retired.end());
+
+    _offset = 0;
+}
+
+void StreamBuffer::end_frame() {
+    void*& fence = _fences[_frame % frames_in_flight];
+    DEBUG_ASSERT(!fence);
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    _frame_stats.frame_capacity = _frame_capacity;
+    _frame_stats.buffer_creations = _stats.buffer_creations;
+    _stats = _frame_stats;
+    _frame_stats = {};
+
+    ++_frame;
+}
+
+StreamRange StreamBuffer::allocate_bytes(size_t size) {
+    DEBUG_ASSERT(size);
+
+    size_t offset = align_up_to(u32(_offset), u32(_alignment));
+    if(offset + size > _frame_capacity) {
+        // Only happens until the capacity fits the biggest frame
+        create_buffer(std::max(_frame_capacity * 2, size * 2));
+        offset = 0;
+    }
+
+    _offset = offset + size;
+
+    ++_frame_stats.allocations;
+    _frame_stats.allocated_bytes += size;
+
+    return StreamRange{_handle, size_t(_frame % frames_in_flight) * _frame_capacity + offset, size};
+}
+
+const StreamBuffer::Stats& StreamBuffer::stats() const {
+    return _stats;
+}
+
+}
@@ -0,0 +1,96 @@
+#ifndef STREAMBUFFER_H
+#define STREAMBUFFER_H
+
+#include <graphics.h>
+
+#include <array>
+#include <vector>
+
+namespace OM3D {
+
+// A range of the stream buffer, only valid for the frame it was allocated in
+struct StreamRange {
+    u32 buffer = 0;
+    size_t offset = 0;
+    size_t size = 0;
+
+    void bind(BufferUsage usage) const;
+    void bind(BufferUsage usage, u32 index) const;
+};
+
+template<typename T>
+struct StreamAllocation : StreamRange {
+    T* data = nullptr;
+
+    size_t element_count() const {
+        return size / sizeof(T);
+    }
+
+    T& operator[](size_t index) const {
+        DEBUG_ASSERT(index < element_count());
+        return data[index];
+    }
+};
+
+// Persistently mapped ring buffer for data rewritten every frame (constants, lights, per draw data).
+// It is split into one region per frame in flight, each guarded by a fence:
+// allocations are a bump pointer in the region of the current frame, and never create GL buffers in steady state.
+class StreamBuffer : NonMovable {
+    public:
+        static constexpr u32 frames_in_flight = 3;
+
+        struct Stats {
+            u32 allocations = 0;
+            size_t allocated_bytes = 0;
+            size_t frame_capacity = 0;
+            u32 buffer_creations = 0; // Since the creation of the stream buffer
+        };
+
+        static StreamBuffer& global();
+
+        ~StreamBuffer();
+
+        // Waits for the GPU to be done with the region of this frame, then starts allocating from it
+        void begin_frame();
+        void end_frame();
+
+        template<typename T>
+        StreamAllocation<T> allocate(size_t count = 1) {
+            StreamAllocation<T> allocation;
+            static_cast<StreamRange&>(allocation) = allocate_bytes(count * sizeof(T));
+            allocation.data = reinterpret_cast<T*>(_mapping + allocation.offset);
+            return allocation;
+        }
+
+        // Stats of the last complete frame
+        const Stats& stats() const;
+
+    private:
+        StreamBuffer();
+
+        StreamRange allocate_bytes(size_t size);
+        void create_buffer(size_t frame_capacity);
+
+        struct Retired {
+            u32 handle = 0;
+            u64 frame = 0;
+        };
+
+        u32 _handle = 0;
+        byte* _mapping = nullptr;
+        size_t _frame_capacity = 0;
+        size_t _alignment = 0;
+
+        std::array<void*, frames_in_flight> _fences = {};
+        std::vector<Retired> _retired;
+
+        u64 _frame = 0;
+        size_t _offset = 0;
+
+        Stats _frame_stats;
+        Stats _stats;
+};
+
+}
+
+#endif // STREAMBUFFER_H
@@ -0,0 +1,125 @@
+#include "TaskGraph.h"
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+
+namespace OM3D {
+
+double TaskGraph::StageTiming::wall_time() const {
+    return tasks ? last_end - first_start : 0.0;
+}
+
+TaskGraph::Task TaskGraph::add(const std::string& stage, std::function<void()> func, std::initializer_list<Task> dependencies) {
+    return add(stage, std::move(func), Span<const Task>(dependencies.begin(), dependencies.size()));
+}
+
+TaskGraph::Task TaskGraph::add(const std::string& stage, std::function<void()> func, Span<const Task> dependencies) {
+    const Task task = Task(_nodes.size());
+
+    auto stage_it = std::find_if(_stages.begin(), _stages.end(), [&](const StageTiming& timing) { return timing.name == stage; });
+    if(stage_it == _stages.end()) {
+        stage_it = _stages.insert(_stages.end(), StageTiming{stage});
+    }
+
+    Node& node = _nodes.emplace_back();
+    node.func = std::move(func);
+    node.stage = u32(stage_it - _stages.begin());
+    for(const Task dependency : dependencies) {
+        DEBUG_ASSERT(dependency < task);
+        _nodes[dependency].successors.push_back(task);
+        ++node.dependency_count;
+    }
+
+    return task;
+}
+
+void TaskGraph::run(ThreadPool& pool) {
+    for(StageTiming& stage : _stages) {
+        stage.tasks = 0;
+        stage.busy_time = 0.0;
+        stage.first_start = std::numeric_limits<double>::max();
+        stage.last_end = 0.0;
+    }
+
+    if(_nodes.empty()) {
+        return;
+    }
+
+    // Same as parallel_for: helpers may start after everything is done,
+    // so they only touch the graph after claiming a task, and the caller only waits for tasks to complete.
+    // Tasks take milliseconds, a single lock is plenty.
+    struct SharedState {
+        TaskGraph* graph = nullptr;
+        std::vector<u32> remaining;
+        std::vector<Task> ready;
+        u32 completed = 0;
+        u32 count = 0;
+        std::mutex lock;
+        std::condition_variable condition;
+
+        void run() {
+            std::unique_lock lock_guard(lock);
+            for(;;) {
+                condition.wait(lock_guard, [&] { return !ready.empty() || completed == count; });
+                if(ready.empty()) {
+                    return;
+                }
+
+                const Task task = ready.back();
+                ready.pop_back();
+                Node& node = graph->_nodes[task];
+
+                lock_guard.unlock();
+                const double start = program_time();
+                node.func();
+                const double end = program_time();
+                lock_guard.lock();
+
+                StageTiming& stage = graph->_stages[node.stage];
+                ++stage.tasks;
+                stage.busy_time += end - start;
+                stage.first_start = std::min(stage.first_start, start);
+                stage.last_end = std::max(stage.last_end, end);
+
+                ++completed;
+                for(const Task successor : node.successors) {
+                    if(!--remaining[successor]) {
+                        ready.push_back(successor);
+                    }
+                }
+                condition.notify_all();
+            }
+        }
+    };
+
+    auto state = std::make_shared<SharedState>();
+    state->graph = this;
+    state->count = u32(_nodes.size());
+    state->remaining.resize(_nodes.size());
+    for(u32 i = 0; i != _nodes.size(); ++i) {
+        state->remaining[i] = _nodes[i].dependency_count;
+        if(!_nodes[i].dependency_count) {
+            state->ready.push_back(i);
+        }
+    }
+    // Popped from the back, so that tasks start in the order they were added
+    std::reverse(state->ready.begin(), state->ready.end());
+
+    const u32 helper_count = std::min(pool.thread_count() - 1, state->count - 1);
+    for(u32 i = 0; i != helper_count; ++i) {
+        pool.schedule([state] { state->run(); });
+    }
+
+    state->run();
+}
+
+Span<const TaskGraph::StageTiming> TaskGraph::stage_timings() const {
+    return _stages;
+}
+
+u32 TaskGraph::task_count() const {
+    return u32(_nodes.size());
+}
+
+}
@@ -0,0 +1,55 @@
+#ifndef TASKGRAPH_H
+#define TASKGRAPH_H
+
+#include <ThreadPool.h>
+
+#include <initializer_list>
+#include <string>
+
+namespace OM3D {
+
+// Tasks with dependencies, run on a thread pool as soon as everything they depend on is done.
+// Tasks are grouped in named stages, for timings.
+class TaskGraph : NonCopyable {
+    public:
+        using Task = u32;
+
+        struct StageTiming {
+            std::string name;
+            u32 tasks = 0;
+            // Summed over every task of the stage, in seconds
+            double busy_time = 0.0;
+            // From the start of the first task of the stage to the end of its last one
+            double first_start = 0.0;
+            double last_end = 0.0;
+
+            double wall_time() const;
+        };
+
+        // Dependencies must have been added before, so the graph can't have cycles
+        Task add(const std::string& stage, std::function<void()> func, std::initializer_list<Task> dependencies = {});
+        Task add(const std::string& stage, std::function<void()> func, Span<const Task> dependencies);
+
+        // The calling thread helps and blocks until every task is done
+        void run(ThreadPool& pool = ThreadPool::global());
+
+        // Stages in the order they were first added to, valid after run
+        Span<const StageTiming> stage_timings() const;
+
+        u32 task_count() const;
+
+    private:
+        struct Node {
+            std::function<void()> func;
+            u32 stage = 0;
+            u32 dependency_count = 0;
+            std::vector<Task> successors;
+        };
+
+        std::vector<Node> _nodes;
+        std::vector<StageTiming> _stages;
+};
+
+}
+
+#endif // TASKGRAPH_H
@@ -1,10 +1,15 @@
 #include "Texture.h"
 
+#include <GLState.h>
+
+#include <glm/common.hpp>
+
 #include <glad/gl.h>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb/stb_image.h>
 
+#include <array>
 #include <cmath>
 #include <algorithm>
 
@@ -31,6 +36,127 @@ Result<TextureData> TextureData::from_file(const std::string& file) {
     return {true, std::move(data)};
 }
 
+Result<TextureData> TextureData::from_memory(Span<const u8> encoded, bool as_sRGB) {
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    if(!stbi_info_from_memory(encoded.data(), int(encoded.size()), &width, &height, &channels)) {
+        return {false, {}};
+    }
+
+    // Grey and grey alpha images are expanded
+    const int components = channels == 3 ? 3 : 4;
+    u8* img = stbi_load_from_memory(encoded.data(), int(encoded.size()), &width, &height, &channels, components);
+    DEFER(stbi_image_free(img));
+    if(!img || width <= 0 || height <= 0) {
+        return {false, {}};
+    }
+
+    const size_t bytes = size_t(width) * size_t(height) * components;
+
+    TextureData data;
+    data.size = glm::uvec2(width, height);
+    if(components == 3) {
+        data.format = as_sRGB ? ImageFormat::RGB8_sRGB : ImageFormat::RGB8_UNORM;
+    } else {
+        data.format = as_sRGB ? ImageFormat::RGBA8_sRGB : ImageFormat::RGBA8_UNORM;
+    }
+    data.data = std::make_unique<u8[]>(bytes);
+    std::copy_n(img, bytes, data.data.get());
+
+    return {true, std::move(data)};
+}
+
+static u32 bytes_per_pixel(ImageFormat format) {
+    switch(format) {
+        case ImageFormat::RGBA8_UNORM:
+        case ImageFormat::RGBA8_sRGB:
+            return 4;
+
+        case ImageFormat::RGB8_UNORM:
+        case ImageFormat::RGB8_sRGB:
+            return 3;
+
+        default:
+            FATAL("Unsupported image format");
+    }
+}
+
+static bool is_sRGB(ImageFormat format) {
+    return format == ImageFormat::RGBA8_sRGB || format == ImageFormat::RGB8_sRGB;
+}
+
+glm::uvec2 TextureData::mip_size(u32 mip) const {
+    return glm::max(glm::uvec2(size.x >> mip, size.y >> mip), glm::uvec2(1));
+}
+
+size_t TextureData::mip_offset(u32 mip) const {
+    const size_t pixel_bytes = bytes_per_pixel(format);
+    size_t offset = 0;
+    for(u32 i = 0; i != mip; ++i) {
+        const glm::uvec2 level = mip_size(i);
+        offset += size_t(level.x) * level.y * pixel_bytes;
+    }
+    return offset;
+}
+
+void TextureData::generate_mips() {
+    const u32 components = bytes_per_pixel(format);
+    const bool srgb = is_sRGB(format);
+
+    static const auto to_linear = [] {
+        std::array<float, 256> table = {};
+        for(u32 i = 0; i != 256; ++i) {
+            const float c = float(i) / 255.0f;
+            table[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        return table;
+    }();
+    auto to_sRGB = [](float c) {
+        return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+    };
+
+    const u32 levels = Texture::mip_levels(size);
+    auto mips = std::make_unique<u8[]>(mip_offset(levels));
+    std::copy_n(data.get(), mip_offset(1), mips.get());
+
+    for(u32 mip = 1; mip != levels; ++mip) {
+        const glm::uvec2 src_size = mip_size(mip - 1);
+        const glm::uvec2 dst_size = mip_size(mip);
+        const u8* src = mips.get() + mip_offset(mip - 1);
+        u8* dst = mips.get() + mip_offset(mip);
+
+        for(u32 y = 0; y != dst_size.y; ++y) {
+            // Odd sizes drop their last row or column, like most GPU implementations
+            const u32 y0 = std::min(y * 2, src_size.y - 1);
+            const u32 y1 = std::min(y * 2 + 1, src_size.y - 1);
+            for(u32 x = 0; x != dst_size.x; ++x) {
+                const u32 x0 = std::min(x * 2, src_size.x - 1);
+                const u32 x1 = std::min(x * 2 + 1, src_size.x - 1);
+                const u8* texels[] = {
+                    src + (size_t(y0) * src_size.x + x0) * components,
+                    src + (size_t(y0) * src_size.x + x1) * components,
+                    src + (size_t(y1) * src_size.x + x0) * components,
+                    src + (size_t(y1) * src_size.x + x1) * components,
+                };
+
+                u8* out = dst + (size_t(y) * dst_size.x + x) * components;
+                for(u32 c = 0; c != components; ++c) {
+                    // Alpha is always linear
+                    if(srgb && c != 3) {
+                        const float linear = (to_linear[texels[0][c]] + to_linear[texels[1][c]] + to_linear[texels[2][c]] + to_linear[texels[3][c]]) * 0.25f;
+                        out[c] = u8(std::lround(to_sRGB(linear) * 255.0f));
+                    } else {
+                        out[c] = u8((u32(texels[0][c]) + texels[1][c] + texels[2][c] + texels[3][c] + 2) / 4);
+                    }
+                }
+            }
+        }
+    }
+
+    data = std::move(mips);
+    mip_count = levels;
+}
 
 
 static GLuint create_texture_handle() {
@@ -39,30 +165,51 @@ static GLuint create_texture_handle() {
     return handle;
 }
 
-Texture::Texture(const TextureData& data) :
+Texture::Texture(const TextureData& data) : Texture(Span<const u8>(data.data.get(), data.mip_offset(data.mip_count)), data.size, data.format, data.mip_count) {
+}
+
+Texture::Texture(Span<const u8> mips, const glm::uvec2& size, ImageFormat format, u32 mip_count) :
     _handle(create_texture_handle()),
-    _size(data.size),
-    _format(data.format) {
+    _size(size),
+    _mip_count(mip_levels(size)),
+    _format(format) {
 
     const ImageFormatGL gl_format = image_format_to_gl(_format);
-    glTextureStorage2D(_handle.get(), mip_levels(_size), gl_format.internal_format, _size.x, _size.y);
-    glTextureSubImage2D(_handle.get(), 0, 0, 0, _size.x, _size.y, gl_format.format, gl_format.component_type, data.data.get());
+    glTextureStorage2D(_handle.get(), _mip_count, gl_format.internal_format, _size.x, _size.y);
+
+    // RGB8 rows are not 4 byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    DEFER(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
+
+    const size_t pixel_bytes = bytes_per_pixel(_format);
+    const u32 uploaded_mips = std::min(mip_count, _mip_count);
+    size_t offset = 0;
+    for(u32 mip = 0; mip != uploaded_mips; ++mip) {
+        const glm::uvec2 level_size = glm::max(glm::uvec2(_size.x >> mip, _size.y >> mip), glm::uvec2(1));
+        const size_t level_bytes = size_t(level_size.x) * level_size.y * pixel_bytes;
+        ALWAYS_ASSERT(offset + level_bytes <= mips.size(), "Texture data too small");
+        glTextureSubImage2D(_handle.get(), mip, 0, 0, level_size.x, level_size.y, gl_format.format, gl_format.component_type, mips.data() + offset);
+        offset += level_bytes;
+    }
 
     if(bindless_enabled()) {
         _bindless = glGetTextureHandleARB(_handle.get());
         glMakeTextureHandleResidentARB(_bindless);
     }
 
-    glGenerateTextureMipmap(_handle.get());
+    if(uploaded_mips < _mip_count) {
+        glGenerateTextureMipmap(_handle.get());
+    }
 }
 
-Texture::Texture(const glm::uvec2 &size, ImageFormat format) :
+Texture::Texture(const glm::uvec2 &size, ImageFormat format, u32 mip_count) :
     _handle(create_texture_handle()),
     _size(size),
+    _mip_count(mip_count),
     _format(format) {
 
     const ImageFormatGL gl_format = image_format_to_gl(_format);
-    glTextureStorage2D(_handle.get(), 1, gl_format.internal_format, _size.x, _size.y);
+    glTextureStorage2D(_handle.get(), _mip_count, gl_format.internal_format, _size.x, _size.y);
 
     if(bindless_enabled()) {
         _bindless = glGetTextureHandleARB(_handle.get());
@@ -72,16 +219,17 @@ Texture::Texture(const glm::uvec2 &size, ImageFormat format) :
 
 Texture::~Texture() {
     if(auto handle = _handle.get()) {
+        forget_texture(handle);
         glDeleteTextures(1, &handle);
     }
 }
 
 void Texture::bind(u32 index) const {
-    glBindTextureUnit(index, _handle.get());
+    bind_texture_unit(index, _handle.get());
 }
 
-void Texture::bind_as_image(u32 index, AccessType access) {
-    glBindImageTexture(index, _handle.get(), 0, false, 0, access_type_to_gl(access), image_format_to_gl(_format).internal_format);
+void Texture::bind_as_image(u32 index, AccessType access, u32 mip) {
+    glBindImageTexture(index, _handle.get(), mip, false, 0, access_type_to_gl(access), image_format_to_gl(_format).internal_format);
 }
 
 u64 Texture::bindless_handle() const {
@@ -92,6 +240,10 @@ glm::uvec2 Texture::size() const {
     return _size;
 }
 
+u32 Texture::mip_count() const {
+    return _mip_count;
+}
+
 // Return number of mip levels needed
 u32 Texture::mip_levels(glm::uvec2 size) {
     const float side = float(std::max(size.x, size.y));
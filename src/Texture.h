@@ -16,8 +16,18 @@ struct TextureData {
     std::unique_ptr<u8[]> data;
     glm::uvec2 size = {};
     ImageFormat format;
+    // Levels are stored one after the other, textures of a single level generate their mips on the GPU
+    u32 mip_count = 1;
 
     static Result<TextureData> from_file(const std::string& file_name);
+    // Decodes an encoded image (PNG, JPEG...) as RGB8 or RGBA8
+    static Result<TextureData> from_memory(Span<const u8> encoded, bool as_sRGB);
+
+    // Full box filtered mip chain, averaged in linear space for sRGB formats. 8 bit formats only.
+    void generate_mips();
+
+    glm::uvec2 mip_size(u32 mip) const;
+    size_t mip_offset(u32 mip) const;
 };
 
 class Texture {
@@ -30,14 +40,17 @@ class Texture {
         ~Texture();
 
         Texture(const TextureData& data);
-        Texture(const glm::uvec2 &size, ImageFormat format);
+        // Levels stored one after the other, like in TextureData
+        Texture(Span<const u8> mips, const glm::uvec2& size, ImageFormat format, u32 mip_count);
+        Texture(const glm::uvec2 &size, ImageFormat format, u32 mip_count = 1);
 
         void bind(u32 index) const;
-        void bind_as_image(u32 index, AccessType access);
+        void bind_as_image(u32 index, AccessType access, u32 mip = 0);
 
         u64 bindless_handle() const;
 
         glm::uvec2 size() const;
+        u32 mip_count() const;
 
 
         static u32 mip_levels(glm::uvec2 size);
@@ -47,6 +60,7 @@ class Texture {
 
         GLHandle _handle;
         glm::uvec2 _size = {};
+        u32 _mip_count = 1;
         u64 _bindless = {};
         ImageFormat _format;
 };
@@ -0,0 +1,120 @@
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <memory>
+#include <algorithm>
+
+namespace OM3D {
+
+ThreadPool::ThreadPool(u32 worker_count) {
+    for(u32 i = 0; i != worker_count; ++i) {
+        _workers.emplace_back([this] { worker(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        const std::unique_lock lock(_lock);
+        _run = false;
+    }
+    _condition.notify_all();
+
+    for(std::thread& thread : _workers) {
+        thread.join();
+    }
+}
+
+ThreadPool& ThreadPool::global() {
+    static ThreadPool pool;
+    return pool;
+}
+
+u32 ThreadPool::default_worker_count() {
+    const u32 hardware_threads = std::thread::hardware_concurrency();
+    return hardware_threads > 1 ? hardware_threads - 1 : 0;
+}
+
+u32 ThreadPool::thread_count() const {
+    return u32(_workers.size()) + 1;
+}
+
+void ThreadPool::schedule(std::function<void()> task) {
+    if(_workers.empty()) {
+        task();
+        return;
+    }
+
+    {
+        const std::unique_lock lock(_lock);
+        _tasks.emplace_back(std::move(task));
+    }
+    _condition.notify_one();
+}
+
+void ThreadPool::parallel_for(u32 count, const std::function<void(u32)>& func) {
+    if(count <= 1 || _workers.empty()) {
+        for(u32 i = 0; i != count; ++i) {
+            func(i);
+        }
+        return;
+    }
+
+    // Helpers may start after everything is done (or never if the pool is busy),
+    // so they only touch func after claiming an index and the caller only waits for indices to complete
+    struct SharedState {
+        const std::function<void(u32)>* func = nullptr;
+        u32 count = 0;
+        std::atomic<u32> next = 0;
+        u32 completed = 0;
+        std::mutex lock;
+        std::condition_variable done;
+
+        void run() {
+            u32 local_completed = 0;
+            for(u32 i = next++; i < count; i = next++) {
+                (*func)(i);
+                ++local_completed;
+            }
+
+            if(local_completed) {
+                const std::unique_lock lock_guard(lock);
+                completed += local_completed;
+                if(completed == count) {
+                    done.notify_all();
+                }
+            }
+        }
+    };
+
+    auto state = std::make_shared<SharedState>();
+    state->func = &func;
+    state->count = count;
+
+    const u32 helper_count = std::min(u32(_workers.size()), count - 1);
+    for(u32 i = 0; i != helper_count; ++i) {
+        schedule([state] { state->run(); });
+    }
+
+    state->run();
+
+    std::unique_lock lock(state->lock);
+    state->done.wait(lock, [&] { return state->completed == state->count; });
+}
+
+void ThreadPool::worker() {
+    for(;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock lock(_lock);
+            _condition.wait(lock, [this] { return !_run || !_tasks.empty(); });
+            if(_tasks.empty()) {
+                return;
+            }
+            task = std::move(_tasks.front());
+            _tasks.pop_front();
+        }
+        task();
+    }
+}
+
+}
@@ -0,0 +1,44 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <utils.h>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <vector>
+
+namespace OM3D {
+
+class ThreadPool : NonMovable {
+    public:
+        ThreadPool(u32 worker_count = default_worker_count());
+        ~ThreadPool();
+
+        static ThreadPool& global();
+        static u32 default_worker_count();
+
+        // Number of threads taking part in parallel_for (workers + calling thread)
+        u32 thread_count() const;
+
+        void schedule(std::function<void()> task);
+
+        // Call func(i) for every i in [0; count), the calling thread helps and blocks until everything is done
+        void parallel_for(u32 count, const std::function<void(u32)>& func);
+
+    private:
+        void worker();
+
+        std::vector<std::thread> _workers;
+
+        std::mutex _lock;
+        std::condition_variable _condition;
+        std::deque<std::function<void()>> _tasks;
+        bool _run = true;
+};
+
+}
+
+#endif // THREADPOOL_H
@@ -0,0 +1,113 @@
+#include "Vertex.h"
+
+#include <Bounds.h>
+
+#include <glm/geometric.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <cmath>
+
+namespace OM3D {
+
+static u16 to_unorm16(float x) {
+    return u16(std::round(glm::clamp(x, 0.0f, 1.0f) * 65535.0f));
+}
+
+static float from_unorm16(u16 x) {
+    return float(x) / 65535.0f;
+}
+
+static float from_snorm16(i16 x) {
+    return std::max(float(x) / 32767.0f, -1.0f);
+}
+
+static u8 to_unorm8(float x) {
+    return u8(std::round(glm::clamp(x, 0.0f, 1.0f) * 255.0f));
+}
+
+glm::vec2 octahedral_encode(const glm::vec3& v) {
+    const float l1 = std::abs(v.x) + std::abs(v.y) + std::abs(v.z);
+    if(l1 <= 0.0f) {
+        return glm::vec2(0.0f);
+    }
+
+    glm::vec2 e = glm::vec2(v.x, v.y) / l1;
+    if(v.z < 0.0f) {
+        e = glm::vec2((1.0f - std::abs(e.y)) * (e.x >= 0.0f ? 1.0f : -1.0f), (1.0f - std::abs(e.x)) * (e.y >= 0.0f ? 1.0f : -1.0f));
+    }
+    return e;
+}
+
+glm::vec3 octahedral_decode(const glm::vec2& e) {
+    glm::vec3 v(e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y));
+    const float t = std::max(-v.z, 0.0f);
+    v.x += v.x >= 0.0f ? -t : t;
+    v.y += v.y >= 0.0f ? -t : t;
+    return glm::normalize(v);
+}
+
+// Rounding each component to the nearest isn't the most accurate, try the 4 neighbouring encodings
+static void encode_unit_vector(const glm::vec3& v, i16 out[2]) {
+    const glm::vec2 e = octahedral_encode(v) * 32767.0f;
+    float best_dot = -2.0f;
+    for(u32 i = 0; i != 4; ++i) {
+        const i16 x = i16(glm::clamp(i & 1 ? std::ceil(e.x) : std::floor(e.x), -32767.0f, 32767.0f));
+        const i16 y = i16(glm::clamp(i & 2 ? std::ceil(e.y) : std::floor(e.y), -32767.0f, 32767.0f));
+        const float d = glm::dot(octahedral_decode(glm::vec2(from_snorm16(x), from_snorm16(y))), v);
+        if(d > best_dot) {
+            best_dot = d;
+            out[0] = x;
+            out[1] = y;
+        }
+    }
+}
+
+VertexQuantization VertexQuantization::from_vertices(Span<const Vertex> vertices) {
+    AABB box;
+    for(const Vertex& vertex : vertices) {
+        box.add(vertex.position);
+    }
+
+    VertexQuantization quantization;
+    if(!box.is_empty()) {
+        quantization.offset = box.min;
+        quantization.scale = box.max - box.min;
+    }
+    return quantization;
+}
+
+PackedVertex pack_vertex(const Vertex& vertex, const VertexQuantization& quantization) {
+    PackedVertex packed = {};
+    for(u32 i = 0; i != 3; ++i) {
+        const float scale = quantization.scale[i];
+        packed.position[i] = to_unorm16(scale > 0.0f ? (vertex.position[i] - quantization.offset[i]) / scale : 0.0f);
+    }
+    packed.position[3] = vertex.tangent_bitangent_sign.w < 0.0f ? 0 : 65535;
+
+    encode_unit_vector(vertex.normal, packed.normal);
+    encode_unit_vector(glm::vec3(vertex.tangent_bitangent_sign), packed.tangent);
+
+    packed.uv[0] = glm::packHalf1x16(vertex.uv.x);
+    packed.uv[1] = glm::packHalf1x16(vertex.uv.y);
+
+    packed.color[0] = to_unorm8(vertex.color.r);
+    packed.color[1] = to_unorm8(vertex.color.g);
+    packed.color[2] = to_unorm8(vertex.color.b);
+    packed.color[3] = 255;
+    return packed;
+}
+
+Vertex unpack_vertex(const PackedVertex& packed, const VertexQuantization& quantization) {
+    const glm::vec3 position(from_unorm16(packed.position[0]), from_unorm16(packed.position[1]), from_unorm16(packed.position[2]));
+
+    Vertex vertex;
+    vertex.position = quantization.offset + position * quantization.scale;
+    vertex.normal = octahedral_decode(glm::vec2(from_snorm16(packed.normal[0]), from_snorm16(packed.normal[1])));
+    vertex.uv = glm::vec2(glm::unpackHalf1x16(packed.uv[0]), glm::unpackHalf1x16(packed.uv[1]));
+    vertex.tangent_bitangent_sign = glm::vec4(octahedral_decode(glm::vec2(from_snorm16(packed.tangent[0]), from_snorm16(packed.tangent[1]))),
+                                              from_unorm16(packed.position[3]) > 0.5f ? 1.0f : -1.0f);
+    vertex.color = glm::vec3(packed.color[0], packed.color[1], packed.color[2]) / 255.0f;
+    return vertex;
+}
+
+}
@@ -1,6 +1,8 @@
 #ifndef VERTEX_H
 #define VERTEX_H
 
+#include <utils.h>
+
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 #include <glm/vec4.hpp>
@@ -15,6 +17,40 @@ struct Vertex {
     glm::vec3 color = glm::vec3(1.0f, 1.0f, 1.0f); // to avoid completly black meshes if no color is present
 };
 
+enum class VertexFormat : u32 {
+    // Vertex, 60 bytes
+    Full,
+    // PackedVertex, 24 bytes
+    Packed,
+};
+
+// Quantized vertex, decoded by the vertex attribute formats and basic.vert
+struct PackedVertex {
+    u16 position[4];    // Unorm16 in the mesh bounding box, w is the bitangent sign (0 for -1, 65535 for 1)
+    i16 normal[2];      // Snorm16 octahedral encoding
+    i16 tangent[2];     // Snorm16 octahedral encoding
+    u16 uv[2];          // Half floats
+    u8 color[4];        // RGBA8 unorm
+};
+
+static_assert(sizeof(PackedVertex) == 24);
+
+// Packed positions are decoded as offset + unorm_position * scale
+struct VertexQuantization {
+    glm::vec3 offset = glm::vec3(0.0f);
+    glm::vec3 scale = glm::vec3(1.0f);
+
+    static VertexQuantization from_vertices(Span<const Vertex> vertices);
+};
+
+PackedVertex pack_vertex(const Vertex& vertex, const VertexQuantization& quantization);
+// Same decoding as the GPU, the w component of the color is dropped
+Vertex unpack_vertex(const PackedVertex& vertex, const VertexQuantization& quantization);
+
+// Maps unit vectors to the [-1, 1] square by projecting them on an octahedron and folding its lower half
+glm::vec2 octahedral_encode(const glm::vec3& v);
+glm::vec3 octahedral_decode(const glm::vec2& e);
+
 }
 
 #endif // VERTEX_H
@@ -0,0 +1,144 @@
+#include "VertexArray.h"
+
+#include <GLState.h>
+
+#include <glad/gl.h>
+
+#include <memory>
+#include <unordered_map>
+
+namespace OM3D {
+
+static GLenum attribute_type_to_gl(AttributeType type) {
+    switch(type) {
+        case AttributeType::Float:
+            return GL_FLOAT;
+
+        case AttributeType::HalfFloat:
+            return GL_HALF_FLOAT;
+
+        case AttributeType::U8:
+            return GL_UNSIGNED_BYTE;
+
+        case AttributeType::I16:
+            return GL_SHORT;
+
+        case AttributeType::U16:
+            return GL_UNSIGNED_SHORT;
+
+        case AttributeType::U32:
+            return GL_UNSIGNED_INT;
+    }
+    FATAL("Unknown attribute type");
+}
+
+static GLuint create_vertex_array_handle() {
+    GLuint handle = 0;
+    glCreateVertexArrays(1, &handle);
+    return handle;
+}
+
+static u32 vertex_array_count = 0;
+
+bool VertexAttribute::operator==(const VertexAttribute& other) const {
+    return location == other.location &&
+           binding == other.binding &&
+           type == other.type &&
+           components == other.components &&
+           kind == other.kind &&
+           offset == other.offset;
+}
+
+bool VertexBinding::operator==(const VertexBinding& other) const {
+    return stride == other.stride && divisor == other.divisor;
+}
+
+u64 VertexLayout::hash() const {
+    u64 h = u64(bindings.size());
+    for(const VertexBinding& binding : bindings) {
+        hash_combine(h, u64(binding.stride));
+        hash_combine(h, u64(binding.divisor));
+    }
+    for(const VertexAttribute& attribute : attributes) {
+        hash_combine(h, u64(attribute.location));
+        hash_combine(h, u64(attribute.binding));
+        hash_combine(h, u64(attribute.type));
+        hash_combine(h, u64(attribute.components));
+        hash_combine(h, u64(attribute.kind));
+        hash_combine(h, u64(attribute.offset));
+    }
+    return h;
+}
+
+bool VertexLayout::operator==(const VertexLayout& other) const {
+    return bindings == other.bindings && attributes == other.attributes;
+}
+
+const VertexArray& VertexArray::get(const VertexLayout& layout) {
+    struct Hasher {
+        size_t operator()(const VertexLayout& layout) const {
+            return size_t(layout.hash());
+        }
+    };
+
+    // Never freed: there is one entry per vertex layout, and only a handful of them
+    static std::unordered_map<VertexLayout, std::unique_ptr<VertexArray>, Hasher> vertex_arrays;
+
+    auto& vertex_array = vertex_arrays[layout];
+    if(!vertex_array) {
+        vertex_array.reset(new VertexArray(layout));
+    }
+    return *vertex_array;
+}
+
+u32 VertexArray::cached_count() {
+    return vertex_array_count;
+}
+
+VertexArray::VertexArray(VertexLayout layout) : _layout(std::move(layout)), _handle(create_vertex_array_handle()) {
+    const u32 handle = _handle.get();
+    for(const VertexAttribute& attribute : _layout.attributes) {
+        DEBUG_ASSERT(attribute.binding < _layout.bindings.size());
+
+        const GLenum type = attribute_type_to_gl(attribute.type);
+        if(attribute.kind == AttributeKind::Integer) {
+            glVertexArrayAttribIFormat(handle, attribute.location, attribute.components, type, attribute.offset);
+        } else {
+            glVertexArrayAttribFormat(handle, attribute.location, attribute.components, type, attribute.kind == AttributeKind::Normalized, attribute.offset);
+        }
+        glVertexArrayAttribBinding(handle, attribute.location, attribute.binding);
+        glEnableVertexArrayAttrib(handle, attribute.location);
+    }
+
+    for(u32 i = 0; i != _layout.bindings.size(); ++i) {
+        glVertexArrayBindingDivisor(handle, i, _layout.bindings[i].divisor);
+    }
+
+    ++vertex_array_count;
+}
+
+VertexArray::~VertexArray() {
+    if(auto handle = _handle.get()) {
+        forget_vertex_array(handle);
+        glDeleteVertexArrays(1, &handle);
+    }
+}
+
+void VertexArray::bind() const {
+    bind_vertex_array(_handle.get());
+}
+
+void VertexArray::bind_vertex_buffer(u32 binding, u32 buffer, size_t offset) const {
+    DEBUG_ASSERT(binding < _layout.bindings.size());
+    OM3D::bind_vertex_buffer(_handle.get(), binding, buffer, offset, _layout.bindings[binding].stride);
+}
+
+void VertexArray::bind_index_buffer(u32 buffer) const {
+    bind_element_buffer(_handle.get(), buffer);
+}
+
+const VertexLayout& VertexArray::layout() const {
+    return _layout;
+}
+
+}
@@ -0,0 +1,137 @@
+#ifndef VERTEXARRAY_H
+#define VERTEXARRAY_H
+
+#include <graphics.h>
+
+#include <vector>
+
+namespace OM3D {
+
+enum class AttributeType : u32 {
+    Float,
+    HalfFloat,
+    U8,
+    I16,
+    U16,
+    U32,
+};
+
+// How the vertex shader reads the attribute
+enum class AttributeKind : u32 {
+    Float,      // Converted to float as is
+    Normalized, // Mapped to [0; 1], or [-1; 1] for signed types
+    Integer,    // Read as an integer (uint or int in the shader)
+};
+
+constexpr u32 attribute_type_size(AttributeType type) {
+    switch(type) {
+        case AttributeType::U8:
+            return 1;
+
+        case AttributeType::HalfFloat:
+        case AttributeType::I16:
+        case AttributeType::U16:
+            return 2;
+
+        default:
+            return 4;
+    }
+}
+
+struct VertexAttribute {
+    u32 location = 0;
+    u32 binding = 0;
+    AttributeType type = AttributeType::Float;
+    u32 components = 0;
+    AttributeKind kind = AttributeKind::Float;
+    u32 offset = 0;
+
+    bool operator==(const VertexAttribute& other) const;
+};
+
+// Vertex buffer binding point, divisor is 0 for per vertex data and n for data advancing every n instances
+struct VertexBinding {
+    u32 stride = 0;
+    u32 divisor = 0;
+
+    bool operator==(const VertexBinding& other) const;
+};
+
+struct VertexLayout {
+    std::vector<VertexBinding> bindings;
+    std::vector<VertexAttribute> attributes;
+
+    u64 hash() const;
+    bool operator==(const VertexLayout& other) const;
+};
+
+// Compile time attribute lists, see GeometryBuffer.cpp:
+//   VertexArray::get<VertexStream<sizeof(Vertex), 0, Attribute<0, AttributeType::Float, 3, offsetof(Vertex, position)>, ...>, ...>()
+// Every stream reads from its own binding point, in order.
+template<u32 Location, AttributeType Type, u32 Components, size_t Offset, AttributeKind Kind = AttributeKind::Float>
+struct Attribute {
+    static_assert(Components >= 1 && Components <= 4, "Attributes have between 1 and 4 components");
+    static_assert(Kind != AttributeKind::Integer || (Type != AttributeType::Float && Type != AttributeType::HalfFloat), "Integer attributes need an integer type");
+
+    static constexpr u32 location = Location;
+    static constexpr size_t end = Offset + Components * attribute_type_size(Type);
+
+    static constexpr VertexAttribute description(u32 binding) {
+        return VertexAttribute{Location, binding, Type, Components, Kind, u32(Offset)};
+    }
+};
+
+template<size_t Stride, u32 Divisor, typename... Attributes>
+struct VertexStream {
+    static_assert(((Attributes::end <= Stride) && ...), "Attribute outside of the vertex");
+
+    static void add_to(VertexLayout& layout) {
+        const u32 binding = u32(layout.bindings.size());
+        layout.bindings.push_back(VertexBinding{u32(Stride), Divisor});
+        (layout.attributes.push_back(Attributes::description(binding)), ...);
+    }
+};
+
+template<typename... Streams>
+VertexLayout make_vertex_layout() {
+    VertexLayout layout;
+    (Streams::add_to(layout), ...);
+    return layout;
+}
+
+// Vertex array object realizing a vertex layout, created once with DSA and shared by everything using the same layout.
+// Drawing only rebinds the vertex array and the buffers that changed, the attribute formats are never specified again.
+class VertexArray : NonMovable {
+    public:
+        // Cached by layout hash
+        static const VertexArray& get(const VertexLayout& layout);
+
+        template<typename... Streams>
+        static const VertexArray& get() {
+            // Only hashes the layout on first use
+            static const VertexArray& vertex_array = get(make_vertex_layout<Streams...>());
+            return vertex_array;
+        }
+
+        // Number of vertex arrays created so far, one per distinct layout
+        static u32 cached_count();
+
+        ~VertexArray();
+
+        void bind() const;
+
+        void bind_vertex_buffer(u32 binding, u32 buffer, size_t offset = 0) const;
+        void bind_index_buffer(u32 buffer) const;
+
+        const VertexLayout& layout() const;
+
+    private:
+        VertexArray(VertexLayout layout);
+
+        VertexLayout _layout;
+        GLHandle _handle;
+};
+
+}
+
+#endif // VERTEXARRAY_H
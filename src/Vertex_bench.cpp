@@ -0,0 +1,96 @@
+#include "Vertex.h"
+#include "MeshOptimizer.h"
+
+#include <benchmarks.h>
+
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <algorithm>
+
+namespace OM3D {
+
+void bench_vertex_packing() {
+    std::cout << "Packed vertices (" << sizeof(Vertex) << " -> " << sizeof(PackedVertex) << " bytes)" << std::endl;
+
+    // Every direction must survive the octahedral encoding
+    {
+        float max_error = 0.0f;
+        std::mt19937 rng(0x5EED);
+        std::normal_distribution<float> gaussian;
+        for(u32 i = 0; i != 100000; ++i) {
+            const glm::vec3 v = glm::normalize(glm::vec3(gaussian(rng), gaussian(rng), gaussian(rng)));
+            max_error = std::max(max_error, glm::length(octahedral_decode(octahedral_encode(v)) - v));
+        }
+        std::cout << "  octahedral round trip: " << std::setprecision(7) << max_error << " max error" << std::setprecision(3) << check_result(max_error < 1.0e-5f) << std::endl;
+    }
+
+    for(const u32 subdivisions : {5, 7}) {
+        // Large model, with every attribute filled
+        MeshData mesh = bumpy_sphere(subdivisions);
+        std::mt19937 rng(0x5EED);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        for(Vertex& vertex : mesh.vertices) {
+            const glm::vec3 n = glm::normalize(vertex.position);
+            vertex.position *= 50.0f;
+            vertex.normal = n;
+            vertex.uv = glm::vec2(std::atan2(n.z, n.x) * 4.0f, std::acos(glm::clamp(n.y, -1.0f, 1.0f)) * 4.0f);
+            const glm::vec3 tangent = std::abs(n.y) < 0.999f ? glm::normalize(glm::cross(glm::vec3(0.0f, 1.0f, 0.0f), n)) : glm::vec3(1.0f, 0.0f, 0.0f);
+            vertex.tangent_bitangent_sign = glm::vec4(tangent, unit(rng) < 0.5f ? -1.0f : 1.0f);
+            vertex.color = glm::vec3(unit(rng), unit(rng), unit(rng));
+        }
+        mesh.optimize();
+
+        const VertexQuantization quantization = VertexQuantization::from_vertices(mesh.vertices);
+        std::vector<PackedVertex> packed(mesh.vertices.size());
+        const double pack_time = time_ms([&] {
+            for(size_t i = 0; i != mesh.vertices.size(); ++i) {
+                packed[i] = pack_vertex(mesh.vertices[i], quantization);
+            }
+        });
+
+        glm::vec3 max_position_error(0.0f);
+        float max_normal_angle = 0.0f;
+        float max_tangent_angle = 0.0f;
+        float max_uv_error = 0.0f;
+        float max_color_error = 0.0f;
+        bool signs = true;
+        auto angle = [](const glm::vec3& a, const glm::vec3& b) {
+            return glm::degrees(2.0f * std::asin(std::min(glm::length(a - b) * 0.5f, 1.0f)));
+        };
+        for(size_t i = 0; i != mesh.vertices.size(); ++i) {
+            const Vertex& vertex = mesh.vertices[i];
+            const Vertex unpacked = unpack_vertex(packed[i], quantization);
+            max_position_error = glm::max(max_position_error, glm::abs(unpacked.position - vertex.position));
+            max_normal_angle = std::max(max_normal_angle, angle(unpacked.normal, vertex.normal));
+            max_tangent_angle = std::max(max_tangent_angle, angle(glm::vec3(unpacked.tangent_bitangent_sign), glm::vec3(vertex.tangent_bitangent_sign)));
+            // Half floats have 11 significant bits
+            max_uv_error = std::max(max_uv_error, glm::length(unpacked.uv - vertex.uv) / std::max(glm::length(vertex.uv), 1.0f));
+            max_color_error = std::max(max_color_error, glm::length(unpacked.color - vertex.color));
+            signs &= unpacked.tangent_bitangent_sign.w == vertex.tangent_bitangent_sign.w;
+        }
+
+        // Positions are within half a quantization step, directions within a hundredth of a degree
+        const glm::vec3 half_step = quantization.scale / 65535.0f * 0.5f;
+        const bool valid = signs
+                && glm::all(glm::lessThanEqual(max_position_error, half_step * 1.01f))
+                && max_normal_angle < 0.01f && max_tangent_angle < 0.01f
+                && max_uv_error < 1.0f / 1024.0f && max_color_error < 1.0f / 255.0f;
+
+        // Bytes fetched by the vertex shader, with the same cache as analyze_vertex_cache
+        const VertexCacheStats cache = analyze_vertex_cache(mesh.indices, mesh.vertices.size());
+        const double fetched_vertices = double(cache.acmr) * double(mesh.indices.size() / 3);
+        auto mb = [](double bytes) { return bytes / (1024.0 * 1024.0); };
+
+        std::cout << "  " << std::setw(6) << mesh.vertices.size() << " vertices (" << mesh.indices.size() / 3 << " triangles): "
+                  << "packed in " << pack_time << "ms, "
+                  << "buffer " << std::setprecision(2) << mb(double(mesh.vertices.size() * sizeof(Vertex))) << " -> " << mb(double(packed.size() * sizeof(PackedVertex))) << "MB, "
+                  << "fetched per draw " << mb(fetched_vertices * sizeof(Vertex)) << " -> " << mb(fetched_vertices * sizeof(PackedVertex)) << "MB" << std::setprecision(3)
+                  << check_result(valid) << std::endl;
+        std::cout << "    max errors: position " << std::setprecision(5) << glm::length(max_position_error) << " (extent " << std::setprecision(1) << glm::length(quantization.scale) << std::setprecision(5) << "), "
+                  << "normal " << max_normal_angle << " deg, tangent " << max_tangent_angle << " deg, "
+                  << "uv " << max_uv_error << ", color " << max_color_error << std::setprecision(3) << std::endl;
+    }
+}
+
+}
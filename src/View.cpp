@@ -0,0 +1,46 @@
+#include "View.h"
+
+namespace OM3D {
+
+View::View(const Camera& camera) {
+    set_camera(camera);
+}
+
+void View::set_camera(const Camera& camera) {
+    _camera = camera;
+    _frustum = _camera.build_frustum();
+}
+
+const Camera& View::camera() const {
+    return _camera;
+}
+
+const Frustum& View::frustum() const {
+    return _frustum;
+}
+
+Span<const u32> View::visible_objects() const {
+    return _visible_objects;
+}
+
+Span<const u32> View::visible_lights() const {
+    return _visible_lights;
+}
+
+const OcclusionCuller::Stats& View::occlusion_stats() const {
+    return _occlusion_stats;
+}
+
+const View::LodStats& View::lod_stats() const {
+    return _lod_stats;
+}
+
+const RenderQueue& View::render_queue() const {
+    return _render_queue;
+}
+
+const LightClusters& View::light_clusters() const {
+    return _light_clusters;
+}
+
+}
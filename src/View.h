@@ -0,0 +1,70 @@
+#ifndef VIEW_H
+#define VIEW_H
+
+#include <Camera.h>
+#include <LightClusters.h>
+#include <OcclusionCuller.h>
+#include <RenderQueue.h>
+#include <StreamBuffer.h>
+#include <StaticMesh.h>
+
+#include <array>
+#include <vector>
+
+namespace OM3D {
+
+// A camera and everything visible from it.
+// Visibility is computed once per frame by Scene::cull and then shared by every pass rendering the view.
+class View {
+    public:
+        struct LodStats {
+            u32 small_culled = 0; // Objects covering less than a pixel
+            std::array<u32, MeshData::max_lod_count> objects = {}; // Visible objects drawn at each level
+        };
+
+        View() = default;
+        View(const Camera& camera);
+
+        void set_camera(const Camera& camera);
+
+        const Camera& camera() const;
+        const Frustum& frustum() const;
+
+        Span<const u32> visible_objects() const;
+        Span<const u32> visible_lights() const;
+
+        // Objects rejected by occlusion culling are not in visible_objects()
+        const OcclusionCuller::Stats& occlusion_stats() const;
+
+        // Levels of detail picked for the visible objects, when selected on the CPU
+        const LodStats& lod_stats() const;
+
+        // Visible objects as draw packets, in submission order
+        const RenderQueue& render_queue() const;
+
+        // Visible lights binned for the forward lighting path
+        const LightClusters& light_clusters() const;
+
+    private:
+        friend class Scene;
+
+        Camera _camera;
+        Frustum _frustum = {};
+
+        std::vector<u32> _visible_objects;
+        std::vector<u32> _visible_lights;
+
+        OcclusionCuller::Stats _occlusion_stats;
+        LodStats _lod_stats;
+
+        RenderQueue _render_queue;
+        LightClusters _light_clusters;
+
+        // Object index of every packet, read through the object index attribute. Only valid for the frame of the cull.
+        mutable StreamRange _object_indices;
+        mutable bool _object_indices_dirty = false;
+};
+
+}
+
+#endif // VIEW_H
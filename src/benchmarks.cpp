@@ -0,0 +1,96 @@
+#include "benchmarks.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <iostream>
+#include <iomanip>
+#include <random>
+
+namespace OM3D {
+
+static u32 failed_checks = 0;
+
+const char* check_result(bool ok, const char* failure) {
+    if(!ok) {
+        ++failed_checks;
+    }
+    return ok ? "" : failure;
+}
+
+std::vector<AABB> random_boxes(size_t count, u32 seed) {
+    std::mt19937 rng(seed);
+
+    // Keep the density constant so that roughly the same fraction is visible at every scale
+    const float half_side = 10.0f * std::cbrt(float(count));
+    std::uniform_real_distribution<float> pos(-half_side, half_side);
+    std::uniform_real_distribution<float> size(0.25f, 2.0f);
+
+    std::vector<AABB> boxes(count);
+    for(AABB& box : boxes) {
+        const glm::vec3 center(pos(rng), pos(rng), pos(rng));
+        const glm::vec3 extent(size(rng), size(rng), size(rng));
+        box = AABB{center - extent, center + extent};
+    }
+    return boxes;
+}
+
+Camera benchmark_camera() {
+    Camera camera;
+    camera.set_view(glm::lookAt(glm::vec3(0.0f), glm::vec3(1.0f, 0.2f, 0.5f), glm::vec3(0.0f, 1.0f, 0.0f)));
+    return camera;
+}
+
+MeshData bumpy_sphere(u32 subdivisions) {
+    MeshData mesh = MeshData::icosphere(subdivisions);
+    for(Vertex& vertex : mesh.vertices) {
+        const glm::vec3 n = glm::normalize(vertex.position);
+        vertex.position = n * (1.0f + 0.05f * std::sin(8.0f * n.x) * std::sin(8.0f * n.y) * std::sin(8.0f * n.z));
+    }
+    return mesh;
+}
+
+MeshData flat_grid(u32 size) {
+    MeshData mesh;
+    for(u32 y = 0; y <= size; ++y) {
+        for(u32 x = 0; x <= size; ++x) {
+            Vertex vertex = {};
+            vertex.position = glm::vec3(float(x), 0.0f, float(y)) / float(size);
+            vertex.normal = glm::vec3(0.0f, 1.0f, 0.0f);
+            vertex.uv = glm::vec2(vertex.position.x, vertex.position.z);
+            mesh.vertices.push_back(vertex);
+        }
+    }
+    for(u32 y = 0; y != size; ++y) {
+        for(u32 x = 0; x != size; ++x) {
+            const u32 i = y * (size + 1) + x;
+            mesh.indices.insert(mesh.indices.end(), {i, i + size + 1, i + 1,  i + 1, i + size + 1, i + size + 2});
+        }
+    }
+    return mesh;
+}
+
+u32 run_benchmarks() {
+    failed_checks = 0;
+
+    std::cout << std::fixed << std::setprecision(3);
+    bench_bvh_culling();
+    bench_sphere_culling();
+    bench_occlusion_culling();
+    bench_render_queue();
+    bench_instancing();
+    bench_light_clusters();
+    bench_scene_graph();
+    bench_loose_octree();
+    bench_mesh_simplification();
+    bench_mesh_optimization();
+    bench_vertex_packing();
+    bench_meshlets();
+    bench_range_allocator();
+    bench_import_pipeline();
+    bench_scene_cache();
+
+    std::cout << (failed_checks ? std::to_string(failed_checks) + " failed checks" : "All checks passed") << std::endl;
+    return failed_checks;
+}
+
+}
@@ -0,0 +1,56 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include <Camera.h>
+#include <StaticMesh.h>
+
+#include <utils.h>
+
+#include <vector>
+
+namespace OM3D {
+
+// CPU only benchmarks, run with --bench
+// Returns the number of failed checks
+u32 run_benchmarks();
+
+// Benchmarks of each module live next to it, in <Module>_bench.cpp
+void bench_bvh_culling();
+void bench_sphere_culling();
+void bench_occlusion_culling();
+void bench_render_queue();
+void bench_instancing();
+void bench_light_clusters();
+void bench_scene_graph();
+void bench_loose_octree();
+void bench_mesh_simplification();
+void bench_mesh_optimization();
+void bench_vertex_packing();
+void bench_meshlets();
+void bench_range_allocator();
+void bench_import_pipeline();
+void bench_scene_cache();
+
+// Counts the check as failed if it isn't ok, returns what to print after its result
+const char* check_result(bool ok, const char* failure = " ERROR");
+
+template<typename F>
+double time_ms(F&& func, u32 iterations = 1) {
+    const double start = program_time();
+    for(u32 i = 0; i != iterations; ++i) {
+        func();
+    }
+    return (program_time() - start) * 1000.0 / double(iterations);
+}
+
+std::vector<AABB> random_boxes(size_t count, u32 seed = 0x5EED);
+Camera benchmark_camera();
+
+// Icosphere with bumps, so that simplification has something to remove
+MeshData bumpy_sphere(u32 subdivisions);
+// Flat square with an open border
+MeshData flat_grid(u32 size);
+
+}
+
+#endif // BENCHMARKS_H
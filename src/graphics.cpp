@@ -1,5 +1,7 @@
 #include "graphics.h"
 
+#include <VertexArray.h>
+
 #include <glad/gl.h>
 
 #define GLFW_INCLUDE_NONE
@@ -37,6 +39,9 @@ u32 buffer_usage_to_gl(BufferUsage usage) {
 
         case BufferUsage::Storage:
             return GL_SHADER_STORAGE_BUFFER;
+
+        case BufferUsage::Indirect:
+            return GL_DRAW_INDIRECT_BUFFER;
     }
 
     FATAL("Unknown usage value");
@@ -99,9 +104,14 @@ void init_graphics() {
     glActiveTexture(GL_TEXTURE0);
     glEnable(GL_FRAMEBUFFER_SRGB);
 
-    GLuint global_vao = 0;
-    glGenVertexArrays(1, &global_vao);
-    glBindVertexArray(global_vao);
+    // Vertex arrays are created per vertex layout (see VertexArray), every draw binds the one it reads from
+    VertexArray::get<>().bind();
+}
+
+void draw_full_screen_triangle() {
+    // Positions come from gl_VertexID, no attribute is read
+    VertexArray::get<>().bind();
+    glDrawArrays(GL_TRIANGLES, 0, 3);
 }
 
 
@@ -52,6 +52,7 @@ enum class BufferUsage {
     Index,
     Uniform,
     Storage,
+    Indirect,
 };
 
 enum class AccessType {
@@ -67,6 +68,9 @@ u32 align_up_to(u32 val, u32 up_to);
 
 void init_graphics();
 
+// Full screen passes draw a single triangle covering the viewport, using the empty vertex layout
+void draw_full_screen_triangle();
+
 bool bindless_enabled();
 
 void audit_bindings();
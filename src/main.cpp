@@ -5,11 +5,16 @@
 #include <GLFW/glfw3.h>
 
 #include <graphics.h>
+#include <GLState.h>
+#include <StreamBuffer.h>
+#include <VertexArray.h>
 #include <Scene.h>
 #include <Texture.h>
 #include <Framebuffer.h>
+#include <DepthPyramid.h>
 #include <TimestampQuery.h>
 #include <ImGuiRenderer.h>
+#include <benchmarks.h>
 
 #include <imgui/imgui.h>
 
@@ -24,9 +29,12 @@ static float delta_time = 0.0f;
 static std::unique_ptr<Scene> scene;
 static float exposure = 1.0;
 static std::vector<std::string> scene_files;
+static GLCallStats frame_gl_calls;
 
 namespace OM3D {
 extern bool audit_bindings_before_draw;
+extern VertexFormat gltf_vertex_format;
+extern bool scene_cache_enabled;
 }
 
 void parse_args(int argc, char** argv) {
@@ -35,6 +43,13 @@ void parse_args(int argc, char** argv) {
 
         if(arg == "--validate") {
             OM3D::audit_bindings_before_draw = true;
+        } else if(arg == "--packed-vertices") {
+            OM3D::gltf_vertex_format = OM3D::VertexFormat::Packed;
+        } else if(arg == "--no-scene-cache") {
+            OM3D::scene_cache_enabled = false;
+        } else if(arg == "--bench") {
+            // CPU only, doesn't need a window
+            std::exit(run_benchmarks() ? EXIT_FAILURE : EXIT_SUCCESS);
         } else {
             std::cerr << "Unknown argument \"" << arg << "\"" << std::endl;
         }
@@ -108,7 +123,7 @@ void process_inputs(GLFWwindow* window, Camera& camera) {
     mouse_pos = new_mouse_pos;
 }
 
-void gui(ImGuiRenderer& imgui, int& debug_opt) {
+void gui(ImGuiRenderer& imgui, const View& view, int& debug_opt) {
     const ImVec4 error_text_color = ImVec4(1.0f, 0.3f, 0.3f, 1.0f);
     const ImVec4 warning_text_color = ImVec4(1.0f, 0.8f, 0.4f, 1.0f);
 
@@ -143,6 +158,90 @@ void gui(ImGuiRenderer& imgui, int& debug_opt) {
             if(scene && ImGui::BeginMenu("Scene Info")) {
                 ImGui::Text("%u objects", u32(scene->objects().size()));
                 ImGui::Text("%u point lights", u32(scene->point_lights().size()));
+                ImGui::Separator();
+                ImGui::Text("%u visible objects", u32(view.visible_objects().size()));
+                ImGui::Text("%u visible point lights", u32(view.visible_lights().size()));
+
+                const LightClusters::Stats& cluster_stats = view.light_clusters().stats();
+                ImGui::Text("%u light references in %u clusters, max %u per cluster", cluster_stats.light_references, cluster_stats.non_empty_clusters, cluster_stats.max_lights_per_cluster);
+                ImGui::Separator();
+                bool octree_culling = scene->octree_culling();
+                if(ImGui::Checkbox("Octree culling", &octree_culling)) {
+                    scene->set_octree_culling(octree_culling);
+                }
+                bool occlusion_culling = scene->occlusion_culling();
+                if(ImGui::Checkbox("Occlusion culling", &occlusion_culling)) {
+                    scene->set_occlusion_culling(occlusion_culling);
+                }
+                const OcclusionCuller::Stats& occlusion = view.occlusion_stats();
+                ImGui::Text("%u occluders (%u triangles)", occlusion.occluders, occlusion.triangles);
+                ImGui::Text("%u / %u objects occluded", occlusion.occluded, occlusion.tested);
+                ImGui::Separator();
+                bool sort_queue = scene->sort_render_queue();
+                if(ImGui::Checkbox("Sort render queue", &sort_queue)) {
+                    scene->set_sort_render_queue(sort_queue);
+                }
+                bool instancing = scene->instancing();
+                if(ImGui::Checkbox("Instancing", &instancing)) {
+                    scene->set_instancing(instancing);
+                }
+                const RenderQueue::Stats& render_stats = scene->render_stats();
+                ImGui::Text("%u draws for %u objects, %u material binds", render_stats.draws, render_stats.instances, render_stats.material_binds);
+                ImGui::Text("%u program switches, %u texture rebinds, %u geometry binds", render_stats.program_switches, render_stats.texture_rebinds, render_stats.geometry_binds);
+                ImGui::Text("CPU submission: %.3f ms, %.2f ms per 10k draws", render_stats.submit_ms, render_stats.draws ? render_stats.submit_ms * 10000.0f / float(render_stats.draws) : 0.0f);
+                ImGui::Separator();
+                bool lod_selection = scene->lod_selection();
+                if(ImGui::Checkbox("LOD selection", &lod_selection)) {
+                    scene->set_lod_selection(lod_selection);
+                }
+                float lod_pixel_error = scene->lod_pixel_error();
+                if(ImGui::DragFloat("LOD pixel error", &lod_pixel_error, 0.1f, 0.1f, 16.0f, "%.1f")) {
+                    scene->set_lod_pixel_error(lod_pixel_error);
+                }
+                if(!scene->gpu_culling()) {
+                    const View::LodStats& lod_stats = view.lod_stats();
+                    ImGui::Text("%u triangles drawn, %u objects under a pixel", render_stats.triangles, lod_stats.small_culled);
+                    for(u32 i = 0; i != lod_stats.objects.size(); ++i) {
+                        if(lod_stats.objects[i]) {
+                            ImGui::Text("LOD %u: %u objects", i, lod_stats.objects[i]);
+                        }
+                    }
+                }
+                ImGui::Separator();
+                bool gpu_culling = scene->gpu_culling();
+                if(ImGui::Checkbox("GPU Hi-Z culling", &gpu_culling)) {
+                    scene->set_gpu_culling(gpu_culling);
+                }
+                if(gpu_culling) {
+                    const GpuCuller::Stats gpu_stats = scene->gpu_culling_stats();
+                    ImGui::Text("%u objects tested", gpu_stats.tested);
+                    ImGui::Text("%u frustum culled", gpu_stats.frustum_culled);
+                    ImGui::Text("%u occlusion culled", gpu_stats.occlusion_culled);
+                    ImGui::Text("%u visible in late phase", gpu_stats.late_visible);
+                    ImGui::Text("%u under a pixel", gpu_stats.small_culled);
+                    bool meshlet_culling = scene->meshlet_culling();
+                    if(ImGui::Checkbox("Meshlet culling", &meshlet_culling)) {
+                        scene->set_meshlet_culling(meshlet_culling);
+                    }
+                    if(meshlet_culling) {
+                        ImGui::Text("%u meshlets tested", gpu_stats.meshlets_tested);
+                        ImGui::Text("%u frustum, %u cone, %u occlusion culled", gpu_stats.meshlets_frustum_culled, gpu_stats.meshlets_cone_culled, gpu_stats.meshlets_occlusion_culled);
+                    }
+                    ImGui::Text("%u triangles submitted, %u culled", gpu_stats.triangles_submitted, gpu_stats.triangles_culled);
+                }
+                ImGui::Separator();
+                ImGui::Text("%u GL state calls issued, %u filtered", frame_gl_calls.issued, frame_gl_calls.filtered);
+                ImGui::Text("%u vertex arrays (one per vertex layout)", VertexArray::cached_count());
+                const StreamBuffer::Stats& stream_stats = StreamBuffer::global().stats();
+                ImGui::Text("Stream buffer: %u allocations, %.1f / %.1f KB", stream_stats.allocations, float(stream_stats.allocated_bytes) / 1024.0f, float(stream_stats.frame_capacity) / 1024.0f);
+                ImGui::Text("%u stream buffer creations", stream_stats.buffer_creations);
+                const GeometryBuffer& geometry = GeometryBuffer::global();
+                const GeometryBuffer::Stats geometry_stats = geometry.stats();
+                ImGui::Text("Geometry: %u full vertices, %u packed vertices", geometry.vertex_count(), geometry.packed_vertex_count());
+                ImGui::Text("%.1f / %.1f MB used, %.1f MB uploaded, %u growths", float(geometry_stats.used_bytes()) / (1024.0f * 1024.0f),
+                    float(geometry_stats.capacity_bytes()) / (1024.0f * 1024.0f), float(geometry_stats.bytes_uploaded) / (1024.0f * 1024.0f), geometry_stats.buffer_growths);
+                ImGui::Text("Fragmentation: %.0f%% vertices, %.0f%% packed, %.0f%% indices", geometry_stats.vertices.fragmentation() * 100.0f,
+                    geometry_stats.packed_vertices.fragmentation() * 100.0f, geometry_stats.indices.fragmentation() * 100.0f);
                 ImGui::EndMenu();
             }
 
@@ -329,6 +428,7 @@ struct RendererState {
             state.lit_hdr_texture = Texture(size, ImageFormat::RGBA8_sRGB);
             state.tone_mapped_texture = Texture(size, ImageFormat::RGBA8_UNORM);
             state.prepass_framebuffer = Framebuffer(&state.depth_texture, std::array<Texture*, 0>{});
+            state.depth_pyramid = DepthPyramid(size);
             state.color_texture = Texture(size, ImageFormat::RGBA8_sRGB);
             state.sunlight_texture = Texture(size, ImageFormat::RGBA8_sRGB);
             state.normal_texture = Texture(size, ImageFormat::RGBA8_UNORM);
@@ -355,6 +455,8 @@ struct RendererState {
     Texture full_light_texture;
     Texture indirect_light_texture;
 
+    DepthPyramid depth_pyramid;
+
     Framebuffer prepass_framebuffer;
     Framebuffer sunlight_framebuffer;
     Framebuffer main_framebuffer;
@@ -400,12 +502,13 @@ int main(int argc, char** argv) {
     auto blur_program = Program::from_files("blur.frag", "screen.vert");
     RendererState renderer;
 
-    glEnable(GL_CULL_FACE);
-    glCullFace(GL_BACK);
+    set_cull_mode(CullMode::Back);
     glFrontFace(GL_CCW);
 
     int debug_opt = 0;
 
+    View main_view;
+
     for(;;) {
         glfwPollEvents();
         if(glfwWindowShouldClose(window) || glfwGetKey(window, GLFW_KEY_ESCAPE)) {
@@ -413,6 +516,8 @@ int main(int argc, char** argv) {
         }
 
         process_profile_markers();
+        frame_gl_calls = reset_gl_call_stats();
+        StreamBuffer::global().begin_frame();
 
         {
             int width = 0;
@@ -434,19 +539,50 @@ int main(int argc, char** argv) {
         {
             PROFILE_GPU("Frame");
 
+            // Compute visibility once, it is shared by all passes
+            {
+                PROFILE_GPU("Culling");
+                scene->update_transforms();
+                main_view.set_camera(scene->camera());
+                scene->cull(main_view);
+            }
+
             //z prepass
             {
                 PROFILE_GPU("Z-Prepass");
                 renderer.prepass_framebuffer.bind(true,true);
-                scene->zprepass();
+                if(scene->gpu_culling()) {
+                    {
+                        PROFILE_GPU("Early culling");
+                        scene->gpu_cull(main_view, renderer.depth_pyramid, GpuCullPhase::Early);
+                    }
+                    scene->zprepass(main_view, GpuCullPhase::Early);
+                    {
+                        PROFILE_GPU("Depth pyramid");
+                        renderer.depth_pyramid.build(renderer.depth_texture, main_view.camera().view_proj_matrix());
+                    }
+                    {
+                        PROFILE_GPU("Late culling");
+                        scene->gpu_cull(main_view, renderer.depth_pyramid, GpuCullPhase::Late);
+                    }
+                    scene->zprepass(main_view, GpuCullPhase::Late);
+                    {
+                        // Complete depth, reprojected by the next frame
+                        PROFILE_GPU("Depth pyramid");
+                        renderer.depth_pyramid.build(renderer.depth_texture, main_view.camera().view_proj_matrix());
+                    }
+                } else {
+                    scene->zprepass(main_view);
+                }
             }
             // Render the scene
             {
                 PROFILE_GPU("GBuffer pass");
                 //renderer.main_framebuffer.bind(false, true);
-                renderer.g_buffer.bind(true, true);
+                // Keep the depth of the prepass, so that each pixel is shaded once
+                renderer.g_buffer.bind(false, true);
                 gbuffer_program->bind();
-                scene->render();
+                scene->render(main_view, MaterialPass::AfterDepthPrepass);
             }
 
             // Compute light using g buffer and ssao
@@ -459,18 +595,16 @@ int main(int argc, char** argv) {
                     renderer.color_texture.bind(0);
                     renderer.normal_texture.bind(1);
                     renderer.depth_texture.bind(2);
-                    glDrawArrays(GL_TRIANGLES, 0, 3);
+                    draw_full_screen_triangle();
                 }
                 else { // render lights
-
-                    glCullFace(GL_FRONT);
-                    glDepthMask(GL_TRUE);
                     renderer.main_framebuffer.bind(true, true);
                     renderer.color_texture.bind(0);
                     renderer.normal_texture.bind(1);
                     renderer.depth_texture.bind(2);
-                    scene->render_lights(renderer.size);
-                    glCullFace(GL_BACK);
+                    scene->render_lights(main_view, renderer.size);
+                    // Light volumes are culled front faces, the full screen passes below need back face culling
+                    set_cull_mode(CullMode::Back);
                 }
                 //renderer.g_buffer.blit();
             }
@@ -484,7 +618,7 @@ int main(int argc, char** argv) {
                 renderer.lit_hdr_texture.bind(0);
                 renderer.normal_texture.bind(1);
                 renderer.depth_texture.bind(2);
-                glDrawArrays(GL_TRIANGLES, 0, 3);
+                draw_full_screen_triangle();
                 // glPopDebugGroup();
             }
 
@@ -495,7 +629,7 @@ int main(int argc, char** argv) {
                 renderer.indirect_light_texture.bind(0);
                 renderer.lit_hdr_texture.bind(1);
                 renderer.depth_texture.bind(2);
-                glDrawArrays(GL_TRIANGLES, 0, 3);
+                draw_full_screen_triangle();
             }
 
             // Apply a tonemap in compute shader
@@ -505,25 +639,24 @@ int main(int argc, char** argv) {
                 tonemap_program->bind();
                 tonemap_program->set_uniform(HASH("exposure"), exposure);
                 renderer.full_light_texture.bind(0);
-                glDrawArrays(GL_TRIANGLES, 0, 3);
+                draw_full_screen_triangle();
             }   
 
             // Blit tonemap result to screen
             {
                 PROFILE_GPU("Blit pass");
 
-                glBindFramebuffer(GL_FRAMEBUFFER, 0);
+                bind_framebuffer(0);
                 renderer.tone_map_framebuffer.blit();
             }
 
             glClear(GL_DEPTH_BUFFER_BIT);
             // Draw GUI on top
 
-            glDisable(GL_CULL_FACE);
-            gui(imgui, debug_opt);
-            glEnable(GL_CULL_FACE);
+            gui(imgui, main_view, debug_opt);
         }
 
+        StreamBuffer::global().end_frame();
         glfwSwapBuffers(window);
     }
 